@@ -1,175 +1,293 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
-#include <ArduinoJson.h>
-#include <Ticker.h>
+#include "gpio_core.h"
+#include "gpio_web.h"
 
 const char* ssid = "SENSORFLOW";
 const char* password = "12345678";
 
 AsyncWebServer server(8080);
-Ticker scheduler;
-Ticker resetScheduler;
-
-struct OperationArgs {
-  int gpio;
-  String state;
-  int duration;
-};
-
-OperationArgs operationArgs;
-
-void resetOperation() {
-  if (operationArgs.state == "high" || operationArgs.state.startsWith("pwm")) {
-    digitalWrite(operationArgs.gpio, LOW); // Reset pin to LOW after duration
-  } else if (operationArgs.state == "low") {
-    digitalWrite(operationArgs.gpio, HIGH); // Reset pin to HIGH after duration
-  }
-}
-
-void scheduleOperation() {
-  pinMode(operationArgs.gpio, OUTPUT);
-  if (operationArgs.state == "high") {
-    digitalWrite(operationArgs.gpio, HIGH);
-  } else if (operationArgs.state == "low") {
-    digitalWrite(operationArgs.gpio, LOW);
-  } else if (operationArgs.state.startsWith("pwm")) {
-    int pwmValue = operationArgs.state.substring(3).toInt();
-    ledcAttachPin(operationArgs.gpio, operationArgs.gpio);
-    ledcSetup(operationArgs.gpio, 5000, 8);
-    ledcWrite(operationArgs.gpio, pwmValue);
-  }
-
-  if (operationArgs.duration > 0) {
-    resetScheduler.once_ms(operationArgs.duration, resetOperation); // Schedule reset after duration
-  }
-}
 
 void setup() {
+  ledcPoolBegin();
+  actuationBegin();
+
   Serial.begin(115200);
 
-  // Connect to Wi-Fi
-  WiFi.begin(ssid, password);
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(1000);
-    Serial.println("Connecting to WiFi...");
-  }
-  Serial.println("Connected to WiFi");
-  Serial.println(WiFi.localIP());
+  // Join Wi-Fi in the background; routes are registered meanwhile and
+  // answer as soon as the link is up
+  wifiBegin();
+
+  // Start the scheduler
+  schedulerBegin();
 
   // Set GPIO
   server.on("/setgpio", HTTP_GET, [](AsyncWebServerRequest *request){
     if (request->hasParam("gpio") && request->hasParam("state")) {
       int gpio = request->getParam("gpio")->value().toInt();
-      String state = request->getParam("state")->value();
-
-      if (gpio >= 0 && gpio <= 33) { // Assuming GPIO 0-33 for ESP32
-        pinMode(gpio, OUTPUT); // Set the pin mode dynamically
-        if (state == "high") {
-          digitalWrite(gpio, HIGH);
-          DynamicJsonDocument jsonResponse(1024);
-          jsonResponse["gpio"] = gpio;
-          jsonResponse["state"] = "HIGH";
-          jsonResponse["status"] = "success";
-          String response;
-          serializeJson(jsonResponse, response);
-          request->send(200, "application/json", response);
-        } else if (state == "low") {
-          digitalWrite(gpio, LOW);
-          DynamicJsonDocument jsonResponse(1024);
-          jsonResponse["gpio"] = gpio;
-          jsonResponse["state"] = "LOW";
-          jsonResponse["status"] = "success";
-          String response;
-          serializeJson(jsonResponse, response);
-          request->send(200, "application/json", response);
-        } else if (state.startsWith("pwm")) {
-          int pwmValue = state.substring(3).toInt();
-          ledcAttachPin(gpio, gpio); // Attach PWM to the pin
-          ledcSetup(gpio, 5000, 8); // 5 kHz PWM with 8-bit resolution
-          ledcWrite(gpio, pwmValue);
-          DynamicJsonDocument jsonResponse(1024);
-          jsonResponse["gpio"] = gpio;
-          jsonResponse["state"] = "PWM";
-          jsonResponse["pwm_value"] = pwmValue;
-          jsonResponse["status"] = "success";
-          String response;
-          serializeJson(jsonResponse, response);
-          request->send(200, "application/json", response);
+      const String &state = request->getParam("state")->value();
+      uint32_t frequency = request->hasParam("freq") ? request->getParam("freq")->value().toInt() : PWM_DEFAULT_FREQ;
+      int resolution = request->hasParam("res") ? request->getParam("res")->value().toInt() : PWM_DEFAULT_RESOLUTION;
+
+      if (pinCanOutput(gpio)) {
+        GpioCommand cmd;
+        if (!decodeCommand(gpio, state.c_str(), cmd, frequency, resolution)) {
+          sendJson(request, 400, "{\"error\":\"Invalid state value\",\"status\":\"failure\"}");
+          return;
+        }
+        if (refuseFailed(request, executeCommand(cmd))) {
+          return;
+        }
+        if (cmd.op == OP_PWM) {
+          sendJsonf(request, 200, "{\"gpio\":%d,\"state\":\"PWM\",\"pwm_value\":%u,\"frequency\":%u,\"resolution\":%u,\"status\":\"success\"}",
+                    gpio, cmd.duty, cmd.frequency, cmd.resolution);
         } else {
-          request->send(400, "application/json", "{\"error\":\"Invalid state value\",\"status\":\"failure\"}");
+          sendJsonf(request, 200, "{\"gpio\":%d,\"state\":\"%s\",\"status\":\"success\"}",
+                    gpio, cmd.op == OP_HIGH ? "HIGH" : "LOW");
         }
       } else {
-        request->send(400, "application/json", "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}");
+        sendJson(request, 400, "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}");
       }
     } else {
-      request->send(400, "application/json", "{\"error\":\"GPIO or state parameter missing\",\"status\":\"failure\"}");
+      sendJson(request, 400, "{\"error\":\"GPIO or state parameter missing\",\"status\":\"failure\"}");
     }
   });
 
   // Batch Operations
   server.on("/batch", HTTP_GET, [](AsyncWebServerRequest *request){
     if (request->hasParam("operations")) {
-      String operationsParam = request->getParam("operations")->value();
-      DynamicJsonDocument doc(1024);
-      deserializeJson(doc, operationsParam);
-      JsonArray operations = doc.as<JsonArray>();
-
-      for (JsonVariant operation : operations) {
-        int gpio = operation["gpio"];
-        String state = operation["state"];
-        pinMode(gpio, OUTPUT);
-        if (state == "high") {
-          digitalWrite(gpio, HIGH);
-        } else if (state == "low") {
-          digitalWrite(gpio, LOW);
-        } else if (state.startsWith("pwm")) {
-          int pwmValue = state.substring(3).toInt();
-          ledcAttachPin(gpio, gpio);
-          ledcSetup(gpio, 5000, 8);
-          ledcWrite(gpio, pwmValue);
+      const String &operations = request->getParam("operations")->value();
+      BatchParser parser;
+      batchBegin(parser);
+      batchFeed(parser, operations.c_str(), operations.length());
+      sendBatchResult(request, parser);
+    } else {
+      sendJson(request, 400, "{\"error\":\"operations parameter missing\",\"status\":\"failure\"}");
+    }
+  });
+
+  // Batch Operations (POST body, applied while it streams in)
+  server.on("/batch", HTTP_POST, [](AsyncWebServerRequest *request){
+    batchPostResult(request);
+  }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t){
+    batchPostBody(request, data, len, index);
+  });
+
+  // Define Pin Group
+  server.on("/group", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (request->hasParam("name") && request->hasParam("pins")) {
+      const String &name = request->getParam("name")->value();
+      uint32_t mask[GPIO_BANKS];
+      if (name.length() == 0 || name.length() >= GROUP_NAME_LEN) {
+        sendJson(request, 400, "{\"error\":\"Invalid group name\",\"status\":\"failure\"}");
+        return;
+      }
+      if (!parsePinList(request->getParam("pins")->value().c_str(), mask)) {
+        sendJson(request, 400, "{\"error\":\"Invalid pin list\",\"status\":\"failure\"}");
+        return;
+      }
+      PinGroup* group = findPinGroup(name.c_str());
+      if (group == NULL) {
+        if (pinGroupCount == MAX_PIN_GROUPS) {
+          sendJson(request, 507, "{\"error\":\"Too many groups\",\"status\":\"failure\"}");
+          return;
         }
+        group = &pinGroups[pinGroupCount++];
+        strcpy(group->name, name.c_str());
       }
-      request->send(200, "application/json", "{\"status\":\"success\"}");
+      memcpy(group->mask, mask, sizeof(mask));
+      sendJson(request, 200, "{\"status\":\"success\"}");
     } else {
-      request->send(400, "application/json", "{\"error\":\"operations parameter missing\",\"status\":\"failure\"}");
+      sendJson(request, 400, "{\"error\":\"name or pins parameter missing\",\"status\":\"failure\"}");
+    }
+  });
+
+  // LEDC Channel Allocation
+  server.on("/ledc", HTTP_GET, [](AsyncWebServerRequest *request){
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"channels\":[");
+    for (int channel = 0; channel < LEDC_CHANNELS; channel++) {
+      portENTER_CRITICAL(&gpioMux);
+      uint8_t gpio = ledcChannelPin[channel];
+      LedcTimer timer = ledcTimers[channel / 2];
+      portEXIT_CRITICAL(&gpioMux);
+      response->printf("%s{\"channel\":%d,\"gpio\":%d,\"frequency\":%u,\"resolution\":%u}",
+                       channel ? "," : "", channel, gpio == LEDC_NONE ? -1 : gpio,
+                       timer.users ? timer.frequency : 0, timer.users ? timer.resolution : 0);
+    }
+    response->printf("],\"reconfigurations\":%u}", ledcReconfigs);
+    request->send(response);
+  });
+
+  // Actuation Queue
+  server.on("/queue", HTTP_GET, [](AsyncWebServerRequest *request){
+    uint32_t head = __atomic_load_n(&actuationHead, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&actuationTail, __ATOMIC_RELAXED);
+    uint32_t executed = __atomic_load_n(&actuationExecuted, __ATOMIC_RELAXED);
+    uint64_t latencySum = actuationLatencySum;
+    sendJsonf(request, 200, "{\"size\":%d,\"depth\":%u,\"max_depth\":%u,\"enqueued\":%u,\"executed\":%u,"
+              "\"full_waits\":%u,\"dropped\":%u,\"latency_avg_us\":%u,\"latency_max_us\":%u,\"core\":%d}",
+              ACTUATION_QUEUE_SIZE, tail - head, actuationMaxDepth, actuationEnqueued, executed, actuationFullWaits,
+              actuationDropped, executed ? (uint32_t)(latencySum / executed) : 0, actuationLatencyMax, ACTUATION_CORE);
+  });
+
+  // List Pin Groups
+  server.on("/groups", HTTP_GET, [](AsyncWebServerRequest *request){
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"groups\":[");
+    for (int i = 0; i < pinGroupCount; i++) {
+      response->printf("%s{\"name\":\"%s\",\"pins\":[", i ? "," : "", pinGroups[i].name);
+      bool first = true;
+      for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+        if (pinGroups[i].mask[gpio >> 5] & (1UL << (gpio & 31))) {
+          response->printf("%s%d", first ? "" : ",", gpio);
+          first = false;
+        }
+      }
+      response->print("]}");
     }
+    response->print("]}");
+    request->send(response);
+  });
+
+  // List Pin Capabilities
+  server.on("/pins", HTTP_GET, [](AsyncWebServerRequest *request){
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"pins\":[");
+    bool first = true;
+    for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+      uint8_t caps = pinTable[gpio].caps;
+      if (caps == 0) {
+        continue; // no such pin on this chip
+      }
+      response->printf("%s{\"gpio\":%d,\"input\":%s,\"output\":%s,\"strapping\":%s,\"flash\":%s,\"touch\":%s",
+                       first ? "" : ",", gpio, caps & PIN_INPUT ? "true" : "false", caps & PIN_OUTPUT ? "true" : "false",
+                       caps & PIN_STRAPPING ? "true" : "false", caps & PIN_FLASH ? "true" : "false",
+                       caps & PIN_TOUCH ? "true" : "false");
+      if (pinAdcUnit(gpio)) {
+        response->printf(",\"adc_unit\":%d,\"adc_channel\":%d", pinAdcUnit(gpio), pinAdcChannel(gpio));
+      }
+      response->print("}");
+      first = false;
+    }
+    response->print("]}");
+    request->send(response);
   });
 
   // Read GPIO State
   server.on("/readgpio", HTTP_GET, [](AsyncWebServerRequest *request){
     if (request->hasParam("gpio")) {
       int gpio = request->getParam("gpio")->value().toInt();
+      if (!pinCanInput(gpio)) {
+        sendJson(request, 400, "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}");
+        return;
+      }
       int state = digitalRead(gpio);
-      DynamicJsonDocument jsonResponse(1024);
-      jsonResponse["gpio"] = gpio;
-      jsonResponse["state"] = state == HIGH ? "HIGH" : "LOW";
-      String response;
-      serializeJson(jsonResponse, response);
-      request->send(200, "application/json", response);
+      sendJsonf(request, 200, "{\"gpio\":%d,\"state\":\"%s\"}", gpio, state == HIGH ? "HIGH" : "LOW");
     } else {
-      request->send(400, "application/json", "{\"error\":\"gpio parameter missing\",\"status\":\"failure\"}");
+      sendJson(request, 400, "{\"error\":\"gpio parameter missing\",\"status\":\"failure\"}");
     }
   });
 
   // Schedule Operations
   server.on("/schedule", HTTP_GET, [](AsyncWebServerRequest *request){
     if (request->hasParam("gpio") && request->hasParam("state") && request->hasParam("delay")) {
-      operationArgs.gpio = request->getParam("gpio")->value().toInt();
-      operationArgs.state = request->getParam("state")->value();
+      int gpio = request->getParam("gpio")->value().toInt();
+      const String &state = request->getParam("state")->value();
       int delayMs = request->getParam("delay")->value().toInt();
-      operationArgs.duration = request->hasParam("duration") ? request->getParam("duration")->value().toInt() : 0;
+      int duration = request->hasParam("duration") ? request->getParam("duration")->value().toInt() : 0;
+      uint32_t frequency = request->hasParam("freq") ? request->getParam("freq")->value().toInt() : PWM_DEFAULT_FREQ;
+      int resolution = request->hasParam("res") ? request->getParam("res")->value().toInt() : PWM_DEFAULT_RESOLUTION;
+
+      if (!pinCanOutput(gpio)) {
+        sendJson(request, 400, "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}");
+        return;
+      }
+      GpioCommand cmd;
+      if (!decodeCommand(gpio, state.c_str(), cmd, frequency, resolution)) {
+        sendJson(request, 400, "{\"error\":\"Invalid state value\",\"status\":\"failure\"}");
+        return;
+      }
+      if (delayMs < 0 || duration < 0) {
+        sendJson(request, 400, "{\"error\":\"Invalid delay or duration\",\"status\":\"failure\"}");
+        return;
+      }
+      cmd.duration = duration;
 
-      scheduler.once_ms(delayMs, scheduleOperation);
-      request->send(200, "application/json", "{\"status\":\"scheduled\"}");
+      uint32_t id = scheduleAdd(cmd, delayMs);
+      if (id == 0) {
+        sendJson(request, 503, "{\"error\":\"Scheduler full\",\"status\":\"failure\"}");
+        return;
+      }
+      sendJsonf(request, 200, "{\"id\":%u,\"status\":\"scheduled\"}", id);
     } else {
-      request->send(400, "application/json", "{\"error\":\"gpio, state, or delay parameter missing\",\"status\":\"failure\"}");
+      sendJson(request, 400, "{\"error\":\"gpio, state, or delay parameter missing\",\"status\":\"failure\"}");
     }
   });
 
+  // List Scheduled Operations
+  server.on("/schedules", HTTP_GET, [](AsyncWebServerRequest *request){
+    int gpioFilter = request->hasParam("gpio") ? request->getParam("gpio")->value().toInt() : -1;
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"scheduled\":[");
+    bool first = true;
+    for (int i = 0; i < SCHEDULER_CAPACITY; i++) {
+      portENTER_CRITICAL(&schedulerMux);
+      ScheduledEntry entry = scheduleEntries[i];
+      uint32_t now = wheelNow;
+      portEXIT_CRITICAL(&schedulerMux);
+      if (entry.phase == PHASE_FREE || (gpioFilter >= 0 && entry.cmd.gpio != gpioFilter)) {
+        continue;
+      }
+      char state[12];
+      formatState(entry.cmd, state, sizeof(state));
+      int32_t dueIn = (int32_t)(entry.expires - now);
+      response->printf("%s{\"id\":%u,\"gpio\":%u,\"state\":\"%s\",\"phase\":\"%s\",\"due_in\":%d,\"duration\":%u}",
+                       first ? "" : ",", entry.id, entry.cmd.gpio, state,
+                       entry.phase == PHASE_SET ? "set" : "reset", dueIn > 0 ? dueIn : 0, entry.cmd.duration);
+      first = false;
+    }
+    response->printf("],\"pending\":%u,\"capacity\":%u,\"dropped\":%u}", pendingEntries, SCHEDULER_CAPACITY,
+                     scheduleDropped);
+    request->send(response);
+  });
+
+  // Cancel Scheduled Operation
+  server.on("/cancel", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (request->hasParam("id")) {
+      uint32_t id = strtoul(request->getParam("id")->value().c_str(), NULL, 10);
+      if (scheduleCancel(id)) {
+        sendJsonf(request, 200, "{\"id\":%u,\"status\":\"cancelled\"}", id);
+      } else {
+        sendJson(request, 404, "{\"error\":\"Schedule not found\",\"status\":\"failure\"}");
+      }
+    } else {
+      sendJson(request, 400, "{\"error\":\"id parameter missing\",\"status\":\"failure\"}");
+    }
+  });
+
+  // Wi-Fi Link
+  server.on("/wifi", HTTP_GET, [](AsyncWebServerRequest *request){
+    WifiLink link = wifiLink;
+    bool up = link.state == LINK_UP;
+    IPAddress ip = up ? WiFi.localIP() : IPAddress();
+    uint32_t waited = millis() - link.since;
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->printf("{\"state\":\"%s\",\"ip\":\"%u.%u.%u.%u\",\"static_ip\":%s,\"channel\":%d,\"rssi\":%d,\"cached\":%s,",
+                     linkStateNames[link.state], ip[0], ip[1], ip[2], ip[3], wifiStatic ? "true" : "false",
+                     up ? (int)WiFi.channel() : 0, up ? WiFi.RSSI() : 0, link.cached ? "true" : "false");
+    response->printf("\"connects\":%u,\"drops\":%u,\"failures\":%u,\"last_connect_ms\":%u,\"max_connect_ms\":%u,"
+                     "\"last_outage_ms\":%u,\"backoff_ms\":%u}",
+                     link.connects, link.drops, link.failed, link.lastConnectMs, link.maxConnectMs, link.lastOutageMs,
+                     link.state == LINK_BACKOFF && waited < link.wait ? link.wait - waited : 0);
+    request->send(response);
+  });
+
   // Start server
   server.begin();
 }
 
 void loop() {
-  // Nothing needed here
+  wifiLoop();
+  delay(10);
 }
@@ -0,0 +1,138 @@
+function createControlElement(gpio) {
+  const container = document.createElement('div');
+  container.className = 'gpio-control';
+
+  const label = document.createElement('h3');
+  label.innerText = `GPIO ${gpio}`;
+  container.appendChild(label);
+
+  const stateLabel = document.createElement('div');
+  stateLabel.id = `state-${gpio}`;
+  stateLabel.innerText = '-';
+  container.appendChild(stateLabel);
+
+  const highButton = document.createElement('button');
+  highButton.innerText = 'HIGH';
+  highButton.onclick = () => setGPIOState(gpio, 'high');
+  container.appendChild(highButton);
+
+  const lowButton = document.createElement('button');
+  lowButton.innerText = 'LOW';
+  lowButton.onclick = () => setGPIOState(gpio, 'low');
+  container.appendChild(lowButton);
+
+  const pwmInput = document.createElement('input');
+  pwmInput.type = 'number';
+  pwmInput.placeholder = 'PWM value';
+  pwmInput.onchange = () => setGPIOState(gpio, `pwm${pwmInput.value}`);
+  container.appendChild(pwmInput);
+
+  return container;
+}
+
+let socket = null;
+
+// Live pin states are pushed over the WebSocket, and pin commands use it
+// while it is open
+function connectSocket() {
+  socket = new WebSocket(`ws://${location.host}/ws`);
+  socket.onmessage = event => {
+    const data = JSON.parse(event.data);
+    (data.pins || []).forEach(pin => {
+      const stateLabel = document.getElementById(`state-${pin.gpio}`);
+      if (stateLabel) {
+        stateLabel.innerText = pin.state === 'PWM' ? `PWM ${pin.pwm_value}` : pin.state;
+      }
+    });
+    if (data.status === 'failure') {
+      alert(`Command failed: ${data.error}`);
+    }
+  };
+  socket.onclose = () => setTimeout(connectSocket, 2000);
+}
+
+function setGPIOState(gpio, state) {
+  if (socket && socket.readyState === WebSocket.OPEN) {
+    socket.send(`s ${gpio} ${state}`);
+    return;
+  }
+  fetch(`/setgpio?gpio=${gpio}&state=${state}`)
+    .then(response => response.json())
+    .then(data => {
+      if (data.status === 'success') {
+        alert(`GPIO ${gpio} set to ${state.toUpperCase()}`);
+      } else {
+        alert(`Failed to set GPIO ${gpio}: ${data.error}`);
+      }
+    });
+}
+
+function scheduleOperation() {
+  const gpio = document.getElementById('schedule-gpio').value;
+  const state = document.getElementById('schedule-state').value;
+  const delay = document.getElementById('schedule-delay').value;
+  const duration = document.getElementById('schedule-duration').value;
+  fetch(`/schedule?gpio=${gpio}&state=${state}&delay=${delay}&duration=${duration}`)
+    .then(response => response.json())
+    .then(data => {
+      if (data.status === 'scheduled') {
+        alert(`Scheduled GPIO ${gpio} to ${state.toUpperCase()} after ${delay}ms for ${duration}ms`);
+      } else {
+        alert(`Failed to schedule GPIO ${gpio}: ${data.error}`);
+      }
+    });
+}
+
+function batchOperation() {
+  const operations = document.getElementById('batch-operations').value;
+  fetch(`/batch?operations=${encodeURIComponent(operations)}`)
+    .then(response => response.json())
+    .then(data => {
+      if (data.status === 'success' || data.status === 'partial') {
+        alert(`Batch executed: ${data.applied} of ${data.operations} operations applied`);
+      } else {
+        alert(`Failed to execute batch operations: ${data.error}`);
+      }
+    });
+}
+
+function blinkGPIO() {
+  const gpio = document.getElementById('blink-gpio').value;
+  const interval = document.getElementById('blink-interval').value;
+  fetch(`/blink?gpio=${gpio}&interval=${interval}`)
+    .then(response => response.json())
+    .then(data => {
+      if (data.status === 'success') {
+        alert(`GPIO ${gpio} set to blink with interval ${interval}ms`);
+      } else {
+        alert(`Failed to set GPIO ${gpio} to blink: ${data.error}`);
+      }
+    });
+}
+
+function stopBlink() {
+  const gpio = document.getElementById('blink-gpio').value;
+  fetch(`/stop?gpio=${gpio}`)
+    .then(response => response.json())
+    .then(data => {
+      if (data.status !== 'success') {
+        alert(`Failed to stop GPIO ${gpio}: ${data.error}`);
+      }
+    });
+}
+
+// Controls are shown for the output-capable pins of this chip only
+function init() {
+  const gpioControls = document.getElementById('gpio-controls');
+  fetch('/pins')
+    .then(response => response.json())
+    .then(data => {
+      data.pins.filter(pin => pin.output).forEach(pin => {
+        const controlElement = createControlElement(pin.gpio);
+        gpioControls.appendChild(controlElement);
+      });
+      connectSocket();
+    });
+}
+
+window.onload = init;
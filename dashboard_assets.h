@@ -0,0 +1,151 @@
+// Generated by tools/embed_assets.py from dashboard/. Do not edit: change the
+// sources and run the script again.
+#pragma once
+
+struct WebAsset {
+  const char* path;
+  const char* type;
+  const char* cacheControl;
+  const char* etag;
+  const uint8_t* data;  // gzip
+  size_t len;
+  size_t rawLen;        // before compression
+};
+
+const uint8_t assetIndexHtml[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x9d, 0x94, 0x4d, 0x6f, 0xda, 0x40,
+  0x10, 0x86, 0xef, 0xf9, 0x15, 0xd3, 0xbd, 0x84, 0x48, 0x01, 0x97, 0x00, 0x4a, 0x85, 0x6c, 0x0e,
+  0x0d, 0xa8, 0x4a, 0x0f, 0x05, 0x89, 0x5e, 0xaa, 0xa8, 0x87, 0xf5, 0x7a, 0x1a, 0x6f, 0xb3, 0xf6,
+  0x5a, 0xbb, 0xeb, 0x10, 0x54, 0xe5, 0xbf, 0x77, 0x3f, 0x6c, 0x17, 0x2c, 0xda, 0xa0, 0x9e, 0x00,
+  0xcf, 0xcc, 0xf3, 0x7a, 0x66, 0x5e, 0x26, 0x7e, 0xb7, 0x5c, 0xdf, 0x7d, 0xfd, 0xb6, 0x59, 0x41,
+  0x6e, 0x0a, 0xb1, 0xb8, 0x88, 0xdb, 0x0f, 0xa4, 0xd9, 0xe2, 0x02, 0x20, 0x36, 0xdc, 0x08, 0x5c,
+  0xac, 0xb6, 0x9b, 0xc9, 0x0d, 0x7c, 0xda, 0xdc, 0xaf, 0xe1, 0x4e, 0x96, 0x46, 0x49, 0x11, 0x47,
+  0x21, 0xe2, 0x72, 0x04, 0x2f, 0x9f, 0x40, 0xa1, 0x48, 0x88, 0x36, 0x7b, 0x81, 0x3a, 0x47, 0x34,
+  0x04, 0x72, 0x85, 0x3f, 0x12, 0x12, 0x65, 0x54, 0xe7, 0xa9, 0xa4, 0x2a, 0x1b, 0xcd, 0xa6, 0x33,
+  0x76, 0x9b, 0x8e, 0xd9, 0x88, 0x69, 0x4d, 0xac, 0x46, 0x14, 0x44, 0xe2, 0x54, 0x66, 0x7b, 0xcf,
+  0xc9, 0xc7, 0x27, 0x84, 0x60, 0xd9, 0x02, 0x6c, 0xc1, 0xd8, 0xe7, 0x65, 0xfc, 0x19, 0x78, 0x96,
+  0x90, 0xc7, 0x8a, 0xcb, 0x21, 0x0b, 0x69, 0x96, 0x18, 0x47, 0x36, 0xd0, 0x25, 0x30, 0x41, 0xb5,
+  0x4e, 0x88, 0xac, 0x50, 0x51, 0xc3, 0x65, 0x49, 0x5c, 0xc4, 0x89, 0x4c, 0x16, 0x5b, 0x96, 0x63,
+  0x56, 0x0b, 0x84, 0x75, 0x1b, 0xb4, 0xe8, 0x49, 0x88, 0x3b, 0xe9, 0x39, 0xc4, 0xbc, 0xac, 0x6a,
+  0x03, 0x66, 0x5f, 0x61, 0x42, 0xca, 0xba, 0x48, 0x51, 0x11, 0x2f, 0xa9, 0x9b, 0xd2, 0xa1, 0xd3,
+  0x26, 0x50, 0x09, 0xca, 0x30, 0x97, 0x22, 0x43, 0x95, 0x10, 0x57, 0xda, 0xa8, 0x6c, 0x0d, 0x35,
+  0xd8, 0xc3, 0x18, 0x7c, 0x31, 0x3d, 0x88, 0x76, 0x69, 0x3d, 0x4a, 0xce, 0x1f, 0xf3, 0x48, 0xc8,
+  0x5d, 0x54, 0xed, 0x8a, 0x86, 0xb6, 0x44, 0x41, 0xf7, 0x30, 0x28, 0xf4, 0xd5, 0x39, 0x6f, 0x96,
+  0xb9, 0xec, 0x1e, 0x34, 0x10, 0x78, 0x09, 0x85, 0x6e, 0x99, 0x75, 0xe8, 0xfc, 0x7c, 0x6c, 0x53,
+  0xd0, 0x27, 0xb7, 0x9c, 0x43, 0x78, 0x9c, 0xd6, 0xc6, 0xd8, 0x67, 0xb2, 0x64, 0x82, 0xb3, 0xa7,
+  0x3f, 0x94, 0x6e, 0xe0, 0x83, 0x2b, 0xd2, 0xad, 0x21, 0x8e, 0x42, 0xba, 0x5f, 0xdd, 0xb9, 0x3b,
+  0xfc, 0x48, 0x0d, 0xcb, 0x4f, 0x2d, 0xb0, 0x7b, 0xa4, 0x61, 0xf0, 0x79, 0xbb, 0xfe, 0xe2, 0x9a,
+  0x73, 0xa3, 0xa7, 0x0a, 0xa9, 0xef, 0x28, 0x75, 0x95, 0xc3, 0x8e, 0xa9, 0x09, 0x28, 0xb9, 0xb3,
+  0x2a, 0x53, 0x02, 0xcc, 0xfa, 0x28, 0x21, 0xb3, 0xf7, 0xc7, 0x3d, 0x5e, 0x3e, 0xfc, 0xf2, 0x56,
+  0x23, 0x73, 0xb8, 0xb9, 0x06, 0x12, 0x96, 0x36, 0x07, 0xbf, 0x29, 0xf2, 0x7a, 0x0d, 0x5d, 0x74,
+  0x72, 0x18, 0xb5, 0x2b, 0x24, 0xaf, 0xdf, 0x2f, 0xad, 0x2b, 0x5b, 0xf5, 0xbf, 0xcc, 0xc6, 0xbf,
+  0xcf, 0xd1, 0x60, 0x56, 0x2f, 0xc8, 0x6a, 0x83, 0xe0, 0x7b, 0xfc, 0xbf, 0xe9, 0xf8, 0xbf, 0xa4,
+  0x33, 0xe4, 0xd9, 0xce, 0x4e, 0x5d, 0xc9, 0x1b, 0xb6, 0xbe, 0x2f, 0x0d, 0xaa, 0x67, 0x2a, 0xde,
+  0x32, 0x4d, 0x60, 0xf1, 0x26, 0xbb, 0xc7, 0xeb, 0x20, 0xff, 0x74, 0x8c, 0x47, 0x38, 0x69, 0x37,
+  0x10, 0xdf, 0xce, 0xe1, 0x20, 0x4e, 0x59, 0xcc, 0xc8, 0xca, 0xe7, 0x79, 0x6b, 0xd9, 0x1f, 0x27,
+  0x06, 0xe7, 0xbe, 0x69, 0xa6, 0x78, 0x65, 0x40, 0x2b, 0x76, 0x74, 0x9c, 0xa6, 0x1f, 0xd8, 0x38,
+  0xc3, 0x14, 0x47, 0x3f, 0xfd, 0x25, 0x09, 0x59, 0xee, 0x48, 0x85, 0xeb, 0x64, 0xc7, 0xe8, 0x0f,
+  0xe3, 0x6f, 0x79, 0xd6, 0x3c, 0xf7, 0x30, 0x05, 0x00, 0x00,
+};
+
+const uint8_t assetDashboardCss[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x65, 0xcd, 0xc1, 0x0e, 0x82, 0x30,
+  0x0c, 0xc6, 0xf1, 0x3b, 0x4f, 0xd1, 0x07, 0x70, 0x06, 0x4d, 0xb8, 0x8c, 0x93, 0x8f, 0x52, 0xa0,
+  0x8c, 0xc6, 0xb2, 0x2d, 0x5b, 0x0d, 0x10, 0xe3, 0xbb, 0x3b, 0x09, 0x5e, 0xf4, 0xd8, 0xe4, 0xfb,
+  0xff, 0xda, 0x85, 0x61, 0x83, 0x67, 0x05, 0x30, 0x06, 0xaf, 0x66, 0xc4, 0x99, 0x65, 0xb3, 0x70,
+  0x4b, 0x8c, 0x72, 0x82, 0x8c, 0x3e, 0x9b, 0x4c, 0x89, 0xc7, 0xb6, 0x2c, 0x94, 0x56, 0x35, 0x28,
+  0xec, 0xbc, 0x85, 0x9e, 0xbc, 0x52, 0x6a, 0xab, 0x57, 0x75, 0x76, 0x91, 0x83, 0xe9, 0x4b, 0x9d,
+  0x82, 0xec, 0xd2, 0xc0, 0x39, 0x0a, 0x16, 0x85, 0xbd, 0xb0, 0x27, 0xd3, 0x49, 0xe8, 0xef, 0x1f,
+  0x60, 0xc6, 0xe4, 0xb8, 0xc4, 0xd7, 0x3a, 0xae, 0xff, 0x69, 0xf7, 0x50, 0x0d, 0x7e, 0x17, 0x16,
+  0x1e, 0x74, 0xb2, 0x70, 0xa9, 0xf7, 0x21, 0xc0, 0x44, 0xec, 0x26, 0xb5, 0xd0, 0x1c, 0xf7, 0x17,
+  0x6a, 0x0e, 0x27, 0x44, 0x4a, 0xa8, 0x7c, 0xd4, 0xbf, 0x6f, 0xde, 0x73, 0x5e, 0xe0, 0x4b, 0xe3,
+  0x00, 0x00, 0x00,
+};
+
+const uint8_t assetDashboardJs[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xcd, 0x58, 0xdf, 0x4f, 0x23, 0x37,
+  0x10, 0x7e, 0xcf, 0x5f, 0x31, 0x95, 0x10, 0xbb, 0x91, 0x60, 0x83, 0xda, 0x37, 0xa2, 0x14, 0x09,
+  0x44, 0xef, 0xa8, 0xe8, 0x81, 0xca, 0x9d, 0x78, 0xa8, 0xaa, 0xc6, 0xd9, 0x75, 0x58, 0x17, 0xc7,
+  0x5e, 0xad, 0xbd, 0xe4, 0x10, 0x97, 0xff, 0xbd, 0x33, 0xf6, 0xfe, 0xf0, 0x42, 0x12, 0x48, 0x7b,
+  0x48, 0x7d, 0x49, 0x9c, 0xf5, 0x37, 0xdf, 0xcc, 0x78, 0x3e, 0x8f, 0xbd, 0x99, 0x57, 0x2a, 0xb5,
+  0x42, 0x2b, 0x48, 0x4b, 0xce, 0x2c, 0x3f, 0xd3, 0xca, 0x96, 0x5a, 0x9e, 0x4b, 0xbe, 0xe0, 0xca,
+  0xc6, 0x77, 0x85, 0xd0, 0x43, 0x78, 0x1a, 0x00, 0xa4, 0x5a, 0x19, 0x4b, 0x9f, 0x96, 0x09, 0xc5,
+  0x4b, 0x98, 0x40, 0xa6, 0xd3, 0x8a, 0x40, 0x89, 0xb7, 0x6c, 0x4c, 0xa2, 0x4c, 0x3c, 0x44, 0xc3,
+  0xb1, 0x37, 0xf1, 0xe0, 0x24, 0x95, 0xcc, 0x98, 0x4f, 0x6c, 0xc1, 0xd1, 0x2c, 0x22, 0xce, 0xc3,
+  0xd4, 0xfb, 0x89, 0xc6, 0x83, 0x96, 0x5b, 0xb2, 0x19, 0x97, 0x5b, 0x78, 0xf3, 0x9f, 0x3c, 0xad,
+  0xc3, 0x25, 0x42, 0x21, 0xf1, 0x67, 0xfe, 0xd5, 0xa2, 0xc5, 0xf4, 0xc3, 0xf5, 0xc5, 0x15, 0xec,
+  0x3d, 0x11, 0xf3, 0x6a, 0xda, 0x77, 0xcd, 0x8a, 0x82, 0xab, 0xec, 0x2c, 0x17, 0x32, 0x8b, 0x9d,
+  0xe5, 0x30, 0x70, 0x69, 0x2c, 0x3a, 0xb8, 0x7c, 0xc5, 0x6f, 0x9b, 0x4f, 0x87, 0x4e, 0x44, 0x46,
+  0x6e, 0xdd, 0x83, 0xc3, 0xd0, 0x6f, 0x08, 0x09, 0x02, 0x8c, 0x0e, 0xa3, 0xcd, 0x51, 0x75, 0x36,
+  0x61, 0x68, 0xb9, 0xb8, 0xcb, 0x4f, 0x2b, 0x6b, 0xb1, 0x32, 0x9b, 0x43, 0x9b, 0x39, 0x80, 0x8f,
+  0xae, 0x33, 0xe8, 0xbb, 0xfe, 0x78, 0xf1, 0xe1, 0x63, 0xf4, 0x0c, 0xa0, 0x55, 0x2a, 0x45, 0x7a,
+  0x8f, 0xd3, 0xf1, 0x10, 0x26, 0x3f, 0x83, 0xe1, 0x96, 0x96, 0xf0, 0x86, 0x22, 0x71, 0x35, 0x3f,
+  0x80, 0x88, 0xe0, 0xcf, 0xeb, 0x18, 0x86, 0xdd, 0xd1, 0x85, 0x61, 0x4b, 0xbd, 0xdc, 0x29, 0xea,
+  0x16, 0xdf, 0x0f, 0xfa, 0xf2, 0xea, 0x36, 0xea, 0x4f, 0xbf, 0x25, 0x64, 0x44, 0x6f, 0x8b, 0xb8,
+  0x25, 0x0b, 0x03, 0x2e, 0x96, 0x8b, 0x0b, 0x55, 0x54, 0x76, 0x4b, 0xbc, 0x82, 0xe6, 0x3d, 0x71,
+  0x83, 0x4e, 0xec, 0x63, 0xe1, 0xc4, 0xac, 0xaa, 0xc5, 0x8c, 0x97, 0x51, 0x6f, 0xae, 0x90, 0x2c,
+  0xe5, 0xb9, 0x96, 0x99, 0xdb, 0x26, 0xd1, 0xf5, 0xed, 0x6f, 0xf0, 0xc0, 0x64, 0xc5, 0xfb, 0x28,
+  0x4c, 0x28, 0x67, 0xea, 0x8e, 0x6f, 0xcb, 0x68, 0x8a, 0xe8, 0xbd, 0xa7, 0xd6, 0xc4, 0xb1, 0xac,
+  0xa6, 0x5b, 0x52, 0x6c, 0xa0, 0x3e, 0xc3, 0x92, 0xdb, 0xaa, 0x54, 0x1d, 0x74, 0x3c, 0x58, 0x0d,
+  0x06, 0x92, 0xa3, 0xee, 0x75, 0x7a, 0xcf, 0x29, 0x65, 0x55, 0x49, 0x89, 0xd0, 0xd1, 0x08, 0x2e,
+  0xc5, 0x03, 0x87, 0x42, 0x28, 0x2f, 0x61, 0x03, 0xac, 0xc4, 0x9f, 0x95, 0xc9, 0x79, 0x06, 0xfa,
+  0x01, 0x13, 0xb1, 0x39, 0x87, 0x5b, 0x3e, 0xbb, 0x71, 0x96, 0x07, 0xc0, 0x54, 0xe6, 0xd0, 0xa9,
+  0x5e, 0x2c, 0x70, 0x6c, 0xa0, 0x32, 0x1c, 0x84, 0x25, 0xa6, 0x25, 0x46, 0x42, 0x63, 0x10, 0x06,
+  0x34, 0x86, 0x36, 0x98, 0xb7, 0x2d, 0x46, 0x63, 0x8d, 0x53, 0xeb, 0x39, 0x62, 0xdf, 0x57, 0xba,
+  0x50, 0xf8, 0xb2, 0x73, 0x10, 0x4f, 0x97, 0xe6, 0x78, 0x34, 0xda, 0x7b, 0x92, 0x3a, 0x65, 0x64,
+  0x9b, 0xe4, 0xda, 0xd8, 0xd5, 0x68, 0x69, 0x7c, 0xf6, 0xde, 0x0a, 0xd7, 0x70, 0xc1, 0x8d, 0x61,
+  0x6e, 0x11, 0xf9, 0x03, 0x16, 0x8b, 0xd6, 0x91, 0x58, 0x9b, 0xea, 0x66, 0xcc, 0x32, 0x9c, 0xfb,
+  0xf5, 0xe6, 0xea, 0x53, 0x52, 0xb0, 0xd2, 0xf0, 0xd8, 0xc1, 0x12, 0x7a, 0xee, 0x88, 0x00, 0x62,
+  0x1a, 0x27, 0x98, 0x8b, 0x81, 0x6f, 0xdf, 0xe0, 0x8f, 0x3f, 0x87, 0xc9, 0x5c, 0x97, 0xe7, 0x2c,
+  0xcd, 0x63, 0xca, 0xaf, 0xe5, 0xdb, 0xde, 0x32, 0xee, 0xb8, 0xad, 0xe5, 0x72, 0xfa, 0x78, 0x91,
+  0xc5, 0x6d, 0x67, 0x40, 0x8a, 0xc4, 0x77, 0x87, 0xda, 0x1b, 0x80, 0x98, 0x43, 0xb8, 0xe5, 0x5b,
+  0xfa, 0x8d, 0xcd, 0x83, 0x38, 0xdc, 0x14, 0x4c, 0x26, 0x5e, 0x4e, 0x11, 0x9c, 0xc0, 0x94, 0x64,
+  0xe5, 0x1d, 0x60, 0xd1, 0xff, 0xaa, 0xa5, 0x01, 0xc7, 0x1d, 0xbc, 0x71, 0xb8, 0x72, 0xdf, 0xab,
+  0x3a, 0x00, 0x72, 0xef, 0x32, 0x26, 0x4c, 0x65, 0x3c, 0xe7, 0x9c, 0x09, 0x59, 0x95, 0x3c, 0xea,
+  0xa2, 0x61, 0x92, 0x97, 0x58, 0x85, 0x33, 0x5f, 0x5e, 0x20, 0x00, 0xcf, 0x8e, 0xd1, 0xa1, 0xb3,
+  0xe5, 0x65, 0xa9, 0xcb, 0x36, 0x27, 0x72, 0xb0, 0xea, 0x55, 0x25, 0x95, 0xda, 0xf4, 0x84, 0xfd,
+  0x59, 0x2c, 0xb8, 0xae, 0x6c, 0xdc, 0x53, 0xc0, 0x01, 0xfc, 0x78, 0x74, 0x74, 0x34, 0x74, 0xaa,
+  0x6c, 0x35, 0xb2, 0x66, 0x17, 0xb8, 0x6c, 0x7c, 0x68, 0x6e, 0xf1, 0xbc, 0x62, 0xf6, 0xf7, 0x1b,
+  0x7f, 0xb8, 0x5b, 0xb3, 0xc7, 0x9b, 0x76, 0x85, 0x5a, 0x11, 0x25, 0x57, 0xd7, 0xe7, 0x9f, 0x9a,
+  0x94, 0x6a, 0xac, 0xc1, 0xad, 0x82, 0xe5, 0x69, 0x0e, 0x0b, 0xfc, 0x76, 0xec, 0x6d, 0x2e, 0x7e,
+  0xcb, 0xd0, 0x98, 0xb2, 0x9a, 0x73, 0x8b, 0x3a, 0x98, 0x8e, 0x30, 0x28, 0x82, 0x9f, 0xd0, 0xc7,
+  0xa4, 0x36, 0xdd, 0x77, 0x86, 0x93, 0x8e, 0xc0, 0xd9, 0x27, 0xb8, 0x4f, 0x54, 0x5c, 0x72, 0x53,
+  0xa0, 0x5a, 0x38, 0x65, 0xdf, 0x8c, 0x93, 0xbf, 0x8d, 0x56, 0xf1, 0x30, 0x84, 0x79, 0x75, 0x76,
+  0x0a, 0x5b, 0x5b, 0x1b, 0x53, 0xa5, 0x29, 0x8a, 0x3c, 0x0a, 0x95, 0x52, 0x57, 0x27, 0x3c, 0xf6,
+  0x68, 0xe1, 0xc0, 0xea, 0x26, 0xa1, 0xc4, 0xea, 0x2f, 0xd8, 0x17, 0xca, 0x33, 0x86, 0x9a, 0x1f,
+  0x06, 0xf2, 0x5b, 0x01, 0x97, 0x18, 0xd8, 0x0b, 0xae, 0x5f, 0x5c, 0x85, 0x89, 0x81, 0x88, 0x42,
+  0xe6, 0x0d, 0x55, 0x0f, 0x85, 0xd5, 0x2b, 0x60, 0x8a, 0x3d, 0xa3, 0x92, 0xfc, 0x0a, 0xbd, 0xbb,
+  0xad, 0x1b, 0x87, 0x17, 0x08, 0x62, 0xdc, 0xb2, 0x71, 0xa2, 0xc6, 0xfa, 0x90, 0x80, 0xd1, 0xd0,
+  0xb7, 0xbc, 0x71, 0xff, 0xc0, 0x7e, 0x93, 0xbd, 0x43, 0xbe, 0x24, 0xc8, 0xb8, 0x64, 0x8f, 0x6f,
+  0x22, 0x70, 0xc8, 0x35, 0x04, 0x95, 0xcf, 0xea, 0x6d, 0x1c, 0x35, 0x38, 0xa4, 0x69, 0x35, 0x55,
+  0x83, 0xb6, 0x89, 0x6a, 0xdf, 0x05, 0x81, 0x3f, 0xdd, 0x37, 0xfe, 0xac, 0xf9, 0xe8, 0x49, 0x3d,
+  0x7c, 0x47, 0xe1, 0xd5, 0x01, 0x66, 0xeb, 0xa4, 0x77, 0xd3, 0x4c, 0xf6, 0xa4, 0xb2, 0x59, 0x80,
+  0xc0, 0xe6, 0x16, 0x4f, 0x91, 0x26, 0x93, 0x85, 0x01, 0xec, 0xb2, 0x10, 0xa4, 0xb1, 0x30, 0x3b,
+  0x69, 0xb4, 0x76, 0xff, 0x5f, 0x84, 0x3a, 0x63, 0x58, 0x88, 0xf5, 0x2a, 0xd5, 0xcd, 0x53, 0xb3,
+  0xad, 0xcc, 0x8e, 0xe0, 0xb0, 0xc3, 0xae, 0xab, 0xb2, 0xc3, 0x9c, 0x74, 0x18, 0xac, 0x1c, 0x57,
+  0xa9, 0xce, 0xf8, 0x97, 0xdf, 0x2f, 0xb0, 0xb9, 0x62, 0x81, 0xe8, 0x8a, 0xd1, 0xcd, 0x0f, 0xdf,
+  0xbf, 0x91, 0xd0, 0x31, 0xf7, 0x62, 0x12, 0x0f, 0x47, 0x2b, 0x98, 0x5c, 0x57, 0xea, 0x53, 0x4a,
+  0x01, 0xf8, 0x57, 0x9e, 0x56, 0x36, 0x38, 0x03, 0xf0, 0xda, 0x21, 0x05, 0xcf, 0x56, 0xa0, 0xe7,
+  0xcd, 0xa3, 0x2e, 0x8d, 0x55, 0xb8, 0x84, 0x35, 0x72, 0x97, 0xfa, 0xd6, 0xde, 0x7c, 0x8d, 0x02,
+  0xae, 0x5d, 0x4b, 0x2c, 0x85, 0xba, 0x27, 0x89, 0xec, 0xd4, 0x83, 0x9c, 0xd5, 0x86, 0x06, 0x24,
+  0x14, 0xca, 0x18, 0x9f, 0xbd, 0x6e, 0xdf, 0x20, 0xd7, 0xaa, 0x82, 0x10, 0xfd, 0x8d, 0xdf, 0xc0,
+  0xf1, 0x41, 0x33, 0xfc, 0xdf, 0x9c, 0x29, 0x2e, 0x5c, 0x58, 0x0a, 0x9b, 0x77, 0xf9, 0x07, 0x61,
+  0xee, 0xb8, 0x75, 0x9f, 0x1d, 0x2f, 0xad, 0x83, 0x5d, 0xcf, 0x19, 0xab, 0x8b, 0x53, 0xb2, 0xfb,
+  0x0e, 0xb5, 0x6d, 0x7b, 0x32, 0x72, 0xf6, 0xca, 0xf2, 0x1e, 0x15, 0xf8, 0xe1, 0x95, 0x0a, 0x04,
+  0x4b, 0x85, 0xe1, 0xfc, 0x8b, 0x0e, 0x87, 0x77, 0xf0, 0xfa, 0x35, 0xde, 0x5f, 0xe3, 0x4d, 0xae,
+  0x97, 0xca, 0xf5, 0x5b, 0xba, 0xc4, 0xe3, 0x35, 0x0c, 0x5f, 0x10, 0x0e, 0x53, 0x56, 0xb0, 0x99,
+  0x74, 0x57, 0x7e, 0x43, 0x5b, 0xd8, 0xe6, 0x78, 0x5d, 0x4f, 0x73, 0x51, 0x80, 0x56, 0xf2, 0xb1,
+  0x5b, 0x66, 0xa1, 0x84, 0x7d, 0xb1, 0xc2, 0x2d, 0xfd, 0x96, 0x95, 0x0e, 0x5f, 0xf3, 0x8d, 0x7f,
+  0x7b, 0xf2, 0xcb, 0x1c, 0x8d, 0xc8, 0x67, 0xf4, 0x1d, 0x56, 0xb6, 0xbd, 0xb9, 0x27, 0x73, 0x21,
+  0x51, 0x8c, 0xcd, 0x8d, 0x9d, 0xae, 0xc0, 0x3e, 0xcd, 0x8d, 0x97, 0xf9, 0xf0, 0x0f, 0x8d, 0xee,
+  0xff, 0x0e, 0xcc, 0x67, 0xed, 0xdf, 0x20, 0xcd, 0x35, 0xbe, 0x5d, 0x6f, 0xe8, 0x2d, 0x43, 0xef,
+  0x15, 0xac, 0xcf, 0xd8, 0x55, 0xa8, 0x1d, 0x3d, 0x7b, 0x0b, 0x1a, 0x87, 0xa5, 0x5b, 0x0a, 0x95,
+  0xe9, 0x25, 0xde, 0xa0, 0xa5, 0x66, 0xf4, 0x17, 0x03, 0xad, 0xfe, 0x78, 0xf0, 0x0f, 0x09, 0x36,
+  0xb6, 0xa3, 0xa4, 0x11, 0x00, 0x00,
+};
+
+const WebAsset webAssets[] = {
+  {"/", "text/html", "no-cache", "\"47c0fa5d223ce794\"", assetIndexHtml, sizeof(assetIndexHtml), 1328},
+  {"/dashboard.545c7b1c.css", "text/css", "public, max-age=31536000, immutable", "\"74a7511aa0606efc\"", assetDashboardCss, sizeof(assetDashboardCss), 227},
+  {"/dashboard.48c1debe.js", "application/javascript", "public, max-age=31536000, immutable", "\"d4837adfa6565ccc\"", assetDashboardJs, sizeof(assetDashboardJs), 4516},
+};
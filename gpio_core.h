@@ -0,0 +1,3638 @@
+// GPIO controller core of the three sketches: pin table,
+// command decoding, LEDC pool, actuation ring, fades, groups, scheduler,
+// persistence, precise pulses, scenes, the batch parser, patterns, ADC
+// sampling, edge capture, pulse counters and the Wi-Fi link state machine.
+// It holds no web server code; gpio_web.h and the sketches add the HTTP,
+// WebSocket and UDP front ends on top.
+//
+// It only reaches the hardware through the Arduino and IDF calls it
+// includes (GPIO registers via gpioOutRead/gpioOutWrite/gpioInRead, LEDC,
+// Preferences, Ticker, esp_timer, FreeRTOS tasks, PCNT, analogRead), so the
+// host build in host/ compiles it unchanged against simulated versions of
+// them, and the tools in tools/ test the real code rather than copies.
+//
+// This file defines rather than declares: include it from exactly one
+// translation unit.
+#pragma once
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include <soc/gpio_reg.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#if SOC_PCNT_SUPPORTED
+#include <driver/pcnt.h>
+#endif
+
+Ticker schedulerTicker;
+Preferences preferences;
+
+// Instrumentation for /metrics. Histograms have fixed power-of-two buckets
+// and every recording site is single-writer or already under a lock, so
+// recording is a few instructions and never allocates. Bucket i counts
+// values up to ((2^i) << shift) - 1; larger values only reach +Inf.
+#define HIST_BUCKETS 12
+#define LATENESS_SHIFT 0      // scheduler lateness in 1 ms steps, up to 2 s
+
+struct Histogram {
+  uint32_t buckets[HIST_BUCKETS];
+  uint32_t count;
+  uint64_t sum;
+};
+
+void histogramObserve(Histogram &histogram, uint32_t value, int shift) {
+  uint32_t scaled = value >> shift;
+  int bucket = scaled ? 32 - __builtin_clz(scaled) : 0;
+  if (bucket < HIST_BUCKETS) {
+    histogram.buckets[bucket]++;
+  }
+  histogram.count++;
+  histogram.sum += value;
+}
+
+Histogram scheduleLateness;          // written from the scheduler tick only
+uint32_t digitalWrites = 0;          // GPIO_OUT register writes, under gpioMux
+uint32_t pwmWrites = 0;              // LEDC duty writes, under gpioMux
+uint32_t cyclesPerMicro = 240;
+
+// Times a scope with the CPU cycle counter and records it in microseconds
+struct ScopeTimer {
+  Histogram &histogram;
+  int shift;
+  uint32_t start;
+
+  ScopeTimer(Histogram &histogram, int shift) : histogram(histogram), shift(shift), start(ESP.getCycleCount()) {}
+  ~ScopeTimer() {
+    histogramObserve(histogram, (ESP.getCycleCount() - start) / cyclesPerMicro, shift);
+  }
+};
+
+// What each pin of the chip can do, fixed at compile time for the target.
+// Every request path checks pins against this table before it touches a
+// register, so flash pins are never driven and input-only pins are never
+// configured as outputs or attached to LEDC.
+#define PIN_INPUT     0x01
+#define PIN_OUTPUT    0x02
+#define PIN_STRAPPING 0x04 // sampled at reset; driving it can change the boot mode
+#define PIN_FLASH     0x08 // wired to the SPI flash, never usable
+#define PIN_TOUCH     0x10
+#define PIN_IO (PIN_INPUT | PIN_OUTPUT)
+#define PIN_ADC1(channel) (0x10 | (channel))
+#define PIN_ADC2(channel) (0x20 | (channel))
+
+struct PinInfo {
+  uint8_t caps;
+  uint8_t adc;  // ADC unit << 4 | channel, 0 when the pin has no ADC
+};
+
+#if CONFIG_IDF_TARGET_ESP32
+constexpr PinInfo pinTable[] = {
+  {PIN_IO | PIN_STRAPPING | PIN_TOUCH, PIN_ADC2(1)}, // 0
+  {PIN_IO, 0},                                       // 1, UART0 TX
+  {PIN_IO | PIN_STRAPPING | PIN_TOUCH, PIN_ADC2(2)}, // 2
+  {PIN_IO, 0},                                       // 3, UART0 RX
+  {PIN_IO | PIN_TOUCH, PIN_ADC2(0)},                 // 4
+  {PIN_IO | PIN_STRAPPING, 0},                       // 5
+  {PIN_FLASH, 0}, {PIN_FLASH, 0}, {PIN_FLASH, 0},    // 6-8
+  {PIN_FLASH, 0}, {PIN_FLASH, 0}, {PIN_FLASH, 0},    // 9-11
+  {PIN_IO | PIN_STRAPPING | PIN_TOUCH, PIN_ADC2(5)}, // 12
+  {PIN_IO | PIN_TOUCH, PIN_ADC2(4)},                 // 13
+  {PIN_IO | PIN_TOUCH, PIN_ADC2(6)},                 // 14
+  {PIN_IO | PIN_STRAPPING | PIN_TOUCH, PIN_ADC2(3)}, // 15
+  {PIN_IO, 0}, {PIN_IO, 0}, {PIN_IO, 0}, {PIN_IO, 0}, // 16-19
+  {0, 0},                                            // 20
+  {PIN_IO, 0}, {PIN_IO, 0}, {PIN_IO, 0},             // 21-23
+  {0, 0},                                            // 24
+  {PIN_IO, PIN_ADC2(8)},                             // 25
+  {PIN_IO, PIN_ADC2(9)},                             // 26
+  {PIN_IO | PIN_TOUCH, PIN_ADC2(7)},                 // 27
+  {0, 0}, {0, 0}, {0, 0}, {0, 0},                    // 28-31
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(4)},                 // 32
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(5)},                 // 33
+  {PIN_INPUT, PIN_ADC1(6)},                          // 34
+  {PIN_INPUT, PIN_ADC1(7)},                          // 35
+  {PIN_INPUT, PIN_ADC1(0)},                          // 36
+  {PIN_INPUT, PIN_ADC1(1)},                          // 37
+  {PIN_INPUT, PIN_ADC1(2)},                          // 38
+  {PIN_INPUT, PIN_ADC1(3)},                          // 39
+};
+#elif CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32S3
+constexpr PinInfo pinTable[] = {
+  {PIN_IO | PIN_STRAPPING, 0},                       // 0
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(0)},                 // 1
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(1)},                 // 2
+#if CONFIG_IDF_TARGET_ESP32S3
+  {PIN_IO | PIN_STRAPPING | PIN_TOUCH, PIN_ADC1(2)}, // 3
+#else
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(2)},                 // 3
+#endif
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(3)},                 // 4
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(4)},                 // 5
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(5)},                 // 6
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(6)},                 // 7
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(7)},                 // 8
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(8)},                 // 9
+  {PIN_IO | PIN_TOUCH, PIN_ADC1(9)},                 // 10
+  {PIN_IO | PIN_TOUCH, PIN_ADC2(0)},                 // 11
+  {PIN_IO | PIN_TOUCH, PIN_ADC2(1)},                 // 12
+  {PIN_IO | PIN_TOUCH, PIN_ADC2(2)},                 // 13
+  {PIN_IO | PIN_TOUCH, PIN_ADC2(3)},                 // 14
+  {PIN_IO, PIN_ADC2(4)},                             // 15
+  {PIN_IO, PIN_ADC2(5)},                             // 16
+  {PIN_IO, PIN_ADC2(6)},                             // 17
+  {PIN_IO, PIN_ADC2(7)},                             // 18
+  {PIN_IO, PIN_ADC2(8)},                             // 19, USB D-
+  {PIN_IO, PIN_ADC2(9)},                             // 20, USB D+
+  {PIN_IO, 0},                                       // 21
+  {0, 0}, {0, 0}, {0, 0}, {0, 0},                    // 22-25
+  {PIN_FLASH, 0}, {PIN_FLASH, 0}, {PIN_FLASH, 0},    // 26-28
+  {PIN_FLASH, 0}, {PIN_FLASH, 0}, {PIN_FLASH, 0},    // 29-31
+  {PIN_FLASH, 0},                                    // 32
+  {PIN_IO, 0}, {PIN_IO, 0}, {PIN_IO, 0}, {PIN_IO, 0}, // 33-36
+  {PIN_IO, 0}, {PIN_IO, 0}, {PIN_IO, 0}, {PIN_IO, 0}, // 37-40
+  {PIN_IO, 0}, {PIN_IO, 0}, {PIN_IO, 0}, {PIN_IO, 0}, // 41-44
+  {PIN_IO | PIN_STRAPPING, 0},                       // 45
+#if CONFIG_IDF_TARGET_ESP32S3
+  {PIN_IO | PIN_STRAPPING, 0},                       // 46
+  {PIN_IO, 0}, {PIN_IO, 0},                          // 47-48
+#else
+  {PIN_INPUT | PIN_STRAPPING, 0},                    // 46
+#endif
+};
+#elif CONFIG_IDF_TARGET_ESP32C3
+constexpr PinInfo pinTable[] = {
+  {PIN_IO, PIN_ADC1(0)},                             // 0
+  {PIN_IO, PIN_ADC1(1)},                             // 1
+  {PIN_IO | PIN_STRAPPING, PIN_ADC1(2)},             // 2
+  {PIN_IO, PIN_ADC1(3)},                             // 3
+  {PIN_IO, PIN_ADC1(4)},                             // 4
+  {PIN_IO, PIN_ADC2(0)},                             // 5
+  {PIN_IO, 0}, {PIN_IO, 0},                          // 6-7
+  {PIN_IO | PIN_STRAPPING, 0},                       // 8
+  {PIN_IO | PIN_STRAPPING, 0},                       // 9
+  {PIN_IO, 0}, {PIN_IO, 0},                          // 10-11
+  {PIN_FLASH, 0}, {PIN_FLASH, 0}, {PIN_FLASH, 0},    // 12-14
+  {PIN_FLASH, 0}, {PIN_FLASH, 0}, {PIN_FLASH, 0},    // 15-17
+  {PIN_IO, 0}, {PIN_IO, 0},                          // 18-19, USB D- and D+
+  {PIN_IO, 0}, {PIN_IO, 0},                          // 20-21, UART0 RX and TX
+};
+#else
+#error "No pin table for this target"
+#endif
+
+static_assert(sizeof(pinTable) / sizeof(pinTable[0]) == SOC_GPIO_PIN_COUNT, "pin table does not match SOC_GPIO_PIN_COUNT");
+
+constexpr bool pinHas(int gpio, uint8_t caps) {
+  return gpio >= 0 && gpio < SOC_GPIO_PIN_COUNT && (pinTable[gpio].caps & caps) == caps;
+}
+
+constexpr bool pinCanOutput(int gpio) {
+  return pinHas(gpio, PIN_OUTPUT);
+}
+
+constexpr bool pinCanInput(int gpio) {
+  return pinHas(gpio, PIN_INPUT);
+}
+
+// 1 or 2, 0 when the pin has no ADC
+constexpr int pinAdcUnit(int gpio) {
+  return gpio >= 0 && gpio < SOC_GPIO_PIN_COUNT ? pinTable[gpio].adc >> 4 : 0;
+}
+
+constexpr int pinAdcChannel(int gpio) {
+  return pinAdcUnit(gpio) ? pinTable[gpio].adc & 0x0F : -1;
+}
+
+// The lookups are constant expressions, so these cost nothing at run time
+// and catch a mistyped table row at compile time.
+static_assert(!pinCanOutput(-1) && !pinCanInput(SOC_GPIO_PIN_COUNT), "out of range pins must be rejected");
+#if CONFIG_IDF_TARGET_ESP32
+static_assert(!pinCanInput(6) && !pinCanOutput(11) && !pinCanOutput(20), "flash and missing pins must be rejected");
+static_assert(pinCanInput(34) && !pinCanOutput(34) && pinCanOutput(33), "34-39 are input only");
+static_assert(pinAdcUnit(36) == 1 && pinAdcChannel(36) == 0 && pinAdcUnit(4) == 2 && pinAdcChannel(2) == 2, "ADC map");
+#elif CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32S3
+static_assert(!pinCanInput(26) && !pinCanOutput(22) && pinCanOutput(33), "flash and missing pins must be rejected");
+static_assert(pinAdcUnit(1) == 1 && pinAdcChannel(10) == 9 && pinAdcUnit(11) == 2 && pinAdcChannel(20) == 9, "ADC map");
+#elif CONFIG_IDF_TARGET_ESP32C3
+static_assert(!pinCanInput(12) && pinCanOutput(18), "flash pins must be rejected");
+static_assert(pinAdcUnit(4) == 1 && pinAdcUnit(5) == 2 && pinAdcChannel(5) == 0, "ADC map");
+#endif
+
+// Commands are decoded once, at ingress, from the "high" / "low" / "pwmNNN"
+// wire strings into this compact form. Executors, the scheduler and
+// persistence only ever see the decoded command.
+#define PWM_DEFAULT_FREQ 5000       // 5 kHz PWM
+#define PWM_DEFAULT_RESOLUTION 8    // with 8-bit resolution
+#define PWM_MAX_RESOLUTION (SOC_LEDC_TIMER_BIT_WIDE_NUM < 16 ? SOC_LEDC_TIMER_BIT_WIDE_NUM : 16) // duty is 16 bits
+
+enum GpioOp : uint8_t {
+  OP_NONE,
+  OP_HIGH,
+  OP_LOW,
+  OP_PWM
+};
+
+struct GpioCommand {
+  uint8_t op;
+  uint8_t gpio;
+  uint16_t duty;
+  uint32_t duration;
+  uint32_t frequency;  // PWM only
+  uint8_t resolution;  // PWM only, in bits
+  uint8_t shape;       // PWM only, RampShape of the fade
+  uint16_t ramp;       // PWM only, ms to fade to duty, 0 for an instant write
+};
+
+// Fade shapes. Exponential changes the duty by the same ratio every step,
+// which looks even to the eye on lamps; S-curve eases in and out, which is
+// gentle on motors.
+#define RAMP_MAX_MS 65535
+
+enum RampShape : uint8_t {
+  RAMP_LINEAR,
+  RAMP_EXP,
+  RAMP_SCURVE,
+  RAMP_SHAPES
+};
+
+const char* const rampShapeNames[RAMP_SHAPES] = {"linear", "exp", "scurve"};
+
+bool pinClaimed(int gpio);
+
+// Fills cmd from a state ("high", "low", "pwm<duty>") without looking at the
+// pin, for decodeCommand() and for group operations
+bool decodeState(const char* state, GpioCommand &cmd, uint32_t frequency, int resolution) {
+  cmd.op = OP_NONE;
+  cmd.gpio = 0;
+  cmd.duty = 0;
+  cmd.duration = 0;
+  cmd.frequency = frequency;
+  cmd.resolution = resolution;
+  cmd.shape = RAMP_LINEAR;
+  cmd.ramp = 0;
+  if (state == NULL) {
+    return false;
+  }
+  if (frequency == 0 || resolution < 1 || resolution > PWM_MAX_RESOLUTION) {
+    return false;
+  }
+  if (strcmp(state, "high") == 0) {
+    cmd.op = OP_HIGH;
+  } else if (strcmp(state, "low") == 0) {
+    cmd.op = OP_LOW;
+  } else if (strncmp(state, "pwm", 3) == 0) {
+    const char* digits = state + 3;
+    uint32_t duty = 0;
+    if (*digits == '\0') {
+      return false;
+    }
+    for (; *digits != '\0'; digits++) {
+      if (*digits < '0' || *digits > '9') {
+        return false;
+      }
+      duty = duty * 10 + (*digits - '0');
+      if (duty > (1UL << resolution) - 1) {
+        return false;
+      }
+    }
+    cmd.op = OP_PWM;
+    cmd.duty = duty;
+  }
+  return cmd.op != OP_NONE;
+}
+
+// A pin edge capture or a pulse counter holds as an input is refused like a
+// pin that cannot output
+bool decodeCommand(int gpio, const char* state, GpioCommand &cmd,
+                   uint32_t frequency = PWM_DEFAULT_FREQ, int resolution = PWM_DEFAULT_RESOLUTION) {
+  bool ok = decodeState(state, cmd, frequency, resolution);
+  cmd.gpio = gpio;
+  return ok && pinCanOutput(gpio) && !pinClaimed(gpio);
+}
+
+// Returns the RampShape called name, or -1
+int rampShapeFind(const char* name) {
+  for (int shape = 0; shape < RAMP_SHAPES; shape++) {
+    if (strcmp(name, rampShapeNames[shape]) == 0) {
+      return shape;
+    }
+  }
+  return -1;
+}
+
+// Makes a decoded command fade over ms instead of jumping. Only PWM commands
+// can fade; ms 0 leaves the command instant.
+bool decodeRamp(GpioCommand &cmd, long ms, int shape) {
+  if (ms < 0 || ms > RAMP_MAX_MS || shape < 0 || shape >= RAMP_SHAPES || (ms > 0 && cmd.op != OP_PWM)) {
+    return false;
+  }
+  cmd.ramp = ms;
+  cmd.shape = shape;
+  return true;
+}
+
+// Writes the wire form of a command ("high", "low", "pwm128") into buf
+void formatState(const GpioCommand &cmd, char* buf, size_t len) {
+  if (cmd.op == OP_PWM) {
+    snprintf(buf, len, "pwm%u", cmd.duty);
+  } else {
+    snprintf(buf, len, "%s", cmd.op == OP_HIGH ? "high" : "low");
+  }
+}
+
+// The command a timed operation reverts to once its duration has elapsed
+GpioCommand resetCommand(const GpioCommand &cmd) {
+  GpioCommand reset = cmd;
+  reset.op = cmd.op == OP_LOW ? OP_HIGH : OP_LOW;
+  reset.duty = 0;
+  reset.duration = 0;
+  reset.ramp = 0;
+  return reset;
+}
+
+// Digital writes are folded into per-bank set/clear masks and applied with a
+// single GPIO_OUT register write per bank, so all pins of a batch change at
+// the same instant. Every digital write in this sketch goes through
+// actuateMask() on the actuation task, under gpioMux, which keeps the
+// read-modify-write safe.
+#if SOC_GPIO_PIN_COUNT > 32
+#define GPIO_BANKS 2
+#else
+#define GPIO_BANKS 1
+#endif
+
+struct GpioMaskWrite {
+  uint32_t set[GPIO_BANKS];
+  uint32_t clear[GPIO_BANKS];
+};
+
+portMUX_TYPE gpioMux = portMUX_INITIALIZER_UNLOCKED;
+uint32_t outputPins[GPIO_BANKS]; // pins already configured as digital outputs
+uint32_t pwmPins[GPIO_BANKS];    // pins currently attached to LEDC
+uint32_t changedPins[GPIO_BANKS]; // pins written since the last WebSocket push
+uint32_t rampPins[GPIO_BANKS];    // pins with a fade in progress
+uint32_t inputPins[GPIO_BANKS];   // pins configured as inputs by the sketch
+
+// Pins edge capture or a pulse counter switched to input. Commands may not
+// drive them, as an output would cut off what is being measured. Each owner
+// keeps its own set; claimedPins is their union, read without the lock.
+enum PinOwner : uint8_t {
+  OWNER_EDGE,
+  OWNER_COUNTER,
+  PIN_OWNERS
+};
+
+uint32_t ownedPins[PIN_OWNERS][GPIO_BANKS]; // under gpioMux
+uint32_t claimedPins[GPIO_BANKS];
+
+// Replaces the pins one owner holds
+void pinsClaim(uint8_t owner, const uint32_t pins[GPIO_BANKS]) {
+  portENTER_CRITICAL(&gpioMux);
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    ownedPins[owner][bank] = pins[bank];
+    uint32_t claimed = 0;
+    for (int i = 0; i < PIN_OWNERS; i++) {
+      claimed |= ownedPins[i][bank];
+    }
+    __atomic_store_n(&claimedPins[bank], claimed, __ATOMIC_RELAXED);
+  }
+  portEXIT_CRITICAL(&gpioMux);
+}
+
+uint32_t claimedMask(int bank) {
+  return __atomic_load_n(&claimedPins[bank], __ATOMIC_RELAXED);
+}
+
+bool pinClaimed(int gpio) {
+  return gpio >= 0 && gpio < SOC_GPIO_PIN_COUNT && (claimedMask(gpio >> 5) >> (gpio & 31)) & 1;
+}
+
+// LEDC channels are handed out to pins on demand and returned when a pin goes
+// back to digital. The Arduino core drives channels 2n and 2n+1 from the same
+// timer, so a channel pair is shared by pins that use the same frequency and
+// resolution. A repeat write with unchanged timing only updates the duty.
+#ifdef SOC_LEDC_SUPPORT_HS_MODE
+#define LEDC_CHANNELS (SOC_LEDC_CHANNEL_NUM * 2)
+#else
+#define LEDC_CHANNELS SOC_LEDC_CHANNEL_NUM
+#endif
+#define LEDC_TIMERS (LEDC_CHANNELS / 2)
+#define LEDC_NONE 0xFF
+
+struct LedcTimer {
+  uint32_t frequency;
+  uint8_t resolution;
+  uint8_t users;
+};
+
+LedcTimer ledcTimers[LEDC_TIMERS];
+uint8_t ledcChannelPin[LEDC_CHANNELS];  // LEDC_NONE when free
+uint8_t pinChannel[SOC_GPIO_PIN_COUNT]; // LEDC_NONE when not doing PWM
+uint16_t pinDuty[SOC_GPIO_PIN_COUNT];   // last duty written, valid while in pwmPins
+uint32_t ledcReconfigs = 0;             // timer (re)configurations so far
+
+void ledcPoolBegin() {
+  memset(ledcTimers, 0, sizeof(ledcTimers));
+  memset(ledcChannelPin, LEDC_NONE, sizeof(ledcChannelPin));
+  memset(pinChannel, LEDC_NONE, sizeof(pinChannel));
+}
+
+// Prefers a free channel on a timer that already runs at this frequency and
+// resolution, then a channel pair nobody uses. Call with gpioMux held.
+uint8_t ledcFindChannel(uint32_t frequency, uint8_t resolution, bool &configure) {
+  for (int channel = 0; channel < LEDC_CHANNELS; channel++) {
+    const LedcTimer &timer = ledcTimers[channel / 2];
+    if (ledcChannelPin[channel] == LEDC_NONE && timer.users > 0 &&
+        timer.frequency == frequency && timer.resolution == resolution) {
+      configure = false;
+      return channel;
+    }
+  }
+  for (int index = 0; index < LEDC_TIMERS; index++) {
+    if (ledcTimers[index].users == 0) {
+      configure = true;
+      return index * 2;
+    }
+  }
+  return LEDC_NONE;
+}
+
+void ledcReleaseLocked(int gpio) {
+  uint8_t channel = pinChannel[gpio];
+  if (channel != LEDC_NONE) {
+    pinChannel[gpio] = LEDC_NONE;
+    ledcChannelPin[channel] = LEDC_NONE;
+    ledcTimers[channel / 2].users--;
+  }
+}
+
+// Returns false when no channel is free or the timer rejects the timing
+bool pwmWrite(int gpio, uint16_t duty, uint32_t frequency, uint8_t resolution) {
+  bool configure = false;
+  bool attach = false;
+  portENTER_CRITICAL(&gpioMux);
+  uint8_t channel = pinChannel[gpio];
+  if (channel != LEDC_NONE) {
+    LedcTimer &timer = ledcTimers[channel / 2];
+    if (timer.frequency != frequency || timer.resolution != resolution) {
+      if (timer.users == 1) {
+        configure = true; // Sole user of the pair, retune it in place
+      } else {
+        bool fresh;
+        uint8_t moved = ledcFindChannel(frequency, resolution, fresh);
+        if (moved == LEDC_NONE) {
+          portEXIT_CRITICAL(&gpioMux);
+          return false;
+        }
+        ledcReleaseLocked(gpio);
+        channel = moved;
+        configure = fresh;
+        attach = true;
+      }
+    }
+  } else {
+    channel = ledcFindChannel(frequency, resolution, configure);
+    if (channel == LEDC_NONE) {
+      portEXIT_CRITICAL(&gpioMux);
+      return false;
+    }
+    attach = true;
+  }
+  if (attach) {
+    pinChannel[gpio] = channel;
+    ledcChannelPin[channel] = gpio;
+    ledcTimers[channel / 2].users++;
+  }
+  if (configure) {
+    ledcTimers[channel / 2].frequency = frequency;
+    ledcTimers[channel / 2].resolution = resolution;
+  }
+  pwmPins[gpio >> 5] |= 1UL << (gpio & 31);
+  outputPins[gpio >> 5] &= ~(1UL << (gpio & 31)); // needs pinMode again once detached
+  rampPins[gpio >> 5] &= ~(1UL << (gpio & 31));   // a new duty replaces any fade
+  portEXIT_CRITICAL(&gpioMux);
+
+  if (configure) {
+    ledcReconfigs++;
+    if (ledcSetup(channel, frequency, resolution) == 0) {
+      // The timer cannot produce this frequency at this resolution. The pin
+      // stays in pwmPins, so a later digital write still detaches it.
+      portENTER_CRITICAL(&gpioMux);
+      ledcTimers[channel / 2].frequency = 0; // Never matches, reprogrammed on next use
+      if (attach) {
+        ledcReleaseLocked(gpio);
+      }
+      portEXIT_CRITICAL(&gpioMux);
+      if (attach) {
+        ledcDetachPin(gpio); // Not left routed to a channel it no longer owns
+      }
+      return false;
+    }
+  }
+  if (attach) {
+    pinMode(gpio, OUTPUT);
+    ledcAttachPin(gpio, channel);
+  }
+  ledcWrite(channel, duty);
+  portENTER_CRITICAL(&gpioMux);
+  pinDuty[gpio] = duty;
+  changedPins[gpio >> 5] |= 1UL << (gpio & 31);
+  pwmWrites++;
+  portEXIT_CRITICAL(&gpioMux);
+  return true;
+}
+
+// Hands the pin's channel back to the pool and returns the pin to GPIO output
+void pwmRelease(int gpio) {
+  portENTER_CRITICAL(&gpioMux);
+  ledcReleaseLocked(gpio);
+  portEXIT_CRITICAL(&gpioMux);
+  ledcDetachPin(gpio);
+}
+
+// The only direct register access in the sketch. Everything else reaches the
+// hardware through Arduino/IDF calls, so these are all a simulated GPIO
+// layer has to replace.
+uint32_t gpioOutRead(int bank) {
+#if GPIO_BANKS > 1
+  if (bank == 1) return REG_READ(GPIO_OUT1_REG);
+#endif
+  return REG_READ(GPIO_OUT_REG);
+}
+
+void gpioOutWrite(int bank, uint32_t value) {
+#if GPIO_BANKS > 1
+  if (bank == 1) {
+    REG_WRITE(GPIO_OUT1_REG, value);
+    return;
+  }
+#endif
+  REG_WRITE(GPIO_OUT_REG, value);
+}
+
+uint32_t IRAM_ATTR gpioInRead(int bank) {
+#if GPIO_BANKS > 1
+  if (bank == 1) return REG_READ(GPIO_IN1_REG);
+#endif
+  return REG_READ(GPIO_IN_REG);
+}
+
+void maskAdd(GpioMaskWrite &write, int gpio, bool level) {
+  uint32_t bit = 1UL << (gpio & 31);
+  int bank = gpio >> 5;
+  if (level) {
+    write.set[bank] |= bit;
+    write.clear[bank] &= ~bit;
+  } else {
+    write.clear[bank] |= bit;
+    write.set[bank] &= ~bit;
+  }
+}
+
+void maskRemove(GpioMaskWrite &write, int gpio) {
+  uint32_t bit = 1UL << (gpio & 31);
+  write.set[gpio >> 5] &= ~bit;
+  write.clear[gpio >> 5] &= ~bit;
+}
+
+// Returns the number of GPIO_OUT register writes it took. Pins that are not
+// outputs yet get their level latched first and are switched to output (or
+// detached from LEDC) afterwards, so they never glitch through the old level.
+int actuateMask(const GpioMaskWrite &write) {
+  uint32_t set[GPIO_BANKS];
+  uint32_t clear[GPIO_BANKS];
+  uint32_t detach[GPIO_BANKS];
+  uint32_t setup[GPIO_BANKS];
+  int writes = 0;
+  portENTER_CRITICAL(&gpioMux);
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    // A pin claimed after the write was queued is left to its owner
+    set[bank] = write.set[bank] & ~claimedPins[bank];
+    clear[bank] = write.clear[bank] & ~claimedPins[bank];
+    detach[bank] = (set[bank] | clear[bank]) & pwmPins[bank];
+    setup[bank] = (set[bank] | clear[bank]) & ~outputPins[bank];
+    pwmPins[bank] &= ~detach[bank];
+    outputPins[bank] |= setup[bank];
+    rampPins[bank] &= ~(set[bank] | clear[bank]);
+    changedPins[bank] |= set[bank] | clear[bank];
+  }
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    if (set[bank] | clear[bank]) {
+      gpioOutWrite(bank, (gpioOutRead(bank) & ~clear[bank]) | set[bank]);
+      writes++;
+      digitalWrites++;
+    }
+  }
+  portEXIT_CRITICAL(&gpioMux);
+
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    while (setup[bank]) {
+      uint32_t bit = setup[bank] & -setup[bank];
+      int gpio = bank * 32 + __builtin_ctz(bit);
+      if (detach[bank] & bit) {
+        pwmRelease(gpio);
+      }
+      pinMode(gpio, OUTPUT);
+      setup[bank] &= ~bit;
+    }
+  }
+  return writes;
+}
+
+bool rampStart(const GpioCommand &cmd);
+void rampStep();
+
+// Outcome of a command, or of an actuation a producer waited for
+enum ActuationResult : uint8_t {
+  ACTUATED,
+  ACTUATION_BUSY,          // dropped by the full ring, nothing done
+  ACTUATION_NO_CHANNEL,    // no free LEDC channel for a PWM pin, a fade's included
+  ACTUATION_CLAIMED        // the pin was claimed as an input after it was checked
+};
+
+// Fails when a PWM command could not get an LEDC channel, or its pin was
+// claimed after it was queued
+ActuationResult actuateCommand(const GpioCommand &cmd) {
+  if (pinClaimed(cmd.gpio)) {
+    return ACTUATION_CLAIMED;
+  }
+  bool ok = true;
+  if (cmd.op == OP_HIGH || cmd.op == OP_LOW) {
+    GpioMaskWrite write = {};
+    maskAdd(write, cmd.gpio, cmd.op == OP_HIGH);
+    actuateMask(write);
+  } else if (cmd.op == OP_PWM && cmd.ramp > 0) {
+    ok = rampStart(cmd);
+  } else if (cmd.op == OP_PWM) {
+    ok = pwmWrite(cmd.gpio, cmd.duty, cmd.frequency, cmd.resolution);
+  }
+  return ok ? ACTUATED : ACTUATION_NO_CHANNEL;
+}
+
+// Pin writes are carried out by one actuation task pinned to the application
+// core. Request handlers, timer callbacks and the UDP listener only validate
+// and push onto a bounded lock-free ring (many producers, one consumer), so
+// LEDC setup never runs on the network task and the pin state is only ever
+// changed from one place, in order. The one exception is precise pulses,
+// whose task sets and clears pins that are digital outputs already, with the
+// same locked read-modify-write of GPIO_OUT (see preciseRun()).
+#define ACTUATION_QUEUE_SIZE 64 // power of two
+#define ACTUATION_PRIORITY 20   // above async_tcp and loop(), below esp_timer
+#define ACTUATION_CORE (portNUM_PROCESSORS - 1)
+#define ACTUATION_STACK 4096
+#define ACTUATION_WAIT_MS 100   // how long a producer waits for room before dropping
+#define ACTUATION_LATENCY_SHIFT 2 // push to execution in 4 us steps, up to 8 ms
+
+struct Scene;
+uint32_t actuateScene(const Scene &scene);
+
+enum ActuationKind : uint8_t {
+  ACT_COMMAND,
+  ACT_MASK,
+  ACT_SCENE,
+  ACT_RAMP
+};
+
+// Filled in by the actuation task for a producer that waits on the result
+struct Completion {
+  TaskHandle_t waiter;
+  volatile bool done;
+  uint8_t result;          // ActuationResult
+  uint32_t failed;         // ACT_SCENE: bit i set when pwm[i] got no channel
+};
+
+struct Actuation {
+  uint8_t kind;
+  GpioCommand cmd;         // ACT_COMMAND
+  GpioMaskWrite write;     // ACT_MASK
+  const Scene* scene;      // ACT_SCENE
+  Completion* completion;  // NULL when nobody waits
+  uint32_t queuedAt;       // micros()
+};
+
+// A cell is free for position p when seq == p and holds position p's
+// actuation when seq == p + 1 (Vyukov's bounded queue).
+struct ActuationCell {
+  uint32_t seq;
+  Actuation actuation;
+};
+
+ActuationCell actuationRing[ACTUATION_QUEUE_SIZE];
+uint32_t actuationTail = 0;      // next position to claim, by compare-and-swap
+uint32_t actuationHead = 0;      // next position to run, actuation task only
+TaskHandle_t actuationTask = NULL;
+uint32_t actuationEnqueued = 0;
+uint32_t actuationDropped = 0;   // pushes given up after ACTUATION_WAIT_MS
+uint32_t actuationFullWaits = 0; // pushes that found the ring full
+uint32_t actuationMaxDepth = 0;
+uint32_t actuationLatencyMax = 0;
+uint64_t actuationLatencySum = 0; // us from push to execution, actuation task only
+uint32_t actuationExecuted = 0;
+Histogram actuationLatency;       // actuation task only
+
+void atomicMax(uint32_t &target, uint32_t value) {
+  uint32_t seen = __atomic_load_n(&target, __ATOMIC_RELAXED);
+  while (value > seen && !__atomic_compare_exchange_n(&target, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+// Returns false when the ring is full
+bool actuationTryPush(const Actuation &actuation) {
+  uint32_t pos = __atomic_load_n(&actuationTail, __ATOMIC_RELAXED);
+  for (;;) {
+    ActuationCell &cell = actuationRing[pos & (ACTUATION_QUEUE_SIZE - 1)];
+    int32_t diff = (int32_t)(__atomic_load_n(&cell.seq, __ATOMIC_ACQUIRE) - pos);
+    if (diff < 0) {
+      return false;
+    }
+    if (diff > 0) {
+      pos = __atomic_load_n(&actuationTail, __ATOMIC_RELAXED); // another producer claimed it
+    } else if (__atomic_compare_exchange_n(&actuationTail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      cell.actuation = actuation;
+      cell.actuation.queuedAt = micros();
+      __atomic_store_n(&cell.seq, pos + 1, __ATOMIC_RELEASE);
+      break;
+    }
+  }
+  __atomic_fetch_add(&actuationEnqueued, 1, __ATOMIC_RELAXED);
+  // The actuation task may already have run it, and more, by now
+  int32_t depth = (int32_t)(pos + 1 - __atomic_load_n(&actuationHead, __ATOMIC_RELAXED));
+  if (depth > 0) {
+    atomicMax(actuationMaxDepth, depth);
+  }
+  xTaskNotifyGive(actuationTask);
+  return true;
+}
+
+// Waits for room while the actuation task catches up. Returns false when the
+// actuation was dropped.
+bool actuationPush(const Actuation &actuation) {
+  if (actuationTryPush(actuation)) {
+    return true;
+  }
+  __atomic_fetch_add(&actuationFullWaits, 1, __ATOMIC_RELAXED);
+  for (int waited = 0; waited < ACTUATION_WAIT_MS; waited++) {
+    vTaskDelay(1);
+    if (actuationTryPush(actuation)) {
+      return true;
+    }
+  }
+  __atomic_fetch_add(&actuationDropped, 1, __ATOMIC_RELAXED);
+  return false;
+}
+
+void actuationLoop(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for (;;) {
+      ActuationCell &cell = actuationRing[actuationHead & (ACTUATION_QUEUE_SIZE - 1)];
+      if (__atomic_load_n(&cell.seq, __ATOMIC_ACQUIRE) != actuationHead + 1) {
+        break; // empty, or the next producer has not finished writing
+      }
+      Actuation actuation = cell.actuation;
+      __atomic_store_n(&cell.seq, actuationHead + ACTUATION_QUEUE_SIZE, __ATOMIC_RELEASE);
+      __atomic_store_n(&actuationHead, actuationHead + 1, __ATOMIC_RELAXED);
+
+      uint32_t latency = micros() - actuation.queuedAt;
+      actuationLatencySum += latency;
+      atomicMax(actuationLatencyMax, latency);
+      histogramObserve(actuationLatency, latency, ACTUATION_LATENCY_SHIFT);
+      ActuationResult result = ACTUATED;
+      uint32_t failed = 0;
+      if (actuation.kind == ACT_MASK) {
+        actuateMask(actuation.write);
+      } else if (actuation.kind == ACT_SCENE) {
+        failed = actuateScene(*actuation.scene);
+        result = failed ? ACTUATION_NO_CHANNEL : ACTUATED;
+      } else if (actuation.kind == ACT_RAMP) {
+        rampStep();
+      } else {
+        result = actuateCommand(actuation.cmd);
+      }
+      // Release: whoever sees the count also sees the pins and stats it covers
+      __atomic_store_n(&actuationExecuted, actuationExecuted + 1, __ATOMIC_RELEASE);
+
+      Completion* completion = actuation.completion;
+      if (completion) {
+        TaskHandle_t waiter = completion->waiter; // completion is gone once done is set
+        completion->result = result;
+        completion->failed = failed;
+        __atomic_store_n(&completion->done, true, __ATOMIC_RELEASE);
+        xTaskNotifyGive(waiter);
+      }
+    }
+  }
+}
+
+void actuationBegin() {
+  for (uint32_t i = 0; i < ACTUATION_QUEUE_SIZE; i++) {
+    actuationRing[i].seq = i;
+  }
+  xTaskCreatePinnedToCore(actuationLoop, "actuation", ACTUATION_STACK, NULL, ACTUATION_PRIORITY, &actuationTask,
+                          ACTUATION_CORE);
+}
+
+// Queues an actuation and waits until the actuation task has run it. Returns
+// its result, or ACTUATION_BUSY when it was dropped.
+ActuationResult actuationCall(Actuation &actuation, Completion &completion) {
+  completion = {xTaskGetCurrentTaskHandle(), false, ACTUATED, 0};
+  actuation.completion = &completion;
+  if (!actuationPush(actuation)) {
+    return ACTUATION_BUSY;
+  }
+  while (!__atomic_load_n(&completion.done, __ATOMIC_ACQUIRE)) {
+    ulTaskNotifyTake(pdTRUE, 1);
+  }
+  return (ActuationResult)completion.result;
+}
+
+// The same for a caller that only needs to know whether it was carried out
+bool actuationCall(Actuation &actuation) {
+  Completion completion;
+  return actuationCall(actuation, completion) == ACTUATED;
+}
+
+// Queues a command. PWM commands wait for the result, as they can fail for
+// want of an LEDC channel; digital writes return once queued, so they only
+// fail as ACTUATION_BUSY. Runs inline until actuationBegin().
+ActuationResult executeCommand(const GpioCommand &cmd) {
+  if (actuationTask == NULL) {
+    return actuateCommand(cmd);
+  }
+  Actuation actuation = {ACT_COMMAND, cmd, {}, NULL, NULL, 0};
+  if (cmd.op != OP_PWM) {
+    return actuationPush(actuation) ? ACTUATED : ACTUATION_BUSY;
+  }
+  Completion completion;
+  return actuationCall(actuation, completion);
+}
+
+// Queues a command, PWM included, without waiting for room or for the
+// result: for timer callbacks, which must not block. Returns false when the
+// ring was full and the command was dropped.
+bool actuationSend(const GpioCommand &cmd) {
+  if (actuationTask == NULL) {
+    return actuateCommand(cmd) == ACTUATED;
+  }
+  Actuation actuation = {ACT_COMMAND, cmd, {}, NULL, NULL, 0};
+  if (actuationTryPush(actuation)) {
+    return true;
+  }
+  __atomic_fetch_add(&actuationDropped, 1, __ATOMIC_RELAXED);
+  return false;
+}
+
+bool maskEmpty(const GpioMaskWrite &write) {
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    if (write.set[bank] | write.clear[bank]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Queues a masked write, skipping empty ones. Returns false when it was dropped.
+bool applyMaskWrite(const GpioMaskWrite &write) {
+  if (maskEmpty(write)) {
+    return true;
+  }
+  if (actuationTask == NULL) {
+    actuateMask(write);
+    return true;
+  }
+  Actuation actuation = {ACT_MASK, {}, write, NULL, NULL, 0};
+  return actuationPush(actuation);
+}
+
+// The same without waiting for room, for timer callbacks as actuationSend()
+// is. Returns false when the ring was full and the write was dropped.
+bool maskSend(const GpioMaskWrite &write) {
+  if (maskEmpty(write)) {
+    return true;
+  }
+  if (actuationTask == NULL) {
+    actuateMask(write);
+    return true;
+  }
+  Actuation actuation = {ACT_MASK, {}, write, NULL, NULL, 0};
+  if (actuationTryPush(actuation)) {
+    return true;
+  }
+  __atomic_fetch_add(&actuationDropped, 1, __ATOMIC_RELAXED);
+  return false;
+}
+
+// PWM fades. A ramp moves a pin from the duty it has now to the duty of its
+// command over cmd.ramp ms. One RAMP_TICK_MS ticker queues a single ramp step
+// onto the actuation ring, and the actuation task writes the next duty of
+// every running ramp on it, so a fade costs no requests and every pin that
+// fades changes on the same tick. Ramps started between two ticks start
+// together on the next one, so a batch or group fades in step. Any other
+// write to the pin ends its ramp.
+#define RAMP_TICK_MS 5
+#define MAX_RAMPS LEDC_CHANNELS // a fading pin holds a channel
+#define RAMP_NONE 0xFF
+
+struct Ramp {
+  uint8_t gpio;       // RAMP_NONE when the slot is free
+  uint8_t shape;
+  bool started;       // start is taken on the first step after rampStart()
+  uint16_t from;
+  uint16_t to;
+  uint32_t start;     // millis()
+  uint32_t length;    // ms
+  float rate;         // RAMP_EXP: log((to + 1) / (from + 1))
+};
+
+Ticker rampTicker;
+Ramp ramps[MAX_RAMPS];   // actuation task only, read under gpioMux
+bool rampTickQueued = false;
+uint32_t rampTickUs = 0;      // time the last step took
+uint32_t rampTickMaxUs = 0;
+
+uint16_t rampValue(const Ramp &ramp, uint32_t elapsed) {
+  float progress = (float)elapsed / ramp.length;
+  float duty;
+  if (ramp.shape == RAMP_EXP) {
+    duty = (ramp.from + 1) * expf(ramp.rate * progress) - 1;
+  } else {
+    if (ramp.shape == RAMP_SCURVE) {
+      progress = progress * progress * (3 - 2 * progress);
+    }
+    duty = ramp.from + ((float)ramp.to - ramp.from) * progress;
+  }
+  return (uint16_t)(duty + 0.5f);
+}
+
+// Runs on the actuation task. Attaches the pin at the duty it has now (full
+// duty for a pin that is HIGH) and leaves the rest to rampStep().
+bool rampStart(const GpioCommand &cmd) {
+  int gpio = cmd.gpio;
+  int bank = gpio >> 5;
+  uint32_t bit = 1UL << (gpio & 31);
+  uint32_t top = (1UL << cmd.resolution) - 1;
+  uint32_t from = 0;
+  portENTER_CRITICAL(&gpioMux);
+  uint8_t channel = pinChannel[gpio];
+  if ((pwmPins[bank] & bit) && channel != LEDC_NONE) {
+    from = (uint64_t)pinDuty[gpio] * top / ((1UL << ledcTimers[channel / 2].resolution) - 1);
+  } else if ((outputPins[bank] & bit) && (gpioOutRead(bank) & bit)) {
+    from = top;
+  }
+  portEXIT_CRITICAL(&gpioMux);
+  if (!pwmWrite(gpio, from, cmd.frequency, cmd.resolution)) {
+    return false;
+  }
+
+  // A slot whose pin was written since is free as well
+  portENTER_CRITICAL(&gpioMux);
+  int slot = -1;
+  for (int i = 0; i < MAX_RAMPS; i++) {
+    uint8_t other = ramps[i].gpio;
+    if (other == gpio) {
+      slot = i;
+      break;
+    }
+    if (slot < 0 && (other == RAMP_NONE || !(rampPins[other >> 5] & (1UL << (other & 31))))) {
+      slot = i;
+    }
+  }
+  if (slot >= 0) {
+    Ramp &ramp = ramps[slot];
+    ramp.gpio = gpio;
+    ramp.shape = cmd.shape;
+    ramp.started = false;
+    ramp.from = from;
+    ramp.to = cmd.duty;
+    ramp.length = cmd.ramp;
+    ramp.rate = cmd.shape == RAMP_EXP ? logf((cmd.duty + 1.0f) / (from + 1.0f)) : 0;
+    rampPins[bank] |= bit;
+  }
+  portEXIT_CRITICAL(&gpioMux);
+  return slot >= 0 || pwmWrite(gpio, cmd.duty, cmd.frequency, cmd.resolution);
+}
+
+// Runs on the actuation task: one duty write per running ramp that moved
+void rampStep() {
+  uint32_t cycles = ESP.getCycleCount();
+  uint32_t now = millis();
+  for (int i = 0; i < MAX_RAMPS; i++) {
+    Ramp &ramp = ramps[i];
+    int gpio = ramp.gpio;
+    if (gpio == RAMP_NONE) {
+      continue;
+    }
+    int bank = gpio >> 5;
+    uint32_t bit = 1UL << (gpio & 31);
+    if (!(rampPins[bank] & bit)) {
+      portENTER_CRITICAL(&gpioMux);
+      ramp.gpio = RAMP_NONE; // ended by another write
+      portEXIT_CRITICAL(&gpioMux);
+      continue;
+    }
+    if (!ramp.started) {
+      ramp.started = true;
+      ramp.start = now;
+    }
+    uint32_t elapsed = now - ramp.start;
+    bool done = elapsed >= ramp.length;
+    uint16_t duty = done ? ramp.to : rampValue(ramp, elapsed);
+    if (duty != pinDuty[gpio]) {
+      ledcWrite(pinChannel[gpio], duty);
+    }
+    portENTER_CRITICAL(&gpioMux);
+    if (duty != pinDuty[gpio]) {
+      pinDuty[gpio] = duty;
+      changedPins[bank] |= bit;
+      pwmWrites++;
+    }
+    if (done) {
+      rampPins[bank] &= ~bit;
+      ramp.gpio = RAMP_NONE;
+    }
+    portEXIT_CRITICAL(&gpioMux);
+  }
+  rampTickUs = (ESP.getCycleCount() - cycles) / cyclesPerMicro;
+  if (rampTickUs > rampTickMaxUs) {
+    rampTickMaxUs = rampTickUs;
+  }
+  __atomic_store_n(&rampTickQueued, false, __ATOMIC_RELEASE);
+}
+
+// Ticker callback. Skips the tick while no pin fades or the last step has
+// not run yet; a late step catches up, as ramps follow millis().
+void rampTick() {
+  bool fading = false;
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    fading = fading || rampPins[bank] != 0;
+  }
+  if (!fading || actuationTask == NULL || __atomic_load_n(&rampTickQueued, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  __atomic_store_n(&rampTickQueued, true, __ATOMIC_RELAXED);
+  Actuation actuation = {ACT_RAMP, {}, {}, NULL, NULL, 0};
+  if (!actuationTryPush(actuation)) {
+    __atomic_store_n(&rampTickQueued, false, __ATOMIC_RELAXED);
+  }
+}
+
+int rampsActive() {
+  int active = 0;
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    active += __builtin_popcount(rampPins[bank]);
+  }
+  return active;
+}
+
+void rampsBegin() {
+  for (int i = 0; i < MAX_RAMPS; i++) {
+    ramps[i].gpio = RAMP_NONE;
+  }
+  rampTicker.attach_ms(RAMP_TICK_MS, rampTick);
+}
+
+// Named pin groups resolve to precomputed bank masks, so a group write in a
+// batch costs the same as a single pin write.
+#define MAX_PIN_GROUPS 8
+#define GROUP_NAME_LEN 16
+
+struct PinGroup {
+  char name[GROUP_NAME_LEN];
+  uint32_t mask[GPIO_BANKS];
+};
+
+PinGroup pinGroups[MAX_PIN_GROUPS];
+int pinGroupCount = 0;
+
+PinGroup* findPinGroup(const char* name) {
+  for (int i = 0; i < pinGroupCount; i++) {
+    if (strcmp(pinGroups[i].name, name) == 0) {
+      return &pinGroups[i];
+    }
+  }
+  return NULL;
+}
+
+// Parses a comma separated pin list ("12,13,14") into bank masks
+bool parsePinList(const char* list, uint32_t mask[GPIO_BANKS]) {
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    mask[bank] = 0;
+  }
+  while (*list != '\0') {
+    char* end;
+    long gpio = strtol(list, &end, 10);
+    if (end == list || !pinCanOutput(gpio) || (*end != ',' && *end != '\0')) {
+      return false;
+    }
+    mask[gpio >> 5] |= 1UL << (gpio & 31);
+    list = *end == ',' ? end + 1 : end;
+  }
+  return true;
+}
+
+bool groupClaimed(const PinGroup &group) {
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    if (group.mask[bank] & claimedMask(bank)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Folds a group operation into a batch. Digital states only touch the masks,
+// PWM is applied to each member pin right away. Returns the first failure of
+// a member, or ACTUATED.
+ActuationResult groupAdd(GpioMaskWrite &write, const PinGroup &group, const GpioCommand &cmd) {
+  ActuationResult result = ACTUATED;
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    if (cmd.op == OP_HIGH) {
+      write.set[bank] |= group.mask[bank];
+      write.clear[bank] &= ~group.mask[bank];
+    } else if (cmd.op == OP_LOW) {
+      write.clear[bank] |= group.mask[bank];
+      write.set[bank] &= ~group.mask[bank];
+    } else if (cmd.op == OP_PWM) {
+      uint32_t pins = group.mask[bank];
+      while (pins) {
+        GpioCommand pinCmd = cmd;
+        pinCmd.gpio = bank * 32 + __builtin_ctz(pins);
+        maskRemove(write, pinCmd.gpio);
+        ActuationResult pinResult = executeCommand(pinCmd);
+        result = result == ACTUATED ? pinResult : result;
+        pins &= pins - 1;
+      }
+    }
+  }
+  return result;
+}
+
+// Scheduled operations live in a preallocated pool and are linked into a
+// hierarchical timer wheel (WHEEL_LEVELS levels of WHEEL_SIZE slots, one
+// tick per millisecond), so insert and cancel are O(1) and a new schedule
+// never overwrites a pending one.
+#define SCHEDULER_CAPACITY 2048
+#define SCHEDULER_POLL_MS 1
+#define WHEEL_BITS 6
+#define WHEEL_LEVELS 4
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_MAX_DELAY ((1UL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+#define SCHEDULE_ID_LIMIT 0x80000000UL // IDs from here up are precise pulses
+#define ENTRY_NONE 0xFFFF
+
+enum EntryPhase : uint8_t {
+  PHASE_FREE,
+  PHASE_SET,   // waiting to apply the state
+  PHASE_RESET  // state applied, waiting to reset after duration
+};
+
+struct ScheduledEntry {
+  uint16_t next;
+  uint16_t prev;
+  uint16_t slot;     // wheel slot the entry is linked into
+  uint8_t phase;
+  uint32_t id;
+  uint32_t expires;  // absolute wheel tick
+  GpioCommand cmd;
+};
+
+ScheduledEntry scheduleEntries[SCHEDULER_CAPACITY];
+uint16_t wheelSlots[WHEEL_LEVELS * WHEEL_SIZE];
+uint16_t freeEntry = ENTRY_NONE;
+uint16_t pendingEntries = 0;
+uint32_t scheduleDropped = 0; // scheduled operations the full ring dropped, timer task only
+uint32_t wheelNow = 0;
+uint32_t nextScheduleSeq = 1;
+portMUX_TYPE schedulerMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Function prototypes
+void resetOperation(const GpioCommand &cmd);
+void scheduleOperation(const GpioCommand &cmd);
+void queueScheduleEvent(const ScheduledEntry &entry);
+bool preciseCancel(uint32_t id);
+
+void logCommand(const GpioCommand &cmd) {
+  Serial.print("GPIO ");
+  Serial.print(cmd.gpio);
+  if (cmd.op == OP_PWM) {
+    Serial.print(" set to PWM with value ");
+    Serial.print(cmd.duty);
+    if (cmd.ramp > 0) {
+      Serial.print(" over ");
+      Serial.print(cmd.ramp);
+      Serial.print(" ms ");
+      Serial.print(rampShapeNames[cmd.shape]);
+    }
+    Serial.println();
+  } else {
+    Serial.println(cmd.op == OP_HIGH ? " set to HIGH" : " set to LOW");
+  }
+}
+
+// Pin states are kept in a RAM image and written behind: loop() commits the
+// whole image as one NVS blob once no pin has changed for persistDebounceMs,
+// or PERSIST_MAX_DELAY_MS after the first unsaved change. A burst of
+// commands therefore costs a single flash commit instead of one per pin.
+#define PERSIST_NAMESPACE "gpio-states"
+#define PERSIST_KEY "pins"
+#define PERSIST_VERSION 2
+#define PERSIST_DEBOUNCE_MS 500
+#define PERSIST_MAX_DELAY_MS 5000
+
+struct StoredPin {
+  uint8_t op;       // OP_NONE when the pin is not resumed
+  uint8_t resolution;
+  uint16_t duty;
+  uint32_t frequency;
+};
+
+struct StateImage {
+  uint8_t version;
+  uint8_t pinCount;
+  uint16_t reserved;
+  StoredPin pins[SOC_GPIO_PIN_COUNT];
+};
+
+StateImage stateImage;
+StateImage committedImage;
+uint64_t dirtyPins = 0;
+uint32_t firstDirtyMs = 0;
+uint32_t lastDirtyMs = 0;
+uint32_t persistDebounceMs = PERSIST_DEBOUNCE_MS;
+uint32_t persistCommits = 0;
+uint32_t restoreMicros = 0; // time from boot until stored outputs were restored
+portMUX_TYPE persistMux = portMUX_INITIALIZER_UNLOCKED;
+
+void markPin(int gpio, const StoredPin &pin) {
+  uint32_t now = millis();
+  portENTER_CRITICAL(&persistMux);
+  stateImage.pins[gpio] = pin;
+  if (dirtyPins == 0) {
+    firstDirtyMs = now;
+  }
+  dirtyPins |= 1ULL << gpio;
+  lastDirtyMs = now;
+  portEXIT_CRITICAL(&persistMux);
+}
+
+// Store the operation state
+void storeCommand(const GpioCommand &cmd) {
+  StoredPin pin = {cmd.op, cmd.resolution, cmd.duty, cmd.frequency};
+  markPin(cmd.gpio, pin);
+}
+
+// Forget the stored state so the pin is not resumed after a restart
+void clearStoredCommand(int gpio) {
+  StoredPin pin = {OP_NONE, 0, 0, 0};
+  markPin(gpio, pin);
+}
+
+// Commits the image if it is due (or always when forced). Runs from loop(),
+// never from a request handler or timer callback.
+void persistFlush(bool force) {
+  StateImage image;
+  uint32_t now = millis();
+  portENTER_CRITICAL(&persistMux);
+  bool due = dirtyPins != 0 &&
+             (force || now - lastDirtyMs >= persistDebounceMs || now - firstDirtyMs >= PERSIST_MAX_DELAY_MS);
+  if (due) {
+    image = stateImage;
+    dirtyPins = 0;
+  }
+  portEXIT_CRITICAL(&persistMux);
+  if (!due || memcmp(&image, &committedImage, sizeof(image)) == 0) {
+    return; // Nothing changed since the last commit
+  }
+  if (preferences.putBytes(PERSIST_KEY, &image, sizeof(image)) == sizeof(image)) {
+    committedImage = image;
+    persistCommits++;
+  }
+}
+
+// Registered with esp_register_shutdown_handler() so esp_restart() saves
+// pending changes first
+void persistShutdown() {
+  persistFlush(true);
+}
+
+volatile bool persistFlushRequested = false;
+
+// Opens the namespace for the lifetime of the sketch and loads the image.
+// Returns false when there is no valid stored image.
+bool persistBegin() {
+  preferences.begin(PERSIST_NAMESPACE, false);
+  bool loaded = preferences.getBytes(PERSIST_KEY, &stateImage, sizeof(StateImage)) == sizeof(StateImage) &&
+                stateImage.version == PERSIST_VERSION && stateImage.pinCount == SOC_GPIO_PIN_COUNT;
+  if (!loaded) {
+    memset(&stateImage, 0, sizeof(stateImage));
+    stateImage.version = PERSIST_VERSION;
+    stateImage.pinCount = SOC_GPIO_PIN_COUNT;
+  }
+  committedImage = stateImage;
+  esp_register_shutdown_handler(persistShutdown);
+  return loaded;
+}
+
+// Restores every stored output straight from the loaded image: the digital
+// pins first, with one masked register write per bank, then the PWM pins.
+// Returns the number of restored pins.
+int resumeStates() {
+  GpioMaskWrite write = {};
+  int restored = 0;
+  // Pins stored before they were checked against the table are skipped
+  for (int i = 0; i < SOC_GPIO_PIN_COUNT; i++) {
+    const StoredPin &pin = stateImage.pins[i];
+    if (pinCanOutput(i) && (pin.op == OP_HIGH || pin.op == OP_LOW)) {
+      maskAdd(write, i, pin.op == OP_HIGH);
+      restored++;
+    }
+  }
+  applyMaskWrite(write);
+  for (int i = 0; i < SOC_GPIO_PIN_COUNT; i++) {
+    const StoredPin &pin = stateImage.pins[i];
+    if (pinCanOutput(i) && pin.op == OP_PWM) {
+      GpioCommand cmd = {OP_PWM, (uint8_t)i, pin.duty, 0, pin.frequency, pin.resolution, RAMP_LINEAR, 0};
+      executeCommand(cmd);
+      restored++;
+    }
+  }
+  return restored;
+}
+
+void storeGroupCommand(const PinGroup &group, const GpioCommand &cmd) {
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    uint32_t pins = group.mask[bank];
+    while (pins) {
+      GpioCommand pinCmd = cmd;
+      pinCmd.gpio = bank * 32 + __builtin_ctz(pins);
+      storeCommand(pinCmd);
+      pins &= pins - 1;
+    }
+  }
+}
+
+// The scheduled operations run on the timer task, so they only queue their
+// command. One that finds the ring full is dropped and counted, and its
+// pin keeps the state it had, stored and logged.
+void resetOperation(const GpioCommand &cmd) {
+  GpioCommand reset = resetCommand(cmd);
+  if (!actuationSend(reset)) { // Reset pin after duration
+    scheduleDropped++;
+    return;
+  }
+  logCommand(reset);
+  clearStoredCommand(cmd.gpio);
+}
+
+void scheduleOperation(const GpioCommand &cmd) {
+  if (!actuationSend(cmd)) {
+    scheduleDropped++;
+    return;
+  }
+  logCommand(cmd);
+  storeCommand(cmd);
+}
+
+// Link an entry into the wheel slot that matches its expiry. Entries further
+// out than the wheel covers are parked in the last level and re-linked when
+// that slot cascades.
+void wheelLink(uint16_t index) {
+  ScheduledEntry &entry = scheduleEntries[index];
+  int32_t delta = (int32_t)(entry.expires - wheelNow);
+  uint16_t slot;
+  if (delta < 0) {
+    slot = wheelNow & WHEEL_MASK; // Overdue, run on the current tick
+  } else {
+    uint32_t expires = entry.expires;
+    if ((uint32_t)delta > WHEEL_MAX_DELAY) {
+      expires = wheelNow + WHEEL_MAX_DELAY;
+      delta = WHEEL_MAX_DELAY;
+    }
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && (uint32_t)delta >= (1UL << (WHEEL_BITS * (level + 1)))) {
+      level++;
+    }
+    slot = level * WHEEL_SIZE + ((expires >> (WHEEL_BITS * level)) & WHEEL_MASK);
+  }
+  entry.slot = slot;
+  entry.prev = ENTRY_NONE;
+  entry.next = wheelSlots[slot];
+  if (entry.next != ENTRY_NONE) {
+    scheduleEntries[entry.next].prev = index;
+  }
+  wheelSlots[slot] = index;
+}
+
+void wheelUnlink(uint16_t index) {
+  ScheduledEntry &entry = scheduleEntries[index];
+  if (entry.prev != ENTRY_NONE) {
+    scheduleEntries[entry.prev].next = entry.next;
+  } else {
+    wheelSlots[entry.slot] = entry.next;
+  }
+  if (entry.next != ENTRY_NONE) {
+    scheduleEntries[entry.next].prev = entry.prev;
+  }
+}
+
+void wheelRelease(uint16_t index) {
+  scheduleEntries[index].phase = PHASE_FREE;
+  scheduleEntries[index].next = freeEntry;
+  freeEntry = index;
+  pendingEntries--;
+}
+
+// Move every entry of a higher-level slot down to the level that now covers it
+void wheelCascade(int level) {
+  uint16_t slot = level * WHEEL_SIZE + ((wheelNow >> (WHEEL_BITS * level)) & WHEEL_MASK);
+  uint16_t index = wheelSlots[slot];
+  wheelSlots[slot] = ENTRY_NONE;
+  while (index != ENTRY_NONE) {
+    uint16_t next = scheduleEntries[index].next;
+    wheelLink(index);
+    index = next;
+  }
+}
+
+void runScheduledEntry(const ScheduledEntry &entry) {
+  queueScheduleEvent(entry);
+  if (entry.phase == PHASE_SET) {
+    scheduleOperation(entry.cmd);
+  } else if (entry.phase == PHASE_RESET) {
+    resetOperation(entry.cmd);
+  }
+}
+
+// Ticker callback: advance the wheel up to the current millisecond and run
+// everything that expired on the way. Operations run outside the lock.
+void schedulerTick() {
+  uint32_t target = millis();
+  portENTER_CRITICAL(&schedulerMux);
+  while ((int32_t)(target - wheelNow) >= 0) {
+    uint16_t slot = wheelNow & WHEEL_MASK;
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+      if (((wheelNow >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK) != 0) {
+        break;
+      }
+      wheelCascade(level);
+    }
+    while (wheelSlots[slot] != ENTRY_NONE) {
+      uint16_t index = wheelSlots[slot];
+      ScheduledEntry fired = scheduleEntries[index];
+      wheelUnlink(index);
+      if (fired.phase == PHASE_SET && fired.cmd.duration > 0) {
+        scheduleEntries[index].phase = PHASE_RESET;
+        scheduleEntries[index].expires = fired.expires + fired.cmd.duration;
+        wheelLink(index);
+      } else {
+        wheelRelease(index);
+      }
+      portEXIT_CRITICAL(&schedulerMux);
+      histogramObserve(scheduleLateness, millis() - fired.expires, LATENESS_SHIFT);
+      runScheduledEntry(fired);
+      portENTER_CRITICAL(&schedulerMux);
+    }
+    wheelNow++;
+  }
+  portEXIT_CRITICAL(&schedulerMux);
+}
+
+// Returns the schedule ID, or 0 when the pool is exhausted. An entry added in
+// PHASE_RESET only runs the reset of cmd, delayMs from now.
+uint32_t scheduleAdd(const GpioCommand &cmd, uint32_t delayMs, uint8_t phase = PHASE_SET) {
+  portENTER_CRITICAL(&schedulerMux);
+  if (freeEntry == ENTRY_NONE) {
+    portEXIT_CRITICAL(&schedulerMux);
+    return 0;
+  }
+  uint16_t index = freeEntry;
+  ScheduledEntry &entry = scheduleEntries[index];
+  freeEntry = entry.next;
+  pendingEntries++;
+
+  entry.id = nextScheduleSeq * SCHEDULER_CAPACITY + index;
+  if (++nextScheduleSeq >= SCHEDULE_ID_LIMIT / SCHEDULER_CAPACITY) {
+    nextScheduleSeq = 1;
+  }
+  entry.phase = phase;
+  entry.expires = millis() + delayMs;
+  entry.cmd = cmd;
+  wheelLink(index);
+  uint32_t id = entry.id;
+  portEXIT_CRITICAL(&schedulerMux);
+  return id;
+}
+
+// Cancels a pending set, or the pending reset of one that already fired
+bool scheduleCancel(uint32_t id) {
+  if (id >= SCHEDULE_ID_LIMIT) {
+    return preciseCancel(id);
+  }
+  uint16_t index = id % SCHEDULER_CAPACITY;
+  portENTER_CRITICAL(&schedulerMux);
+  ScheduledEntry &entry = scheduleEntries[index];
+  bool found = entry.phase != PHASE_FREE && entry.id == id;
+  if (found) {
+    wheelUnlink(index);
+    wheelRelease(index);
+  }
+  portEXIT_CRITICAL(&schedulerMux);
+  return found;
+}
+
+void schedulerBegin() {
+  for (int i = 0; i < WHEEL_LEVELS * WHEEL_SIZE; i++) {
+    wheelSlots[i] = ENTRY_NONE;
+  }
+  for (int i = SCHEDULER_CAPACITY - 1; i >= 0; i--) {
+    scheduleEntries[i].phase = PHASE_FREE;
+    scheduleEntries[i].next = freeEntry;
+    freeEntry = i;
+  }
+  wheelNow = millis();
+  schedulerTicker.attach_ms(SCHEDULER_POLL_MS, schedulerTick);
+}
+
+// Precise pulses: /schedule with delay_us (and duration_us) runs high/low
+// edges on a task of their own instead of the millisecond wheel. A hardware
+// timer alarm is armed for the earliest microsecond deadline, early by the
+// measured time from alarm to task, and its interrupt wakes the task, which
+// busy-waits the last few microseconds. The task has the top priority on the
+// application core, so callbacks on the esp_timer task, loop() and the
+// actuation task cannot hold an edge back. What still can: other interrupt
+// handlers, critical sections on that core, and flash writes, as an NVS
+// commit stalls both cores for its duration. The lateness histogram shows
+// how much that adds up to.
+//
+// The task writes GPIO_OUT itself, one read-modify-write per bank under
+// gpioMux, rather than queueing on the actuation ring. So it only writes pins
+// that are plain digital outputs: preciseAdd() makes the pin one through the
+// ring first, and an edge whose pin went to PWM or a fade since is skipped
+// and counted in preciseSkipped. Storing the new states happens in loop(). A
+// reset is due duration_us after the deadline of its set edge, not after the
+// time the set edge actually ran, so errors do not add up over a pulse.
+#define PRECISE_CAPACITY 32
+#define PRECISE_SPIN_US 50       // most the task busy-waits for a deadline
+#define PRECISE_MARGIN_US 5      // alarm this much before the expected wake-up
+#define PRECISE_LEAD_INIT_US 10  // alarm to task delay assumed until one is measured
+#define PRECISE_LOG 64           // fired edges kept for /precise
+#define PRECISE_LATENESS_SHIFT 0 // lateness in 1 us steps, up to 2 ms
+#define PRECISE_TIMER (SOC_TIMER_GROUP_TOTAL_TIMERS - 1) // the last hardware timer: 3 on the ESP32, 1 on the C3
+#define PRECISE_PRIORITY (configMAX_PRIORITIES - 1)
+#define PRECISE_CORE ACTUATION_CORE
+#define PRECISE_STACK 3072
+
+struct PreciseEntry {
+  uint32_t id;        // 0 when the slot is free
+  uint8_t gpio;
+  uint8_t op;         // OP_HIGH or OP_LOW, as scheduled
+  uint8_t phase;      // PHASE_SET or PHASE_RESET
+  uint32_t duration;  // us, 0 for no reset
+  int64_t deadline;   // esp_timer_get_time()
+};
+
+struct PreciseEdge {
+  uint32_t id;
+  uint8_t gpio;
+  uint8_t op;
+  uint8_t phase;
+  int32_t lateness;   // us from the deadline to the register write
+  int64_t deadline;
+};
+
+PreciseEntry preciseEntries[PRECISE_CAPACITY];
+PreciseEdge preciseLog[PRECISE_LOG]; // by edge number % PRECISE_LOG
+uint32_t preciseFired = 0;           // edges recorded so far
+uint32_t preciseStored = 0;          // edges loop() has stored, loop() only
+uint32_t preciseSkipped = 0;         // edges whose pin was not a digital output
+uint32_t nextPreciseSeq = 1;
+int32_t preciseLead = PRECISE_LEAD_INIT_US * 8; // average alarm to task delay, 1/8 us
+int64_t preciseAlarm = 0;            // when the timer was set to go off
+Histogram preciseLateness;           // precise task only
+hw_timer_t* preciseTimer = NULL;    // NULL when the timer could not be had: no precise pulses
+TaskHandle_t preciseTask = NULL;
+SemaphoreHandle_t preciseArmLock;    // task and handlers re-arm one at a time
+portMUX_TYPE preciseMux = portMUX_INITIALIZER_UNLOCKED;
+
+int64_t preciseEarliestLocked() {
+  int64_t earliest = INT64_MAX;
+  for (int i = 0; i < PRECISE_CAPACITY; i++) {
+    if (preciseEntries[i].id != 0 && preciseEntries[i].deadline < earliest) {
+      earliest = preciseEntries[i].deadline;
+    }
+  }
+  return earliest;
+}
+
+// Arms the timer for the earliest pending deadline. The lock keeps a handler
+// and the task from arming for a deadline the other already replaced.
+void preciseArm() {
+  xSemaphoreTake(preciseArmLock, portMAX_DELAY);
+  portENTER_CRITICAL(&preciseMux);
+  int64_t earliest = preciseEarliestLocked();
+  portEXIT_CRITICAL(&preciseMux);
+  timerAlarmDisable(preciseTimer);
+  if (earliest != INT64_MAX) {
+    int64_t now = esp_timer_get_time();
+    int64_t alarm = earliest - preciseLead / 8 - PRECISE_MARGIN_US;
+    preciseAlarm = alarm > now ? alarm : now;
+    timerWrite(preciseTimer, 0);
+    timerAlarmWrite(preciseTimer, preciseAlarm - now + 1, false); // the alarm needs the counter to reach it
+    timerAlarmEnable(preciseTimer);
+  }
+  xSemaphoreGive(preciseArmLock);
+}
+
+void IRAM_ATTR preciseAlarmIsr() {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(preciseTask, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+// Runs on the precise task once the alarm goes off: writes every edge that
+// is due, in deadline order, with one register write per bank for edges
+// that share a deadline, then arms the alarm for the next one
+void preciseRun() {
+  int64_t delay = esp_timer_get_time() - preciseAlarm;
+  if (delay >= 0 && delay < PRECISE_SPIN_US * 4) {
+    preciseLead += (int32_t)delay - preciseLead / 8; // in whole us it would stall up to 7 us short
+  }
+  for (;;) {
+    portENTER_CRITICAL(&preciseMux);
+    int64_t due = preciseEarliestLocked();
+    portEXIT_CRITICAL(&preciseMux);
+    if (due == INT64_MAX || due - esp_timer_get_time() > PRECISE_SPIN_US) {
+      break;
+    }
+    int64_t now;
+    while ((now = esp_timer_get_time()) < due) {
+    }
+
+    // Everything due by now goes out in the same write. After a late wake
+    // that can be several deadlines: they are taken in deadline order, so
+    // the latest edge on a pin is the one it is left at.
+    GpioMaskWrite write = {};
+    uint32_t firedIds[PRECISE_CAPACITY];
+    int fired = 0;
+    portENTER_CRITICAL(&preciseMux);
+    for (int i = 0; i < PRECISE_CAPACITY; i++) {
+      const PreciseEntry &entry = preciseEntries[i];
+      if (entry.id != 0 && entry.deadline <= now) {
+        int at = fired++;
+        for (; at > 0 && preciseEntries[firedIds[at - 1] % PRECISE_CAPACITY].deadline > entry.deadline; at--) {
+          firedIds[at] = firedIds[at - 1];
+        }
+        firedIds[at] = entry.id;
+      }
+    }
+    for (int i = 0; i < fired; i++) {
+      const PreciseEntry &entry = preciseEntries[firedIds[i] % PRECISE_CAPACITY];
+      bool high = entry.op == OP_HIGH;
+      maskAdd(write, entry.gpio, entry.phase == PHASE_SET ? high : !high);
+    }
+    portEXIT_CRITICAL(&preciseMux);
+    int64_t written = esp_timer_get_time();
+    uint32_t ready[GPIO_BANKS];
+    portENTER_CRITICAL(&gpioMux);
+    for (int bank = 0; bank < GPIO_BANKS; bank++) {
+      ready[bank] = outputPins[bank] & ~pwmPins[bank];
+      uint32_t set = write.set[bank] & ready[bank];
+      uint32_t clear = write.clear[bank] & ready[bank];
+      if (set | clear) {
+        gpioOutWrite(bank, (gpioOutRead(bank) & ~clear) | set);
+        changedPins[bank] |= set | clear;
+        digitalWrites++;
+      }
+    }
+    portEXIT_CRITICAL(&gpioMux);
+
+    portENTER_CRITICAL(&preciseMux);
+    for (int i = 0; i < fired; i++) {
+      PreciseEntry &entry = preciseEntries[firedIds[i] % PRECISE_CAPACITY];
+      if (entry.id != firedIds[i]) {
+        continue; // cancelled meanwhile
+      }
+      if (!(ready[entry.gpio >> 5] & (1UL << (entry.gpio & 31)))) {
+        preciseSkipped++;
+      } else {
+        PreciseEdge &edge = preciseLog[preciseFired++ % PRECISE_LOG];
+        edge.id = entry.id;
+        edge.gpio = entry.gpio;
+        edge.op = entry.op;
+        edge.phase = entry.phase;
+        edge.lateness = written - entry.deadline;
+        edge.deadline = entry.deadline;
+        histogramObserve(preciseLateness, edge.lateness, PRECISE_LATENESS_SHIFT);
+      }
+      if (entry.phase == PHASE_SET && entry.duration > 0) {
+        entry.phase = PHASE_RESET;
+        entry.deadline += entry.duration;
+      } else {
+        entry.id = 0;
+      }
+    }
+    portEXIT_CRITICAL(&preciseMux);
+  }
+  preciseArm();
+}
+
+void preciseLoop(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    preciseRun();
+  }
+}
+
+// Returns the schedule ID, or 0 when every slot is taken, the pin could not
+// be made a digital output, or there is no timer
+uint32_t preciseAdd(const GpioCommand &cmd, uint32_t delayUs, uint32_t durationUs) {
+  if (preciseTimer == NULL) {
+    return 0;
+  }
+  int64_t deadline = esp_timer_get_time() + delayUs;
+  int bank = cmd.gpio >> 5;
+  uint32_t bit = 1UL << (cmd.gpio & 31);
+  portENTER_CRITICAL(&gpioMux);
+  bool ready = outputPins[bank] & ~pwmPins[bank] & bit;
+  portEXIT_CRITICAL(&gpioMux);
+  if (!ready) {
+    // Output at the level the pulse starts from, before the task needs it
+    GpioMaskWrite write = {};
+    maskAdd(write, cmd.gpio, cmd.op != OP_HIGH);
+    if (actuationTask == NULL) {
+      actuateMask(write);
+    } else {
+      Actuation actuation = {ACT_MASK, {}, write, NULL, NULL, 0};
+      if (!actuationCall(actuation)) {
+        return 0;
+      }
+    }
+  }
+  uint32_t id = 0;
+  portENTER_CRITICAL(&preciseMux);
+  for (int i = 0; i < PRECISE_CAPACITY && id == 0; i++) {
+    PreciseEntry &entry = preciseEntries[i];
+    if (entry.id == 0) {
+      id = SCHEDULE_ID_LIMIT | ((nextPreciseSeq++ * PRECISE_CAPACITY + i) & (SCHEDULE_ID_LIMIT - 1));
+      entry.id = id;
+      entry.gpio = cmd.gpio;
+      entry.op = cmd.op;
+      entry.phase = PHASE_SET;
+      entry.duration = durationUs;
+      entry.deadline = deadline;
+    }
+  }
+  portEXIT_CRITICAL(&preciseMux);
+  if (id != 0) {
+    preciseArm();
+  }
+  return id;
+}
+
+bool preciseCancel(uint32_t id) {
+  portENTER_CRITICAL(&preciseMux);
+  PreciseEntry &entry = preciseEntries[id % PRECISE_CAPACITY];
+  bool found = entry.id == id;
+  if (found) {
+    entry.id = 0;
+  }
+  portEXIT_CRITICAL(&preciseMux);
+  return found; // the task finds nothing due and re-arms the alarm
+}
+
+// Stores the states of the edges fired since the last call, as
+// scheduleOperation() and resetOperation() do for the wheel. Runs from loop().
+void preciseStore() {
+  while (preciseStored != preciseFired) {
+    portENTER_CRITICAL(&preciseMux);
+    if (preciseFired - preciseStored > PRECISE_LOG) {
+      preciseStored = preciseFired - PRECISE_LOG; // overwritten before loop() got to them
+    }
+    PreciseEdge edge = preciseLog[preciseStored % PRECISE_LOG];
+    portEXIT_CRITICAL(&preciseMux);
+    GpioCommand cmd = {edge.op, edge.gpio, 0, 0, 0, 0, RAMP_LINEAR, 0};
+    if (edge.phase == PHASE_SET) {
+      storeCommand(cmd);
+    } else {
+      clearStoredCommand(edge.gpio);
+    }
+    preciseStored++;
+  }
+}
+
+// Leaves precise pulses off, and /schedule answering 501 for them, when the
+// timer is missing or already taken
+void preciseBegin() {
+  hw_timer_t* timer = timerBegin(PRECISE_TIMER, 80, true); // 1 us counts from the 80 MHz APB clock
+  if (timer == NULL) {
+    Serial.println("No hardware timer for precise pulses");
+    return;
+  }
+  preciseArmLock = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(preciseLoop, "precise", PRECISE_STACK, NULL, PRECISE_PRIORITY, &preciseTask, PRECISE_CORE);
+  // The interrupt goes to the core that attaches it, the task's core
+  timerAttachInterrupt(timer, preciseAlarmIsr, false);
+  preciseTimer = timer;
+}
+
+// Scenes are named presets of pin levels, PWM duties and timed resets. They
+// are compiled once when saved, from the operation list /batch takes, into
+// per-bank register masks and a short LEDC duty list. Applying one is a
+// single actuation with nothing left to parse: one GPIO_OUT write per bank
+// and at most SCENE_MAX_PWM duty writes. Scenes are kept in NVS in compiled
+// form, one key per slot, and written from loop().
+#define MAX_SCENES 8
+#define SCENE_NAME_LEN GROUP_NAME_LEN
+#define SCENE_MAX_PWM 8
+#define SCENE_MAX_RESETS 16
+#define SCENE_VERSION 1
+
+struct ScenePwm {
+  uint8_t gpio;
+  uint8_t resolution;
+  uint16_t duty;
+  uint32_t frequency;
+};
+
+// Reverts a pin after duration the way a /schedule duration does
+struct SceneReset {
+  uint8_t gpio;
+  uint8_t op;         // operation the scene applies to the pin
+  uint16_t reserved;
+  uint32_t duration;  // ms
+};
+
+// In NVS a header is followed by pwmCount ScenePwm and resetCount
+// SceneReset entries
+struct SceneHeader {
+  uint8_t version;
+  uint8_t pinCount;
+  uint8_t pwmCount;
+  uint8_t resetCount;
+  char name[SCENE_NAME_LEN]; // empty when the slot is free
+  GpioMaskWrite write;
+};
+
+struct Scene {
+  SceneHeader header;
+  ScenePwm pwm[SCENE_MAX_PWM];
+  SceneReset resets[SCENE_MAX_RESETS];
+};
+
+Scene scenes[MAX_SCENES];   // changed from the async_tcp task only
+uint8_t scenesDirty = 0;    // slots loop() has to write or erase, under sceneMux
+uint32_t sceneApplies = 0;
+portMUX_TYPE sceneMux = portMUX_INITIALIZER_UNLOCKED;
+
+void sceneBegin(Scene &scene, const char* name) {
+  memset(&scene, 0, sizeof(scene));
+  scene.header.version = SCENE_VERSION;
+  scene.header.pinCount = SOC_GPIO_PIN_COUNT;
+  strcpy(scene.header.name, name);
+}
+
+Scene* findScene(const char* name) {
+  for (int i = 0; i < MAX_SCENES; i++) {
+    if (scenes[i].header.name[0] != '\0' && strcmp(scenes[i].header.name, name) == 0) {
+      return &scenes[i];
+    }
+  }
+  return NULL;
+}
+
+// Folds one pin operation into a scene; a later operation on the same pin
+// replaces an earlier one. Returns false when the scene has no room for it.
+bool sceneAdd(Scene &scene, const GpioCommand &cmd, uint32_t duration) {
+  SceneHeader &header = scene.header;
+  maskRemove(header.write, cmd.gpio);
+  for (int i = header.pwmCount - 1; i >= 0; i--) {
+    if (scene.pwm[i].gpio == cmd.gpio) {
+      scene.pwm[i] = scene.pwm[--header.pwmCount];
+    }
+  }
+  for (int i = header.resetCount - 1; i >= 0; i--) {
+    if (scene.resets[i].gpio == cmd.gpio) {
+      scene.resets[i] = scene.resets[--header.resetCount];
+    }
+  }
+
+  if (cmd.op == OP_PWM) {
+    if (header.pwmCount == SCENE_MAX_PWM) {
+      return false;
+    }
+    ScenePwm pwm = {cmd.gpio, cmd.resolution, cmd.duty, cmd.frequency};
+    scene.pwm[header.pwmCount++] = pwm;
+  } else {
+    maskAdd(header.write, cmd.gpio, cmd.op == OP_HIGH);
+  }
+  if (duration > 0) {
+    if (header.resetCount == SCENE_MAX_RESETS) {
+      return false;
+    }
+    SceneReset reset = {cmd.gpio, cmd.op, 0, duration};
+    scene.resets[header.resetCount++] = reset;
+  }
+  return true;
+}
+
+bool sceneAddGroup(Scene &scene, const PinGroup &group, const GpioCommand &cmd, uint32_t duration) {
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    uint32_t pins = group.mask[bank];
+    while (pins) {
+      GpioCommand pinCmd = cmd;
+      pinCmd.gpio = bank * 32 + __builtin_ctz(pins);
+      if (!sceneAdd(scene, pinCmd, duration)) {
+        return false;
+      }
+      pins &= pins - 1;
+    }
+  }
+  return true;
+}
+
+// True when the scene would drive a pin claimed since it was saved
+bool sceneClaimed(const Scene &scene) {
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    if ((scene.header.write.set[bank] | scene.header.write.clear[bank]) & claimedMask(bank)) {
+      return true;
+    }
+  }
+  for (int i = 0; i < scene.header.pwmCount; i++) {
+    if (pinClaimed(scene.pwm[i].gpio)) {
+      return true;
+    }
+  }
+  for (int i = 0; i < scene.header.resetCount; i++) {
+    if (pinClaimed(scene.resets[i].gpio)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int sceneDigitalPins(const Scene &scene) {
+  int count = 0;
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    count += __builtin_popcount(scene.header.write.set[bank] | scene.header.write.clear[bank]);
+  }
+  return count;
+}
+
+// Runs on the actuation task. Returns the PWM entries that could not get an
+// LEDC channel, bit i for pwm[i]; the rest of the scene is applied regardless.
+uint32_t actuateScene(const Scene &scene) {
+  actuateMask(scene.header.write);
+  uint32_t failed = 0;
+  for (int i = 0; i < scene.header.pwmCount; i++) {
+    const ScenePwm &pwm = scene.pwm[i];
+    if (!pwmWrite(pwm.gpio, pwm.duty, pwm.frequency, pwm.resolution)) {
+      failed |= 1UL << i;
+    }
+  }
+  return failed;
+}
+
+// Applies a scene as one actuation, then records the new states and starts
+// the timed resets of the pins it actually drove: none when the actuation was
+// dropped, and not the PWM pins that got no channel.
+ActuationResult sceneApply(const Scene &scene) {
+  Actuation actuation = {ACT_SCENE, {}, {}, &scene, NULL, 0};
+  uint32_t failed = 0;
+  if (actuationTask == NULL) {
+    failed = actuateScene(scene);
+  } else {
+    Completion completion;
+    if (actuationCall(actuation, completion) == ACTUATION_BUSY) {
+      return ACTUATION_BUSY;
+    }
+    failed = completion.failed;
+  }
+  sceneApplies++;
+
+  const SceneHeader &header = scene.header;
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    uint32_t pins = header.write.set[bank] | header.write.clear[bank];
+    while (pins) {
+      uint32_t bit = pins & -pins;
+      GpioCommand cmd = {(uint8_t)(header.write.set[bank] & bit ? OP_HIGH : OP_LOW),
+                         (uint8_t)(bank * 32 + __builtin_ctz(bit)), 0, 0, 0, 0, RAMP_LINEAR, 0};
+      storeCommand(cmd);
+      pins &= ~bit;
+    }
+  }
+  for (int i = 0; i < header.pwmCount; i++) {
+    const ScenePwm &pwm = scene.pwm[i];
+    if (!(failed & (1UL << i))) {
+      GpioCommand cmd = {OP_PWM, pwm.gpio, pwm.duty, 0, pwm.frequency, pwm.resolution, RAMP_LINEAR, 0};
+      storeCommand(cmd);
+    }
+  }
+  for (int i = 0; i < header.resetCount; i++) {
+    const SceneReset &reset = scene.resets[i];
+    bool driven = true;
+    for (int j = 0; j < header.pwmCount; j++) {
+      if (scene.pwm[j].gpio == reset.gpio && (failed & (1UL << j))) {
+        driven = false;
+      }
+    }
+    if (driven) {
+      GpioCommand cmd = {reset.op, reset.gpio, 0, reset.duration, 0, 0, RAMP_LINEAR, 0};
+      scheduleAdd(cmd, reset.duration, PHASE_RESET);
+    }
+  }
+  return failed ? ACTUATION_NO_CHANNEL : ACTUATED;
+}
+
+// Compact NVS form: the header and only the used list entries
+size_t sceneEncode(const Scene &scene, uint8_t* out) {
+  const SceneHeader &header = scene.header;
+  size_t len = 0;
+  memcpy(out, &header, sizeof(header));
+  len += sizeof(header);
+  memcpy(out + len, scene.pwm, header.pwmCount * sizeof(ScenePwm));
+  len += header.pwmCount * sizeof(ScenePwm);
+  memcpy(out + len, scene.resets, header.resetCount * sizeof(SceneReset));
+  len += header.resetCount * sizeof(SceneReset);
+  return len;
+}
+
+// Returns false for a blob from another layout or chip, or one that names
+// pins the pin table does not allow
+bool sceneDecode(const uint8_t* data, size_t len, Scene &scene) {
+  memset(&scene, 0, sizeof(scene));
+  SceneHeader &header = scene.header;
+  if (len < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.version != SCENE_VERSION || header.pinCount != SOC_GPIO_PIN_COUNT || header.pwmCount > SCENE_MAX_PWM ||
+      header.resetCount > SCENE_MAX_RESETS || header.name[0] == '\0' || header.name[SCENE_NAME_LEN - 1] != '\0' ||
+      len != sizeof(header) + header.pwmCount * sizeof(ScenePwm) + header.resetCount * sizeof(SceneReset)) {
+    return false;
+  }
+  memcpy(scene.pwm, data + sizeof(header), header.pwmCount * sizeof(ScenePwm));
+  memcpy(scene.resets, data + sizeof(header) + header.pwmCount * sizeof(ScenePwm),
+         header.resetCount * sizeof(SceneReset));
+  for (int gpio = 0; gpio < GPIO_BANKS * 32; gpio++) {
+    uint32_t bit = 1UL << (gpio & 31);
+    if ((header.write.set[gpio >> 5] | header.write.clear[gpio >> 5]) & bit && !pinCanOutput(gpio)) {
+      return false;
+    }
+  }
+  for (int i = 0; i < header.pwmCount; i++) {
+    if (!pinCanOutput(scene.pwm[i].gpio)) {
+      return false;
+    }
+  }
+  for (int i = 0; i < header.resetCount; i++) {
+    if (!pinCanOutput(scene.resets[i].gpio)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void sceneKey(int slot, char* key, size_t len) {
+  snprintf(key, len, "scene%d", slot);
+}
+
+// Replaces the slot (an empty name frees it) and has loop() save it, unless
+// nothing changed
+void sceneStore(int slot, const Scene &scene) {
+  portENTER_CRITICAL(&sceneMux);
+  if (memcmp(&scenes[slot], &scene, sizeof(scene)) != 0) {
+    scenes[slot] = scene;
+    scenesDirty |= 1 << slot;
+  }
+  portEXIT_CRITICAL(&sceneMux);
+}
+
+// Writes changed scenes to NVS. Runs from loop().
+void scenesFlush() {
+  for (int slot = 0; slot < MAX_SCENES; slot++) {
+    Scene scene;
+    portENTER_CRITICAL(&sceneMux);
+    bool dirty = scenesDirty & (1 << slot);
+    if (dirty) {
+      scene = scenes[slot];
+      scenesDirty &= ~(1 << slot);
+    }
+    portEXIT_CRITICAL(&sceneMux);
+    if (!dirty) {
+      continue;
+    }
+    char key[12];
+    sceneKey(slot, key, sizeof(key));
+    if (scene.header.name[0] == '\0') {
+      preferences.remove(key);
+    } else {
+      uint8_t blob[sizeof(Scene)];
+      preferences.putBytes(key, blob, sceneEncode(scene, blob));
+    }
+  }
+}
+
+// Loads the stored scenes. Needs the namespace persistBegin() opened.
+void scenesBegin() {
+  for (int slot = 0; slot < MAX_SCENES; slot++) {
+    char key[12];
+    uint8_t blob[sizeof(Scene)];
+    sceneKey(slot, key, sizeof(key));
+    size_t len = preferences.getBytesLength(key);
+    if (len == 0 || len > sizeof(blob) || preferences.getBytes(key, blob, len) != len ||
+        !sceneDecode(blob, len, scenes[slot])) {
+      memset(&scenes[slot], 0, sizeof(Scene));
+    }
+  }
+}
+
+// Batch operations are parsed one character at a time, so a POST body is
+// consumed chunk by chunk as it arrives and every operation is applied as
+// soon as its object closes. Memory is one BatchParser however long the batch
+// is. Only the flat operation objects /batch takes are understood: strings
+// without escapes and integers, no nesting. Anything else, a trailing comma
+// included, makes the batch malformed.
+#define BATCH_TOKEN_LEN GROUP_NAME_LEN // longest key or string value kept
+#define BATCH_MAX_ERRORS 16            // failed operations reported by index
+
+enum BatchState : uint8_t {
+  BATCH_START,
+  BATCH_ELEMENT,
+  BATCH_NEXT_ELEMENT,   // after a comma: another operation must follow
+  BATCH_KEY,
+  BATCH_NEXT_KEY,       // after a comma: another key must follow
+  BATCH_KEY_STRING,
+  BATCH_COLON,
+  BATCH_VALUE,
+  BATCH_STRING,
+  BATCH_NUMBER,
+  BATCH_LITERAL,
+  BATCH_AFTER_VALUE,
+  BATCH_AFTER_ELEMENT,
+  BATCH_DONE,
+  BATCH_MALFORMED
+};
+
+enum BatchField : uint8_t {
+  FIELD_OTHER, FIELD_GPIO, FIELD_STATE, FIELD_GROUP, FIELD_FREQ, FIELD_RES, FIELD_DURATION, FIELD_RAMP, FIELD_SHAPE
+};
+
+enum BatchError : uint8_t {BATCH_OK, BATCH_INVALID, BATCH_UNKNOWN_GROUP, BATCH_NO_CHANNEL, BATCH_SCENE_FULL,
+                          BATCH_PIN_CLAIMED, BATCH_BUSY};
+
+struct BatchParser {
+  uint8_t state;
+  uint8_t field;          // key the current value belongs to
+  bool digits;            // the number has at least one digit
+  bool overflow;          // token did not fit, or number out of range
+  bool negative;
+  uint8_t tokenLen;
+  char token[BATCH_TOKEN_LEN];
+  int32_t number;
+  // Operation being read
+  bool invalid;
+  bool hasGroup;
+  int32_t gpio;
+  int32_t resolution;
+  uint32_t frequency;
+  uint32_t duration;      // scenes only
+  int32_t ramp;
+  int32_t shape;          // -1 for an unknown name
+  char stateValue[BATCH_TOKEN_LEN];
+  char group[GROUP_NAME_LEN];
+  Scene* scene;           // compile into this scene instead of applying
+  // Results
+  uint32_t offset;        // bytes consumed
+  uint32_t operations;
+  uint32_t failed;
+  uint8_t errorCount;
+  uint8_t errorCode[BATCH_MAX_ERRORS];
+  uint32_t errorIndex[BATCH_MAX_ERRORS];
+  GpioMaskWrite write;    // digital operations not yet applied
+  uint32_t pending;       // digital operations in write
+  uint32_t pendingIndex[BATCH_MAX_ERRORS]; // the first of them, all a drop can report
+};
+
+void batchBegin(BatchParser &p) {
+  memset(&p, 0, sizeof(p));
+  p.state = BATCH_START;
+}
+
+void batchOperationBegin(BatchParser &p) {
+  p.invalid = false;
+  p.hasGroup = false;
+  p.gpio = -1;
+  p.frequency = PWM_DEFAULT_FREQ;
+  p.resolution = PWM_DEFAULT_RESOLUTION;
+  p.duration = 0;
+  p.ramp = 0;
+  p.shape = RAMP_LINEAR;
+  p.stateValue[0] = '\0';
+}
+
+// Keeps the errors in index order, the first BATCH_MAX_ERRORS of them, as
+// a dropped write reports its operations after later ones have failed
+void batchFail(BatchParser &p, uint32_t index, uint8_t error) {
+  p.failed++;
+  int at = p.errorCount;
+  while (at > 0 && p.errorIndex[at - 1] > index) {
+    at--;
+  }
+  if (at == BATCH_MAX_ERRORS) {
+    return;
+  }
+  int end = p.errorCount < BATCH_MAX_ERRORS ? p.errorCount++ : BATCH_MAX_ERRORS - 1;
+  for (int i = end; i > at; i--) {
+    p.errorCode[i] = p.errorCode[i - 1];
+    p.errorIndex[i] = p.errorIndex[i - 1];
+  }
+  p.errorCode[at] = error;
+  p.errorIndex[at] = index;
+}
+
+// Applies the digital operations folded into the write. Their pins are only
+// stored once the write is queued: when the full ring drops it, each of the
+// operations fails as busy instead.
+void batchFlush(BatchParser &p) {
+  if (p.pending == 0) {
+    return;
+  }
+  if (applyMaskWrite(p.write)) {
+    for (int bank = 0; bank < GPIO_BANKS; bank++) {
+      uint32_t pins = p.write.set[bank] | p.write.clear[bank];
+      while (pins) {
+        int bit = __builtin_ctz(pins);
+        GpioCommand cmd = {};
+        cmd.op = (p.write.set[bank] >> bit) & 1 ? OP_HIGH : OP_LOW;
+        cmd.gpio = bank * 32 + bit;
+        cmd.frequency = PWM_DEFAULT_FREQ;
+        cmd.resolution = PWM_DEFAULT_RESOLUTION;
+        storeCommand(cmd);
+        pins &= pins - 1;
+      }
+    }
+  } else {
+    for (uint32_t i = 0; i < p.pending; i++) {
+      batchFail(p, i < BATCH_MAX_ERRORS ? p.pendingIndex[i] : UINT32_MAX, BATCH_BUSY);
+    }
+  }
+  memset(&p.write, 0, sizeof(p.write));
+  p.pending = 0;
+}
+
+uint8_t batchResultError(ActuationResult result) {
+  switch (result) {
+    case ACTUATED: return BATCH_OK;
+    case ACTUATION_BUSY: return BATCH_BUSY;
+    case ACTUATION_CLAIMED: return BATCH_PIN_CLAIMED;
+    default: return BATCH_NO_CHANNEL;
+  }
+}
+
+void batchOperationEnd(BatchParser &p) {
+  GpioCommand cmd;
+  bool digital = false;
+  uint8_t error = BATCH_OK;
+  if (p.invalid) {
+    error = BATCH_INVALID;
+  } else if (p.hasGroup) {
+    PinGroup* group = findPinGroup(p.group);
+    if (group == NULL) {
+      error = BATCH_UNKNOWN_GROUP;
+    } else if (groupClaimed(*group)) {
+      error = BATCH_PIN_CLAIMED;
+    } else if (!decodeState(p.stateValue, cmd, p.frequency, p.resolution) ||
+               !decodeRamp(cmd, p.ramp, p.shape) || (p.scene != NULL && cmd.ramp > 0)) {
+      error = BATCH_INVALID;
+    } else if (p.scene != NULL) {
+      if (!sceneAddGroup(*p.scene, *group, cmd, p.duration)) {
+        error = BATCH_SCENE_FULL;
+      }
+    } else {
+      error = batchResultError(groupAdd(p.write, *group, cmd));
+      if (error == BATCH_OK && cmd.op == OP_PWM) {
+        storeGroupCommand(*group, cmd);
+      } else if (error == BATCH_OK) {
+        digital = true;
+      }
+    }
+  } else if (pinCanOutput(p.gpio) && pinClaimed(p.gpio)) {
+    error = BATCH_PIN_CLAIMED;
+  } else if (!decodeCommand(p.gpio, p.stateValue, cmd, p.frequency, p.resolution) ||
+             !decodeRamp(cmd, p.ramp, p.shape) || (p.scene != NULL && cmd.ramp > 0)) { // scenes apply at once
+    error = BATCH_INVALID;
+  } else if (p.scene != NULL) {
+    if (!sceneAdd(*p.scene, cmd, p.duration)) {
+      error = BATCH_SCENE_FULL;
+    }
+  } else {
+    if (cmd.op == OP_PWM) {
+      maskRemove(p.write, cmd.gpio); // a later operation on the same pin wins
+      error = batchResultError(executeCommand(cmd));
+      if (error == BATCH_OK) {
+        storeCommand(cmd);
+      }
+    } else {
+      maskAdd(p.write, cmd.gpio, cmd.op == OP_HIGH);
+      digital = true;
+    }
+  }
+
+  if (digital) {
+    if (p.pending < BATCH_MAX_ERRORS) {
+      p.pendingIndex[p.pending] = p.operations;
+    }
+    p.pending++;
+  } else if (error != BATCH_OK) {
+    batchFail(p, p.operations, error);
+  }
+  p.operations++;
+}
+
+void batchTokenBegin(BatchParser &p) {
+  p.tokenLen = 0;
+  p.overflow = false;
+  p.digits = false;
+}
+
+void batchTokenChar(BatchParser &p, char c) {
+  if (p.tokenLen < BATCH_TOKEN_LEN - 1) {
+    p.token[p.tokenLen++] = c;
+  } else {
+    p.overflow = true;
+  }
+}
+
+uint8_t batchField(BatchParser &p) {
+  p.token[p.tokenLen] = '\0';
+  if (p.overflow) return FIELD_OTHER;
+  if (strcmp(p.token, "gpio") == 0) return FIELD_GPIO;
+  if (strcmp(p.token, "state") == 0) return FIELD_STATE;
+  if (strcmp(p.token, "group") == 0) return FIELD_GROUP;
+  if (strcmp(p.token, "freq") == 0) return FIELD_FREQ;
+  if (strcmp(p.token, "res") == 0) return FIELD_RES;
+  if (strcmp(p.token, "duration") == 0) return FIELD_DURATION;
+  if (strcmp(p.token, "ramp") == 0) return FIELD_RAMP;
+  if (strcmp(p.token, "shape") == 0) return FIELD_SHAPE;
+  return FIELD_OTHER;
+}
+
+void batchString(BatchParser &p) {
+  p.token[p.tokenLen] = '\0';
+  if (p.field == FIELD_SHAPE) {
+    p.shape = p.overflow ? -1 : rampShapeFind(p.token);
+  } else if (p.field == FIELD_STATE || p.field == FIELD_GROUP) {
+    if (p.overflow) {
+      p.invalid = true;
+    } else if (p.field == FIELD_STATE) {
+      strcpy(p.stateValue, p.token);
+    } else {
+      strcpy(p.group, p.token);
+      p.hasGroup = true;
+    }
+  } else if (p.field != FIELD_OTHER) {
+    p.invalid = true; // numbers only
+  }
+}
+
+void batchNumber(BatchParser &p) {
+  int32_t value = p.negative ? -p.number : p.number;
+  if (p.field == FIELD_OTHER) return;
+  if (p.overflow || p.field == FIELD_STATE || p.field == FIELD_GROUP || p.field == FIELD_SHAPE) {
+    p.invalid = true;
+  } else if (p.field == FIELD_GPIO) {
+    p.gpio = value;
+  } else if (p.field == FIELD_RES) {
+    p.resolution = value;
+  } else if (p.field == FIELD_DURATION && value >= 0) {
+    p.duration = value;
+  } else if (p.field == FIELD_RAMP) {
+    p.ramp = value; // range checked with the state
+  } else if (p.field == FIELD_FREQ && value > 0) {
+    p.frequency = value;
+  } else {
+    p.invalid = true;
+  }
+}
+
+// Returns false on a character that cannot appear at this point
+bool batchChar(BatchParser &p, char c) {
+  switch (p.state) {
+    case BATCH_KEY_STRING:
+    case BATCH_STRING:
+      if (c == '\\') {
+        return false; // no escapes: keys and values are plain names
+      } else if (c != '"') {
+        batchTokenChar(p, c);
+      } else if (p.state == BATCH_KEY_STRING) {
+        p.field = batchField(p);
+        p.state = BATCH_COLON;
+      } else {
+        batchString(p);
+        p.state = BATCH_AFTER_VALUE;
+      }
+      return true;
+    case BATCH_NUMBER:
+      if (c >= '0' && c <= '9') {
+        p.digits = true;
+        if (p.number > (INT32_MAX - 9) / 10) {
+          p.overflow = true;
+        } else {
+          p.number = p.number * 10 + (c - '0');
+        }
+        return true;
+      }
+      if (c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+        p.overflow = true; // integers only
+        return true;
+      }
+      if (!p.digits) return false; // a lone '-'
+      batchNumber(p);
+      p.state = BATCH_AFTER_VALUE; // c ends the number and is handled below
+      break;
+    case BATCH_LITERAL:
+      if (c >= 'a' && c <= 'z') return true;
+      p.state = BATCH_AFTER_VALUE;
+      break;
+    default:
+      break;
+  }
+
+  if (c == ' ' || c == '\t' || c == '\r' || c == '\n') return true;
+
+  switch (p.state) {
+    case BATCH_START:
+      if (c != '[') return false;
+      p.state = BATCH_ELEMENT;
+      return true;
+    case BATCH_ELEMENT:
+    case BATCH_NEXT_ELEMENT:
+      if (c == ']' && p.state == BATCH_ELEMENT) {
+        p.state = BATCH_DONE;
+      } else if (c == '{') {
+        batchOperationBegin(p);
+        p.state = BATCH_KEY;
+      } else {
+        return false;
+      }
+      return true;
+    case BATCH_KEY:
+    case BATCH_NEXT_KEY:
+      if (c == '}' && p.state == BATCH_KEY) {
+        batchOperationEnd(p);
+        p.state = BATCH_AFTER_ELEMENT;
+      } else if (c == '"') {
+        batchTokenBegin(p);
+        p.state = BATCH_KEY_STRING;
+      } else {
+        return false;
+      }
+      return true;
+    case BATCH_COLON:
+      if (c != ':') return false;
+      p.state = BATCH_VALUE;
+      return true;
+    case BATCH_VALUE:
+      batchTokenBegin(p);
+      if (c == '"') {
+        p.state = BATCH_STRING;
+      } else if (c == '-' || (c >= '0' && c <= '9')) {
+        p.negative = c == '-';
+        p.digits = !p.negative;
+        p.number = p.negative ? 0 : c - '0';
+        p.state = BATCH_NUMBER;
+      } else if (c >= 'a' && c <= 'z') {
+        if (p.field != FIELD_OTHER) p.invalid = true; // true, false, null
+        p.state = BATCH_LITERAL;
+      } else {
+        return false;
+      }
+      return true;
+    case BATCH_AFTER_VALUE:
+      if (c == ',') {
+        p.state = BATCH_NEXT_KEY;
+      } else if (c == '}') {
+        batchOperationEnd(p);
+        p.state = BATCH_AFTER_ELEMENT;
+      } else {
+        return false;
+      }
+      return true;
+    case BATCH_AFTER_ELEMENT:
+      if (c == ',') {
+        p.state = BATCH_NEXT_ELEMENT;
+      } else if (c == ']') {
+        p.state = BATCH_DONE;
+      } else {
+        return false;
+      }
+      return true;
+    default:
+      return false; // nothing may follow the closing bracket
+  }
+}
+
+// Feeds the next chunk of a batch and applies the digital operations it
+// completed. Chunks may split the input anywhere.
+void batchFeed(BatchParser &p, const char* data, size_t len) {
+  for (size_t i = 0; i < len && p.state != BATCH_MALFORMED; i++) {
+    if (batchChar(p, data[i])) {
+      p.offset++;
+    } else {
+      p.state = BATCH_MALFORMED;
+    }
+  }
+  batchFlush(p);
+}
+
+const char* batchErrorText(uint8_t error) {
+  switch (error) {
+    case BATCH_UNKNOWN_GROUP: return "Unknown group";
+    case BATCH_NO_CHANNEL: return "No free PWM channel";
+    case BATCH_SCENE_FULL: return "Too many PWM pins or timed resets";
+    case BATCH_PIN_CLAIMED: return "GPIO in use by edge capture or a counter";
+    case BATCH_BUSY: return "Busy: actuation queue full";
+    default: return "Invalid operation";
+  }
+}
+
+// Blink patterns. Each pin has its own period, duty cycle, phase offset and
+// repeat count, and all of them run from one PATTERN_TICK_MS ticker that
+// folds the edges due on a tick into a single mask write. Cycles are aligned
+// to the millis() clock, so pins with the same period keep their relative
+// phase however far apart they were started. The tick runs on the timer
+// task, so it never waits for room in the ring: a write the full ring drops
+// is counted and kept, and sent again with the next tick's edges.
+#define MAX_PATTERNS 16
+#define PATTERN_TICK_MS 1
+#define PATTERN_NONE 0xFF
+
+struct Pattern {
+  uint8_t gpio;         // PATTERN_NONE when the slot is free
+  bool level;           // level the pin has now
+  uint8_t duty;         // percent of the period spent high
+  uint32_t period;      // ms
+  uint32_t phase;       // ms
+  uint32_t repeat;      // cycles to run, 0 for no limit
+  uint32_t cycles;      // cycles started so far
+  uint32_t cycleStart;  // millis() at which the current cycle starts
+  uint32_t nextEdge;    // millis() of the next toggle
+};
+
+Ticker patternTicker;
+Pattern patterns[MAX_PATTERNS];
+int patternCount = 0;
+GpioMaskWrite patternUnsent = {}; // levels of dropped tick writes, under patternMux
+uint32_t patternDropped = 0;      // tick writes the full ring dropped, timer task only
+portMUX_TYPE patternMux = portMUX_INITIALIZER_UNLOCKED;
+
+void patternTick() {
+  if (patternCount == 0 && maskEmpty(patternUnsent)) return; // a finished pattern's last write may be unsent
+  uint32_t now = millis();
+  portENTER_CRITICAL(&patternMux);
+  GpioMaskWrite write = patternUnsent;
+  for (int i = 0; i < MAX_PATTERNS; i++) {
+    Pattern &pattern = patterns[i];
+    if (pattern.gpio == PATTERN_NONE || (int32_t)(now - pattern.nextEdge) < 0) continue;
+    int gpio = pattern.gpio;
+    bool level = pattern.level;
+    // Consume every edge that is due, so a late tick catches up without
+    // shifting the pattern
+    while ((int32_t)(now - pattern.nextEdge) >= 0) {
+      if (pattern.level) {
+        pattern.level = false;
+        pattern.cycleStart += pattern.period;
+        pattern.nextEdge = pattern.cycleStart;
+        if (pattern.repeat != 0 && pattern.cycles == pattern.repeat) {
+          pattern.gpio = PATTERN_NONE; // Done, the pin stays low
+          patternCount--;
+          break;
+        }
+      } else {
+        pattern.level = true;
+        pattern.cycles++;
+        pattern.nextEdge = pattern.cycleStart + (uint64_t)pattern.period * pattern.duty / 100;
+      }
+    }
+    if (pattern.level != level) {
+      maskAdd(write, gpio, pattern.level);
+    }
+  }
+  // Kept until it is queued; patternStart() and patternStop() take their
+  // pins out of it meanwhile
+  patternUnsent = write;
+  portEXIT_CRITICAL(&patternMux);
+  if (!maskSend(write)) {
+    patternDropped++;
+    return;
+  }
+  if (!maskEmpty(write)) {
+    portENTER_CRITICAL(&patternMux);
+    memset(&patternUnsent, 0, sizeof(patternUnsent));
+    portEXIT_CRITICAL(&patternMux);
+  }
+}
+
+// Returns false when every pattern slot is taken
+bool patternStart(int gpio, uint32_t period, int duty, uint32_t phase, uint32_t repeat) {
+  uint32_t now = millis();
+  uint32_t start = phase % period;
+  int32_t behind = now - start;
+  if (behind > 0) {
+    start += (behind + period - 1) / period * period; // first cycle start not before now
+  }
+
+  portENTER_CRITICAL(&patternMux);
+  int slot = -1;
+  for (int i = 0; i < MAX_PATTERNS; i++) {
+    if (patterns[i].gpio == gpio) {
+      slot = i;
+      break;
+    }
+    if (slot < 0 && patterns[i].gpio == PATTERN_NONE) {
+      slot = i;
+    }
+  }
+  if (slot >= 0) {
+    Pattern &pattern = patterns[slot];
+    if (pattern.gpio == PATTERN_NONE) {
+      patternCount++;
+    }
+    maskRemove(patternUnsent, gpio);
+    pattern.gpio = gpio;
+    pattern.level = false;
+    pattern.duty = duty;
+    pattern.period = period;
+    pattern.phase = phase;
+    pattern.repeat = repeat;
+    pattern.cycles = 0;
+    pattern.cycleStart = start;
+    pattern.nextEdge = start;
+  }
+  portEXIT_CRITICAL(&patternMux);
+  if (slot < 0) return false;
+
+  GpioMaskWrite write = {};
+  maskAdd(write, gpio, false); // Low until the first cycle starts
+  applyMaskWrite(write);
+  return true;
+}
+
+// Stops the pattern on a pin (or on every pin for gpio -1) and drives it low
+int patternStop(int gpio) {
+  GpioMaskWrite write = {};
+  int stopped = 0;
+  portENTER_CRITICAL(&patternMux);
+  for (int i = 0; i < MAX_PATTERNS; i++) {
+    if (patterns[i].gpio != PATTERN_NONE && (gpio < 0 || patterns[i].gpio == gpio)) {
+      maskAdd(write, patterns[i].gpio, false);
+      maskRemove(patternUnsent, patterns[i].gpio);
+      patterns[i].gpio = PATTERN_NONE;
+      patternCount--;
+      stopped++;
+    }
+  }
+  portEXIT_CRITICAL(&patternMux);
+  applyMaskWrite(write);
+  return stopped;
+}
+
+void patternsBegin() {
+  for (int i = 0; i < MAX_PATTERNS; i++) {
+    patterns[i].gpio = PATTERN_NONE;
+  }
+  patternTicker.attach_ms(PATTERN_TICK_MS, patternTick);
+}
+
+// Schedule fire/reset events, collected for the WebSocket push. Nothing is
+// recorded while no client listens.
+#define SCHEDULE_EVENT_LOG 32
+
+volatile int scheduleEventListeners = 0; // set by the front end
+
+struct ScheduleEvent {
+  uint32_t id;
+  uint8_t phase;
+  GpioCommand cmd;  // the state that was applied
+};
+
+ScheduleEvent scheduleEvents[SCHEDULE_EVENT_LOG];
+int scheduleEventCount = 0;
+uint32_t scheduleEventsDropped = 0;
+portMUX_TYPE eventMux = portMUX_INITIALIZER_UNLOCKED;
+
+void queueScheduleEvent(const ScheduledEntry &entry) {
+  if (__atomic_load_n(&scheduleEventListeners, __ATOMIC_RELAXED) == 0) return;
+  portENTER_CRITICAL(&eventMux);
+  if (scheduleEventCount < SCHEDULE_EVENT_LOG) {
+    ScheduleEvent &event = scheduleEvents[scheduleEventCount++];
+    event.id = entry.id;
+    event.phase = entry.phase;
+    event.cmd = entry.phase == PHASE_RESET ? resetCommand(entry.cmd) : entry.cmd;
+  } else {
+    scheduleEventsDropped++;
+  }
+  portEXIT_CRITICAL(&eventMux);
+}
+
+// Whole-port snapshot: the input registers are sampled once, together with
+// the output/PWM masks and duty shadow, so every pin in it is from the same
+// instant. format=hex and format=bin return the same layout as raw bytes
+// (little endian): levels, outputs and pwm as one uint32 per bank, then one
+// uint16 duty per pwm pin in ascending pin order.
+struct PortSnapshot {
+  uint32_t levels[GPIO_BANKS];
+  uint32_t outputs[GPIO_BANKS];
+  uint32_t pwm[GPIO_BANKS];
+  uint16_t duty[SOC_GPIO_PIN_COUNT];
+};
+
+void takeSnapshot(PortSnapshot &snap, const uint32_t mask[GPIO_BANKS]) {
+  portENTER_CRITICAL(&gpioMux);
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    snap.levels[bank] = gpioInRead(bank) & mask[bank];
+    snap.outputs[bank] = outputPins[bank] & ~pwmPins[bank] & mask[bank];
+    snap.pwm[bank] = pwmPins[bank] & mask[bank];
+    uint32_t pins = snap.pwm[bank];
+    while (pins) {
+      int gpio = bank * 32 + __builtin_ctz(pins);
+      snap.duty[gpio] = pinDuty[gpio];
+      pins &= pins - 1;
+    }
+  }
+  portEXIT_CRITICAL(&gpioMux);
+}
+
+// Packs a snapshot into the hex/bin layout, returns the byte count
+size_t packSnapshot(const PortSnapshot &snap, uint8_t* out) {
+  size_t len = 0;
+  const uint32_t* words[] = {snap.levels, snap.outputs, snap.pwm};
+  for (int i = 0; i < 3; i++) {
+    for (int bank = 0; bank < GPIO_BANKS; bank++) {
+      memcpy(out + len, &words[i][bank], 4);
+      len += 4;
+    }
+  }
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    uint32_t pins = snap.pwm[bank];
+    while (pins) {
+      memcpy(out + len, &snap.duty[bank * 32 + __builtin_ctz(pins)], 2);
+      len += 2;
+      pins &= pins - 1;
+    }
+  }
+  return len;
+}
+
+// Background ADC sampling. An esp_timer ticks every ADC_TICK_US and only
+// wakes the sampling task, which reads each configured channel when it is
+// due, averaging `oversample` reads into one sample: up to 64 analogRead()
+// calls would otherwise hold up every other esp_timer callback. Samples go
+// out raw, or as one min/max/mean record per `window` samples. Records land
+// in a ring that the sampling task is the only writer of; readers copy
+// records out without locking and use each record's sequence number to
+// detect ones that were overwritten while being read.
+#define ADC_TICK_US 250            // 4 kHz base tick
+#define ADC_TICK_HZ (1000000 / ADC_TICK_US)
+#define ADC_MAX_CHANNELS 4
+#define ADC_MAX_READS_PER_SEC 8000 // analogRead() budget across all channels
+#define ADC_MAX_OVERSAMPLE 64
+#define ADC_RING_SIZE 1024         // records, power of two
+#define ADC_NONE 0xFF
+#define ADC_PRIORITY 5             // above async_tcp and loop(), below the actuation task
+#define ADC_CORE ACTUATION_CORE
+#define ADC_STACK 2048
+
+// On the ESP32 and ESP32-C3 the Wi-Fi driver owns ADC2 while it is up, so
+// only ADC1 pins can be read there
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32C3
+#define ADC2_USABLE 0
+#else
+#define ADC2_USABLE 1
+#endif
+
+constexpr bool pinAdcUsable(int gpio) {
+  return pinAdcUnit(gpio) == 1 || (ADC2_USABLE && pinAdcUnit(gpio) == 2);
+}
+
+struct AdcChannel {
+  uint8_t gpio;         // ADC_NONE when the slot is unused
+  uint8_t oversample;
+  uint16_t interval;    // ticks between samples
+  uint16_t window;      // samples per min/max/mean record, 0 for raw samples
+  // Filled in by the sampling task
+  uint16_t countdown;
+  uint16_t windowCount;
+  uint16_t windowMin;
+  uint16_t windowMax;
+  uint32_t windowSum;
+};
+
+struct AdcRecord {
+  uint32_t seq;         // written last; ADC_SEQ_WRITING while being updated
+  uint32_t time;        // esp_timer_get_time() in microseconds, low 32 bits
+  uint8_t gpio;
+  bool windowed;
+  uint16_t value;       // sample, or window mean
+  uint16_t min;
+  uint16_t max;
+};
+
+#define ADC_SEQ_WRITING 0xFFFFFFFF
+
+AdcChannel adcConfig[ADC_MAX_CHANNELS];   // written by handlers under adcMux
+AdcChannel adcChannels[ADC_MAX_CHANNELS]; // sampling task's working copy
+uint8_t adcConfigDirty = 0;               // channels to pick up from adcConfig
+bool adcRestarted = false;                // the timer was started again, under adcMux
+AdcRecord adcRing[ADC_RING_SIZE];
+uint32_t adcHead = 0;                     // sequence number of the next record
+uint32_t adcOverruns = 0;                 // samplings that ran late
+int64_t adcLastTick = 0;                  // sampling task only
+esp_timer_handle_t adcTimer = NULL;
+TaskHandle_t adcTask = NULL;
+portMUX_TYPE adcMux = portMUX_INITIALIZER_UNLOCKED;
+
+void adcPush(uint8_t gpio, bool windowed, uint16_t value, uint16_t min, uint16_t max) {
+  uint32_t seq = adcHead;
+  AdcRecord &record = adcRing[seq & (ADC_RING_SIZE - 1)];
+  __atomic_store_n(&record.seq, ADC_SEQ_WRITING, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  record.time = (uint32_t)esp_timer_get_time();
+  record.gpio = gpio;
+  record.windowed = windowed;
+  record.value = value;
+  record.min = min;
+  record.max = max;
+  __atomic_store_n(&record.seq, seq, __ATOMIC_RELEASE);
+  __atomic_store_n(&adcHead, seq + 1, __ATOMIC_RELEASE);
+}
+
+// Copies record seq out of the ring, false if it has been overwritten
+bool adcRead(uint32_t seq, AdcRecord &out) {
+  const AdcRecord &record = adcRing[seq & (ADC_RING_SIZE - 1)];
+  if (__atomic_load_n(&record.seq, __ATOMIC_ACQUIRE) != seq) return false;
+  out = record;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&record.seq, __ATOMIC_RELAXED) == seq;
+}
+
+void adcTick(void *) {
+  xTaskNotifyGive(adcTask);
+}
+
+// Takes the samples due after `ticks` timer ticks, normally 1. More means the
+// task fell behind: the channels due in the meantime are sampled once, late.
+void adcSample(uint32_t ticks) {
+  portENTER_CRITICAL(&adcMux);
+  for (int i = 0; adcConfigDirty; i++) {
+    if (adcConfigDirty & (1 << i)) {
+      adcChannels[i] = adcConfig[i];
+      adcConfigDirty &= ~(1 << i);
+    }
+  }
+  if (adcRestarted) {
+    adcLastTick = 0; // the pause is not an overrun
+    adcRestarted = false;
+  }
+  portEXIT_CRITICAL(&adcMux);
+
+  int64_t now = esp_timer_get_time();
+  if (adcLastTick != 0 && now - adcLastTick > 2 * ADC_TICK_US) {
+    __atomic_fetch_add(&adcOverruns, 1, __ATOMIC_RELAXED);
+  }
+  adcLastTick = now;
+
+  for (int i = 0; i < ADC_MAX_CHANNELS; i++) {
+    AdcChannel &channel = adcChannels[i];
+    if (channel.gpio == ADC_NONE) continue;
+    if (channel.countdown > ticks) {
+      channel.countdown -= ticks;
+      continue;
+    }
+    channel.countdown = channel.interval;
+
+    uint32_t sum = 0;
+    for (int n = 0; n < channel.oversample; n++) {
+      sum += analogRead(channel.gpio);
+    }
+    uint16_t value = sum / channel.oversample;
+    if (channel.window == 0) {
+      adcPush(channel.gpio, false, value, value, value);
+      continue;
+    }
+    if (channel.windowCount == 0 || value < channel.windowMin) channel.windowMin = value;
+    if (channel.windowCount == 0 || value > channel.windowMax) channel.windowMax = value;
+    channel.windowSum += value;
+    if (++channel.windowCount == channel.window) {
+      adcPush(channel.gpio, true, channel.windowSum / channel.window, channel.windowMin, channel.windowMax);
+      channel.windowCount = 0;
+      channel.windowSum = 0;
+    }
+  }
+}
+
+void adcLoop(void *) {
+  for (;;) {
+    adcSample(ulTaskNotifyTake(pdTRUE, portMAX_DELAY));
+  }
+}
+
+void adcBegin() {
+  for (int i = 0; i < ADC_MAX_CHANNELS; i++) {
+    adcConfig[i].gpio = ADC_NONE;
+    adcChannels[i].gpio = ADC_NONE;
+  }
+  xTaskCreatePinnedToCore(adcLoop, "adc", ADC_STACK, NULL, ADC_PRIORITY, &adcTask, ADC_CORE);
+  esp_timer_create_args_t args = {};
+  args.callback = adcTick;
+  args.name = "adc";
+  esp_timer_create(&args, &adcTimer);
+}
+
+// Sets (rate > 0) or stops (rate == 0) sampling of a pin. Returns the HTTP
+// status code for the outcome.
+int adcConfigure(int gpio, uint32_t rate, int oversample, int window) {
+  if (!pinAdcUsable(gpio)) return 400;
+  if (rate > ADC_TICK_HZ || oversample < 1 || oversample > ADC_MAX_OVERSAMPLE || window < 0 || window > 0xFFFF) return 400;
+
+  portENTER_CRITICAL(&adcMux);
+  int slot = -1;
+  int freeSlot = -1;
+  uint32_t reads = rate * oversample;
+  for (int i = 0; i < ADC_MAX_CHANNELS; i++) {
+    if (adcConfig[i].gpio == gpio) {
+      slot = i;
+    } else if (adcConfig[i].gpio == ADC_NONE) {
+      freeSlot = freeSlot < 0 ? i : freeSlot;
+    } else {
+      reads += ADC_TICK_HZ / adcConfig[i].interval * adcConfig[i].oversample;
+    }
+  }
+  int code = 200;
+  if (rate == 0) {
+    if (slot >= 0) {
+      adcConfig[slot].gpio = ADC_NONE;
+      adcConfigDirty |= 1 << slot;
+    } else {
+      code = 404;
+    }
+  } else if (slot < 0 && freeSlot < 0) {
+    code = 507;
+  } else if (reads > ADC_MAX_READS_PER_SEC) {
+    code = 503;
+  } else {
+    slot = slot < 0 ? freeSlot : slot;
+    AdcChannel &channel = adcConfig[slot];
+    memset(&channel, 0, sizeof(channel));
+    channel.gpio = gpio;
+    channel.oversample = oversample;
+    channel.interval = (ADC_TICK_HZ + rate / 2) / rate;
+    channel.window = window;
+    channel.countdown = 1;
+    adcConfigDirty |= 1 << slot;
+  }
+  bool active = false;
+  for (int i = 0; i < ADC_MAX_CHANNELS; i++) {
+    active |= adcConfig[i].gpio != ADC_NONE;
+  }
+  adcRestarted = true;
+  portEXIT_CRITICAL(&adcMux);
+
+  // Runs only while some channel is sampled
+  esp_timer_stop(adcTimer);
+  if (active) {
+    esp_timer_start_periodic(adcTimer, ADC_TICK_US);
+  }
+  return code;
+}
+
+// Input edge capture. /edge arms a pin interrupt for rising, falling or both
+// edges, and the ISR stamps each edge with esp_timer_get_time() and appends
+// it to a ring the way adcPush() does. GPIO interrupts are all dispatched by
+// one handler on one core, so the ISR is the only writer of the ring and
+// takes no lock. An edge closer than `debounce` us to the last one reported
+// on its pin is dropped as a bounce, and so is a "both" edge that leaves the
+// pin at the level it last reported.
+#define EDGE_RING_SIZE 1024          // records, power of two
+#define EDGE_MAX_DEBOUNCE_US 1000000
+#define EDGE_BATCH_MAX 256           // records per /edges response
+#define EDGE_WAIT_MAX_MS 30000
+
+enum EdgeMode : uint8_t {
+  EDGE_OFF,
+  EDGE_RISING,
+  EDGE_FALLING,
+  EDGE_BOTH,
+  EDGE_MODES
+};
+
+const char* const edgeModeNames[EDGE_MODES] = {"off", "rising", "falling", "both"};
+
+struct EdgePin {
+  uint8_t mode;
+  uint8_t pull;       // INPUT, INPUT_PULLUP or INPUT_PULLDOWN
+  bool level;         // level after the last reported edge
+  uint32_t debounce;  // us
+  uint32_t last;      // time of the last reported edge
+  uint32_t edges;     // reported since the pin was armed
+  uint32_t bounces;   // dropped by the debounce
+  bool held;          // switched to input when armed, so commands may not drive it
+};
+
+struct EdgeRecord {
+  uint32_t seq;       // written last; EDGE_SEQ_WRITING while being updated
+  uint32_t time;      // esp_timer_get_time() in microseconds, low 32 bits
+  uint8_t gpio;
+  bool level;         // level after the edge
+};
+
+#define EDGE_SEQ_WRITING 0xFFFFFFFF
+
+EdgePin edgePins[SOC_GPIO_PIN_COUNT]; // written by handlers while the pin is detached
+EdgeRecord edgeRing[EDGE_RING_SIZE];
+uint32_t edgeHead = 0;                // sequence number of the next record
+uint32_t edgeOverflows = 0;           // reads that found records overwritten
+uint32_t edgeLost = 0;                // records overwritten before they were read
+
+void IRAM_ATTR edgePush(uint8_t gpio, bool level, uint32_t time) {
+  uint32_t seq = edgeHead;
+  EdgeRecord &record = edgeRing[seq & (EDGE_RING_SIZE - 1)];
+  __atomic_store_n(&record.seq, EDGE_SEQ_WRITING, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  record.time = time;
+  record.gpio = gpio;
+  record.level = level;
+  __atomic_store_n(&record.seq, seq, __ATOMIC_RELEASE);
+  __atomic_store_n(&edgeHead, seq + 1, __ATOMIC_RELEASE);
+}
+
+// Copies record seq out of the ring, false if it has been overwritten
+bool edgeRead(uint32_t seq, EdgeRecord &out) {
+  const EdgeRecord &record = edgeRing[seq & (EDGE_RING_SIZE - 1)];
+  if (__atomic_load_n(&record.seq, __ATOMIC_ACQUIRE) != seq) return false;
+  out = record;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&record.seq, __ATOMIC_RELAXED) == seq;
+}
+
+void IRAM_ATTR edgeIsr(void *arg) {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  int gpio = (intptr_t)arg;
+  EdgePin &pin = edgePins[gpio];
+  bool level = pin.mode == EDGE_BOTH ? (gpioInRead(gpio >> 5) >> (gpio & 31)) & 1 : pin.mode == EDGE_RISING;
+  if (now - pin.last < pin.debounce || (pin.mode == EDGE_BOTH && level == pin.level)) {
+    pin.bounces++;
+    return;
+  }
+  pin.last = now;
+  pin.level = level;
+  pin.edges++;
+  edgePush(gpio, level, now);
+}
+
+// Makes sure a pin can be read. A pin the sketch does not drive is switched
+// to input on first use, or always when force is set; a driven pin is read
+// back as it is. Returns false for a driven pin.
+bool inputBegin(int gpio, uint8_t pull, bool force) {
+  int bank = gpio >> 5;
+  uint32_t bit = 1UL << (gpio & 31);
+  portENTER_CRITICAL(&gpioMux);
+  bool driven = (outputPins[bank] | pwmPins[bank]) & bit;
+  bool configure = !driven && (force || !(inputPins[bank] & bit));
+  if (configure) {
+    inputPins[bank] |= bit;
+  }
+  portEXIT_CRITICAL(&gpioMux);
+  if (configure) {
+    pinMode(gpio, pull);
+  }
+  return !driven;
+}
+
+bool pinLevel(int gpio) {
+  return (gpioInRead(gpio >> 5) >> (gpio & 31)) & 1;
+}
+
+// Claims the armed pins edge capture switched to input. An armed pin the
+// sketch drives is only read back, and stays the sketch's.
+void edgeClaimsUpdate() {
+  uint32_t pins[GPIO_BANKS] = {};
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+    if (edgePins[gpio].mode != EDGE_OFF && edgePins[gpio].held) {
+      pins[gpio >> 5] |= 1UL << (gpio & 31);
+    }
+  }
+  pinsClaim(OWNER_EDGE, pins);
+}
+
+// Arms (mode != EDGE_OFF) or disarms edge capture on a pin. Returns the HTTP
+// status code for the outcome.
+int edgeConfigure(int gpio, uint8_t mode, uint8_t pull, uint32_t debounce) {
+  // Input-only pins have no pull resistors
+  if (!pinCanInput(gpio) || mode >= EDGE_MODES || debounce > EDGE_MAX_DEBOUNCE_US ||
+      (pull != INPUT && !pinCanOutput(gpio))) {
+    return 400;
+  }
+  EdgePin &pin = edgePins[gpio];
+  if (mode == EDGE_OFF && pin.mode == EDGE_OFF) {
+    return 404;
+  }
+  if (pin.mode != EDGE_OFF) {
+    detachInterrupt(gpio);
+    pin.mode = EDGE_OFF;
+  }
+  if (mode == EDGE_OFF) {
+    edgeClaimsUpdate();
+    return 200;
+  }
+  pin.held = inputBegin(gpio, pull, true);
+  pin.pull = pull;
+  pin.debounce = debounce;
+  pin.level = pinLevel(gpio);
+  pin.last = (uint32_t)esp_timer_get_time() - debounce;
+  pin.edges = 0;
+  pin.bounces = 0;
+  pin.mode = mode;
+  attachInterruptArg(gpio, edgeIsr, (void*)(intptr_t)gpio,
+                     mode == EDGE_RISING ? RISING : mode == EDGE_FALLING ? FALLING : CHANGE);
+  edgeClaimsUpdate();
+  return 200;
+}
+
+uint32_t edgeBounces() {
+  uint32_t bounces = 0;
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+    bounces += edgePins[gpio].bounces;
+  }
+  return bounces;
+}
+
+// Streams up to max records from next as JSON, a chunk at a time. As a long
+// poll, it first waits until an edge arrives or the deadline passes. ready()
+// is only asked when AsyncTCP polls the connection, every 500 ms (lwIP's slow
+// timer), so a waiting response starts up to that long after the edge. The
+// push cannot wake it sooner: it runs in the ISR, and the connection's
+// callbacks only run on the async_tcp task, which offers no way to be poked.
+struct EdgeStream {
+  uint32_t next;
+  uint32_t end;
+  uint32_t max;
+  uint32_t dropped;
+  uint32_t deadline;    // millis()
+  int gpio;             // -1 for all pins
+  bool waiting;
+  uint8_t phase;        // 0 header, 1 records, 2 footer, 3 done
+  bool first;
+  uint8_t linePos;
+  uint8_t lineLen;
+  char line[48];
+
+  bool ready() {
+    if (!waiting) return true;
+    uint32_t head = __atomic_load_n(&edgeHead, __ATOMIC_ACQUIRE);
+    if (head == next && (int32_t)(millis() - deadline) < 0) return false;
+    waiting = false;
+    uint32_t oldest = head > EDGE_RING_SIZE ? head - EDGE_RING_SIZE : 0;
+    if (next < oldest) {
+      dropped = oldest - next;
+      next = oldest;
+    }
+    end = head - next > max ? next + max : head;
+    return true;
+  }
+
+  bool nextLine() {
+    EdgeRecord record;
+    lineLen = 0;
+    linePos = 0;
+    while (phase == 1 && lineLen == 0) {
+      if (next == end) {
+        phase = 2;
+      } else if (!edgeRead(next, record)) {
+        uint32_t oldest = __atomic_load_n(&edgeHead, __ATOMIC_ACQUIRE) - EDGE_RING_SIZE;
+        uint32_t skip = (int32_t)(oldest - next) > 0 ? oldest - next : 1;
+        skip = skip < end - next ? skip : end - next;
+        dropped += skip;
+        next += skip;
+      } else {
+        next++;
+        if (gpio >= 0 && record.gpio != gpio) continue;
+        lineLen = snprintf(line, sizeof(line), "%s[%u,%u,%u]", first ? "" : ",", record.time, record.gpio, record.level);
+        first = false;
+      }
+    }
+    if (phase == 0) {
+      lineLen = snprintf(line, sizeof(line), "{\"edges\":[");
+      phase = 1;
+    } else if (phase == 2) {
+      lineLen = snprintf(line, sizeof(line), "],\"next\":%u,\"dropped\":%u}", next, dropped);
+      phase = 3;
+      if (dropped > 0) {
+        __atomic_fetch_add(&edgeOverflows, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&edgeLost, dropped, __ATOMIC_RELAXED);
+      }
+    }
+    return lineLen > 0;
+  }
+};
+
+// Pulse counters. /counter binds a pin to one of the PCNT units, which count
+// edges in hardware at rates no interrupt per edge could keep up with. A
+// unit's counter is 16 bits and returns to 0 when it reaches +/-COUNTER_LIMIT,
+// so an esp_timer reads every unit each COUNTER_POLL_US and folds the change
+// since the last read into a 64-bit total. That stays exact while fewer than
+// COUNTER_LIMIT edges arrive between two polls, about 6 MHz, or half that
+// with a direction pin. The same tick closes each counter's frequency window.
+#define COUNTER_POLL_US 5000
+#define COUNTER_LIMIT 32767          // the unit counts within (-limit, limit)
+#define COUNTER_FILTER_MAX_NS 12787  // 1023 APB cycles of 12.5 ns
+#define COUNTER_WINDOW_MIN_MS 10
+#define COUNTER_WINDOW_MAX_MS 60000
+#define COUNTER_NONE 0xFF
+
+#if SOC_PCNT_SUPPORTED
+#define COUNTER_UNITS SOC_PCNT_UNITS_PER_GROUP
+#define COUNTER_AVAILABLE COUNTER_UNITS
+#else
+#define COUNTER_UNITS 1              // array size only
+#define COUNTER_AVAILABLE 0          // no PCNT (ESP32-C3), /counter answers 501
+#endif
+
+struct Counter {
+  uint8_t gpio;         // COUNTER_NONE when the unit is free
+  uint8_t ctrl;         // counts down while this pin is low, COUNTER_NONE for up only
+  uint8_t edge;         // EDGE_RISING, EDGE_FALLING or EDGE_BOTH
+  uint16_t filter;      // glitch filter in ns, 0 when off
+  uint16_t ppr;         // counted edges per revolution, 0 for no rpm
+  uint32_t window;      // ms
+  int16_t raw;          // unit counter at the last read
+  int64_t total;        // since the counter was configured
+  int64_t base;         // total at the last reset
+  int64_t windowTotal;  // total when the current window opened
+  int64_t windowStart;  // esp_timer_get_time() when the current window opened
+  int64_t lastCount;    // edges in the last complete window
+  uint32_t lastUs;      // length of the last complete window, 0 before the first
+};
+
+Counter counters[COUNTER_UNITS]; // written by handlers and counterTick() under counterMux
+esp_timer_handle_t counterTimer = NULL;
+portMUX_TYPE counterMux = portMUX_INITIALIZER_UNLOCKED;
+
+int16_t counterRead(int unit) {
+  int16_t value = 0;
+#if SOC_PCNT_SUPPORTED
+  pcnt_get_counter_value((pcnt_unit_t)unit, &value);
+#endif
+  return value;
+}
+
+// Adds the edges counted since the last read to the total. The unit's value
+// is only known modulo COUNTER_LIMIT, so the change is taken as the smallest
+// non-negative residue for a counter that only counts up, and as the residue
+// nearest zero for one with a direction pin. Called with counterMux held.
+void counterFold(Counter &counter, int unit) {
+  int16_t raw = counterRead(unit);
+  int32_t delta = ((int32_t)raw - counter.raw) % COUNTER_LIMIT;
+  if (counter.ctrl == COUNTER_NONE) {
+    delta += delta < 0 ? COUNTER_LIMIT : 0;
+  } else if (delta > COUNTER_LIMIT / 2) {
+    delta -= COUNTER_LIMIT;
+  } else if (delta < -(COUNTER_LIMIT / 2)) {
+    delta += COUNTER_LIMIT;
+  }
+  counter.raw = raw;
+  counter.total += delta;
+}
+
+void counterTick(void *) {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&counterMux);
+  for (int unit = 0; unit < COUNTER_UNITS; unit++) {
+    Counter &counter = counters[unit];
+    if (counter.gpio == COUNTER_NONE) continue;
+    counterFold(counter, unit);
+    if (now - counter.windowStart >= (int64_t)counter.window * 1000) {
+      counter.lastCount = counter.total - counter.windowTotal;
+      counter.lastUs = now - counter.windowStart;
+      counter.windowTotal = counter.total;
+      counter.windowStart = now;
+    }
+  }
+  portEXIT_CRITICAL(&counterMux);
+}
+
+void countersBegin() {
+  for (int unit = 0; unit < COUNTER_UNITS; unit++) {
+    counters[unit].gpio = COUNTER_NONE;
+  }
+  esp_timer_create_args_t args = {};
+  args.callback = counterTick;
+  args.name = "counter";
+  esp_timer_create(&args, &counterTimer);
+}
+
+int countersActive() {
+  int active = 0;
+  for (int unit = 0; unit < COUNTER_UNITS; unit++) {
+    active += counters[unit].gpio != COUNTER_NONE;
+  }
+  return active;
+}
+
+// Runs the poll only while some pin is counted
+void counterTimerUpdate() {
+  esp_timer_stop(counterTimer);
+  if (countersActive() > 0) {
+    esp_timer_start_periodic(counterTimer, COUNTER_POLL_US);
+  }
+}
+
+// Claims the pulse and control pins of the bound units
+void counterClaimsUpdate() {
+  uint32_t pins[GPIO_BANKS] = {};
+  portENTER_CRITICAL(&counterMux);
+  for (int unit = 0; unit < COUNTER_UNITS; unit++) {
+    if (counters[unit].gpio == COUNTER_NONE) {
+      continue; // a released unit keeps its last ctrl
+    }
+    for (uint8_t gpio : {counters[unit].gpio, counters[unit].ctrl}) {
+      if (gpio != COUNTER_NONE) {
+        pins[gpio >> 5] |= 1UL << (gpio & 31);
+      }
+    }
+  }
+  portEXIT_CRITICAL(&counterMux);
+  pinsClaim(OWNER_COUNTER, pins);
+}
+
+// Binds a pin to a unit (edge != EDGE_OFF) or releases it (edge == EDGE_OFF).
+// Binding a counted pin again reconfigures its unit and restarts its count.
+// Returns the HTTP status code for the outcome.
+int counterConfigure(int gpio, uint8_t edge, int ctrl, uint32_t filter, uint32_t window, uint32_t ppr) {
+  if (COUNTER_AVAILABLE == 0) return 501;
+  if (!pinCanInput(gpio) || edge >= EDGE_MODES || (ctrl >= 0 && (!pinCanInput(ctrl) || ctrl == gpio)) ||
+      filter > COUNTER_FILTER_MAX_NS || window < COUNTER_WINDOW_MIN_MS || window > COUNTER_WINDOW_MAX_MS || ppr > 0xFFFF) {
+    return 400;
+  }
+
+  // The unit switches the pin to input, which would cut off a pin the
+  // sketch drives
+  int bank = gpio >> 5;
+  uint32_t bit = 1UL << (gpio & 31);
+  portENTER_CRITICAL(&gpioMux);
+  bool driven = (outputPins[bank] | pwmPins[bank]) & bit;
+  portEXIT_CRITICAL(&gpioMux);
+  if (edge != EDGE_OFF && driven) return 409;
+
+  // Handlers run one at a time, so the unit picked here stays ours. It is
+  // marked free while the driver calls below run, so the tick skips it.
+  portENTER_CRITICAL(&counterMux);
+  int unit = -1;
+  int freeUnit = -1;
+  for (int i = 0; i < COUNTER_UNITS; i++) {
+    if (counters[i].gpio == gpio) {
+      unit = i;
+    } else if (counters[i].gpio == COUNTER_NONE && freeUnit < 0) {
+      freeUnit = i;
+    }
+  }
+  if (unit >= 0) {
+    counters[unit].gpio = COUNTER_NONE;
+  }
+  portEXIT_CRITICAL(&counterMux);
+
+  if (edge == EDGE_OFF) {
+    if (unit < 0) return 404;
+#if SOC_PCNT_SUPPORTED
+    pcnt_counter_pause((pcnt_unit_t)unit);
+    pcnt_set_pin((pcnt_unit_t)unit, PCNT_CHANNEL_0, PCNT_PIN_NOT_USED, PCNT_PIN_NOT_USED);
+#endif
+    counterTimerUpdate();
+    counterClaimsUpdate();
+    return 200;
+  }
+  unit = unit < 0 ? freeUnit : unit;
+  if (unit < 0) return 507;
+
+#if SOC_PCNT_SUPPORTED
+  pcnt_config_t config = {};
+  config.pulse_gpio_num = gpio;
+  config.ctrl_gpio_num = ctrl < 0 ? PCNT_PIN_NOT_USED : ctrl;
+  config.lctrl_mode = ctrl < 0 ? PCNT_MODE_KEEP : PCNT_MODE_REVERSE;
+  config.hctrl_mode = PCNT_MODE_KEEP;
+  config.pos_mode = edge == EDGE_FALLING ? PCNT_COUNT_DIS : PCNT_COUNT_INC;
+  config.neg_mode = edge == EDGE_RISING ? PCNT_COUNT_DIS : PCNT_COUNT_INC;
+  config.counter_h_lim = COUNTER_LIMIT;
+  config.counter_l_lim = -COUNTER_LIMIT;
+  config.unit = (pcnt_unit_t)unit;
+  config.channel = PCNT_CHANNEL_0;
+  pcnt_unit_config(&config);
+  pcnt_counter_pause((pcnt_unit_t)unit);
+  if (filter > 0) {
+    pcnt_set_filter_value((pcnt_unit_t)unit, (filter * 80 + 999) / 1000); // APB cycles
+    pcnt_filter_enable((pcnt_unit_t)unit);
+  } else {
+    pcnt_filter_disable((pcnt_unit_t)unit);
+  }
+  pcnt_counter_clear((pcnt_unit_t)unit);
+  pcnt_counter_resume((pcnt_unit_t)unit);
+#endif
+
+  // The unit has enabled the pin's pull-up; keep /readgpio from resetting it
+  portENTER_CRITICAL(&gpioMux);
+  inputPins[bank] |= bit;
+  portEXIT_CRITICAL(&gpioMux);
+
+  Counter counter = {};
+  counter.gpio = gpio;
+  counter.ctrl = ctrl < 0 ? COUNTER_NONE : ctrl;
+  counter.edge = edge;
+  counter.filter = filter;
+  counter.ppr = ppr;
+  counter.window = window;
+  counter.windowStart = esp_timer_get_time();
+  portENTER_CRITICAL(&counterMux);
+  counters[unit] = counter;
+  portEXIT_CRITICAL(&counterMux);
+  counterTimerUpdate();
+  counterClaimsUpdate();
+  return 200;
+}
+
+// Copies every counter with its total brought up to date, all at the same
+// instant. With reset, each copied counter's count starts again from zero.
+void countersSnapshot(Counter out[COUNTER_UNITS], int gpio, bool reset) {
+  portENTER_CRITICAL(&counterMux);
+  for (int unit = 0; unit < COUNTER_UNITS; unit++) {
+    Counter &counter = counters[unit];
+    if (counter.gpio == COUNTER_NONE || (gpio >= 0 && counter.gpio != gpio)) {
+      out[unit].gpio = COUNTER_NONE;
+      continue;
+    }
+    counterFold(counter, unit);
+    out[unit] = counter;
+    if (reset) {
+      counter.base = counter.total;
+    }
+  }
+  portEXIT_CRITICAL(&counterMux);
+}
+
+// Streams records [next, end) as JSON a chunk at a time. Records overwritten
+// before they were sent are counted in "dropped" and skipped.
+struct SampleStream {
+  uint32_t next;
+  uint32_t end;
+  uint32_t dropped;
+  int gpio;             // -1 for all channels
+  uint8_t phase;        // 0 header, 1 records, 2 footer, 3 done
+  bool first;
+  uint8_t linePos;
+  uint8_t lineLen;
+  char line[64];
+
+  bool nextLine() {
+    AdcRecord record;
+    lineLen = 0;
+    linePos = 0;
+    while (phase == 1 && lineLen == 0) {
+      if (next == end) {
+        phase = 2;
+      } else if (!adcRead(next, record)) {
+        uint32_t oldest = __atomic_load_n(&adcHead, __ATOMIC_ACQUIRE) - ADC_RING_SIZE;
+        uint32_t skip = (int32_t)(oldest - next) > 0 ? oldest - next : 1;
+        skip = skip < end - next ? skip : end - next;
+        dropped += skip;
+        next += skip;
+      } else {
+        next++;
+        if (gpio >= 0 && record.gpio != gpio) continue;
+        if (record.windowed) {
+          lineLen = snprintf(line, sizeof(line), "%s[%u,%u,%u,%u,%u]", first ? "" : ",",
+                             record.time, record.gpio, record.value, record.min, record.max);
+        } else {
+          lineLen = snprintf(line, sizeof(line), "%s[%u,%u,%u]", first ? "" : ",", record.time, record.gpio, record.value);
+        }
+        first = false;
+      }
+    }
+    if (phase == 0) {
+      lineLen = snprintf(line, sizeof(line), "{\"samples\":[");
+      phase = 1;
+    } else if (phase == 2) {
+      lineLen = snprintf(line, sizeof(line), "],\"next\":%u,\"dropped\":%u}", next, dropped);
+      phase = 3;
+    }
+    return lineLen > 0;
+  }
+};
+
+// Wi-Fi link state machine. A join uses the BSSID and channel cached from
+// the last good connection, which skips the scan, unless a cached join has
+// failed since. Failed joins are retried after an exponential backoff with
+// jitter. wifiStep() only decides what to do; the sketch's wifiLoop() feeds
+// it the driver's events and carries out the action it returns.
+#define WIFI_CACHED_TIMEOUT_MS 3000
+#define WIFI_SCAN_TIMEOUT_MS 15000
+#define WIFI_BACKOFF_MIN_MS 1000
+#define WIFI_BACKOFF_MAX_MS 60000
+
+enum LinkState : uint8_t {
+  LINK_IDLE,
+  LINK_JOINING,
+  LINK_UP,
+  LINK_BACKOFF,
+  LINK_STATES
+};
+
+const char* const linkStateNames[LINK_STATES] = {"idle", "connecting", "connected", "backoff"};
+
+enum LinkEvent : uint8_t {
+  LINK_TICK,
+  LINK_GOT_IP,
+  LINK_LOST,       // disconnected, or lost the IP address
+};
+
+enum LinkAction : uint8_t {
+  LINK_NONE,
+  LINK_JOIN_CACHED,
+  LINK_JOIN_SCAN,
+  LINK_STOP,       // end the driver's attempt
+  LINK_SAVE,       // connected: cache this BSSID and channel
+};
+
+struct WifiLink {
+  uint8_t state;
+  bool cached;            // the current join uses the cached BSSID/channel
+  bool skipCache;         // a cached join failed; scan until one succeeds
+  uint8_t failures;       // consecutive failed joins
+  uint32_t since;         // millis() when the state was entered
+  uint32_t downSince;     // millis() when the link went down
+  uint32_t wait;          // ms to stay in LINK_BACKOFF
+  uint32_t connects;
+  uint32_t drops;
+  uint32_t failed;        // joins that failed or timed out
+  uint32_t lastConnectMs; // last successful join, from its start to the IP
+  uint32_t maxConnectMs;
+  uint32_t lastOutageMs;  // last time down, from the drop (or boot) to the IP
+};
+
+LinkAction wifiJoin(WifiLink &link, uint32_t now, bool haveCache) {
+  link.state = LINK_JOINING;
+  link.since = now;
+  link.cached = haveCache && !link.skipCache;
+  return link.cached ? LINK_JOIN_CACHED : LINK_JOIN_SCAN;
+}
+
+// Advances the link by one event at time now (LINK_TICK when nothing
+// happened). haveCache tells whether a BSSID/channel is cached, random
+// spreads the backoff. Returns what the caller has to do to the driver.
+LinkAction wifiStep(WifiLink &link, uint8_t event, uint32_t now, bool haveCache, uint32_t random) {
+  if (event == LINK_GOT_IP && link.state != LINK_UP) {
+    link.lastConnectMs = now - link.since;
+    link.maxConnectMs = link.lastConnectMs > link.maxConnectMs ? link.lastConnectMs : link.maxConnectMs;
+    link.lastOutageMs = now - link.downSince;
+    link.state = LINK_UP;
+    link.since = now;
+    link.failures = 0;
+    link.skipCache = false;
+    link.connects++;
+    return LINK_SAVE;
+  }
+  switch (link.state) {
+    case LINK_UP:
+      if (event != LINK_LOST) return LINK_NONE;
+      // Rejoin at once; the AP is most likely still where it was
+      link.drops++;
+      link.downSince = now;
+      return wifiJoin(link, now, haveCache);
+    case LINK_JOINING: {
+      uint32_t timeout = link.cached ? WIFI_CACHED_TIMEOUT_MS : WIFI_SCAN_TIMEOUT_MS;
+      if (event != LINK_LOST && now - link.since < timeout) return LINK_NONE;
+      link.failed++;
+      if (link.cached) {
+        // The AP may have changed channel or been replaced: scan right away
+        link.skipCache = true;
+        return wifiJoin(link, now, haveCache);
+      }
+      uint32_t wait = WIFI_BACKOFF_MAX_MS;
+      if (link.failures < 16) {
+        wait = (uint32_t)WIFI_BACKOFF_MIN_MS << link.failures;
+        wait = wait < WIFI_BACKOFF_MAX_MS ? wait : WIFI_BACKOFF_MAX_MS;
+      }
+      link.failures += link.failures < 0xFF;
+      link.wait = wait / 2 + random % (wait / 2 + 1);
+      link.state = LINK_BACKOFF;
+      link.since = now;
+      return LINK_STOP;
+    }
+    case LINK_BACKOFF:
+      if (now - link.since < link.wait) return LINK_NONE;
+      return wifiJoin(link, now, haveCache);
+    default:
+      return wifiJoin(link, now, haveCache);
+  }
+}
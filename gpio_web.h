@@ -0,0 +1,240 @@
+// Front end pieces the sketches share on top of gpio_core.h: the JSON reply
+// helpers, the /batch result and POST body handling, and the Wi-Fi glue that runs wifiStep() against
+// the driver. Each sketch keeps its own routes, setup() and loop(), and
+// defines ssid, password and the AsyncWebServer.
+//
+// Like gpio_core.h, this file defines rather than declares: include it from
+// exactly one translation unit.
+#pragma once
+
+#include <WiFi.h>
+#include <ESPAsyncWebServer.h>
+#include <esp_system.h>
+#include "gpio_core.h"
+
+extern const char* ssid;
+extern const char* password;
+
+// Replies. Fixed bodies are sent straight from flash with send_P, dynamic
+// ones are formatted into a stack buffer; handlers build no JSON documents
+// or Strings of their own.
+#define JSON_REPLY_MAX 192
+
+void sendJson(AsyncWebServerRequest *request, int code, PGM_P body) {
+  request->send_P(code, "application/json", body);
+}
+
+__attribute__((format(printf, 3, 4)))
+void sendJsonf(AsyncWebServerRequest *request, int code, const char* format, ...) {
+  char body[JSON_REPLY_MAX];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(body, sizeof(body), format, args);
+  va_end(args);
+  request->send(code, "application/json", body);
+}
+
+#define CLAIMED_REPLY "{\"error\":\"GPIO in use by edge capture or a counter\",\"status\":\"failure\"}"
+
+#define BUSY_REPLY "{\"error\":\"Busy: actuation queue full\",\"status\":\"failure\"}"
+#define BUSY_RETRY_AFTER "1" // s
+
+// Answers 503 for a write the full actuation ring dropped. Nothing was done,
+// so the client may send it again.
+void sendBusy(AsyncWebServerRequest *request) {
+  AsyncWebServerResponse *response = request->beginResponse_P(503, "application/json", BUSY_REPLY);
+  response->addHeader("Retry-After", BUSY_RETRY_AFTER);
+  request->send(response);
+}
+
+#define NO_CHANNEL_REPLY "{\"error\":\"No free PWM channel\",\"status\":\"failure\"}"
+
+// Answers a command that was not carried out: 503 busy for one the full ring
+// dropped, 503 for want of an LEDC channel, 409 for a pin claimed meanwhile.
+// Returns false, sending nothing, when it was carried out.
+bool refuseFailed(AsyncWebServerRequest *request, ActuationResult result) {
+  if (result == ACTUATED) {
+    return false;
+  }
+  if (result == ACTUATION_BUSY) {
+    sendBusy(request);
+  } else if (result == ACTUATION_CLAIMED) {
+    sendJson(request, 409, CLAIMED_REPLY);
+  } else {
+    sendJson(request, 503, NO_CHANNEL_REPLY);
+  }
+  return true;
+}
+
+// Answers 409 for a pin edge capture or a pulse counter holds as an input
+bool refuseClaimed(AsyncWebServerRequest *request, int gpio) {
+  if (!pinClaimed(gpio)) {
+    return false;
+  }
+  sendJson(request, 409, CLAIMED_REPLY);
+  return true;
+}
+
+void sendBatchResult(AsyncWebServerRequest *request, const BatchParser &p) {
+  bool complete = p.state == BATCH_DONE;
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->setCode(complete ? 200 : 400);
+  response->printf("{\"operations\":%u,\"applied\":%u,\"failed\":%u,\"errors\":[",
+                   p.operations, p.operations - p.failed, p.failed);
+  for (int i = 0; i < p.errorCount; i++) {
+    response->printf("%s{\"index\":%u,\"error\":\"%s\"}", i ? "," : "", p.errorIndex[i], batchErrorText(p.errorCode[i]));
+  }
+  if (!complete) {
+    response->printf("],\"error\":\"Malformed operations\",\"offset\":%u,\"status\":\"failure\"}", p.offset);
+  } else {
+    response->printf("],\"status\":\"%s\"}", p.failed ? "partial" : "success");
+  }
+  request->send(response);
+}
+
+// POST /batch. The body is only read as JSON: the library keeps a form body,
+// which is what curl -d sends without a Content-Type, from the body handler,
+// so such a request is answered 415 rather than applying nothing.
+bool batchJsonBody(AsyncWebServerRequest *request) {
+  return strncasecmp(request->contentType().c_str(), "application/json", 16) == 0;
+}
+
+// Body handler: applies the operations as the body streams in
+void batchPostBody(AsyncWebServerRequest *request, const uint8_t *data, size_t len, size_t index) {
+  if (index == 0 && batchJsonBody(request)) {
+    request->_tempObject = malloc(sizeof(BatchParser)); // freed with the request
+    if (request->_tempObject != NULL) {
+      batchBegin(*(BatchParser*)request->_tempObject);
+    }
+  }
+  if (request->_tempObject != NULL) {
+    batchFeed(*(BatchParser*)request->_tempObject, (const char*)data, len);
+  }
+}
+
+// Request handler, once the body is in
+void batchPostResult(AsyncWebServerRequest *request) {
+  BatchParser* parser = (BatchParser*)request->_tempObject;
+  if (parser != NULL) {
+    sendBatchResult(request, *parser);
+  } else if (request->contentLength() > 0 && !batchJsonBody(request)) {
+    sendJson(request, 415, "{\"error\":\"Content-Type must be application/json\",\"status\":\"failure\"}");
+  } else if (request->contentLength() > 0) {
+    sendJson(request, 503, "{\"error\":\"Out of memory\",\"status\":\"failure\"}");
+  } else {
+    sendJson(request, 400, "{\"error\":\"operations body missing\",\"status\":\"failure\"}");
+  }
+}
+
+// Wi-Fi link. setup() starts joining and goes on registering routes; loop()
+// drives wifiStep() (in gpio_core.h) with the events the driver posts and
+// carries out the joins it asks for.
+//
+// For a static address, which also skips DHCP on every join, define before
+// including this file:
+//   #define WIFI_STATIC_IP 192, 168, 1, 50
+//   #define WIFI_GATEWAY 192, 168, 1, 1
+//   #define WIFI_SUBNET 255, 255, 255, 0
+//   #define WIFI_DNS 192, 168, 1, 1
+#define WIFI_NAMESPACE "wifi"
+#define WIFI_CACHE_KEY "link"
+#define WIFI_JOIN_SHIFT 4 // join time in 16 ms steps, up to 32 s
+
+struct WifiCache {
+  uint32_t ssidHash;      // the cache is only used for the SSID it was made for
+  uint8_t bssid[6];
+  uint8_t channel;        // 0 when nothing is cached
+};
+
+WifiLink wifiLink = {};   // written by loop() only
+WifiCache wifiCache = {};
+bool wifiStatic = false;
+Histogram wifiJoinTime;   // written by loop() only
+uint8_t wifiPending = LINK_TICK; // latest driver event, taken by wifiLoop()
+
+uint32_t wifiHash(const char* text) {
+  uint32_t hash = 2166136261UL;
+  while (*text) {
+    hash = (hash ^ (uint8_t)*text++) * 16777619UL;
+  }
+  return hash;
+}
+
+// Runs on the driver's event task. Only the latest event is kept: it is
+// the current state of the link.
+void wifiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  uint8_t pending;
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    pending = LINK_GOT_IP;
+  } else if (event == ARDUINO_EVENT_WIFI_STA_LOST_IP ||
+             (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED &&
+              info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE)) { // not our own disconnect()
+    pending = LINK_LOST;
+  } else {
+    return;
+  }
+  __atomic_store_n(&wifiPending, pending, __ATOMIC_RELEASE);
+}
+
+// Stores the BSSID and channel of the current connection if they changed
+void wifiSave() {
+  WifiCache cache = {};
+  cache.ssidHash = wifiHash(ssid);
+  const uint8_t* bssid = WiFi.BSSID();
+  if (bssid == NULL) return;
+  memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  if (memcmp(&cache, &wifiCache, sizeof(cache)) == 0) return;
+  wifiCache = cache;
+  Preferences store;
+  store.begin(WIFI_NAMESPACE, false);
+  store.putBytes(WIFI_CACHE_KEY, &wifiCache, sizeof(wifiCache));
+  store.end();
+}
+
+// Called from loop()
+void wifiLoop() {
+  uint8_t event = __atomic_exchange_n(&wifiPending, LINK_TICK, __ATOMIC_ACQUIRE);
+  switch (wifiStep(wifiLink, event, millis(), wifiCache.channel != 0, esp_random())) {
+    case LINK_JOIN_CACHED:
+      WiFi.disconnect();
+      WiFi.begin(ssid, password, wifiCache.channel, wifiCache.bssid);
+      break;
+    case LINK_JOIN_SCAN:
+      WiFi.disconnect();
+      WiFi.begin(ssid, password);
+      break;
+    case LINK_STOP:
+      WiFi.disconnect();
+      break;
+    case LINK_SAVE:
+      histogramObserve(wifiJoinTime, wifiLink.lastConnectMs, WIFI_JOIN_SHIFT);
+      wifiSave();
+      Serial.print("Connected to WiFi in ");
+      Serial.print(wifiLink.lastConnectMs);
+      Serial.print(" ms: ");
+      Serial.println(WiFi.localIP());
+      break;
+    default:
+      break;
+  }
+}
+
+void wifiBegin() {
+  Preferences store;
+  store.begin(WIFI_NAMESPACE, false);
+  if (store.getBytes(WIFI_CACHE_KEY, &wifiCache, sizeof(wifiCache)) != sizeof(wifiCache) ||
+      wifiCache.ssidHash != wifiHash(ssid)) {
+    memset(&wifiCache, 0, sizeof(wifiCache));
+  }
+  store.end();
+
+  WiFi.persistent(false);       // the cache above replaces the driver's copy in flash
+  WiFi.setAutoReconnect(false); // wifiStep() decides when to rejoin
+  WiFi.mode(WIFI_STA);
+#ifdef WIFI_STATIC_IP
+  wifiStatic = WiFi.config(IPAddress(WIFI_STATIC_IP), IPAddress(WIFI_GATEWAY), IPAddress(WIFI_SUBNET), IPAddress(WIFI_DNS));
+#endif
+  WiFi.onEvent(wifiEvent);
+  wifiLoop(); // the first join starts here
+}
@@ -0,0 +1,187 @@
+// Host stand-in for the ESP32 Arduino core (2.x API): the calls gpio_core.h
+// and the sketches make, backed by the models in host/sim.cpp.
+#pragma once
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "soc/soc_caps.h"
+#include "esp_system.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+#define PGM_P const char*
+
+#define digitalPinToInterrupt(p) (p)
+
+typedef bool boolean;
+
+class String {
+public:
+  String(const char* s = "") : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  explicit String(int v) : s_(std::to_string(v)) {}
+  explicit String(unsigned v) : s_(std::to_string(v)) {}
+  explicit String(long v) : s_(std::to_string(v)) {}
+  explicit String(unsigned long v) : s_(std::to_string(v)) {}
+
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return s_.size(); }
+  long toInt() const { return strtol(s_.c_str(), NULL, 10); }
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator==(const char* o) const { return s_ == o; }
+  bool operator!=(const String &o) const { return s_ != o.s_; }
+  bool operator!=(const char* o) const { return s_ != o; }
+  bool startsWith(const char* prefix) const { return s_.compare(0, strlen(prefix), prefix) == 0; }
+  int indexOf(const char* text) const {
+    size_t at = s_.find(text);
+    return at == std::string::npos ? -1 : (int)at;
+  }
+  String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    return from < s_.size() && from < to ? String(s_.substr(from, to - from)) : String();
+  }
+  String &operator+=(const char* o) { s_ += o; return *this; }
+  String &operator+=(const String &o) { s_ += o.s_; return *this; }
+
+  std::string s_;
+};
+
+// IPv4 address, first octet in the low byte as on the chip
+class IPAddress {
+public:
+  IPAddress() : address_(0) {}
+  IPAddress(uint32_t address) : address_(address) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : address_(a | (uint32_t)b << 8 | (uint32_t)c << 16 | (uint32_t)d << 24) {}
+
+  operator uint32_t() const { return address_; }
+  uint8_t operator[](int index) const { return address_ >> (8 * index); }
+  bool operator==(const IPAddress &o) const { return address_ == o.address_; }
+  bool fromString(const char* text) {
+    unsigned a, b, c, d;
+    char tail;
+    if (sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+      return false;
+    }
+    *this = IPAddress(a, b, c, d);
+    return true;
+  }
+  String toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(text);
+  }
+
+private:
+  uint32_t address_;
+};
+
+// Formats into a virtual write(), like the core's Print
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(const uint8_t* data, size_t len) = 0;
+  size_t write(uint8_t c) { return write(&c, 1); }
+
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const String &s) { return print(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(long long v) { return printf("%lld", v); }
+  size_t print(unsigned long long v) { return printf("%llu", v); }
+  size_t print(double v) { return printf("%.2f", v); }
+  size_t print(const IPAddress &ip) { return print(ip.toString()); }
+  template <typename T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+  size_t println() { return print("\r\n"); }
+
+  __attribute__((format(printf, 2, 3)))
+  size_t printf(const char* format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (n < 0) return 0;
+    if ((size_t)n < sizeof(buf)) return write((const uint8_t*)buf, n);
+    std::string big(n + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&big[0], big.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)big.data(), n);
+  }
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  size_t write(const uint8_t* data, size_t len) override;
+  using Print::write;
+};
+extern HardwareSerial Serial;
+
+struct EspClass {
+  uint32_t getCycleCount();
+  uint32_t getFreeHeap();
+};
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+uint32_t getCpuFrequencyMhz();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+int8_t digitalPinToAnalogChannel(uint8_t pin);
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+// Hardware timers: a counter in divider / 80 us steps and a one-shot alarm
+struct hw_timer_s;
+typedef struct hw_timer_s hw_timer_t;
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp);
+void timerAttachInterrupt(hw_timer_t* timer, void (*handler)(void), bool edge);
+void timerWrite(hw_timer_t* timer, uint64_t value);
+void timerAlarmWrite(hw_timer_t* timer, uint64_t value, bool autoreload);
+void timerAlarmEnable(hw_timer_t* timer);
+void timerAlarmDisable(hw_timer_t* timer);
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolution);
+uint32_t ledcChangeFrequency(uint8_t channel, uint32_t freq, uint8_t resolution);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcDetachPin(uint8_t pin);
+void ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
@@ -0,0 +1,43 @@
+// Host stand-in for AsyncUDP. listen() binds a real socket when net.h's
+// simUdpPort is set; packets can always be injected with simUdpPacket().
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "Arduino.h"
+
+class AsyncUDP;
+
+class AsyncUDPPacket {
+public:
+  AsyncUDPPacket(AsyncUDP* udp, const uint8_t* data, size_t len, IPAddress remoteIp, uint16_t remotePort)
+      : udp_(udp), data_(data), len_(len), remoteIp_(remoteIp), remotePort_(remotePort) {}
+
+  uint8_t* data() { return (uint8_t*)data_; }
+  size_t length() { return len_; }
+  IPAddress remoteIP() { return remoteIp_; }
+  uint16_t remotePort() { return remotePort_; }
+  size_t write(const uint8_t* data, size_t len); // answers the sender
+
+private:
+  AsyncUDP* udp_;
+  const uint8_t* data_;
+  size_t len_;
+  IPAddress remoteIp_;
+  uint16_t remotePort_;
+};
+
+typedef std::function<void(AsyncUDPPacket &packet)> AuPacketHandlerFunction;
+
+class AsyncUDP {
+public:
+  ~AsyncUDP();
+  bool listen(uint16_t port);
+  void onPacket(AuPacketHandlerFunction callback) { handler_ = callback; }
+  void close();
+
+  // Host side
+  AuPacketHandlerFunction handler_;
+  int fd_ = -1;
+  std::vector<std::vector<uint8_t>>* replies_ = nullptr; // where write() goes for injected packets
+};
@@ -0,0 +1,289 @@
+// Host stand-in for ESPAsyncWebServer: the handler API the sketch uses, with
+// responses that produce their bytes the way the library's do (a stream
+// buffered up front, a chunked filler asked for up to one segment at a time
+// and asked again after RESPONSE_TRY_AGAIN on the next poll). Requests reach
+// the handlers through hostRequest() in net.h, or through the HTTP/1.1 front
+// end in host/net.cpp when simHttpPort is set. WebSocket clients are
+// in-process only (simConnect and friends below).
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Arduino.h"
+
+typedef enum {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+class AsyncWebServerRequest;
+
+typedef std::function<size_t(uint8_t* buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+typedef std::function<void(AsyncWebServerRequest* request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, const String &filename, size_t index, uint8_t* data,
+                           size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total)>
+    ArBodyHandlerFunction;
+
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String &name, const String &value) : name_(name), value_(value) {}
+  const String &name() const { return name_; }
+  const String &value() const { return value_; }
+
+private:
+  String name_;
+  String value_;
+};
+
+class AsyncWebHeader {
+public:
+  AsyncWebHeader(const String &name, const String &value) : name_(name), value_(value) {}
+  const String &name() const { return name_; }
+  const String &value() const { return value_; }
+
+private:
+  String name_;
+  String value_;
+};
+
+// A response produces its body in segments of at most maxLen bytes: the
+// number written, 0 once done, or RESPONSE_TRY_AGAIN for nothing yet
+class AsyncWebServerResponse {
+public:
+  AsyncWebServerResponse(int code, const String &contentType) : code_(code), contentType_(contentType) {}
+  virtual ~AsyncWebServerResponse() {}
+  void setCode(int code) { code_ = code; }
+  void addHeader(const String &name, const String &value) { headers_.emplace_back(name, value); }
+
+  virtual bool chunked() const { return false; }
+  virtual size_t length() const = 0;
+  virtual size_t produce(uint8_t* buffer, size_t maxLen) = 0;
+
+  int code_;
+  String contentType_;
+  std::vector<std::pair<String, String>> headers_;
+};
+
+class AsyncBasicResponse : public AsyncWebServerResponse {
+public:
+  AsyncBasicResponse(int code, const String &contentType, const uint8_t* data, size_t len, bool copy);
+  size_t length() const override { return len_; }
+  size_t produce(uint8_t* buffer, size_t maxLen) override;
+
+private:
+  std::string owned_;    // send(): the content is copied, as the library copies the String
+  const uint8_t* data_;  // send_P(): sent from flash as it is
+  size_t len_;
+  size_t pos_ = 0;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+public:
+  AsyncResponseStream(const String &contentType, size_t bufferSize);
+  size_t write(const uint8_t* data, size_t len) override;
+  using Print::write;
+  size_t length() const override { return buffer_.size(); }
+  size_t produce(uint8_t* buffer, size_t maxLen) override;
+
+private:
+  std::string buffer_;
+  size_t pos_ = 0;
+};
+
+class AsyncChunkedResponse : public AsyncWebServerResponse {
+public:
+  AsyncChunkedResponse(const String &contentType, AwsResponseFiller filler)
+      : AsyncWebServerResponse(200, contentType), filler_(filler) {}
+  bool chunked() const override { return true; }
+  size_t length() const override { return 0; }
+  size_t produce(uint8_t* buffer, size_t maxLen) override;
+
+private:
+  AwsResponseFiller filler_;
+  size_t index_ = 0;
+};
+
+class AsyncWebServerRequest {
+public:
+  AsyncWebServerRequest(WebRequestMethodComposite method, const String &url) : method_(method), url_(url) {}
+  ~AsyncWebServerRequest();
+
+  WebRequestMethodComposite method() const { return method_; }
+  const String &url() const { return url_; }
+  size_t contentLength() const { return contentLength_; }
+  const String &contentType() const { return contentType_; }
+
+  bool hasParam(const String &name, bool post = false, bool file = false) const;
+  AsyncWebParameter* getParam(const String &name, bool post = false, bool file = false) const;
+  bool hasHeader(const String &name) const { return getHeader(name) != nullptr; }
+  AsyncWebHeader* getHeader(const String &name) const;
+  String header(const char* name) const;
+
+  AsyncWebServerResponse* beginResponse(int code, const String &contentType = String(), const String &content = String());
+  AsyncWebServerResponse* beginResponse_P(int code, const String &contentType, const uint8_t* content, size_t len);
+  AsyncWebServerResponse* beginResponse_P(int code, const String &contentType, PGM_P content);
+  AsyncWebServerResponse* beginChunkedResponse(const String &contentType, AwsResponseFiller filler);
+  AsyncResponseStream* beginResponseStream(const String &contentType, size_t bufferSize = 1460);
+
+  void send(AsyncWebServerResponse* response);
+  void send(int code, const String &contentType = String(), const String &content = String()) {
+    send(beginResponse(code, contentType, content));
+  }
+  void send_P(int code, const String &contentType, const uint8_t* content, size_t len) {
+    send(beginResponse_P(code, contentType, content, len));
+  }
+  void send_P(int code, const String &contentType, PGM_P content) { send(beginResponse_P(code, contentType, content)); }
+
+  void* _tempObject = nullptr; // freed with the request, as in the library
+
+  // Host side
+  std::vector<AsyncWebParameter*> params_;
+  std::vector<AsyncWebHeader*> headers_;
+  size_t contentLength_ = 0;
+  String contentType_;
+  AsyncWebServerResponse* response_ = nullptr;
+
+private:
+  WebRequestMethodComposite method_;
+  String url_;
+};
+
+class AsyncWebHandler {
+public:
+  virtual ~AsyncWebHandler() {}
+  virtual bool canHandle(AsyncWebServerRequest* request) { (void)request; return false; }
+  virtual void handleRequest(AsyncWebServerRequest* request) { (void)request; }
+  virtual void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+    (void)request; (void)data; (void)len; (void)index; (void)total;
+  }
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+  AsyncCallbackWebHandler(const String &uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                          ArBodyHandlerFunction onBody)
+      : uri_(uri), method_(method), onRequest_(onRequest), onBody_(onBody) {}
+  bool canHandle(AsyncWebServerRequest* request) override;
+  void handleRequest(AsyncWebServerRequest* request) override {
+    if (onRequest_) onRequest_(request);
+  }
+  void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) override {
+    if (onBody_) onBody_(request, data, len, index, total);
+  }
+
+private:
+  String uri_;
+  WebRequestMethodComposite method_;
+  ArRequestHandlerFunction onRequest_;
+  ArBodyHandlerFunction onBody_;
+};
+
+// WebSocket
+
+typedef enum { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA } AwsEventType;
+typedef enum { WS_CONTINUATION, WS_TEXT, WS_BINARY, WS_DISCONNECT = 0x08, WS_PING, WS_PONG } AwsFrameType;
+
+typedef struct {
+  uint8_t message_opcode;
+  uint32_t num;
+  uint8_t final;
+  uint8_t masked;
+  uint8_t opcode;
+  uint64_t len;
+  uint8_t mask[4];
+  uint64_t index;
+} AwsFrameInfo;
+
+class AsyncWebSocket;
+
+class AsyncWebSocketClient {
+public:
+  AsyncWebSocketClient(AsyncWebSocket* server, uint32_t id) : server_(server), id_(id) {}
+  uint32_t id() const { return id_; }
+  bool queueIsFull() const { return queueFull_; }
+  bool canSend() const { return !queueFull_; }
+  void text(const char* message, size_t len);
+  void text(const char* message) { text(message, strlen(message)); }
+  void text(const String &message) { text(message.c_str(), message.length()); }
+  void close(uint16_t code = 0, const char* message = NULL);
+
+  // Host side: what the client was sent, and a send queue that can be
+  // made to look full. Frames may come from the loop task and from
+  // replies on async_tcp at once; read received_ once both have stopped.
+  std::vector<std::string> received_;
+  std::mutex sendLock_;
+  bool queueFull_ = false;
+  std::atomic<bool> closed_{false};
+  uint16_t closeCode_ = 0;
+
+private:
+  AsyncWebSocket* server_;
+  uint32_t id_;
+};
+
+typedef std::function<void(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg,
+                           uint8_t* data, size_t len)> AwsEventHandler;
+
+class AsyncWebSocket : public AsyncWebHandler {
+public:
+  explicit AsyncWebSocket(const String &url) : url_(url) {}
+  ~AsyncWebSocket();
+  void onEvent(AwsEventHandler handler) { handler_ = handler; }
+  AsyncWebSocketClient* client(uint32_t id);
+  size_t count() const;
+  void textAll(const char* message, size_t len);
+  void textAll(const char* message) { textAll(message, strlen(message)); }
+  void cleanupClients(uint16_t maxClients = 8);
+
+  // Host side: in-process clients. The events reach the handler on the
+  // calling thread, which stands in for async_tcp. A disconnected client is
+  // kept until the server is destroyed, so a pointer another thread looked
+  // up just before stays valid.
+  AsyncWebSocketClient* simConnect();
+  void simMessage(AsyncWebSocketClient* client, const char* text);
+  void simDisconnect(AsyncWebSocketClient* client);
+
+private:
+  String url_;
+  AwsEventHandler handler_;
+  std::vector<AsyncWebSocketClient*> clients_;
+  std::vector<AsyncWebSocketClient*> retired_;
+  mutable std::recursive_mutex lock_;
+  uint32_t nextId_ = 1;
+};
+
+class AsyncWebServer {
+public:
+  explicit AsyncWebServer(uint16_t port);
+  ~AsyncWebServer();
+
+  AsyncCallbackWebHandler &on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
+  AsyncCallbackWebHandler &on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                              ArUploadHandlerFunction onUpload);
+  AsyncCallbackWebHandler &on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                              ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody);
+  AsyncWebHandler &addHandler(AsyncWebHandler* handler);
+  void onNotFound(ArRequestHandlerFunction onNotFound) { notFound_ = onNotFound; }
+  void begin();
+
+  // Host side
+  AsyncWebHandler* find(AsyncWebServerRequest* request);
+  std::vector<AsyncWebHandler*> handlers_;
+  std::vector<AsyncCallbackWebHandler*> owned_;
+  ArRequestHandlerFunction notFound_;
+  uint16_t port_;
+};
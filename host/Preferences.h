@@ -0,0 +1,24 @@
+// Host stand-in for the core's Preferences, over the in-process NVS of
+// host/sim.cpp. Every put or remove is one commit, as on the chip.
+#pragma once
+
+#include "Arduino.h"
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false, const char* partition = NULL);
+  void end();
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+  size_t putBytes(const char* key, const void* value, size_t len);
+  size_t getBytesLength(const char* key);
+  size_t getBytes(const char* key, void* buf, size_t maxLen);
+  size_t putUInt(const char* key, uint32_t value);
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+
+private:
+  std::string name_;
+  bool open_ = false;
+  bool readOnly_ = false;
+};
@@ -0,0 +1,35 @@
+// Host stand-in for the core's Ticker, which is a thin wrapper over esp_timer
+#pragma once
+
+#include <stdint.h>
+#include "esp_timer.h"
+
+class Ticker {
+public:
+  typedef void (*callback_t)();
+  ~Ticker() { detach(); }
+
+  void attach_ms(uint32_t ms, callback_t callback) { start(ms, true, callback); }
+  void once_ms(uint32_t ms, callback_t callback) { start(ms, false, callback); }
+  void detach() {
+    if (timer_) {
+      esp_timer_stop(timer_);
+      esp_timer_delete(timer_);
+      timer_ = nullptr;
+    }
+  }
+  bool active() const { return timer_ != nullptr && esp_timer_is_active(timer_); }
+
+private:
+  static void run(void* arg) { ((callback_t)arg)(); }
+  void start(uint32_t ms, bool repeat, callback_t callback) {
+    detach();
+    esp_timer_create_args_t args = {};
+    args.callback = run;
+    args.arg = (void*)callback;
+    args.name = "Ticker";
+    esp_timer_create(&args, &timer_);
+    repeat ? esp_timer_start_periodic(timer_, ms * 1000ULL) : esp_timer_start_once(timer_, ms * 1000ULL);
+  }
+  esp_timer_handle_t timer_ = nullptr;
+};
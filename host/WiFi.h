@@ -0,0 +1,72 @@
+// Host stand-in for the core's WiFi station: begin() joins after a simulated
+// delay (see SimWifi in net.h) and the driver events arrive on the esp_timer
+// thread, as they arrive on the event task on the chip
+#pragma once
+
+#include <functional>
+#include "Arduino.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3,
+} wifi_mode_t;
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_START = 2,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP = 9,
+  ARDUINO_EVENT_MAX = 40,
+} arduino_event_id_t;
+
+#define WIFI_REASON_ASSOC_LEAVE 8
+#define WIFI_REASON_BEACON_TIMEOUT 200
+
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef union {
+  wifi_event_sta_disconnected_t wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+typedef arduino_event_info_t WiFiEventInfo_t;
+typedef std::function<void(arduino_event_id_t event, arduino_event_info_t info)> WiFiEventFuncCb;
+typedef size_t wifi_event_id_t;
+
+class WiFiClass {
+public:
+  wl_status_t begin(const char* ssid, const char* passphrase = NULL, int32_t channel = 0, const uint8_t* bssid = NULL,
+                    bool connect = true);
+  bool disconnect(bool wifioff = false, bool eraseap = false);
+  bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress(),
+              IPAddress dns2 = IPAddress());
+  bool mode(wifi_mode_t mode) { (void)mode; return true; }
+  void persistent(bool persistent) { (void)persistent; }
+  bool setAutoReconnect(bool autoReconnect) { (void)autoReconnect; return true; }
+  wifi_event_id_t onEvent(WiFiEventFuncCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+
+  wl_status_t status();
+  IPAddress localIP();
+  uint8_t* BSSID();
+  int32_t channel();
+  int8_t RSSI();
+  String SSID();
+};
+extern WiFiClass WiFi;
@@ -0,0 +1,45 @@
+// Counts heap allocations for simAllocations(), by wrapping glibc's malloc
+// family (operator new goes through malloc). Linked into the benchmarks and
+// the tests that count allocations; leave it out of sanitizer builds, which
+// bring their own allocator.
+
+#include "sim.h"
+
+#include <atomic>
+#include <stdlib.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static std::atomic<uint64_t> allocations(0);
+
+uint64_t simAllocations() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+  __libc_free(ptr);
+}
+
+}
@@ -0,0 +1,134 @@
+// gpio_bench: per-endpoint cost of the HTTP API of
+// html_GPIO_control_dashboard.cpp on the host build. Runs setup() and
+// loop() as gpio_host does, then sends each endpoint a run of requests
+// in-process through hostRequest() and reports requests per second,
+// heap allocations per request made by the handler (from the call into it
+// to its send()) and latency percentiles of the whole request.
+//
+//   cmake -S . -B build && cmake --build build --target gpio_bench
+//   ./build/gpio_bench [-n requests per endpoint] [-f endpoint substring] [--csv]
+//
+// Host figures: they rank endpoints and show what a change does to one, the
+// device is slower in absolute terms. Allocation counts are exact, as the
+// handler code is the same.
+
+#include "net.h"
+#include "sim.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+void setup();
+void loop();
+
+struct Endpoint {
+  const char* name;
+  const char* method;
+  std::vector<std::string> urls; // sent in turn
+  std::string body;
+};
+
+static std::string batchBody(int ops) {
+  std::string body = "[";
+  for (int i = 0; i < ops; i++) {
+    char op[48];
+    snprintf(op, sizeof(op), "%s{\"gpio\":%d,\"state\":\"%s\"}", i ? "," : "", i % 2 ? 4 : 5, i % 4 < 2 ? "high" : "low");
+    body += op;
+  }
+  return body + "]";
+}
+
+int main(int argc, char** argv) {
+  int requests = 2000;
+  const char* filter = "";
+  bool csv = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue) {
+      requests = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-f" && hasValue) {
+      filter = argv[++i];
+    } else if (arg == "--csv") {
+      csv = true;
+    } else {
+      fprintf(stderr, "usage: gpio_bench [-n requests per endpoint] [-f endpoint substring] [--csv]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  setup();
+  std::thread([] {
+    for (;;) loop();
+  }).detach();
+
+  std::vector<Endpoint> endpoints = {
+    {"GET /", "GET", {"/"}, ""},
+    {"GET / (cached)", "GET", {"/"}, ""},
+    {"GET /setgpio digital", "GET", {"/setgpio?gpio=4&state=high", "/setgpio?gpio=4&state=low"}, ""},
+    {"GET /setgpio pwm", "GET", {"/setgpio?gpio=18&state=pwm10", "/setgpio?gpio=18&state=pwm200"}, ""},
+    {"GET /readgpio", "GET", {"/readgpio?gpio=4"}, ""},
+    {"GET /readall", "GET", {"/readall"}, ""},
+    {"GET /batch", "GET", {"/batch?operations=[{\"gpio\":4,\"state\":\"high\"},{\"gpio\":5,\"state\":\"low\"}]"}, ""},
+    {"POST /batch 2 ops", "POST", {"/batch"}, batchBody(2)},
+    {"POST /batch 200 ops", "POST", {"/batch"}, batchBody(200)},
+    {"GET /schedules", "GET", {"/schedules"}, ""},
+    {"GET /pins", "GET", {"/pins"}, ""},
+    {"GET /ledc", "GET", {"/ledc"}, ""},
+    {"GET /queue", "GET", {"/queue"}, ""},
+    {"GET /status", "GET", {"/status"}, ""},
+    {"GET /metrics", "GET", {"/metrics"}, ""},
+  };
+  // The dashboard's ETag, for the conditional request
+  std::string etag = hostHeader(hostRequest("GET", "/"), "ETag");
+
+  if (csv) {
+    printf("endpoint,requests,ops_per_sec,allocs_per_op,p50_us,p99_us,p999_us,bytes\n");
+  } else {
+    printf("%-22s %8s %10s %10s %9s %9s %9s %8s\n", "endpoint", "requests", "ops/s", "allocs/op", "p50 us", "p99 us",
+           "p99.9 us", "bytes");
+  }
+  for (const Endpoint &endpoint : endpoints) {
+    if (!strstr(endpoint.name, filter)) continue;
+    std::vector<std::pair<std::string, std::string>> headers;
+    if (strstr(endpoint.name, "cached")) {
+      headers.emplace_back("If-None-Match", etag);
+    }
+    for (int i = 0; i < requests / 10 + 1; i++) { // warm up
+      hostRequest(endpoint.method, endpoint.urls[i % endpoint.urls.size()].c_str(), endpoint.body, headers);
+    }
+    std::vector<double> latency;
+    latency.reserve(requests);
+    uint64_t allocations = 0;
+    size_t bytes = 0;
+    int failures = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < requests; i++) {
+      auto t0 = std::chrono::steady_clock::now();
+      HostResponse response =
+          hostRequest(endpoint.method, endpoint.urls[i % endpoint.urls.size()].c_str(), endpoint.body, headers);
+      latency.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+      allocations += response.allocations;
+      bytes = response.body.size();
+      failures += response.code != 200 && response.code != 304;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::sort(latency.begin(), latency.end());
+    auto percentile = [&](double p) { return latency[std::min(latency.size() - 1, (size_t)(p * latency.size()))]; };
+    if (csv) {
+      printf("%s,%d,%.0f,%.2f,%.1f,%.1f,%.1f,%zu\n", endpoint.name, requests, requests / seconds,
+             (double)allocations / requests, percentile(0.5), percentile(0.99), percentile(0.999), bytes);
+    } else {
+      printf("%-22s %8d %10.0f %10.2f %9.1f %9.1f %9.1f %8zu%s\n", endpoint.name, requests, requests / seconds,
+             (double)allocations / requests, percentile(0.5), percentile(0.99), percentile(0.999), bytes,
+             failures ? "  (errors)" : "");
+    }
+  }
+  return 0;
+}
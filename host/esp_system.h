@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+
+typedef void (*shutdown_handler_t)(void);
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+void esp_restart(); // runs the shutdown handlers; the host process keeps going
+uint32_t esp_random();
+uint32_t esp_get_free_heap_size();
@@ -0,0 +1,2 @@
+// Nothing of the driver API is called directly; WiFi.h covers the sketch
+#pragma once
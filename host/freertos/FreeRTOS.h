@@ -0,0 +1,39 @@
+// Host stand-in for the FreeRTOS kernel as the ESP32 Arduino core ships it:
+// tasks are std::threads, critical sections are recursive mutexes and a tick
+// is 1 ms. See sim.h for how time behaves.
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffu
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define configMAX_PRIORITIES 25
+#define portNUM_PROCESSORS 2
+#define PRO_CPU_NUM 0
+#define APP_CPU_NUM 1
+#define ARDUINO_RUNNING_CORE 1
+#define tskNO_AFFINITY 0x7fffffff
+
+// A spinlock on the chip; here one recursive mutex per lock. Like the
+// spinlock it is held across nested sections on the same task.
+struct portMUX_TYPE {
+  std::recursive_mutex lock;
+};
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+inline void portENTER_CRITICAL(portMUX_TYPE* mux) { mux->lock.lock(); }
+inline void portEXIT_CRITICAL(portMUX_TYPE* mux) { mux->lock.unlock(); }
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE* mux) { mux->lock.lock(); }
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE* mux) { mux->lock.unlock(); }
+#define portYIELD_FROM_ISR(...) ((void)0)
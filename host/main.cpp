@@ -0,0 +1,46 @@
+// gpio_host: html_GPIO_control_dashboard.cpp running on the host against the
+// simulated hardware in host/, with the HTTP API and the dashboard on a real
+// port and the UDP listener on another. Runs setup() once, then loop() for
+// ever, as the Arduino core does. dynamic_host and resuming_host are the
+// same runner linked with the other two sketches.
+//
+//   cmake -S . -B build && cmake --build build --target gpio_host
+//   ./build/gpio_host [-p http port, 0 for a free one] [-u udp port, 0 for none]
+//   curl 'http://localhost:8080/setgpio?gpio=2&state=high'
+
+#include "net.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setup();
+void loop();
+
+int main(int argc, char** argv) {
+  simHttpPort = 8080;
+  simUdpPort = 4210;
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "-p") == 0 && hasValue) {
+      simHttpPort = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-u") == 0 && hasValue) {
+      simUdpPort = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: gpio_host [-p http port, 0 for a free one] [-u udp port, 0 for none]\n");
+      return 2;
+    }
+  }
+  if (simHttpPort < 0) {
+    fprintf(stderr, "gpio_host: the HTTP port must be 0 or more\n");
+    return 2;
+  }
+  if (simHttpPort == 0) simHttpPort = SIM_PORT_ANY; // the port bound is printed below
+  setup();
+  printf("gpio_host: http://localhost:%d/\n", simHttpPort);
+  fflush(stdout);
+  for (;;) {
+    loop();
+  }
+}
@@ -0,0 +1,756 @@
+// Network stand-ins behind WiFi.h, AsyncUDP.h and ESPAsyncWebServer.h: the
+// in-process request path of hostRequest(), a small HTTP/1.1 front end on a
+// real socket for gpio_host, in-process WebSocket clients, AsyncUDP over a
+// real socket or injected packets, and a Wi-Fi station that joins after a
+// delay. See net.h.
+
+#include "net.h"
+#include "sim.h"
+
+#include <AsyncUDP.h>
+#include <ESPAsyncWebServer.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+int simHttpPort = 0;
+int simUdpPort = 0;
+
+static int64_t wallNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Responses
+
+AsyncBasicResponse::AsyncBasicResponse(int code, const String &contentType, const uint8_t* data, size_t len, bool copy)
+    : AsyncWebServerResponse(code, contentType), data_(data), len_(len) {
+  if (copy) {
+    owned_.assign((const char*)data, len);
+    data_ = (const uint8_t*)owned_.data();
+  }
+}
+
+size_t AsyncBasicResponse::produce(uint8_t* buffer, size_t maxLen) {
+  size_t n = len_ - pos_ < maxLen ? len_ - pos_ : maxLen;
+  memcpy(buffer, data_ + pos_, n);
+  pos_ += n;
+  return n;
+}
+
+AsyncResponseStream::AsyncResponseStream(const String &contentType, size_t bufferSize)
+    : AsyncWebServerResponse(200, contentType) {
+  buffer_.reserve(bufferSize);
+}
+
+size_t AsyncResponseStream::write(const uint8_t* data, size_t len) {
+  buffer_.append((const char*)data, len);
+  return len;
+}
+
+size_t AsyncResponseStream::produce(uint8_t* buffer, size_t maxLen) {
+  size_t n = buffer_.size() - pos_ < maxLen ? buffer_.size() - pos_ : maxLen;
+  memcpy(buffer, buffer_.data() + pos_, n);
+  pos_ += n;
+  return n;
+}
+
+size_t AsyncChunkedResponse::produce(uint8_t* buffer, size_t maxLen) {
+  size_t n = filler_(buffer, maxLen, index_);
+  if (n != RESPONSE_TRY_AGAIN) {
+    index_ += n;
+  }
+  return n;
+}
+
+// Requests
+
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+  for (AsyncWebParameter* param : params_) delete param;
+  for (AsyncWebHeader* header : headers_) delete header;
+  delete response_;
+  if (_tempObject != nullptr) {
+    free(_tempObject);
+  }
+}
+
+bool AsyncWebServerRequest::hasParam(const String &name, bool post, bool file) const {
+  return getParam(name, post, file) != nullptr;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(const String &name, bool post, bool file) const {
+  if (post || file) return nullptr; // only query parameters reach the sketch
+  for (AsyncWebParameter* param : params_) {
+    if (param->name() == name) return param;
+  }
+  return nullptr;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const String &name) const {
+  for (AsyncWebHeader* header : headers_) {
+    if (strcasecmp(header->name().c_str(), name.c_str()) == 0) return header;
+  }
+  return nullptr;
+}
+
+String AsyncWebServerRequest::header(const char* name) const {
+  AsyncWebHeader* found = getHeader(name);
+  return found ? found->value() : String();
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String &contentType, const String &content) {
+  return new AsyncBasicResponse(code, contentType, (const uint8_t*)content.c_str(), content.length(), true);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int code, const String &contentType,
+                                                               const uint8_t* content, size_t len) {
+  return new AsyncBasicResponse(code, contentType, content, len, false);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int code, const String &contentType, PGM_P content) {
+  return new AsyncBasicResponse(code, contentType, (const uint8_t*)content, strlen(content), false);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginChunkedResponse(const String &contentType, AwsResponseFiller filler) {
+  return new AsyncChunkedResponse(contentType, filler);
+}
+
+AsyncResponseStream* AsyncWebServerRequest::beginResponseStream(const String &contentType, size_t bufferSize) {
+  return new AsyncResponseStream(contentType, bufferSize);
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse* response) {
+  delete response_; // the library also keeps only the last one
+  response_ = response;
+}
+
+// As in the library: the exact path, or a path below it
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest* request) {
+  if (!(method_ & request->method())) return false;
+  const std::string &uri = uri_.s_;
+  const std::string &url = request->url().s_;
+  return url == uri || (url.size() > uri.size() && url.compare(0, uri.size(), uri) == 0 && url[uri.size()] == '/' &&
+                        uri != "/");
+}
+
+// Server
+
+static AsyncWebServer* webServer = nullptr;
+static std::mutex serverLock; // one request at a time, as on the single async_tcp task
+static void frontEnd(void* arg);
+
+AsyncWebServer::AsyncWebServer(uint16_t port) : port_(port) {
+  webServer = this;
+}
+
+AsyncWebServer::~AsyncWebServer() {
+  webServer = nullptr;
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char* uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest) {
+  return on(uri, method, onRequest, nullptr, nullptr);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char* uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload) {
+  return on(uri, method, onRequest, onUpload, nullptr);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char* uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload,
+                                            ArBodyHandlerFunction onBody) {
+  (void)onUpload;
+  AsyncCallbackWebHandler* handler = new AsyncCallbackWebHandler(uri, method, onRequest, onBody);
+  owned_.push_back(handler);
+  handlers_.push_back(handler);
+  return *handler;
+}
+
+AsyncWebHandler &AsyncWebServer::addHandler(AsyncWebHandler* handler) {
+  handlers_.push_back(handler);
+  return *handler;
+}
+
+AsyncWebHandler* AsyncWebServer::find(AsyncWebServerRequest* request) {
+  for (AsyncWebHandler* handler : handlers_) {
+    if (handler->canHandle(request)) return handler;
+  }
+  return nullptr;
+}
+
+void AsyncWebServer::begin() {
+  if (simHttpPort == 0) return;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(simHttpPort == SIM_PORT_ANY ? 0 : simHttpPort);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  socklen_t addrLen = sizeof(addr);
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0 ||
+      getsockname(fd, (sockaddr*)&addr, &addrLen) != 0) {
+    fprintf(stderr, "gpio_host: cannot listen on port %d\n", simHttpPort);
+    exit(1);
+  }
+  simHttpPort = ntohs(addr.sin_port);
+  xTaskCreatePinnedToCore(frontEnd, "async_tcp", 8192, (void*)(intptr_t)fd, 3, NULL, tskNO_AFFINITY);
+}
+
+static int hexDigit(char c) {
+  return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+}
+
+static std::string urlDecode(const std::string &text) {
+  std::string out;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '+') {
+      out += ' ';
+    } else if (text[i] == '%' && i + 2 < text.size() && hexDigit(text[i + 1]) >= 0 && hexDigit(text[i + 2]) >= 0) {
+      out += (char)(hexDigit(text[i + 1]) * 16 + hexDigit(text[i + 2]));
+      i += 2;
+    } else {
+      out += text[i];
+    }
+  }
+  return out;
+}
+
+static WebRequestMethodComposite methodCode(const char* method) {
+  static const char* const names[] = {"GET", "POST", "DELETE", "PUT", "PATCH", "HEAD", "OPTIONS"};
+  for (int i = 0; i < 7; i++) {
+    if (strcmp(method, names[i]) == 0) return 1 << i;
+  }
+  return 0;
+}
+
+static AsyncWebServerRequest* buildRequest(const char* method, const std::string &target,
+                                           const std::vector<std::pair<std::string, std::string>> &headers,
+                                           size_t contentLength) {
+  size_t query = target.find('?');
+  AsyncWebServerRequest* request =
+      new AsyncWebServerRequest(methodCode(method), String(urlDecode(target.substr(0, query))));
+  if (query != std::string::npos) {
+    size_t pos = query + 1;
+    while (pos <= target.size()) {
+      size_t end = target.find('&', pos);
+      end = end == std::string::npos ? target.size() : end;
+      std::string pair = target.substr(pos, end - pos);
+      if (!pair.empty()) {
+        size_t eq = pair.find('=');
+        std::string name = urlDecode(pair.substr(0, eq));
+        std::string value = eq == std::string::npos ? "" : urlDecode(pair.substr(eq + 1));
+        request->params_.push_back(new AsyncWebParameter(String(name), String(value)));
+      }
+      pos = end + 1;
+    }
+  }
+  for (const auto &header : headers) {
+    request->headers_.push_back(new AsyncWebHeader(String(header.first), String(header.second)));
+    if (strcasecmp(header.first.c_str(), "Content-Type") == 0) {
+      request->contentType_ = String(header.second);
+    }
+  }
+  request->contentLength_ = contentLength;
+  return request;
+}
+
+// Runs the handler for a request, its body first, as the library does. Like
+// the library, it keeps form bodies from the body handler: it would parse
+// them into POST parameters, which no route here reads.
+static void dispatch(AsyncWebServerRequest* request, const std::string &body) {
+  AsyncWebHandler* handler = webServer ? webServer->find(request) : nullptr;
+  if (handler == nullptr) {
+    if (webServer && webServer->notFound_) {
+      webServer->notFound_(request);
+    } else {
+      request->send(404);
+    }
+    return;
+  }
+  bool form = request->contentType().startsWith("application/x-www-form-urlencoded") ||
+              request->contentType().startsWith("multipart/form-data");
+  for (size_t index = 0; !form && index < body.size(); index += SIM_TCP_SEGMENT) {
+    size_t len = body.size() - index < SIM_TCP_SEGMENT ? body.size() - index : SIM_TCP_SEGMENT;
+    handler->handleBody(request, (uint8_t*)body.data() + index, len, index, body.size());
+  }
+  handler->handleRequest(request);
+}
+
+HostResponse hostRequest(const char* method, const char* url, const std::string &body,
+                         const std::vector<std::pair<std::string, std::string>> &headers) {
+  HostResponse result = {};
+  std::lock_guard<std::mutex> lock(serverLock);
+  AsyncWebServerRequest* request = buildRequest(method, url, headers, body.size());
+  int64_t start = wallNs();
+  uint64_t allocationsBefore = simAllocations();
+  dispatch(request, body);
+  result.allocations = simAllocations() - allocationsBefore;
+
+  AsyncWebServerResponse* response = request->response_;
+  if (response == nullptr) {
+    result.code = 0; // never answered
+    delete request;
+    return result;
+  }
+  result.code = response->code_;
+  result.type = response->contentType_.s_;
+  result.chunked = response->chunked();
+  for (const auto &header : response->headers_) {
+    result.headers.emplace_back(header.first.s_, header.second.s_);
+  }
+  uint8_t segment[SIM_TCP_SEGMENT];
+  for (;;) {
+    size_t n = response->produce(segment, sizeof(segment));
+    if (n == RESPONSE_TRY_AGAIN) {
+      result.tryAgains++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(SIM_TCP_POLL_MS));
+      continue;
+    }
+    if (n == 0) break;
+    if (result.body.empty()) {
+      result.firstByteNs = wallNs() - start;
+    }
+    result.body.append((const char*)segment, n);
+  }
+  delete request;
+  return result;
+}
+
+std::string hostHeader(const HostResponse &response, const char* name) {
+  for (const auto &header : response.headers) {
+    if (strcasecmp(header.first.c_str(), name) == 0) return header.second;
+  }
+  return std::string();
+}
+
+// HTTP/1.1 front end: one thread, like async_tcp, one request per
+// connection. A response that answers RESPONSE_TRY_AGAIN is asked again
+// on the next poll, SIM_TCP_POLL_MS later.
+
+struct Connection {
+  int fd;
+  std::string in;
+  AsyncWebServerRequest* request;
+  int64_t retryAt;   // wallNs(), while a chunked response has nothing yet
+};
+
+static const char* reason(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 409: return "Conflict";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    case 507: return "Insufficient Storage";
+    default: return "Status";
+  }
+}
+
+static bool sendAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+// Parses a complete request out of in. Returns false while more is needed.
+static bool parseRequest(Connection &conn) {
+  size_t headerEnd = conn.in.find("\r\n\r\n");
+  if (headerEnd == std::string::npos) return false;
+  std::vector<std::pair<std::string, std::string>> headers;
+  size_t lineEnd = conn.in.find("\r\n");
+  std::string requestLine = conn.in.substr(0, lineEnd);
+  size_t contentLength = 0;
+  for (size_t pos = lineEnd + 2; pos < headerEnd;) {
+    size_t end = conn.in.find("\r\n", pos);
+    std::string line = conn.in.substr(pos, end - pos);
+    size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+      std::string name = line.substr(0, colon);
+      size_t valueStart = line.find_first_not_of(' ', colon + 1);
+      std::string value = valueStart == std::string::npos ? "" : line.substr(valueStart);
+      if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+        contentLength = strtoul(value.c_str(), NULL, 10);
+      }
+      headers.emplace_back(name, value);
+    }
+    pos = end + 2;
+  }
+  if (conn.in.size() < headerEnd + 4 + contentLength) return false;
+
+  char method[16] = "";
+  char target[4096] = "";
+  sscanf(requestLine.c_str(), "%15s %4095s", method, target);
+  conn.request = buildRequest(method, target, headers, contentLength);
+  std::lock_guard<std::mutex> lock(serverLock);
+  dispatch(conn.request, conn.in.substr(headerEnd + 4, contentLength));
+  return true;
+}
+
+// Sends the response head, then as much of the body as is ready. Returns
+// true once the connection is done with.
+static bool pump(Connection &conn, bool first) {
+  AsyncWebServerResponse* response = conn.request->response_;
+  if (response == nullptr) {
+    const char* reply = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    sendAll(conn.fd, reply, strlen(reply));
+    return true;
+  }
+  if (first) {
+    std::string head = "HTTP/1.1 " + std::to_string(response->code_) + " " + reason(response->code_) + "\r\n";
+    if (response->contentType_.length()) {
+      head += "Content-Type: " + response->contentType_.s_ + "\r\n";
+    }
+    for (const auto &header : response->headers_) {
+      head += header.first.s_ + ": " + header.second.s_ + "\r\n";
+    }
+    head += response->chunked() ? std::string("Transfer-Encoding: chunked\r\n")
+                                : "Content-Length: " + std::to_string(response->length()) + "\r\n";
+    head += "Connection: close\r\n\r\n";
+    if (!sendAll(conn.fd, head.data(), head.size())) return true;
+  }
+  uint8_t segment[SIM_TCP_SEGMENT];
+  std::lock_guard<std::mutex> lock(serverLock);
+  for (;;) {
+    size_t n = response->produce(segment, sizeof(segment));
+    if (n == RESPONSE_TRY_AGAIN) {
+      conn.retryAt = wallNs() + SIM_TCP_POLL_MS * 1000000LL;
+      return false;
+    }
+    if (response->chunked()) {
+      char size[16];
+      int len = snprintf(size, sizeof(size), "%zx\r\n", n);
+      if (!sendAll(conn.fd, size, len) || !sendAll(conn.fd, (const char*)segment, n) || !sendAll(conn.fd, "\r\n", 2)) {
+        return true;
+      }
+    } else if (n > 0 && !sendAll(conn.fd, (const char*)segment, n)) {
+      return true;
+    }
+    if (n == 0) return true;
+  }
+}
+
+static void frontEnd(void* arg) {
+  int listenFd = (int)(intptr_t)arg;
+  std::vector<Connection> connections;
+  for (;;) {
+    std::vector<pollfd> fds;
+    fds.push_back({listenFd, POLLIN, 0});
+    int timeout = SIM_TCP_POLL_MS;
+    for (const Connection &conn : connections) {
+      fds.push_back({conn.fd, (short)(conn.request ? 0 : POLLIN), 0});
+      if (conn.request) {
+        int64_t wait = (conn.retryAt - wallNs()) / 1000000;
+        timeout = wait < 0 ? 0 : wait < timeout ? (int)wait : timeout;
+      }
+    }
+    poll(fds.data(), fds.size(), timeout);
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(listenFd, NULL, NULL);
+      if (fd >= 0) {
+        connections.push_back({fd, std::string(), nullptr, 0});
+      }
+    }
+    for (size_t i = 0; i < connections.size(); i++) {
+      Connection &conn = connections[i];
+      bool done = false;
+      if (conn.request == nullptr && i + 1 < fds.size() && (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+        char buffer[4096];
+        ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+          done = true;
+        } else {
+          conn.in.append(buffer, n);
+          if (parseRequest(conn)) {
+            done = pump(conn, true);
+          }
+        }
+      } else if (conn.request && wallNs() >= conn.retryAt) {
+        done = pump(conn, false);
+      }
+      if (done) {
+        close(conn.fd);
+        {
+          std::lock_guard<std::mutex> lock(serverLock);
+          delete conn.request;
+        }
+        connections.erase(connections.begin() + i);
+        i--;
+      }
+    }
+  }
+}
+
+// WebSocket
+
+void AsyncWebSocketClient::text(const char* message, size_t len) {
+  std::lock_guard<std::mutex> lock(sendLock_);
+  received_.emplace_back(message, len);
+}
+
+void AsyncWebSocketClient::close(uint16_t code, const char* message) {
+  (void)message;
+  closed_ = true;
+  closeCode_ = code;
+}
+
+AsyncWebSocket::~AsyncWebSocket() {
+  for (AsyncWebSocketClient* client : clients_) delete client;
+  for (AsyncWebSocketClient* client : retired_) delete client;
+}
+
+AsyncWebSocketClient* AsyncWebSocket::client(uint32_t id) {
+  std::lock_guard<std::recursive_mutex> lock(lock_);
+  for (AsyncWebSocketClient* client : clients_) {
+    if (client->id() == id && !client->closed_) return client;
+  }
+  return nullptr;
+}
+
+size_t AsyncWebSocket::count() const {
+  std::lock_guard<std::recursive_mutex> lock(lock_);
+  size_t open = 0;
+  for (AsyncWebSocketClient* client : clients_) {
+    open += !client->closed_;
+  }
+  return open;
+}
+
+void AsyncWebSocket::textAll(const char* message, size_t len) {
+  std::lock_guard<std::recursive_mutex> lock(lock_);
+  for (AsyncWebSocketClient* client : clients_) {
+    if (!client->closed_) client->text(message, len);
+  }
+}
+
+void AsyncWebSocket::cleanupClients(uint16_t maxClients) {
+  (void)maxClients;
+  std::vector<AsyncWebSocketClient*> closed;
+  {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    for (AsyncWebSocketClient* client : clients_) {
+      if (client->closed_) closed.push_back(client);
+    }
+  }
+  for (AsyncWebSocketClient* client : closed) {
+    simDisconnect(client);
+  }
+}
+
+AsyncWebSocketClient* AsyncWebSocket::simConnect() {
+  AsyncWebSocketClient* client;
+  {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    client = new AsyncWebSocketClient(this, nextId_++);
+    clients_.push_back(client);
+  }
+  if (handler_) handler_(this, client, WS_EVT_CONNECT, NULL, NULL, 0);
+  return client;
+}
+
+void AsyncWebSocket::simMessage(AsyncWebSocketClient* client, const char* text) {
+  size_t len = strlen(text);
+  AwsFrameInfo info = {};
+  info.message_opcode = WS_TEXT;
+  info.opcode = WS_TEXT;
+  info.final = 1;
+  info.len = len;
+  if (handler_) handler_(this, client, WS_EVT_DATA, &info, (uint8_t*)text, len);
+}
+
+void AsyncWebSocket::simDisconnect(AsyncWebSocketClient* client) {
+  {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    size_t i = 0;
+    while (i < clients_.size() && clients_[i] != client) i++;
+    if (i == clients_.size()) return;
+    clients_.erase(clients_.begin() + i);
+    retired_.push_back(client);
+    client->closed_ = true;
+  }
+  if (handler_) handler_(this, client, WS_EVT_DISCONNECT, NULL, NULL, 0);
+}
+
+// UDP
+
+size_t AsyncUDPPacket::write(const uint8_t* data, size_t len) {
+  if (udp_->replies_) {
+    udp_->replies_->emplace_back(data, data + len);
+    return len;
+  }
+  if (udp_->fd_ < 0) return 0;
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(remotePort_);
+  addr.sin_addr.s_addr = (uint32_t)remoteIp_;
+  ssize_t n = sendto(udp_->fd_, data, len, 0, (sockaddr*)&addr, sizeof(addr));
+  return n < 0 ? 0 : n;
+}
+
+AsyncUDP::~AsyncUDP() {
+  close();
+}
+
+void AsyncUDP::close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+static void udpReceive(void* arg) {
+  AsyncUDP* udp = (AsyncUDP*)arg;
+  int fd = udp->fd_;
+  uint8_t buffer[1500];
+  for (;;) {
+    sockaddr_in from = {};
+    socklen_t fromLen = sizeof(from);
+    ssize_t n = recvfrom(fd, buffer, sizeof(buffer), 0, (sockaddr*)&from, &fromLen);
+    if (n < 0) return;
+    AsyncUDPPacket packet(udp, buffer, n, IPAddress(from.sin_addr.s_addr), ntohs(from.sin_port));
+    if (udp->handler_) udp->handler_(packet);
+  }
+}
+
+bool AsyncUDP::listen(uint16_t port) {
+  (void)port;
+  if (simUdpPort == 0) return true; // packets come from simUdpPacket() only
+  fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(simUdpPort);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd_, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    close();
+    return false;
+  }
+  xTaskCreatePinnedToCore(udpReceive, "async_udp", 4096, this, 3, NULL, tskNO_AFFINITY);
+  return true;
+}
+
+std::vector<std::vector<uint8_t>> simUdpPacket(AsyncUDP &udp, const void* data, size_t len, uint32_t ip, uint16_t port) {
+  std::vector<std::vector<uint8_t>> replies;
+  udp.replies_ = &replies;
+  AsyncUDPPacket packet(&udp, (const uint8_t*)data, len, IPAddress(ip), port);
+  if (udp.handler_) udp.handler_(packet);
+  udp.replies_ = nullptr;
+  return replies;
+}
+
+// Wi-Fi
+
+WiFiClass WiFi;
+SimWifi simWifi = {1500, 200, false, false, 0};
+static std::vector<WiFiEventFuncCb> wifiHandlers;
+static esp_timer_handle_t wifiJoinTimer = nullptr;
+static const uint8_t wifiBssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+static void wifiPost(arduino_event_id_t event, uint8_t reason = 0) {
+  arduino_event_info_t info = {};
+  info.wifi_sta_disconnected.reason = reason;
+  for (const WiFiEventFuncCb &handler : wifiHandlers) {
+    handler(event, info);
+  }
+}
+
+static void wifiJoined(void* arg) {
+  (void)arg;
+  if (simWifi.failJoins) return; // the sketch times the join out itself
+  simWifi.up = true;
+  simWifi.joins++;
+  wifiPost(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  wifiPost(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel, const uint8_t* bssid,
+                             bool connect) {
+  (void)ssid;
+  (void)passphrase;
+  if (wifiJoinTimer == nullptr) {
+    esp_timer_create_args_t args = {};
+    args.callback = wifiJoined;
+    args.name = "wifi";
+    esp_timer_create(&args, &wifiJoinTimer);
+  }
+  if (connect) {
+    esp_timer_stop(wifiJoinTimer);
+    esp_timer_start_once(wifiJoinTimer, (channel && bssid ? simWifi.cachedJoinMs : simWifi.scanJoinMs) * 1000ULL);
+  }
+  return WL_DISCONNECTED;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap) {
+  (void)wifioff;
+  (void)eraseap;
+  if (wifiJoinTimer) {
+    esp_timer_stop(wifiJoinTimer);
+  }
+  if (simWifi.up) {
+    simWifi.up = false;
+    wifiPost(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+  }
+  return true;
+}
+
+void simWifiDrop() {
+  if (!simWifi.up) return;
+  simWifi.up = false;
+  wifiPost(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+}
+
+bool WiFiClass::config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2) {
+  (void)local;
+  (void)gateway;
+  (void)subnet;
+  (void)dns1;
+  (void)dns2;
+  return true;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb callback, arduino_event_id_t event) {
+  (void)event;
+  wifiHandlers.push_back(callback);
+  return wifiHandlers.size();
+}
+
+wl_status_t WiFiClass::status() {
+  return simWifi.up ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+IPAddress WiFiClass::localIP() {
+  return simWifi.up ? IPAddress(127, 0, 0, 1) : IPAddress();
+}
+
+uint8_t* WiFiClass::BSSID() {
+  return simWifi.up ? (uint8_t*)wifiBssid : nullptr;
+}
+
+int32_t WiFiClass::channel() {
+  return simWifi.up ? 6 : 0;
+}
+
+int8_t WiFiClass::RSSI() {
+  return simWifi.up ? -52 : 0;
+}
+
+String WiFiClass::SSID() {
+  return String("host");
+}
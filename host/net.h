@@ -0,0 +1,56 @@
+// Control side of the network stand-ins (WiFi.h, AsyncUDP.h,
+// ESPAsyncWebServer.h): in-process requests for tests and benchmarks, and
+// the real sockets gpio_host listens on.
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// HTTP. hostRequest() runs a request through the handlers registered on the
+// sketch's AsyncWebServer on the calling thread, which stands in for
+// async_tcp: query parameters are percent-decoded, a POST body reaches the
+// body handler in segments of SIM_TCP_SEGMENT bytes, and a chunked response
+// that answers RESPONSE_TRY_AGAIN is asked again after SIM_TCP_POLL_MS, the
+// AsyncTCP poll interval.
+#define SIM_TCP_SEGMENT 1460
+#define SIM_TCP_POLL_MS 500
+
+struct HostResponse {
+  int code;
+  std::string type;
+  std::vector<std::pair<std::string, std::string>> headers;
+  std::string body;
+  bool chunked;
+  uint32_t tryAgains;        // RESPONSE_TRY_AGAIN answers before the body was done
+  uint64_t allocations;      // heap allocations from the handler call to send(), with host/alloc.cpp
+  int64_t firstByteNs;       // from the handler call to the first body byte
+};
+
+HostResponse hostRequest(const char* method, const char* url, const std::string &body = std::string(),
+                         const std::vector<std::pair<std::string, std::string>> &headers = {});
+std::string hostHeader(const HostResponse &response, const char* name); // "" when absent
+
+// Real sockets: 0 (the default) keeps the sketch's server and UDP listener
+// in-process only; otherwise they listen on these ports instead of their own.
+// SIM_PORT_ANY has the server take a free port, written back here once bound.
+#define SIM_PORT_ANY -1
+extern int simHttpPort;
+extern int simUdpPort;
+
+// UDP packets injected without a socket; returns what the sketch answered
+class AsyncUDP;
+std::vector<std::vector<uint8_t>> simUdpPacket(AsyncUDP &udp, const void* data, size_t len,
+                                               uint32_t ip = 0x0100007f, uint16_t port = 40000);
+
+// Wi-Fi: how long a join takes, and the link's current state
+struct SimWifi {
+  uint32_t scanJoinMs;       // WiFi.begin() without a channel and BSSID
+  uint32_t cachedJoinMs;     // with both
+  bool failJoins;            // joins time out instead
+  bool up;
+  uint32_t joins;
+};
+extern SimWifi simWifi;
+void simWifiDrop();          // the access point goes away: posts DISCONNECTED
@@ -0,0 +1,984 @@
+// Simulated hardware behind the host stand-in headers: clock and esp_timer,
+// FreeRTOS tasks, the GPIO, LEDC, PCNT and ADC peripherals, NVS and Serial.
+// See sim.h.
+
+#include "sim.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <driver/pcnt.h>
+#include <soc/gpio_reg.h>
+
+#include <stdarg.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Clock
+
+static const std::chrono::steady_clock::time_point clockStart = std::chrono::steady_clock::now();
+static std::atomic<bool> clockManual(false);
+static std::atomic<int64_t> manualNs(0);
+uint32_t simReadCostNs = 0;
+std::function<int64_t(const char* timer)> simTimerLatency;
+
+static int64_t realNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - clockStart).count();
+}
+
+static int64_t peekNs() {
+  return clockManual ? manualNs.load() : realNs();
+}
+
+// What code under test sees: under the manual clock every read costs
+// simReadCostNs, so a busy-wait on the clock gets somewhere
+static int64_t readNs() {
+  if (!clockManual) return realNs();
+  return manualNs.fetch_add(simReadCostNs) + simReadCostNs;
+}
+
+int64_t simNowUs() {
+  return peekNs() / 1000;
+}
+
+int64_t esp_timer_get_time() {
+  return readNs() / 1000;
+}
+
+unsigned long micros() {
+  return (uint32_t)(readNs() / 1000);
+}
+
+unsigned long millis() {
+  return (uint32_t)(readNs() / 1000000);
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+uint32_t getCpuFrequencyMhz() {
+  return 240;
+}
+
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(readNs() * 240 / 1000);
+}
+
+uint32_t EspClass::getFreeHeap() {
+  return esp_get_free_heap_size();
+}
+
+// esp_timer. Timers are kept in a list and never freed, so a callback that
+// is still running when its timer is deleted does not pull it out from
+// under itself.
+
+struct esp_timer {
+  esp_timer_cb_t callback;
+  void* arg;
+  const char* name;
+  bool armed;
+  bool deleted;
+  int64_t dueNs;      // when it should run
+  int64_t fireNs;     // when it runs: due plus the simulated dispatch latency
+  uint64_t periodUs;  // 0 for one-shot
+};
+
+// Never destroyed: the esp_timer thread is detached and still waits on them
+// while the program exits, and glibc blocks destroying a waited-on condition
+static std::mutex &timerLock = *new std::mutex();
+static std::condition_variable &timerWake = *new std::condition_variable();
+static std::vector<esp_timer*> &timers = *new std::vector<esp_timer*>();
+static bool timerThreadStarted = false;
+
+static void timerArm(esp_timer* timer, int64_t dueNs) {
+  timer->dueNs = dueNs;
+  timer->fireNs = dueNs + (simTimerLatency ? simTimerLatency(timer->name) * 1000 : 0);
+  timer->armed = true;
+}
+
+// Picks the next timer to run at or before limitNs. Called with timerLock
+// held; timerTaken() re-arms or disarms it.
+static esp_timer* timerNext(int64_t limitNs) {
+  esp_timer* next = nullptr;
+  for (esp_timer* timer : timers) {
+    if (timer->armed && timer->fireNs <= limitNs && (next == nullptr || timer->fireNs < next->fireNs)) {
+      next = timer;
+    }
+  }
+  return next;
+}
+
+static void timerTaken(esp_timer* timer, int64_t nowNs) {
+  if (timer->periodUs) {
+    int64_t due = timer->dueNs + timer->periodUs * 1000;
+    timerArm(timer, due > nowNs ? due : nowNs);
+  } else {
+    timer->armed = false;
+  }
+}
+
+static void timerThread() {
+  std::unique_lock<std::mutex> lock(timerLock);
+  for (;;) {
+    if (clockManual) {
+      timerWake.wait(lock);
+      continue;
+    }
+    int64_t now = realNs();
+    esp_timer* timer = timerNext(now);
+    if (timer == nullptr) {
+      esp_timer* earliest = timerNext(INT64_MAX);
+      if (earliest == nullptr) {
+        timerWake.wait(lock);
+      } else {
+        timerWake.wait_until(lock, clockStart + std::chrono::nanoseconds(earliest->fireNs));
+      }
+      continue;
+    }
+    timerTaken(timer, now);
+    esp_timer_cb_t callback = timer->callback;
+    void* arg = timer->arg;
+    lock.unlock();
+    callback(arg);
+    lock.lock();
+  }
+}
+
+static void timerThreadBody();
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+  esp_timer* timer = new esp_timer();
+  timer->callback = args->callback;
+  timer->arg = args->arg;
+  timer->name = args->name ? args->name : "";
+  std::lock_guard<std::mutex> lock(timerLock);
+  timers.push_back(timer);
+  if (!timerThreadStarted) {
+    timerThreadStarted = true;
+    std::thread(timerThreadBody).detach();
+  }
+  *handle = timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+  std::lock_guard<std::mutex> lock(timerLock);
+  if (timer->armed) return ESP_ERR_INVALID_STATE;
+  timer->periodUs = 0;
+  timerArm(timer, peekNs() + timeoutUs * 1000);
+  timerWake.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+  std::lock_guard<std::mutex> lock(timerLock);
+  if (timer->armed) return ESP_ERR_INVALID_STATE;
+  timer->periodUs = periodUs;
+  timerArm(timer, peekNs() + periodUs * 1000);
+  timerWake.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> lock(timerLock);
+  if (!timer->armed) return ESP_ERR_INVALID_STATE;
+  timer->armed = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> lock(timerLock);
+  if (timer->armed) return ESP_ERR_INVALID_STATE;
+  timer->deleted = true;
+  timer->callback = [](void*) {};
+  return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> lock(timerLock);
+  return timer->armed;
+}
+
+void simManualClock(int64_t startUs) {
+  manualNs = startUs * 1000;
+  clockManual = true;
+  timerWake.notify_all();
+}
+
+void simAdvanceUs(int64_t us) {
+  int64_t target = manualNs.load() + us * 1000;
+  std::unique_lock<std::mutex> lock(timerLock);
+  for (;;) {
+    esp_timer* timer = timerNext(target);
+    if (timer == nullptr) break;
+    if (timer->fireNs > manualNs) {
+      manualNs = timer->fireNs;
+    }
+    timerTaken(timer, manualNs);
+    esp_timer_cb_t callback = timer->callback;
+    void* arg = timer->arg;
+    lock.unlock();
+    callback(arg);
+    lock.lock();
+  }
+  if (target > manualNs) {
+    manualNs = target;
+  }
+}
+
+// Hardware timers. The alarm is an esp_timer named "hw_timer", so its
+// handler runs where other timer callbacks do and simTimerLatency delays it
+// like any of them. Only one-shot alarms are modelled: the alarm disables
+// itself when it goes off, as it does on the chip without auto-reload.
+
+struct hw_timer_s {
+  std::mutex lock;
+  esp_timer_handle_t alarm;
+  uint16_t divider;
+  int64_t zeroNs;          // when the counter was at 0
+  uint64_t alarmValue;
+  bool alarmEnabled;
+  void (*handler)();
+};
+
+static int64_t hwTimerNs(hw_timer_t* timer, uint64_t counts) {
+  return (int64_t)(counts * timer->divider * 1000 / 80);
+}
+
+static void hwTimerFire(void* arg) {
+  hw_timer_t* timer = (hw_timer_t*)arg;
+  void (*handler)() = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(timer->lock);
+    if (timer->alarmEnabled) {
+      timer->alarmEnabled = false;
+      handler = timer->handler;
+    }
+  }
+  if (handler) handler();
+}
+
+// Called with the timer's lock held
+static void hwTimerArm(hw_timer_t* timer) {
+  esp_timer_stop(timer->alarm);
+  if (timer->alarmEnabled) {
+    int64_t wait = timer->zeroNs + hwTimerNs(timer, timer->alarmValue) - peekNs();
+    esp_timer_start_once(timer->alarm, wait > 0 ? (wait + 999) / 1000 : 0);
+  }
+}
+
+// As on the chip, NULL for a timer number past the last one
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp) {
+  (void)countUp;
+  if (num >= SOC_TIMER_GROUP_TOTAL_TIMERS) {
+    return nullptr;
+  }
+  hw_timer_t* timer = new hw_timer_t();
+  timer->divider = divider;
+  timer->zeroNs = peekNs();
+  esp_timer_create_args_t args = {};
+  args.callback = hwTimerFire;
+  args.arg = timer;
+  args.name = "hw_timer";
+  esp_timer_create(&args, &timer->alarm);
+  return timer;
+}
+
+void timerAttachInterrupt(hw_timer_t* timer, void (*handler)(void), bool edge) {
+  (void)edge;
+  std::lock_guard<std::mutex> lock(timer->lock);
+  timer->handler = handler;
+}
+
+void timerWrite(hw_timer_t* timer, uint64_t value) {
+  std::lock_guard<std::mutex> lock(timer->lock);
+  timer->zeroNs = peekNs() - hwTimerNs(timer, value);
+  hwTimerArm(timer);
+}
+
+void timerAlarmWrite(hw_timer_t* timer, uint64_t value, bool autoreload) {
+  (void)autoreload;
+  std::lock_guard<std::mutex> lock(timer->lock);
+  timer->alarmValue = value;
+  hwTimerArm(timer);
+}
+
+void timerAlarmEnable(hw_timer_t* timer) {
+  std::lock_guard<std::mutex> lock(timer->lock);
+  timer->alarmEnabled = true;
+  hwTimerArm(timer);
+}
+
+void timerAlarmDisable(hw_timer_t* timer) {
+  std::lock_guard<std::mutex> lock(timer->lock);
+  timer->alarmEnabled = false;
+  hwTimerArm(timer);
+}
+
+// FreeRTOS
+
+struct SimTask {
+  std::string name;
+  std::mutex lock;
+  std::condition_variable wake;
+  uint32_t notified = 0;
+};
+
+struct SimSemaphore {
+  std::timed_mutex lock;
+};
+
+static thread_local SimTask* currentTask = nullptr;
+static std::atomic<int> threadCount(0);
+
+static void timerThreadBody() {
+  currentTask = new SimTask();
+  currentTask->name = "esp_timer";
+  timerThread();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* created, BaseType_t core) {
+  (void)stackDepth;
+  (void)priority;
+  (void)core;
+  SimTask* task = new SimTask();
+  task->name = name;
+  if (created) {
+    *created = task;
+  }
+  std::thread([task, code, arg]() {
+    currentTask = task;
+    code(arg);
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stackDepth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* created) {
+  return xTaskCreatePinnedToCore(code, name, stackDepth, arg, priority, created, tskNO_AFFINITY);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  if (currentTask == nullptr) {
+    currentTask = new SimTask();
+    currentTask->name = threadCount++ == 0 ? "loopTask" : "thread";
+  }
+  return currentTask;
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+  return (task ? task : xTaskGetCurrentTaskHandle())->name.c_str();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+  SimTask* task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->lock);
+  if (ticksToWait == portMAX_DELAY) {
+    task->wake.wait(lock, [task] { return task->notified > 0; });
+  } else {
+    task->wake.wait_for(lock, std::chrono::milliseconds(ticksToWait), [task] { return task->notified > 0; });
+  }
+  uint32_t value = task->notified;
+  if (clearOnExit) {
+    task->notified = 0;
+  } else if (value) {
+    task->notified--;
+  }
+  return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  if (task == nullptr) return pdFAIL;
+  std::lock_guard<std::mutex> lock(task->lock);
+  task->notified++;
+  task->wake.notify_one();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+  xTaskNotifyGive(task);
+  if (higherPriorityTaskWoken) {
+    *higherPriorityTaskWoken = pdTRUE;
+  }
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(peekNs() / 1000000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new SimSemaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+  if (ticksToWait == portMAX_DELAY) {
+    semaphore->lock.lock();
+    return pdTRUE;
+  }
+  return semaphore->lock.try_lock_for(std::chrono::milliseconds(ticksToWait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  semaphore->lock.unlock();
+  return pdTRUE;
+}
+
+// GPIO. The model keeps its own lock: the code under test calls it both
+// inside and outside its critical sections, and tests drive inputs from
+// their own threads.
+
+SimGpio simGpio;
+static std::recursive_mutex gpioLock;
+static int8_t ledcRoute[64];  // channel a pin is routed to, -1 for plain GPIO
+static void (*interruptHandler[64])(void*);
+static void* interruptArg[64];
+static int interruptMode[64];
+
+static bool padLevel(int gpio) {
+  int bank = gpio >> 5;
+  uint32_t bit = 1UL << (gpio & 31);
+  if (ledcRoute[gpio] >= 0) {
+    return simLedc.channel[ledcRoute[gpio]].duty != 0;
+  }
+  return simGpio.enable[bank] & bit ? simGpio.out[bank] & bit : simGpio.input[bank] & bit;
+}
+
+bool simPinLevel(int gpio) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  return padLevel(gpio);
+}
+
+uint32_t simRegRead(uint32_t address) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  switch (address) {
+    case GPIO_OUT_REG: simGpio.outReads[0]++; return simGpio.out[0];
+    case GPIO_OUT1_REG: simGpio.outReads[1]++; return simGpio.out[1];
+    case GPIO_ENABLE_REG: return simGpio.enable[0];
+    case GPIO_ENABLE1_REG: return simGpio.enable[1];
+    case GPIO_IN_REG:
+    case GPIO_IN1_REG: {
+      int bank = address == GPIO_IN1_REG;
+      simGpio.inReads[bank]++;
+      uint32_t levels = 0;
+      for (int bit = 0; bit < 32; bit++) {
+        levels |= (uint32_t)padLevel(bank * 32 + bit) << bit;
+      }
+      return levels;
+    }
+    default:
+      fprintf(stderr, "sim: read of unmodelled register 0x%08x\n", address);
+      abort();
+  }
+}
+
+std::function<void(int bank, uint32_t out)> simOnOutWrite;
+
+void simRegWrite(uint32_t address, uint32_t value) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  switch (address) {
+    case GPIO_OUT_REG: simGpio.out[0] = value; simGpio.outWrites[0]++; break;
+    case GPIO_OUT_W1TS_REG: simGpio.out[0] |= value; simGpio.outWrites[0]++; break;
+    case GPIO_OUT_W1TC_REG: simGpio.out[0] &= ~value; simGpio.outWrites[0]++; break;
+    case GPIO_OUT1_REG: simGpio.out[1] = value; simGpio.outWrites[1]++; break;
+    case GPIO_OUT1_W1TS_REG: simGpio.out[1] |= value; simGpio.outWrites[1]++; break;
+    case GPIO_OUT1_W1TC_REG: simGpio.out[1] &= ~value; simGpio.outWrites[1]++; break;
+    case GPIO_ENABLE_REG: simGpio.enable[0] = value; return;
+    case GPIO_ENABLE1_REG: simGpio.enable[1] = value; return;
+    default:
+      fprintf(stderr, "sim: write of unmodelled register 0x%08x\n", address);
+      abort();
+  }
+  if (simOnOutWrite) {
+    int bank = address >= GPIO_OUT1_REG;
+    simOnOutWrite(bank, simGpio.out[bank]);
+  }
+}
+
+// pinMode() routes the pad back to the GPIO matrix, as gpio_config() does,
+// so a pin attached to LEDC stops showing its channel
+void pinMode(uint8_t pin, uint8_t mode) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  uint32_t bit = 1UL << (pin & 31);
+  simGpio.mode[pin] = mode;
+  simGpio.pinModes++;
+  if (ledcRoute[pin] >= 0) {
+    simLedc.channel[ledcRoute[pin]].gpio = -1;
+    ledcRoute[pin] = -1;
+  }
+  if (mode == OUTPUT) {
+    simGpio.enable[pin >> 5] |= bit;
+  } else {
+    simGpio.enable[pin >> 5] &= ~bit;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  simGpio.digitalWrites++;
+  simRegWrite(pin < 32 ? (val ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG) : (val ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG),
+              1UL << (pin & 31));
+}
+
+int digitalRead(uint8_t pin) {
+  return (simRegRead(pin < 32 ? GPIO_IN_REG : GPIO_IN1_REG) >> (pin & 31)) & 1;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  interruptHandler[pin] = handler;
+  interruptArg[pin] = arg;
+  interruptMode[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  interruptHandler[pin] = nullptr;
+}
+
+void simSetInput(int gpio, bool level) {
+  void (*handler)(void*) = nullptr;
+  void* arg = nullptr;
+  {
+    std::lock_guard<std::recursive_mutex> lock(gpioLock);
+    bool before = padLevel(gpio);
+    uint32_t bit = 1UL << (gpio & 31);
+    simGpio.input[gpio >> 5] = level ? simGpio.input[gpio >> 5] | bit : simGpio.input[gpio >> 5] & ~bit;
+    bool after = padLevel(gpio);
+    int mode = interruptMode[gpio];
+    if (before != after && (mode == CHANGE || (mode == RISING && after) || (mode == FALLING && !after))) {
+      handler = interruptHandler[gpio];
+      arg = interruptArg[gpio];
+    }
+  }
+  if (handler) {
+    handler(arg); // the ISR, on the thread that moved the pad
+  }
+}
+
+// LEDC. Channels share a timer in pairs, as the core sets them up, so
+// ledcSetup() on one channel retimes its partner.
+
+SimLedc simLedc;
+
+static uint32_t ledcTimerSetup(uint8_t channel, uint32_t freq, uint8_t resolution) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  simLedc.setups++;
+  // The timer divides the 80 MHz APB clock by a 10.8 fixed-point divider
+  // of at least 1 and below 1024
+  uint64_t ticks = (uint64_t)freq << resolution;
+  if (channel >= 16 || resolution < 1 || resolution > SOC_LEDC_TIMER_BIT_WIDE_NUM || freq == 0 ||
+      ticks > 80000000ULL || (80000000ULL << 8) / ticks >= (1ULL << 18)) {
+    return 0;
+  }
+  for (int i = channel & ~1; i <= (channel | 1); i++) {
+    simLedc.channel[i].frequency = freq;
+    simLedc.channel[i].resolution = resolution;
+  }
+  return freq;
+}
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolution) {
+  return ledcTimerSetup(channel, freq, resolution);
+}
+
+uint32_t ledcChangeFrequency(uint8_t channel, uint32_t freq, uint8_t resolution) {
+  return ledcTimerSetup(channel, freq, resolution);
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  simLedc.attaches++;
+  ledcRoute[pin] = channel;
+  simLedc.channel[channel].gpio = pin;
+}
+
+void ledcDetachPin(uint8_t pin) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  simLedc.detaches++;
+  if (ledcRoute[pin] >= 0) {
+    simLedc.channel[ledcRoute[pin]].gpio = -1;
+    ledcRoute[pin] = -1;
+  }
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  simLedc.writes++;
+  simLedc.channel[channel].duty = duty;
+}
+
+uint32_t ledcRead(uint8_t channel) {
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  return simLedc.channel[channel].duty;
+}
+
+// ADC
+
+std::function<uint16_t(int gpio)> simAnalog;
+uint32_t simAnalogReads = 0;
+
+uint16_t analogRead(uint8_t pin) {
+  __atomic_fetch_add(&simAnalogReads, 1, __ATOMIC_RELAXED);
+  return simAnalog ? simAnalog(pin) : 0;
+}
+
+int8_t digitalPinToAnalogChannel(uint8_t pin) {
+  static const int8_t channels[40] = {
+    11, -1, 12, -1, 10, -1, -1, -1, -1, -1, -1, -1, 15, 14, 16, 13, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, 18, 19, 17, -1, -1, -1, -1, 4, 5, 6, 7, 0, 1, 2, 3,
+  };
+  return pin < 40 ? channels[pin] : -1;
+}
+
+// PCNT: a 16-bit counter that returns to 0 at either limit, a glitch filter
+// that passes only levels held for the filter time and a control pin that
+// can reverse or stop counting. Inputs are fed in time order; reads settle
+// the units at the current clock.
+
+struct PcntUnit {
+  bool configured;
+  pcnt_config_t config;
+  bool paused;
+  bool filtered;
+  int64_t filterNs;
+  int16_t count;
+  bool level;          // filtered pulse level
+  bool input;          // raw pulse level
+  int64_t inputSince;  // ns, when the raw level last changed
+  bool ctrl;
+
+  // Accepts the raw level once it has been held for the filter time
+  void settle(int64_t now) {
+    if (input == level || now - inputSince < (filtered ? filterNs : 0)) return;
+    level = input;
+    if (paused) return;
+    pcnt_count_mode_t mode = level ? config.pos_mode : config.neg_mode;
+    pcnt_ctrl_mode_t ctrlMode = ctrl ? config.hctrl_mode : config.lctrl_mode;
+    if (mode == PCNT_COUNT_DIS || ctrlMode == PCNT_MODE_DISABLE) return;
+    bool up = (mode == PCNT_COUNT_INC) != (ctrlMode == PCNT_MODE_REVERSE);
+    count += up ? 1 : -1;
+    if (count >= config.counter_h_lim || count <= config.counter_l_lim) {
+      count = 0;
+    }
+  }
+};
+
+static PcntUnit pcntUnits[PCNT_UNIT_MAX];
+static std::mutex pcntLock;
+
+void simPcntInput(int gpio, bool level, int64_t atNs) {
+  {
+    std::lock_guard<std::mutex> lock(pcntLock);
+    for (PcntUnit &unit : pcntUnits) {
+      if (!unit.configured) continue;
+      if (unit.config.pulse_gpio_num == gpio) {
+        unit.settle(atNs);
+        unit.input = level;
+        unit.inputSince = atNs;
+        unit.settle(atNs);
+      }
+      if (unit.config.ctrl_gpio_num == gpio) {
+        unit.settle(atNs);
+        unit.ctrl = level;
+      }
+    }
+  }
+  std::lock_guard<std::recursive_mutex> lock(gpioLock);
+  uint32_t bit = 1UL << (gpio & 31);
+  simGpio.input[gpio >> 5] = level ? simGpio.input[gpio >> 5] | bit : simGpio.input[gpio >> 5] & ~bit;
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config) {
+  if (config->unit >= PCNT_UNIT_MAX || config->counter_h_lim <= 0 || config->counter_l_lim >= 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(pcntLock);
+  PcntUnit &unit = pcntUnits[config->unit];
+  bool filtered = unit.filtered;
+  int64_t filterNs = unit.filterNs;
+  unit = PcntUnit();
+  unit.configured = true;
+  unit.config = *config;
+  unit.filtered = filtered;
+  unit.filterNs = filterNs;
+  unit.ctrl = true; // the driver enables the pull-ups
+  return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count) {
+  std::lock_guard<std::mutex> lock(pcntLock);
+  pcntUnits[unit].settle(peekNs());
+  *count = pcntUnits[unit].count;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit) {
+  std::lock_guard<std::mutex> lock(pcntLock);
+  pcntUnits[unit].settle(peekNs());
+  pcntUnits[unit].paused = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit) {
+  std::lock_guard<std::mutex> lock(pcntLock);
+  pcntUnits[unit].settle(peekNs());
+  pcntUnits[unit].paused = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit) {
+  std::lock_guard<std::mutex> lock(pcntLock);
+  pcntUnits[unit].count = 0;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t filterValue) {
+  if (filterValue > 1023) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> lock(pcntLock);
+  pcntUnits[unit].filterNs = filterValue * 1000 / 80; // APB cycles
+  return ESP_OK;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit) {
+  std::lock_guard<std::mutex> lock(pcntLock);
+  pcntUnits[unit].filtered = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_filter_disable(pcnt_unit_t unit) {
+  std::lock_guard<std::mutex> lock(pcntLock);
+  pcntUnits[unit].filtered = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_set_pin(pcnt_unit_t unit, pcnt_channel_t channel, int pulseIo, int ctrlIo) {
+  (void)channel;
+  std::lock_guard<std::mutex> lock(pcntLock);
+  pcntUnits[unit].config.pulse_gpio_num = pulseIo;
+  pcntUnits[unit].config.ctrl_gpio_num = ctrlIo;
+  return ESP_OK;
+}
+
+// NVS, by namespace and key
+
+SimNvs simNvs;
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs;
+static std::mutex nvsLock;
+
+void simNvsErase() {
+  std::lock_guard<std::mutex> lock(nvsLock);
+  nvs.clear();
+}
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partition) {
+  (void)partition;
+  name_ = name;
+  readOnly_ = readOnly;
+  open_ = true;
+  return true;
+}
+
+void Preferences::end() {
+  open_ = false;
+}
+
+bool Preferences::clear() {
+  if (!open_ || readOnly_) return false;
+  std::lock_guard<std::mutex> lock(nvsLock);
+  nvs.erase(name_);
+  simNvs.commits++;
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  if (!open_ || readOnly_) return false;
+  std::lock_guard<std::mutex> lock(nvsLock);
+  simNvs.commits++;
+  return nvs[name_].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  std::lock_guard<std::mutex> lock(nvsLock);
+  return open_ && nvs[name_].count(key) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  if (!open_ || readOnly_ || len == 0) return 0;
+  std::lock_guard<std::mutex> lock(nvsLock);
+  nvs[name_][key].assign((const uint8_t*)value, (const uint8_t*)value + len);
+  simNvs.commits++;
+  simNvs.bytesWritten += len;
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (!open_) return 0;
+  std::lock_guard<std::mutex> lock(nvsLock);
+  simNvs.reads++;
+  auto &space = nvs[name_];
+  auto found = space.find(key);
+  return found == space.end() ? 0 : found->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  if (!open_) return 0;
+  std::lock_guard<std::mutex> lock(nvsLock);
+  simNvs.reads++;
+  auto &space = nvs[name_];
+  auto found = space.find(key);
+  if (found == space.end() || found->second.size() > maxLen) return 0;
+  memcpy(buf, found->second.data(), found->second.size());
+  return found->second.size();
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+  return putBytes(key, &value, sizeof(value));
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+  uint32_t value;
+  return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
+
+// System
+
+HardwareSerial Serial;
+bool simSerialQuiet = false;
+
+size_t HardwareSerial::write(const uint8_t* data, size_t len) {
+  if (!simSerialQuiet) {
+    fwrite(data, 1, len, stdout);
+  }
+  return len;
+}
+
+static std::vector<shutdown_handler_t> shutdownHandlers;
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+  shutdownHandlers.push_back(handler);
+  return ESP_OK;
+}
+
+void esp_restart() {
+  for (shutdown_handler_t handler : shutdownHandlers) {
+    handler();
+  }
+}
+
+uint32_t esp_random() {
+  static std::mt19937 rng(1);
+  static std::mutex lock;
+  std::lock_guard<std::mutex> guard(lock);
+  return rng();
+}
+
+// The host heap is not the chip's; report a fixed heap of the size a
+// running sketch usually has left
+#define SIM_FREE_HEAP 180000
+
+uint32_t esp_get_free_heap_size() {
+  return SIM_FREE_HEAP;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  (void)caps;
+  return SIM_FREE_HEAP;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  (void)caps;
+  return SIM_FREE_HEAP;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  (void)caps;
+  return SIM_FREE_HEAP / 2;
+}
+
+__attribute__((weak)) uint64_t simAllocations() {
+  return 0;
+}
+
+void simResetHardware() {
+  {
+    std::lock_guard<std::recursive_mutex> lock(gpioLock);
+    simGpio = SimGpio();
+    simLedc = SimLedc();
+    for (int channel = 0; channel < 16; channel++) {
+      simLedc.channel[channel].gpio = -1;
+    }
+    for (int pin = 0; pin < 64; pin++) {
+      ledcRoute[pin] = -1;
+      interruptHandler[pin] = nullptr;
+    }
+  }
+  std::lock_guard<std::mutex> lock(pcntLock);
+  for (PcntUnit &unit : pcntUnits) {
+    unit = PcntUnit();
+  }
+}
+
+static struct SimInit {
+  SimInit() { simResetHardware(); }
+} simInit;
+
+// Checks
+
+std::atomic<int> simFailures(0);
+
+void simFailf(const char* format, ...) {
+  if (simFailures++ >= SIM_FAILS_SHOWN) return;
+  char line[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  fprintf(stderr, "%s\n", line);
+}
+
+void simFail(const char* what, long got, long want) {
+  simFailf("%s: got %ld, expected %ld", what, got, want);
+}
+
+void simFail(const char* where, const char* what, long got, long want) {
+  simFailf("%s: %s: got %ld, expected %ld", where, what, got, want);
+}
+
+bool simCheck(const char* what, long got, long want) {
+  if (got == want) return true;
+  simFail(what, got, want);
+  return false;
+}
+
+int simExit(const char* name) {
+  if (name) {
+    printf("%s: %d violations\n", name, simFailures.load());
+  } else {
+    printf("%d violations\n", simFailures.load());
+  }
+  return simFailures ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+// Control side of the simulated hardware layer. The stand-in Arduino, IDF
+// and FreeRTOS headers in host/ compile gpio_core.h and the dashboard sketch
+// unchanged on Linux or macOS; this header is what host programs use to
+// drive and inspect the models behind them.
+//
+// Clock: real by default (steady_clock from program start), with timers
+// dispatched in deadline order from one "esp_timer" thread, as on the chip.
+// simManualClock() freezes it instead: time only moves in simAdvanceUs(),
+// which runs every timer that falls due on the calling thread, at its due
+// time plus whatever simTimerLatency adds. A callback that busy-waits on the
+// clock needs simReadCostNs > 0, or it never sees the time move.
+//
+// FreeRTOS tasks are std::threads and waits use the real clock in both
+// modes. Critical sections are one recursive mutex per portMUX.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+
+// Clock
+void simManualClock(int64_t startUs = 0);
+void simAdvanceUs(int64_t us);
+int64_t simNowUs();
+extern uint32_t simReadCostNs;                     // manual clock: time each clock read takes
+extern std::function<int64_t(const char* timer)> simTimerLatency; // extra us before a due timer runs
+
+// GPIO: the GPIO_OUT/ENABLE registers, the pad levels GPIO_IN reads back for
+// pins that are not outputs, and how often each path was used
+struct SimGpio {
+  uint32_t out[2];
+  uint32_t enable[2];
+  uint32_t input[2];          // external levels, for pins that are not outputs
+  uint8_t mode[64];           // last pinMode(), 0 if never set
+  uint32_t outWrites[2];      // GPIO_OUT register writes, RMW or W1TS/W1TC, per bank
+  uint32_t outReads[2];
+  uint32_t inReads[2];
+  uint32_t digitalWrites;     // digitalWrite() calls
+  uint32_t pinModes;          // pinMode() calls
+};
+extern SimGpio simGpio;
+void simSetInput(int gpio, bool level); // drives a pad; runs an attached interrupt on a matching edge
+bool simPinLevel(int gpio);             // what the pad is at: the output latch or the external level
+// Called with the bank's new GPIO_OUT value after every write to it, under
+// the model's lock, on the writing thread
+extern std::function<void(int bank, uint32_t out)> simOnOutWrite;
+
+// LEDC: channel state and how often timers were set up and duties written
+struct SimLedcChannel {
+  uint32_t frequency;
+  uint8_t resolution;
+  uint32_t duty;
+  int gpio;                   // -1 when no pin is attached
+};
+struct SimLedc {
+  SimLedcChannel channel[16];
+  uint32_t setups;            // ledcSetup() and ledcChangeFrequency() calls
+  uint32_t writes;
+  uint32_t attaches;
+  uint32_t detaches;
+};
+extern SimLedc simLedc;
+
+// NVS behind Preferences. Contents live as long as the process, so a
+// "reboot" that runs the begin functions again finds what was committed.
+struct SimNvs {
+  uint32_t commits;           // put and remove calls, each an nvs_commit() on the chip
+  uint32_t reads;             // lookups: get and getBytesLength calls
+  uint64_t bytesWritten;
+};
+extern SimNvs simNvs;
+void simNvsErase();
+
+// ADC: analogRead() returns this, by pin; counts its calls
+extern std::function<uint16_t(int gpio)> simAnalog;
+extern uint32_t simAnalogReads;
+
+// PCNT: a unit counts the edges of its pulse pin that pass its glitch filter,
+// backwards while a control pin set to reverse is low, and returns to 0 at
+// either limit. Inputs are fed in ns, in time order; reads settle the units
+// at the current clock.
+void simPcntInput(int gpio, bool level, int64_t atNs);
+
+// Serial output goes to stdout unless quiet
+extern bool simSerialQuiet;
+
+// Heap allocations since start, when the program links host/alloc.cpp
+uint64_t simAllocations();
+
+// Resets the GPIO, LEDC and PCNT models and their counters (not NVS, not
+// the clock)
+void simResetHardware();
+
+// Checks, shared by the tools in tools/. Every violation is counted, from
+// any thread; the first SIM_FAILS_SHOWN are printed to stderr as they
+// happen, one line each. simExit() prints the count, prefixed by name when
+// given, and returns the exit status: 0 without violations, 1 with any.
+#define SIM_FAILS_SHOWN 10
+extern std::atomic<int> simFailures;
+void simFailf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void simFail(const char* what, long got, long want);                    // "what: got G, expected W"
+void simFail(const char* where, const char* what, long got, long want); // "where: what: got G, expected W"
+bool simCheck(const char* what, long got, long want);                   // simFail() unless got == want
+int simExit(const char* name = nullptr);
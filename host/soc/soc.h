@@ -0,0 +1,13 @@
+// Register access for the host build: the GPIO block is modelled by
+// host/sim.cpp, so reads and writes go to it instead of memory
+#pragma once
+
+#include <stdint.h>
+
+#define DR_REG_GPIO_BASE 0x3ff44000
+
+uint32_t simRegRead(uint32_t address);
+void simRegWrite(uint32_t address, uint32_t value);
+
+#define REG_READ(r) simRegRead((uint32_t)(r))
+#define REG_WRITE(r, v) simRegWrite((uint32_t)(r), (uint32_t)(v))
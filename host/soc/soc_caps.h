@@ -0,0 +1,11 @@
+// The host build targets the classic ESP32
+#pragma once
+
+#define CONFIG_IDF_TARGET_ESP32 1
+#define SOC_GPIO_PIN_COUNT 40
+#define SOC_LEDC_CHANNEL_NUM 8
+#define SOC_LEDC_SUPPORT_HS_MODE 1
+#define SOC_LEDC_TIMER_BIT_WIDE_NUM 20
+#define SOC_PCNT_SUPPORTED 1
+#define SOC_PCNT_UNITS_PER_GROUP 8
+#define SOC_TIMER_GROUP_TOTAL_TIMERS 4
@@ -1,474 +1,1779 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
-#include <ArduinoJson.h>
-#include <Ticker.h>
-#include <Preferences.h>
-#include <esp_timer.h>
+#include <AsyncUDP.h>
+#include <esp_system.h>
 #include <esp_wifi.h>
 #include <esp_heap_caps.h>
+#include "gpio_core.h"
+#include "gpio_web.h"
+#include "dashboard_assets.h"
 
 const char* ssid = "SENSORFLOW";
 const char* password = "12345678";
 
 AsyncWebServer server(80);
-Ticker scheduler;
-Ticker resetScheduler;
-Preferences preferences;
-
-struct OperationArgs {
-  int gpio;
-  String state;
-  int duration;
+AsyncWebSocket ws("/ws");
+
+// Per-route handler latency for /metrics, on the core's Histogram
+#define ROUTE_LATENCY_SHIFT 4 // handler time in 16 us steps, up to 32 ms
+
+enum Route : uint8_t {
+  ROUTE_INDEX,
+  ROUTE_SETGPIO,
+  ROUTE_SCHEDULE,
+  ROUTE_SCHEDULES,
+  ROUTE_PRECISE,
+  ROUTE_CANCEL,
+  ROUTE_BATCH,
+  ROUTE_GROUP,
+  ROUTE_GROUPS,
+  ROUTE_SCENE,
+  ROUTE_SCENES,
+  ROUTE_LEDC,
+  ROUTE_RAMPS,
+  ROUTE_QUEUE,
+  ROUTE_PINS,
+  ROUTE_BLINK,
+  ROUTE_PATTERN,
+  ROUTE_STOP,
+  ROUTE_PATTERNS,
+  ROUTE_READGPIO,
+  ROUTE_READALL,
+  ROUTE_READADC,
+  ROUTE_SAMPLE,
+  ROUTE_SAMPLES,
+  ROUTE_EDGE,
+  ROUTE_EDGES,
+  ROUTE_COUNTER,
+  ROUTE_COUNTERS,
+  ROUTE_WIFI,
+  ROUTE_STATUS,
+  ROUTE_PERSIST,
+  ROUTE_METRICS,
+  ROUTE_COUNT
+};
+
+const char* const routeNames[ROUTE_COUNT] = {
+  "/", "/setgpio", "/schedule", "/schedules", "/precise", "/cancel", "/batch", "/group", "/groups",
+  "/scene", "/scenes", "/ledc", "/ramps", "/queue", "/pins", "/blink", "/pattern", "/stop", "/patterns",
+  "/readgpio", "/readall", "/readadc", "/sample", "/samples", "/edge", "/edges", "/counter",
+  "/counters", "/wifi", "/status", "/persist", "/metrics"
 };
 
-OperationArgs operationArgs;
-
-Ticker blinkTicker;
-int blinkPin = -1;
-int blinkInterval = 0;
-
-const char* html = R"rawliteral(
-<!DOCTYPE html>
-<html>
-<head>
-  <title>ESP32 GPIO Control</title>
-  <style>
-    body {
-      font-family: Arial, sans-serif;
-      text-align: center;
-    }
-    .gpio-control {
-      display: inline-block;
-      margin: 20px;
-    }
-    .gpio-control button {
-      width: 100px;
-      height: 50px;
-      margin: 5px;
-    }
-    .operation {
-      margin: 20px;
-    }
-  </style>
-</head>
-<body>
-  <h1>ESP32 GPIO Control Dashboard</h1>
-  <div id="gpio-controls"></div>
-  <div class="operation">
-    <h3>Schedule Operation</h3>
-    GPIO: <input type="number" id="schedule-gpio" placeholder="GPIO">
-    State: <input type="text" id="schedule-state" placeholder="high/low/pwm">
-    Delay (ms): <input type="number" id="schedule-delay" placeholder="Delay in ms">
-    Duration (ms): <input type="number" id="schedule-duration" placeholder="Duration in ms">
-    <button onclick="scheduleOperation()">Schedule</button>
-  </div>
-  <div class="operation">
-    <h3>Batch Operation</h3>
-    Operations (JSON): <textarea id="batch-operations" rows="4" cols="50" placeholder='[{"gpio": 2, "state": "high"}, {"gpio": 3, "state": "low"}]'></textarea>
-    <button onclick="batchOperation()">Execute Batch</button>
-  </div>
-  <div class="operation">
-    <h3>Blink GPIO</h3>
-    GPIO: <input type="number" id="blink-gpio" placeholder="GPIO">
-    Interval (ms): <input type="number" id="blink-interval" placeholder="Interval in ms">
-    <button onclick="blinkGPIO()">Blink</button>
-  </div>
-
-  <script>
-    const gpioPins = [...Array(34).keys()]; // GPIO 0 to 33
-
-    function createControlElement(gpio) {
-      const container = document.createElement('div');
-      container.className = 'gpio-control';
-
-      const label = document.createElement('h3');
-      label.innerText = `GPIO ${gpio}`;
-      container.appendChild(label);
-
-      const highButton = document.createElement('button');
-      highButton.innerText = 'HIGH';
-      highButton.onclick = () => setGPIOState(gpio, 'high');
-      container.appendChild(highButton);
-
-      const lowButton = document.createElement('button');
-      lowButton.innerText = 'LOW';
-      lowButton.onclick = () => setGPIOState(gpio, 'low');
-      container.appendChild(lowButton);
-
-      const pwmInput = document.createElement('input');
-      pwmInput.type = 'number';
-      pwmInput.placeholder = 'PWM value';
-      pwmInput.onchange = () => setGPIOState(gpio, `pwm${pwmInput.value}`);
-      container.appendChild(pwmInput);
-
-      return container;
-    }
-
-    function setGPIOState(gpio, state) {
-      fetch(`/setgpio?gpio=${gpio}&state=${state}`)
-        .then(response => response.json())
-        .then(data => {
-          if (data.status === 'success') {
-            alert(`GPIO ${gpio} set to ${state.toUpperCase()}`);
-          } else {
-            alert(`Failed to set GPIO ${gpio}: ${data.error}`);
-          }
-        });
-    }
-
-    function scheduleOperation() {
-      const gpio = document.getElementById('schedule-gpio').value;
-      const state = document.getElementById('schedule-state').value;
-      const delay = document.getElementById('schedule-delay').value;
-      const duration = document.getElementById('schedule-duration').value;
-      fetch(`/schedule?gpio=${gpio}&state=${state}&delay=${delay}&duration=${duration}`)
-        .then(response => response.json())
-        .then(data => {
-          if (data.status === 'scheduled') {
-            alert(`Scheduled GPIO ${gpio} to ${state.toUpperCase()} after ${delay}ms for ${duration}ms`);
-          } else {
-            alert(`Failed to schedule GPIO ${gpio}: ${data.error}`);
-          }
-        });
-    }
-
-    function batchOperation() {
-      const operations = document.getElementById('batch-operations').value;
-      fetch(`/batch?operations=${encodeURIComponent(operations)}`)
-        .then(response => response.json())
-        .then(data => {
-          if (data.status === 'success') {
-            alert(`Batch operations executed successfully`);
-          } else {
-            alert(`Failed to execute batch operations: ${data.error}`);
-          }
-        });
-    }
-
-    function blinkGPIO() {
-      const gpio = document.getElementById('blink-gpio').value;
-      const interval = document.getElementById('blink-interval').value;
-      fetch(`/blink?gpio=${gpio}&interval=${interval}`)
-        .then(response => response.json())
-        .then(data => {
-          if (data.status === 'success') {
-            alert(`GPIO ${gpio} set to blink with interval ${interval}ms`);
-          } else {
-            alert(`Failed to set GPIO ${gpio} to blink: ${data.error}`);
-          }
-        });
-    }
-
-    function init() {
-      const gpioControls = document.getElementById('gpio-controls');
-      gpioPins.forEach(gpio => {
-        const controlElement = createControlElement(gpio);
-        gpioControls.appendChild(controlElement);
-      });
-    }
-
-    window.onload = init;
-  </script>
-</body>
-</html>
-)rawliteral";
-
-// Function prototypes
-void resetOperation();
-void scheduleOperation();
-void blinkOperation();
-void handleBlink();
-
-void resetOperation() {
-  Serial.println("Resetting operation...");
-  if (operationArgs.state == "high" || operationArgs.state.startsWith("pwm")) {
-    digitalWrite(operationArgs.gpio, LOW); // Reset pin to LOW after duration
-    Serial.print("GPIO ");
-    Serial.print(operationArgs.gpio);
-    Serial.println(" set to LOW");
-  } else if (operationArgs.state == "low") {
-    digitalWrite(operationArgs.gpio, HIGH); // Reset pin to HIGH after duration
-    Serial.print("GPIO ");
-    Serial.print(operationArgs.gpio);
-    Serial.println(" set to HIGH");
-  }
-  // Store the reset state
-  preferences.begin("gpio-states", false);
-  preferences.remove(String(operationArgs.gpio).c_str());
-  preferences.end();
+Histogram routeLatency[ROUTE_COUNT]; // written from the async_tcp task only
+
+// Times a handler from construction to the end of its scope
+struct RouteTimer : ScopeTimer {
+  RouteTimer(uint8_t route) : ScopeTimer(routeLatency[route], ROUTE_LATENCY_SHIFT) {}
+};
+
+// The dashboard page, CSS and JS live in dashboard/ and are gzipped into
+// dashboard_assets.h by tools/embed_assets.py. They go out as stored, with a
+// strong ETag; a browser that already has the current version gets a 304.
+void sendAsset(AsyncWebServerRequest *request, const WebAsset &asset) {
+  AsyncWebServerResponse *response;
+  if (request->hasHeader("If-None-Match") && request->header("If-None-Match").indexOf(asset.etag) >= 0) {
+    response = request->beginResponse(304);
+  } else {
+    response = request->beginResponse_P(200, asset.type, asset.data, asset.len);
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", asset.etag);
+  response->addHeader("Cache-Control", asset.cacheControl);
+  request->send(response);
 }
 
-void scheduleOperation() {
-  Serial.print("Scheduling operation on GPIO ");
-  Serial.print(operationArgs.gpio);
-  Serial.print(" with state ");
-  Serial.println(operationArgs.state);
-  
-  pinMode(operationArgs.gpio, OUTPUT);
-  if (operationArgs.state == "high") {
-    digitalWrite(operationArgs.gpio, HIGH);
-    Serial.print("GPIO ");
-    Serial.print(operationArgs.gpio);
-    Serial.println(" set to HIGH");
-  } else if (operationArgs.state == "low") {
-    digitalWrite(operationArgs.gpio, LOW);
-    Serial.print("GPIO ");
-    Serial.print(operationArgs.gpio);
-    Serial.println(" set to LOW");
-  } else if (operationArgs.state.startsWith("pwm")) {
-    int pwmValue = operationArgs.state.substring(3).toInt();
-    ledcAttachPin(operationArgs.gpio, operationArgs.gpio);
-    ledcSetup(operationArgs.gpio, 5000, 8);
-    ledcWrite(operationArgs.gpio, pwmValue);
-    Serial.print("GPIO ");
-    Serial.print(operationArgs.gpio);
-    Serial.print(" set to PWM with value ");
-    Serial.println(pwmValue);
-  }
-
-  if (operationArgs.duration > 0) {
-    resetScheduler.once_ms(operationArgs.duration, resetOperation); // Schedule reset after duration
-  }
-
-  // Store the operation state
-  preferences.begin("gpio-states", false);
-  preferences.putString(String(operationArgs.gpio).c_str(), operationArgs.state);
-  preferences.end();
+// WebSocket channel on /ws. Clients send one command per text frame and get
+// the same JSON replies as the HTTP endpoints:
+//   s <gpio> <state> [freq] [res]                    set a pin
+//   b [{"gpio":4,"state":"high"},...]                run a batch
+//   t <gpio> <state> <delay> [duration] [freq] [res] schedule
+//   c <id>                                           cancel a schedule
+// Pin changes and schedule fire/reset events are collected as they happen
+// and pushed to every client once per loop() pass, as a single frame. A
+// client whose send queue is full is skipped and gets a full snapshot
+// instead once it has drained.
+#define WS_MAX_CLIENTS 8
+#define WS_COMMAND_MAX 64
+
+// The frame buffer holds a delta and a snapshot at their largest: every pin
+// doing PWM with a 5-digit duty, and a full schedule event log with 10-digit
+// IDs and the longest state. Entry sizes include the separating comma.
+#define WS_PIN_JSON_MAX 48    // ,{"gpio":39,"state":"PWM","pwm_value":65535}
+#define WS_EVENT_JSON_MAX 72  // ,{"id":4294967295,"event":"fired","gpio":39,"state":"pwm65535"}
+#define WS_PINS_JSON_MAX (16 + SOC_GPIO_PIN_COUNT * WS_PIN_JSON_MAX)
+#define WS_DELTA_MAX (64 + WS_PINS_JSON_MAX + SCHEDULE_EVENT_LOG * WS_EVENT_JSON_MAX)
+#define WS_SNAPSHOT_MAX (32 + WS_PINS_JSON_MAX)
+#define WS_FRAME_MAX (WS_DELTA_MAX + 1 + WS_SNAPSHOT_MAX)
+
+struct WsSubscriber {
+  uint32_t id;      // 0 when the slot is free
+  bool resync;      // missed pushes, send a snapshot next
+};
+
+// Slots are taken and freed by the WebSocket events on async_tcp and read
+// by wsPush() on the loop task, both under wsMux
+WsSubscriber wsSubscribers[WS_MAX_CLIENTS];
+int wsSubscriberCount = 0;
+portMUX_TYPE wsMux = portMUX_INITIALIZER_UNLOCKED;
+char wsFrame[WS_FRAME_MAX];
+size_t wsFrameLen = 0;
+bool wsFrameOverflow = false; // what was built did not fit, and is not sent
+
+__attribute__((format(printf, 1, 2)))
+void framef(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(wsFrame + wsFrameLen, sizeof(wsFrame) - wsFrameLen, format, args);
+  va_end(args);
+  if (n < 0 || wsFrameLen + n >= sizeof(wsFrame)) {
+    wsFrameOverflow = true;
+    wsFrameLen = sizeof(wsFrame) - 1;
+  } else {
+    wsFrameLen += n;
+  }
 }
 
-void handleBlink() {
-  static bool state = false;
-  state = !state;
-  digitalWrite(blinkPin, state);
+// Appends the current state of every pin in mask as a "pins" array
+void framePins(const uint32_t mask[GPIO_BANKS]) {
+  bool first = true;
+  framef("\"pins\":[");
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    uint32_t pins = mask[bank];
+    uint32_t levels = gpioOutRead(bank);
+    while (pins) {
+      int gpio = bank * 32 + __builtin_ctz(pins);
+      uint32_t bit = pins & -pins;
+      portENTER_CRITICAL(&gpioMux);
+      bool pwm = (pwmPins[bank] & bit) && pinChannel[gpio] != LEDC_NONE;
+      uint16_t duty = pinDuty[gpio];
+      portEXIT_CRITICAL(&gpioMux);
+      if (pwm) {
+        framef("%s{\"gpio\":%d,\"state\":\"PWM\",\"pwm_value\":%u}", first ? "" : ",", gpio, duty);
+      } else {
+        framef("%s{\"gpio\":%d,\"state\":\"%s\"}", first ? "" : ",", gpio, (levels & bit) ? "HIGH" : "LOW");
+      }
+      first = false;
+      pins &= pins - 1;
+    }
+  }
+  framef("]");
 }
 
-void blinkOperation() {
-  blinkTicker.attach_ms(blinkInterval, handleBlink);
+// Called from loop(): sends what changed since the last pass
+void wsPush() {
+  uint32_t changed[GPIO_BANKS];
+  uint32_t active[GPIO_BANKS];
+  portENTER_CRITICAL(&gpioMux);
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    changed[bank] = changedPins[bank];
+    active[bank] = outputPins[bank] | pwmPins[bank];
+    changedPins[bank] = 0;
+  }
+  portEXIT_CRITICAL(&gpioMux);
+
+  ScheduleEvent events[SCHEDULE_EVENT_LOG];
+  portENTER_CRITICAL(&eventMux);
+  int eventCount = scheduleEventCount;
+  uint32_t dropped = scheduleEventsDropped;
+  memcpy(events, scheduleEvents, eventCount * sizeof(ScheduleEvent));
+  scheduleEventCount = 0;
+  scheduleEventsDropped = 0;
+  portEXIT_CRITICAL(&eventMux);
+
+  bool pending = eventCount > 0 || dropped > 0;
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    pending |= changed[bank] != 0;
+  }
+
+  // The delta frame is built once and copied to each client that keeps up.
+  // Should it not fit, every client is sent a snapshot instead.
+  wsFrameLen = 0;
+  wsFrameOverflow = false;
+  if (pending) {
+    framef("{\"event\":\"update\",");
+    framePins(changed);
+    framef(",\"schedules\":[");
+    for (int i = 0; i < eventCount; i++) {
+      char state[12];
+      formatState(events[i].cmd, state, sizeof(state));
+      framef("%s{\"id\":%u,\"event\":\"%s\",\"gpio\":%d,\"state\":\"%s\"}", i ? "," : "", events[i].id,
+             events[i].phase == PHASE_SET ? "fired" : "reset", events[i].cmd.gpio, state);
+    }
+    framef("],\"dropped\":%u}", dropped);
+  }
+  bool deltaLost = wsFrameOverflow;
+  size_t deltaLen = deltaLost ? 0 : wsFrameLen;
+  bool snapshotBuilt = false;
+  bool snapshotLost = false;
+
+  // Clients are sent to from a copy of the slots, so wsMux is not held
+  // across sends; only the resync flags are written back
+  WsSubscriber subscribers[WS_MAX_CLIENTS];
+  portENTER_CRITICAL(&wsMux);
+  memcpy(subscribers, wsSubscribers, sizeof(subscribers));
+  portEXIT_CRITICAL(&wsMux);
+
+  for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+    WsSubscriber &subscriber = subscribers[i];
+    if (subscriber.id == 0 || (!pending && !subscriber.resync)) continue;
+    AsyncWebSocketClient *client = ws.client(subscriber.id);
+    if (client == NULL) continue;
+    if (client->queueIsFull()) {
+      subscriber.resync = true;
+      continue;
+    }
+    if (subscriber.resync || deltaLost) {
+      if (!snapshotBuilt) {
+        wsFrameLen = deltaLen + 1; // keep the delta, build the snapshot after it
+        wsFrameOverflow = false;
+        framef("{\"event\":\"snapshot\",");
+        framePins(active);
+        framef("}");
+        snapshotBuilt = true;
+        snapshotLost = wsFrameOverflow;
+      }
+      if (snapshotLost) {
+        subscriber.resync = true;
+        continue;
+      }
+      client->text(wsFrame + deltaLen + 1, wsFrameLen - deltaLen - 1);
+      subscriber.resync = false;
+    } else {
+      client->text(wsFrame, deltaLen);
+    }
+  }
+  portENTER_CRITICAL(&wsMux);
+  for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+    if (wsSubscribers[i].id == subscribers[i].id) {
+      wsSubscribers[i].resync = subscribers[i].resync;
+    }
+  }
+  portEXIT_CRITICAL(&wsMux);
 }
 
-void setup() {
-  Serial.begin(115200);
-  Serial.println("Starting setup...");
+__attribute__((format(printf, 2, 3)))
+void wsReplyf(AsyncWebSocketClient *client, const char* format, ...) {
+  char body[JSON_REPLY_MAX];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(body, sizeof(body), format, args);
+  va_end(args);
+  client->text(body);
+}
+
+// Parses a whole decimal argument, rejecting trailing characters
+bool parseNumber(const char* text, long &value) {
+  char* end;
+  value = strtol(text, &end, 10);
+  return end != text && *end == '\0';
+}
 
-  // Connect to Wi-Fi
-  WiFi.begin(ssid, password);
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(1000);
-    Serial.println("Connecting to WiFi...");
-  }
-  Serial.println("Connected to WiFi");
-  Serial.println(WiFi.localIP());
-
-  // Resume previous GPIO states
-  preferences.begin("gpio-states", true);
-  for (int i = 0; i <= 33; i++) {
-    String state = preferences.getString(String(i).c_str(), "");
-    if (state != "") {
-      Serial.print("Resuming state for GPIO ");
-      Serial.print(i);
-      Serial.print(": ");
-      Serial.println(state);
-      
-      operationArgs.gpio = i;
-      operationArgs.state = state;
-      operationArgs.duration = 0; // Set to 0 to avoid scheduling reset
-      scheduleOperation();
+void wsCommand(AsyncWebSocketClient *client, const char* data, size_t len) {
+  if (len > 2 && data[0] == 'b' && data[1] == ' ') {
+    BatchParser parser;
+    batchBegin(parser);
+    batchFeed(parser, data + 2, len - 2);
+    if (parser.state != BATCH_DONE) {
+      wsReplyf(client, "{\"operations\":%u,\"applied\":%u,\"failed\":%u,\"error\":\"Malformed operations\",\"offset\":%u,\"status\":\"failure\"}",
+               parser.operations, parser.operations - parser.failed, parser.failed, parser.offset);
     } else {
-      Serial.print("No state found for GPIO ");
-      Serial.println(i);
+      wsReplyf(client, "{\"operations\":%u,\"applied\":%u,\"failed\":%u,\"status\":\"%s\"}",
+               parser.operations, parser.operations - parser.failed, parser.failed, parser.failed ? "partial" : "success");
     }
+    return;
   }
-  preferences.end();
 
-  // Serve the HTML page
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send_P(200, "text/html", html);
-  });
+  char line[WS_COMMAND_MAX];
+  if (len >= sizeof(line)) {
+    client->text("{\"error\":\"Command too long\",\"status\":\"failure\"}");
+    return;
+  }
+  memcpy(line, data, len);
+  line[len] = '\0';
+  char* argv[7];
+  int argc = 0;
+  for (char* arg = strtok(line, " "); arg != NULL && argc < 7; arg = strtok(NULL, " ")) {
+    argv[argc++] = arg;
+  }
+
+  long number[5] = {-1, -1, 0, PWM_DEFAULT_FREQ, PWM_DEFAULT_RESOLUTION};
+  GpioCommand cmd;
+  ActuationResult result;
+  if (argc == 0 || strlen(argv[0]) != 1) {
+    client->text("{\"error\":\"Unknown command\",\"status\":\"failure\"}");
+  } else if (argv[0][0] == 's') {
+    if (argc < 3 || argc > 5 || !parseNumber(argv[1], number[0]) ||
+        (argc > 3 && !parseNumber(argv[3], number[3])) || (argc > 4 && !parseNumber(argv[4], number[4]))) {
+      client->text("{\"error\":\"usage: s <gpio> <state> [freq] [res]\",\"status\":\"failure\"}");
+    } else if (pinClaimed(number[0])) {
+      client->text(CLAIMED_REPLY);
+    } else if (!decodeCommand(number[0], argv[2], cmd, number[3], number[4])) {
+      client->text("{\"error\":\"Invalid state value\",\"status\":\"failure\"}");
+    } else if ((result = executeCommand(cmd)) == ACTUATION_BUSY) {
+      client->text(BUSY_REPLY);
+    } else if (result == ACTUATION_CLAIMED) {
+      client->text(CLAIMED_REPLY);
+    } else if (result != ACTUATED) {
+      client->text(NO_CHANNEL_REPLY);
+    } else {
+      storeCommand(cmd);
+      if (cmd.op == OP_PWM) {
+        wsReplyf(client, "{\"gpio\":%u,\"state\":\"PWM\",\"pwm_value\":%u,\"frequency\":%u,\"resolution\":%u,\"status\":\"success\"}",
+                 cmd.gpio, cmd.duty, cmd.frequency, cmd.resolution);
+      } else {
+        wsReplyf(client, "{\"gpio\":%u,\"state\":\"%s\",\"status\":\"success\"}", cmd.gpio, cmd.op == OP_HIGH ? "HIGH" : "LOW");
+      }
+    }
+  } else if (argv[0][0] == 't') {
+    if (argc < 4 || !parseNumber(argv[1], number[0]) || !parseNumber(argv[3], number[1]) ||
+        (argc > 4 && !parseNumber(argv[4], number[2])) || (argc > 5 && !parseNumber(argv[5], number[3])) ||
+        (argc > 6 && !parseNumber(argv[6], number[4]))) {
+      client->text("{\"error\":\"usage: t <gpio> <state> <delay> [duration] [freq] [res]\",\"status\":\"failure\"}");
+    } else if (pinClaimed(number[0])) {
+      client->text(CLAIMED_REPLY);
+    } else if (!decodeCommand(number[0], argv[2], cmd, number[3], number[4])) {
+      client->text("{\"error\":\"Invalid state value\",\"status\":\"failure\"}");
+    } else if (number[1] < 0 || number[2] < 0) {
+      client->text("{\"error\":\"Invalid delay or duration\",\"status\":\"failure\"}");
+    } else {
+      cmd.duration = number[2];
+      uint32_t id = scheduleAdd(cmd, number[1]);
+      if (id == 0) {
+        client->text("{\"error\":\"Scheduler full\",\"status\":\"failure\"}");
+      } else {
+        wsReplyf(client, "{\"id\":%u,\"status\":\"scheduled\"}", id);
+      }
+    }
+  } else if (argv[0][0] == 'c') {
+    if (argc != 2 || !parseNumber(argv[1], number[0]) || number[0] <= 0) {
+      client->text("{\"error\":\"usage: c <id>\",\"status\":\"failure\"}");
+    } else if (!scheduleCancel(number[0])) {
+      client->text("{\"error\":\"Schedule not found\",\"status\":\"failure\"}");
+    } else {
+      wsReplyf(client, "{\"id\":%ld,\"status\":\"cancelled\"}", number[0]);
+    }
+  } else {
+    client->text("{\"error\":\"Unknown command\",\"status\":\"failure\"}");
+  }
+}
+
+void onWsEvent(AsyncWebSocket *, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+  if (type == WS_EVT_CONNECT) {
+    bool added = false;
+    portENTER_CRITICAL(&wsMux);
+    for (int i = 0; i < WS_MAX_CLIENTS && !added; i++) {
+      if (wsSubscribers[i].id == 0) {
+        wsSubscribers[i].id = client->id();
+        wsSubscribers[i].resync = true; // Starts with a snapshot
+        __atomic_store_n(&scheduleEventListeners, ++wsSubscriberCount, __ATOMIC_RELAXED);
+        added = true;
+      }
+    }
+    portEXIT_CRITICAL(&wsMux);
+    if (!added) {
+      client->close(1013, "Too many clients");
+    }
+  } else if (type == WS_EVT_DISCONNECT) {
+    portENTER_CRITICAL(&wsMux);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+      if (wsSubscribers[i].id == client->id()) {
+        wsSubscribers[i].id = 0;
+        __atomic_store_n(&scheduleEventListeners, --wsSubscriberCount, __ATOMIC_RELAXED);
+      }
+    }
+    portEXIT_CRITICAL(&wsMux);
+  } else if (type == WS_EVT_DATA) {
+    AwsFrameInfo *info = (AwsFrameInfo*)arg;
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+      client->text("{\"error\":\"Commands must be single text frames\",\"status\":\"failure\"}");
+      return;
+    }
+    wsCommand(client, (const char*)data, len);
+  }
+}
+
+// Binary UDP control, for clients that need lower latency than an HTTP
+// request. Each datagram is one fixed-layout little-endian frame: a UdpHeader
+// followed by the body for its type. Every frame is answered with a UdpAck
+// that echoes its sequence number. The last UDP_ACK_WINDOW acks of each
+// client are kept, so a retried frame gets its original ack back instead of
+// being run twice; frames older than the window are refused as stale.
+// Clients should start each session at a random sequence number.
+#define UDP_CONTROL_PORT 4210 // 0 disables the UDP listener
+#define UDP_MAGIC 'G'
+#define UDP_VERSION 1
+#define UDP_CLIENTS 4
+#define UDP_ACK_WINDOW 16
+#define UDP_CLIENT_IDLE_MS 60000
+
+enum UdpType : uint8_t {
+  UDP_SET = 1,      // UdpSet
+  UDP_MASK = 2,     // UdpMask
+  UDP_PWM = 3,      // UdpPwm
+  UDP_SCHEDULE = 4, // UdpSchedule
+  UDP_CANCEL = 5,   // UdpCancel
+  UDP_ACK = 0x80    // OR-ed into the type of the frame being answered
+};
+
+enum UdpStatus : uint8_t {
+  UDP_OK,
+  UDP_BAD_FRAME,     // unknown type, wrong length or version
+  UDP_INVALID,       // pin or value rejected
+  UDP_NO_CHANNEL,    // no free PWM channel
+  UDP_FULL,          // scheduler full
+  UDP_NOT_FOUND,     // no such schedule to cancel
+  UDP_STALE,         // sequence number older than the ack window
+  UDP_BUSY           // actuation queue full, nothing done: resend, same seq
+};
+
+struct __attribute__((packed)) UdpHeader {
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint8_t status;    // 0 in requests
+  uint32_t seq;
+};
+
+struct __attribute__((packed)) UdpSet {
+  uint8_t gpio;
+  uint8_t level;     // 0 or 1
+  uint8_t reserved[2];
+};
+
+struct __attribute__((packed)) UdpMask {
+  uint32_t set[2];   // per bank, GPIO 0-31 and 32-63
+  uint32_t clear[2];
+};
+
+struct __attribute__((packed)) UdpPwm {
+  uint8_t gpio;
+  uint8_t resolution; // 0 for PWM_DEFAULT_RESOLUTION
+  uint16_t duty;
+  uint32_t frequency; // 0 for PWM_DEFAULT_FREQ
+};
+
+struct __attribute__((packed)) UdpSchedule {
+  uint8_t gpio;
+  uint8_t op;         // GpioOp: 1 high, 2 low, 3 pwm
+  uint8_t resolution;
+  uint8_t reserved;
+  uint16_t duty;
+  uint16_t reserved2;
+  uint32_t frequency;
+  uint32_t delay;     // ms
+  uint32_t duration;  // ms, 0 to stay
+};
+
+struct __attribute__((packed)) UdpCancel {
+  uint32_t id;
+};
+
+struct __attribute__((packed)) UdpAck {
+  UdpHeader header;
+  uint32_t value;     // schedule id for UDP_SCHEDULE, otherwise 0
+};
+
+static_assert(sizeof(UdpHeader) == 8 && sizeof(UdpSet) == 4 && sizeof(UdpMask) == 16 && sizeof(UdpPwm) == 8 &&
+              sizeof(UdpSchedule) == 20 && sizeof(UdpCancel) == 4 && sizeof(UdpAck) == 12, "UDP frame layout");
+
+struct UdpClient {
+  uint32_t ip;       // 0 when the slot is free
+  uint16_t port;
+  uint32_t lastSeen;
+  uint32_t highestSeq;
+  UdpAck acks[UDP_ACK_WINDOW]; // by seq % UDP_ACK_WINDOW
+};
+
+AsyncUDP udp;
+UdpClient udpClients[UDP_CLIENTS]; // only touched from the UDP receive callback
+uint32_t udpFrames = 0;
+uint32_t udpRetries = 0;
+uint32_t udpRejected = 0;
+
+// Output-capable pins of one bank, from the pin table
+constexpr uint32_t outputCapableMask(int bank, int bit = 0) {
+  return bit == 32 ? 0 : (pinCanOutput(bank * 32 + bit) ? 1UL << bit : 0) | outputCapableMask(bank, bit + 1);
+}
+
+// Fills cmd from binary fields, with the checks decodeCommand applies to the
+// text form
+bool udpDecode(uint8_t gpio, uint8_t op, uint16_t duty, uint32_t frequency, uint8_t resolution, GpioCommand &cmd) {
+  cmd.op = op;
+  cmd.gpio = gpio;
+  cmd.duty = op == OP_PWM ? duty : 0;
+  cmd.duration = 0;
+  cmd.frequency = frequency ? frequency : PWM_DEFAULT_FREQ;
+  cmd.resolution = resolution ? resolution : PWM_DEFAULT_RESOLUTION;
+  cmd.shape = RAMP_LINEAR;
+  cmd.ramp = 0;
+  if (!pinCanOutput(gpio) || pinClaimed(gpio) || (op != OP_HIGH && op != OP_LOW && op != OP_PWM)) {
+    return false;
+  }
+  return cmd.resolution <= PWM_MAX_RESOLUTION && cmd.duty <= (1UL << cmd.resolution) - 1;
+}
+
+UdpClient* udpFindClient(uint32_t ip, uint16_t port, uint32_t seq) {
+  uint32_t now = millis();
+  UdpClient* oldest = &udpClients[0];
+  for (int i = 0; i < UDP_CLIENTS; i++) {
+    UdpClient &client = udpClients[i];
+    if (client.ip == ip && client.port == port && now - client.lastSeen < UDP_CLIENT_IDLE_MS) {
+      client.lastSeen = now;
+      return &client;
+    }
+    if (oldest->ip != 0 && (client.ip == 0 || now - client.lastSeen > now - oldest->lastSeen)) {
+      oldest = &client; // a free slot, else the longest idle one
+    }
+  }
+  // New client, or one that went idle: forget what was cached for the slot
+  memset(oldest, 0, sizeof(*oldest));
+  oldest->ip = ip;
+  oldest->port = port;
+  oldest->lastSeen = now;
+  oldest->highestSeq = seq - 1;
+  return oldest;
+}
+
+// The status for what became of a command: a claimed pin is one rejected
+uint8_t udpStatus(ActuationResult result) {
+  switch (result) {
+    case ACTUATED: return UDP_OK;
+    case ACTUATION_BUSY: return UDP_BUSY;
+    case ACTUATION_NO_CHANNEL: return UDP_NO_CHANNEL;
+    case ACTUATION_CLAIMED: return UDP_INVALID;
+  }
+  return UDP_INVALID;
+}
+
+// Runs one frame and returns its status; value is set for UDP_SCHEDULE
+uint8_t udpExecute(uint8_t type, const uint8_t* body, size_t len, uint32_t &value) {
+  GpioCommand cmd;
+  if (type == UDP_SET && len == sizeof(UdpSet)) {
+    UdpSet frame;
+    memcpy(&frame, body, sizeof(frame));
+    if (frame.level > 1 || !udpDecode(frame.gpio, frame.level ? OP_HIGH : OP_LOW, 0, 0, 0, cmd)) {
+      return UDP_INVALID;
+    }
+    uint8_t status = udpStatus(executeCommand(cmd));
+    if (status == UDP_OK) storeCommand(cmd);
+    return status;
+  }
+  if (type == UDP_PWM && len == sizeof(UdpPwm)) {
+    UdpPwm frame;
+    memcpy(&frame, body, sizeof(frame));
+    if (!udpDecode(frame.gpio, OP_PWM, frame.duty, frame.frequency, frame.resolution, cmd)) {
+      return UDP_INVALID;
+    }
+    uint8_t status = udpStatus(executeCommand(cmd));
+    if (status == UDP_OK) storeCommand(cmd);
+    return status;
+  }
+  if (type == UDP_MASK && len == sizeof(UdpMask)) {
+    UdpMask frame;
+    memcpy(&frame, body, sizeof(frame));
+    GpioMaskWrite write = {};
+    PinGroup high = {}, low = {};
+    for (int bank = 0; bank < 2; bank++) {
+      uint32_t valid = bank < GPIO_BANKS ? outputCapableMask(bank) & ~claimedMask(bank) : 0;
+      if ((frame.set[bank] | frame.clear[bank]) & ~valid || frame.set[bank] & frame.clear[bank]) {
+        return UDP_INVALID;
+      }
+    }
+    for (int bank = 0; bank < GPIO_BANKS; bank++) {
+      write.set[bank] = high.mask[bank] = frame.set[bank];
+      write.clear[bank] = low.mask[bank] = frame.clear[bank];
+    }
+    if (!applyMaskWrite(write)) {
+      return UDP_BUSY;
+    }
+    GpioCommand highCmd = {OP_HIGH, 0, 0, 0, 0, 0, RAMP_LINEAR, 0};
+    GpioCommand lowCmd = {OP_LOW, 0, 0, 0, 0, 0, RAMP_LINEAR, 0};
+    storeGroupCommand(high, highCmd);
+    storeGroupCommand(low, lowCmd);
+    return UDP_OK;
+  }
+  if (type == UDP_SCHEDULE && len == sizeof(UdpSchedule)) {
+    UdpSchedule frame;
+    memcpy(&frame, body, sizeof(frame));
+    if (!udpDecode(frame.gpio, frame.op, frame.duty, frame.frequency, frame.resolution, cmd) ||
+        frame.delay > INT32_MAX || frame.duration > INT32_MAX) {
+      return UDP_INVALID;
+    }
+    cmd.duration = frame.duration;
+    value = scheduleAdd(cmd, frame.delay);
+    return value ? UDP_OK : UDP_FULL;
+  }
+  if (type == UDP_CANCEL && len == sizeof(UdpCancel)) {
+    UdpCancel frame;
+    memcpy(&frame, body, sizeof(frame));
+    return scheduleCancel(frame.id) ? UDP_OK : UDP_NOT_FOUND;
+  }
+  return UDP_BAD_FRAME;
+}
+
+void onUdpPacket(AsyncUDPPacket &packet) {
+  UdpHeader header;
+  if (packet.length() < sizeof(header)) {
+    udpRejected++;
+    return; // too short to answer
+  }
+  memcpy(&header, packet.data(), sizeof(header));
+  if (header.magic != UDP_MAGIC || header.type & UDP_ACK) {
+    udpRejected++;
+    return; // not ours, or an ack looped back
+  }
+  udpFrames++;
+
+  UdpAck ack = {{UDP_MAGIC, UDP_VERSION, (uint8_t)(header.type | UDP_ACK), UDP_OK, header.seq}, 0};
+  if (header.version != UDP_VERSION) {
+    ack.header.status = UDP_BAD_FRAME;
+    udpRejected++;
+    packet.write((const uint8_t*)&ack, sizeof(ack));
+    return;
+  }
+
+  UdpClient* client = udpFindClient(packet.remoteIP(), packet.remotePort(), header.seq);
+  UdpAck &cached = client->acks[header.seq % UDP_ACK_WINDOW];
+  int32_t age = client->highestSeq - header.seq;
+  if (cached.header.magic == UDP_MAGIC && cached.header.seq == header.seq) {
+    udpRetries++;
+    packet.write((const uint8_t*)&cached, sizeof(cached)); // already run: same answer again
+    return;
+  }
+  if (age >= UDP_ACK_WINDOW) {
+    ack.header.status = UDP_STALE;
+    udpRejected++;
+    packet.write((const uint8_t*)&ack, sizeof(ack));
+    return;
+  }
+
+  uint32_t value = 0;
+  ack.header.status = udpExecute(header.type, packet.data() + sizeof(header), packet.length() - sizeof(header), value);
+  ack.value = value;
+  if (ack.header.status != UDP_OK) {
+    udpRejected++;
+  }
+  if (ack.header.status != UDP_BUSY) {
+    cached = ack; // a busy frame ran nothing, so a resend runs it again
+  }
+  if (age < 0) {
+    client->highestSeq = header.seq;
+  }
+  packet.write((const uint8_t*)&ack, sizeof(ack));
+}
+
+void udpBegin() {
+  if (UDP_CONTROL_PORT != 0 && udp.listen(UDP_CONTROL_PORT)) {
+    udp.onPacket(onUdpPacket);
+  }
+}
+
+// Fills a chunked response buffer from a source that produces its body one
+// line at a time (line, linePos, lineLen and nextLine()). A line that does
+// not fit is continued in the next chunk.
+template <typename Source>
+size_t fillChunk(Source &source, uint8_t *buffer, size_t maxLen) {
+  size_t len = 0;
+  while (len < maxLen) {
+    if (source.linePos == source.lineLen && !source.nextLine()) break;
+    size_t n = source.lineLen - source.linePos;
+    n = n < maxLen - len ? n : maxLen - len;
+    memcpy(buffer + len, source.line + source.linePos, n);
+    source.linePos += n;
+    len += n;
+  }
+  return len;
+}
+
+// Prometheus text exposition for /metrics, generated one line at a time.
+// Gauges are sampled when the scrape starts.
+struct MetricsStream {
+  uint8_t phase;        // 0 route histograms, 1 lateness, 2 actuation latency, 3 precise lateness, 4 Wi-Fi join time, 5 gauges, 6 done
+  uint8_t route;
+  uint8_t item;
+  uint8_t linePos;
+  uint8_t lineLen;
+  char line[112];
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;
+  uint32_t largestBlock;
+  int rssi;
+
+  // One line of a histogram: the TYPE line, cumulative buckets, +Inf, sum
+  // and count. Returns false once the histogram is done.
+  bool histogramLine(const char* name, const char* label, const Histogram &histogram, int shift) {
+    const char* sep = label[0] ? "," : "";
+    if (item == 0) {
+      lineLen = snprintf(line, sizeof(line), "# TYPE %s histogram\n", name);
+      item = 1;
+      return true;
+    }
+    int bucket = item - 1;
+    if (bucket < HIST_BUCKETS) {
+      uint32_t cumulative = 0;
+      for (int i = 0; i <= bucket; i++) {
+        cumulative += histogram.buckets[i];
+      }
+      lineLen = snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"%u\"} %u\n", name, label, sep,
+                         ((1U << bucket) << shift) - 1, cumulative);
+    } else if (bucket == HIST_BUCKETS) {
+      lineLen = snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"+Inf\"} %u\n", name, label, sep, histogram.count);
+    } else if (bucket == HIST_BUCKETS + 1) {
+      lineLen = snprintf(line, sizeof(line), "%s_sum%s%s%s %llu\n", name, sep[0] ? "{" : "", label, sep[0] ? "}" : "",
+                         (unsigned long long)histogram.sum);
+    } else if (bucket == HIST_BUCKETS + 2) {
+      lineLen = snprintf(line, sizeof(line), "%s_count%s%s%s %u\n", name, sep[0] ? "{" : "", label, sep[0] ? "}" : "",
+                         histogram.count);
+    } else {
+      return false;
+    }
+    item++;
+    return true;
+  }
+
+  bool nextLine() {
+    char label[32];
+    lineLen = 0;
+    linePos = 0;
+    while (lineLen == 0) {
+      if (phase == 0) {
+        // Routes that were never hit are left out
+        while (route < ROUTE_COUNT && routeLatency[route].count == 0) {
+          route++;
+        }
+        if (route == ROUTE_COUNT) {
+          phase = 1;
+          item = 0;
+          continue;
+        }
+        snprintf(label, sizeof(label), "route=\"%s\"", routeNames[route]);
+        if (!histogramLine("gpio_http_handler_duration_us", label, routeLatency[route], ROUTE_LATENCY_SHIFT)) {
+          route++;
+          item = 1; // TYPE line only once
+        }
+      } else if (phase == 1) {
+        if (!histogramLine("gpio_schedule_lateness_ms", "", scheduleLateness, LATENESS_SHIFT)) {
+          phase = 2;
+          item = 0;
+        }
+      } else if (phase == 2) {
+        if (!histogramLine("gpio_actuation_latency_us", "", actuationLatency, ACTUATION_LATENCY_SHIFT)) {
+          phase = 3;
+          item = 0;
+        }
+      } else if (phase == 3) {
+        if (!histogramLine("gpio_precise_lateness_us", "", preciseLateness, PRECISE_LATENESS_SHIFT)) {
+          phase = 4;
+          item = 0;
+        }
+      } else if (phase == 4) {
+        if (!histogramLine("gpio_wifi_connect_ms", "", wifiJoinTime, WIFI_JOIN_SHIFT)) {
+          phase = 5;
+          item = 0;
+        }
+      } else if (phase == 5) {
+        switch (item++) {
+          case 0: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_digital_writes_total counter\ngpio_digital_writes_total %u\n", digitalWrites); break;
+          case 1: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_pwm_writes_total counter\ngpio_pwm_writes_total %u\n", pwmWrites); break;
+          case 2: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_nvs_commits_total counter\ngpio_nvs_commits_total %u\n", persistCommits); break;
+          case 3: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_ledc_reconfigurations_total counter\ngpio_ledc_reconfigurations_total %u\n", ledcReconfigs); break;
+          case 4: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_schedules_pending gauge\ngpio_schedules_pending %u\n", pendingEntries); break;
+          case 5: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_adc_overruns_total counter\ngpio_adc_overruns_total %u\n", adcOverruns); break;
+          case 6: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_heap_free_bytes gauge\ngpio_heap_free_bytes %u\n", freeHeap); break;
+          case 7: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_heap_min_free_bytes gauge\ngpio_heap_min_free_bytes %u\n", minFreeHeap); break;
+          case 8: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_heap_largest_free_block_bytes gauge\ngpio_heap_largest_free_block_bytes %u\n", largestBlock); break;
+          case 9: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_wifi_rssi_dbm gauge\ngpio_wifi_rssi_dbm %d\n", rssi); break;
+          case 10: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_websocket_clients gauge\ngpio_websocket_clients %d\n", wsSubscriberCount); break;
+          case 11: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_uptime_seconds counter\ngpio_uptime_seconds %u\n", (uint32_t)(esp_timer_get_time() / 1000000)); break;
+          case 12: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_udp_frames_total counter\ngpio_udp_frames_total %u\n", udpFrames); break;
+          case 13: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_udp_retries_total counter\ngpio_udp_retries_total %u\n", udpRetries); break;
+          case 14: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_udp_rejected_total counter\ngpio_udp_rejected_total %u\n", udpRejected); break;
+          case 15: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_actuation_queue_depth gauge\ngpio_actuation_queue_depth %u\n", actuationTail - actuationHead); break;
+          case 16: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_actuation_queue_max_depth gauge\ngpio_actuation_queue_max_depth %u\n", actuationMaxDepth); break;
+          case 17: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_actuation_enqueued_total counter\ngpio_actuation_enqueued_total %u\n", actuationEnqueued); break;
+          case 18: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_actuation_full_waits_total counter\ngpio_actuation_full_waits_total %u\n", actuationFullWaits); break;
+          case 19: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_actuation_dropped_total counter\ngpio_actuation_dropped_total %u\n", actuationDropped); break;
+          case 20: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_ramps_active gauge\ngpio_ramps_active %d\n", rampsActive()); break;
+          case 21: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_ramp_step_max_us gauge\ngpio_ramp_step_max_us %u\n", rampTickMaxUs); break;
+          case 22: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_edges_total counter\ngpio_edges_total %u\n", __atomic_load_n(&edgeHead, __ATOMIC_ACQUIRE)); break;
+          case 23: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_edge_bounces_total counter\ngpio_edge_bounces_total %u\n", edgeBounces()); break;
+          case 24: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_edge_overflows_total counter\ngpio_edge_overflows_total %u\n", edgeOverflows); break;
+          case 25: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_edges_lost_total counter\ngpio_edges_lost_total %u\n", edgeLost); break;
+          case 26: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_counters_active gauge\ngpio_counters_active %d\n", countersActive()); break;
+          case 27: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_wifi_connects_total counter\ngpio_wifi_connects_total %u\n", wifiLink.connects); break;
+          case 28: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_wifi_drops_total counter\ngpio_wifi_drops_total %u\n", wifiLink.drops); break;
+          case 29: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_wifi_join_failures_total counter\ngpio_wifi_join_failures_total %u\n", wifiLink.failed); break;
+          case 30: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_wifi_last_outage_ms gauge\ngpio_wifi_last_outage_ms %u\n", wifiLink.lastOutageMs); break;
+          case 31: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_schedules_dropped_total counter\ngpio_schedules_dropped_total %u\n", scheduleDropped); break;
+          case 32: lineLen = snprintf(line, sizeof(line), "# TYPE gpio_pattern_writes_dropped_total counter\ngpio_pattern_writes_dropped_total %u\n", patternDropped); break;
+          default: phase = 6; return false;
+        }
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// Reads the optional ramp and shape parameters into a decoded command
+bool requestRamp(AsyncWebServerRequest *request, GpioCommand &cmd) {
+  long ms = request->hasParam("ramp") ? request->getParam("ramp")->value().toInt() : 0;
+  int shape = request->hasParam("shape") ? rampShapeFind(request->getParam("shape")->value().c_str()) : RAMP_LINEAR;
+  return decodeRamp(cmd, ms, shape);
+}
+
+void setup() {
+  ledcPoolBegin();
+
+  // Resume previous GPIO states before anything else, Wi-Fi can take seconds
+  persistBegin();
+  int restored = resumeStates();
+  restoreMicros = micros();
+  actuationBegin(); // restore above runs inline, before anything can queue
+  scenesBegin();
+
+  Serial.begin(115200);
+  Serial.println("Starting setup...");
+  Serial.print("Resumed ");
+  Serial.print(restored);
+  Serial.print(" GPIO states ");
+  Serial.print(restoreMicros);
+  Serial.println(" us after boot");
+
+  // Join Wi-Fi in the background; routes are registered meanwhile and
+  // answer as soon as the link is up
+  wifiBegin();
+
+  cyclesPerMicro = getCpuFrequencyMhz();
+
+  // Start the scheduler
+  schedulerBegin();
+  preciseBegin();
+
+  // Blink patterns
+  patternsBegin();
+
+  // PWM fades
+  rampsBegin();
+
+  // ADC sampling stays idle until /sample configures a channel
+  adcBegin();
+
+  // Pulse counters, polled only while /counter has bound a pin
+  countersBegin();
+
+  // Serve the dashboard page and its assets
+  for (const WebAsset &asset : webAssets) {
+    server.on(asset.path, HTTP_GET, [&asset](AsyncWebServerRequest *request){
+      RouteTimer timer(ROUTE_INDEX);
+      sendAsset(request, asset);
+    });
+  }
 
   // Set GPIO
   server.on("/setgpio", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_SETGPIO);
     if (request->hasParam("gpio") && request->hasParam("state")) {
       int gpio = request->getParam("gpio")->value().toInt();
-      String state = request->getParam("state")->value();
-
-      if (gpio >= 0 && gpio <= 33) { // Assuming GPIO 0-33 for ESP32
-        pinMode(gpio, OUTPUT); // Set the pin mode dynamically
-        if (state == "high") {
-          digitalWrite(gpio, HIGH);
-          DynamicJsonDocument jsonResponse(1024);
-          jsonResponse["gpio"] = gpio;
-          jsonResponse["state"] = "HIGH";
-          jsonResponse["status"] = "success";
-          String response;
-          serializeJson(jsonResponse, response);
-          request->send(200, "application/json", response);
-        } else if (state == "low") {
-          digitalWrite(gpio, LOW);
-          DynamicJsonDocument jsonResponse(1024);
-          jsonResponse["gpio"] = gpio;
-          jsonResponse["state"] = "LOW";
-          jsonResponse["status"] = "success";
-          String response;
-          serializeJson(jsonResponse, response);
-          request->send(200, "application/json", response);
-        } else if (state.startsWith("pwm")) {
-          int pwmValue = state.substring(3).toInt();
-          ledcAttachPin(gpio, gpio); // Attach PWM to the pin
-          ledcSetup(gpio, 5000, 8); // 5 kHz PWM with 8-bit resolution
-          ledcWrite(gpio, pwmValue);
-          DynamicJsonDocument jsonResponse(1024);
-          jsonResponse["gpio"] = gpio;
-          jsonResponse["state"] = "PWM";
-          jsonResponse["pwm_value"] = pwmValue;
-          jsonResponse["status"] = "success";
-          String response;
-          serializeJson(jsonResponse, response);
-          request->send(200, "application/json", response);
+      const String &state = request->getParam("state")->value();
+      uint32_t frequency = request->hasParam("freq") ? request->getParam("freq")->value().toInt() : PWM_DEFAULT_FREQ;
+      int resolution = request->hasParam("res") ? request->getParam("res")->value().toInt() : PWM_DEFAULT_RESOLUTION;
+
+      if (pinCanOutput(gpio)) {
+        if (refuseClaimed(request, gpio)) {
+          return;
+        }
+        GpioCommand cmd;
+        if (!decodeCommand(gpio, state.c_str(), cmd, frequency, resolution)) {
+          sendJson(request, 400, "{\"error\":\"Invalid state value\",\"status\":\"failure\"}");
+          return;
+        }
+        if (!requestRamp(request, cmd)) {
+          sendJson(request, 400, "{\"error\":\"Invalid ramp\",\"status\":\"failure\"}");
+          return;
+        }
+        if (refuseFailed(request, executeCommand(cmd))) {
+          return;
+        }
+        if (cmd.op == OP_PWM) {
+          sendJsonf(request, 200, "{\"gpio\":%d,\"state\":\"PWM\",\"pwm_value\":%u,\"frequency\":%u,\"resolution\":%u,\"ramp\":%u,\"status\":\"success\"}",
+                    gpio, cmd.duty, cmd.frequency, cmd.resolution, cmd.ramp);
         } else {
-          request->send(400, "application/json", "{\"error\":\"Invalid state value\",\"status\":\"failure\"}");
+          sendJsonf(request, 200, "{\"gpio\":%d,\"state\":\"%s\",\"status\":\"success\"}",
+                    gpio, cmd.op == OP_HIGH ? "HIGH" : "LOW");
         }
 
         // Store the operation state
-        preferences.begin("gpio-states", false);
-        preferences.putString(String(gpio).c_str(), state);
-        preferences.end();
+        storeCommand(cmd);
 
       } else {
-        request->send(400, "application/json", "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}");
+        sendJson(request, 400, "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}");
       }
     } else {
-      request->send(400, "application/json", "{\"error\":\"GPIO or state parameter missing\",\"status\":\"failure\"}");
+      sendJson(request, 400, "{\"error\":\"GPIO or state parameter missing\",\"status\":\"failure\"}");
     }
   });
 
   // Schedule Operation
   server.on("/schedule", HTTP_GET, [](AsyncWebServerRequest *request){
-    if (request->hasParam("gpio") && request->hasParam("state") && request->hasParam("delay")) {
-      operationArgs.gpio = request->getParam("gpio")->value().toInt();
-      operationArgs.state = request->getParam("state")->value();
-      int delayMs = request->getParam("delay")->value().toInt();
-      operationArgs.duration = request->hasParam("duration") ? request->getParam("duration")->value().toInt() : 0;
-
-      Serial.print("Scheduling operation: GPIO=");
-      Serial.print(operationArgs.gpio);
+    RouteTimer timer(ROUTE_SCHEDULE);
+    bool precise = request->hasParam("delay_us");
+    if (request->hasParam("gpio") && request->hasParam("state") && (request->hasParam("delay") || precise)) {
+      int gpio = request->getParam("gpio")->value().toInt();
+      const String &state = request->getParam("state")->value();
+      const char* delayName = precise ? "delay_us" : "delay";
+      const char* durationName = precise ? "duration_us" : "duration";
+      int wait = request->getParam(delayName)->value().toInt(); // ms, or us when precise
+      int duration = request->hasParam(durationName) ? request->getParam(durationName)->value().toInt() : 0;
+      uint32_t frequency = request->hasParam("freq") ? request->getParam("freq")->value().toInt() : PWM_DEFAULT_FREQ;
+      int resolution = request->hasParam("res") ? request->getParam("res")->value().toInt() : PWM_DEFAULT_RESOLUTION;
+
+      if (!pinCanOutput(gpio)) {
+        sendJson(request, 400, "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}");
+        return;
+      }
+      if (refuseClaimed(request, gpio)) {
+        return;
+      }
+      GpioCommand cmd;
+      if (!decodeCommand(gpio, state.c_str(), cmd, frequency, resolution)) {
+        sendJson(request, 400, "{\"error\":\"Invalid state value\",\"status\":\"failure\"}");
+        return;
+      }
+      if (wait < 0 || duration < 0) {
+        sendJson(request, 400, "{\"error\":\"Invalid delay or duration\",\"status\":\"failure\"}");
+        return;
+      }
+      if (!requestRamp(request, cmd)) {
+        sendJson(request, 400, "{\"error\":\"Invalid ramp\",\"status\":\"failure\"}");
+        return;
+      }
+      if (precise && cmd.op == OP_PWM) {
+        sendJson(request, 400, "{\"error\":\"Precise mode takes high or low\",\"status\":\"failure\"}");
+        return;
+      }
+      if (precise && preciseTimer == NULL) {
+        sendJson(request, 501, "{\"error\":\"No hardware timer for precise pulses\",\"status\":\"failure\"}");
+        return;
+      }
+      cmd.duration = duration;
+
+      uint32_t id = precise ? preciseAdd(cmd, wait, duration) : scheduleAdd(cmd, wait);
+      if (id == 0) {
+        sendJson(request, 503, "{\"error\":\"Scheduler full\",\"status\":\"failure\"}");
+        return;
+      }
+
+      Serial.print("Scheduling operation: ID=");
+      Serial.print(id);
+      Serial.print(", GPIO=");
+      Serial.print(gpio);
       Serial.print(", State=");
-      Serial.print(operationArgs.state);
-      Serial.print(", Delay=");
-      Serial.print(delayMs);
-      Serial.print(", Duration=");
-      Serial.println(operationArgs.duration);
-
-      scheduler.once_ms(delayMs, scheduleOperation);
-      request->send(200, "application/json", "{\"status\":\"scheduled\"}");
+      Serial.print(state);
+      Serial.print(precise ? ", Delay us=" : ", Delay=");
+      Serial.print(wait);
+      Serial.print(precise ? ", Duration us=" : ", Duration=");
+      Serial.println(duration);
+
+      sendJsonf(request, 200, "{\"id\":%u,\"status\":\"scheduled\"}", id);
     } else {
-      request->send(400, "application/json", "{\"error\":\"gpio, state, or delay parameter missing\",\"status\":\"failure\"}");
+      sendJson(request, 400, "{\"error\":\"gpio, state, or delay parameter missing\",\"status\":\"failure\"}");
+    }
+  });
+
+  // List Scheduled Operations
+  server.on("/schedules", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_SCHEDULES);
+    int gpioFilter = request->hasParam("gpio") ? request->getParam("gpio")->value().toInt() : -1;
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"scheduled\":[");
+    bool first = true;
+    for (int i = 0; i < SCHEDULER_CAPACITY; i++) {
+      portENTER_CRITICAL(&schedulerMux);
+      ScheduledEntry entry = scheduleEntries[i];
+      uint32_t now = wheelNow;
+      portEXIT_CRITICAL(&schedulerMux);
+      if (entry.phase == PHASE_FREE || (gpioFilter >= 0 && entry.cmd.gpio != gpioFilter)) {
+        continue;
+      }
+      char state[12];
+      formatState(entry.cmd, state, sizeof(state));
+      int32_t dueIn = (int32_t)(entry.expires - now);
+      response->printf("%s{\"id\":%u,\"gpio\":%u,\"state\":\"%s\",\"phase\":\"%s\",\"due_in\":%d,\"duration\":%u}",
+                       first ? "" : ",", entry.id, entry.cmd.gpio, state,
+                       entry.phase == PHASE_SET ? "set" : "reset", dueIn > 0 ? dueIn : 0, entry.cmd.duration);
+      first = false;
+    }
+    response->printf("],\"pending\":%u,\"capacity\":%u,\"dropped\":%u}", pendingEntries, SCHEDULER_CAPACITY, scheduleDropped);
+    request->send(response);
+  });
+
+  // List Precise Pulses
+  server.on("/precise", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_PRECISE);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"pending\":[");
+    int64_t now = esp_timer_get_time();
+    bool first = true;
+    for (int i = 0; i < PRECISE_CAPACITY; i++) {
+      portENTER_CRITICAL(&preciseMux);
+      PreciseEntry entry = preciseEntries[i];
+      portEXIT_CRITICAL(&preciseMux);
+      if (entry.id == 0) {
+        continue;
+      }
+      int64_t dueIn = entry.deadline - now;
+      response->printf("%s{\"id\":%u,\"gpio\":%u,\"state\":\"%s\",\"phase\":\"%s\",\"due_in_us\":%lld,\"duration_us\":%u}",
+                       first ? "" : ",", entry.id, entry.gpio, entry.op == OP_HIGH ? "high" : "low",
+                       entry.phase == PHASE_SET ? "set" : "reset", (long long)(dueIn > 0 ? dueIn : 0), entry.duration);
+      first = false;
+    }
+    response->print("],\"edges\":[");
+    portENTER_CRITICAL(&preciseMux);
+    uint32_t fired = preciseFired;
+    portEXIT_CRITICAL(&preciseMux);
+    uint32_t shown = fired < PRECISE_LOG ? fired : PRECISE_LOG;
+    for (uint32_t n = fired - shown; n != fired; n++) {
+      portENTER_CRITICAL(&preciseMux);
+      PreciseEdge edge = preciseLog[n % PRECISE_LOG];
+      portEXIT_CRITICAL(&preciseMux);
+      bool level = (edge.op == OP_HIGH) == (edge.phase == PHASE_SET);
+      response->printf("%s{\"id\":%u,\"gpio\":%u,\"level\":\"%s\",\"phase\":\"%s\",\"lateness_us\":%d}",
+                       n == fired - shown ? "" : ",", edge.id, edge.gpio, level ? "HIGH" : "LOW",
+                       edge.phase == PHASE_SET ? "set" : "reset", edge.lateness);
+    }
+    response->printf("],\"fired\":%u,\"skipped\":%u,\"lead_us\":%d,\"capacity\":%u}", fired, preciseSkipped,
+                     preciseLead / 8, PRECISE_CAPACITY);
+    request->send(response);
+  });
+
+  // Cancel Scheduled Operation
+  server.on("/cancel", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_CANCEL);
+    if (request->hasParam("id")) {
+      uint32_t id = strtoul(request->getParam("id")->value().c_str(), NULL, 10);
+      if (scheduleCancel(id)) {
+        sendJsonf(request, 200, "{\"id\":%u,\"status\":\"cancelled\"}", id);
+      } else {
+        sendJson(request, 404, "{\"error\":\"Schedule not found\",\"status\":\"failure\"}");
+      }
+    } else {
+      sendJson(request, 400, "{\"error\":\"id parameter missing\",\"status\":\"failure\"}");
     }
   });
 
   // Batch Operation
   server.on("/batch", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_BATCH);
     if (request->hasParam("operations")) {
-      String operationsParam = request->getParam("operations")->value();
-      DynamicJsonDocument doc(1024);
-      deserializeJson(doc, operationsParam);
-      JsonArray operations = doc.as<JsonArray>();
-
-      for (JsonVariant operation : operations) {
-        int gpio = operation["gpio"];
-        String state = operation["state"];
-        pinMode(gpio, OUTPUT);
-        if (state == "high") {
-          digitalWrite(gpio, HIGH);
-        } else if (state == "low") {
-          digitalWrite(gpio, LOW);
-        } else if (state.startsWith("pwm")) {
-          int pwmValue = state.substring(3).toInt();
-          ledcAttachPin(gpio, gpio);
-          ledcSetup(gpio, 5000, 8);
-          ledcWrite(gpio, pwmValue);
+      const String &operations = request->getParam("operations")->value();
+      BatchParser parser;
+      batchBegin(parser);
+      batchFeed(parser, operations.c_str(), operations.length());
+      sendBatchResult(request, parser);
+    } else {
+      sendJson(request, 400, "{\"error\":\"operations parameter missing\",\"status\":\"failure\"}");
+    }
+  });
+
+  // Batch Operations (POST body, applied while it streams in)
+  server.on("/batch", HTTP_POST, [](AsyncWebServerRequest *request){
+    batchPostResult(request);
+  }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t){
+    RouteTimer timer(ROUTE_BATCH); // the operations run as the body arrives
+    batchPostBody(request, data, len, index);
+  });
+
+  // Define Pin Group
+  server.on("/group", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_GROUP);
+    if (request->hasParam("name") && request->hasParam("pins")) {
+      const String &name = request->getParam("name")->value();
+      uint32_t mask[GPIO_BANKS];
+      if (name.length() == 0 || name.length() >= GROUP_NAME_LEN) {
+        sendJson(request, 400, "{\"error\":\"Invalid group name\",\"status\":\"failure\"}");
+        return;
+      }
+      if (!parsePinList(request->getParam("pins")->value().c_str(), mask)) {
+        sendJson(request, 400, "{\"error\":\"Invalid pin list\",\"status\":\"failure\"}");
+        return;
+      }
+      PinGroup* group = findPinGroup(name.c_str());
+      if (group == NULL) {
+        if (pinGroupCount == MAX_PIN_GROUPS) {
+          sendJson(request, 507, "{\"error\":\"Too many groups\",\"status\":\"failure\"}");
+          return;
         }
+        group = &pinGroups[pinGroupCount++];
+        strcpy(group->name, name.c_str());
+      }
+      memcpy(group->mask, mask, sizeof(mask));
+      sendJson(request, 200, "{\"status\":\"success\"}");
+    } else {
+      sendJson(request, 400, "{\"error\":\"name or pins parameter missing\",\"status\":\"failure\"}");
+    }
+  });
 
-        // Store the operation state
-        preferences.begin("gpio-states", false);
-        preferences.putString(String(gpio).c_str(), state);
-        preferences.end();
+  // LEDC Channel Allocation
+  server.on("/ledc", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_LEDC);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"channels\":[");
+    for (int channel = 0; channel < LEDC_CHANNELS; channel++) {
+      portENTER_CRITICAL(&gpioMux);
+      uint8_t gpio = ledcChannelPin[channel];
+      LedcTimer timer = ledcTimers[channel / 2];
+      portEXIT_CRITICAL(&gpioMux);
+      response->printf("%s{\"channel\":%d,\"gpio\":%d,\"frequency\":%u,\"resolution\":%u}",
+                       channel ? "," : "", channel, gpio == LEDC_NONE ? -1 : gpio,
+                       timer.users ? timer.frequency : 0, timer.users ? timer.resolution : 0);
+    }
+    response->printf("],\"reconfigurations\":%u}", ledcReconfigs);
+    request->send(response);
+  });
+
+  // List PWM Fades
+  server.on("/ramps", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_RAMPS);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"ramps\":[");
+    uint32_t now = millis();
+    bool first = true;
+    for (int i = 0; i < MAX_RAMPS; i++) {
+      portENTER_CRITICAL(&gpioMux);
+      Ramp ramp = ramps[i];
+      bool running = ramp.gpio != RAMP_NONE && (rampPins[ramp.gpio >> 5] & (1UL << (ramp.gpio & 31)));
+      uint16_t duty = running ? pinDuty[ramp.gpio] : 0;
+      portEXIT_CRITICAL(&gpioMux);
+      if (!running) {
+        continue;
+      }
+      uint32_t elapsed = ramp.started ? now - ramp.start : 0;
+      response->printf("%s{\"gpio\":%u,\"from\":%u,\"to\":%u,\"duty\":%u,\"shape\":\"%s\",\"length\":%u,\"remaining\":%u}",
+                       first ? "" : ",", ramp.gpio, ramp.from, ramp.to, duty, rampShapeNames[ramp.shape], ramp.length,
+                       elapsed < ramp.length ? ramp.length - elapsed : 0);
+      first = false;
+    }
+    response->printf("],\"tick_ms\":%d,\"step_us\":%u,\"step_max_us\":%u}", RAMP_TICK_MS, rampTickUs, rampTickMaxUs);
+    request->send(response);
+  });
+
+  // Actuation Queue
+  server.on("/queue", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_QUEUE);
+    uint32_t head = __atomic_load_n(&actuationHead, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&actuationTail, __ATOMIC_RELAXED);
+    uint32_t executed = __atomic_load_n(&actuationExecuted, __ATOMIC_RELAXED);
+    uint64_t latencySum = actuationLatencySum;
+    sendJsonf(request, 200, "{\"size\":%d,\"depth\":%u,\"max_depth\":%u,\"enqueued\":%u,\"executed\":%u,"
+              "\"full_waits\":%u,\"dropped\":%u,\"latency_avg_us\":%u,\"latency_max_us\":%u,\"core\":%d}",
+              ACTUATION_QUEUE_SIZE, tail - head, actuationMaxDepth, actuationEnqueued, executed, actuationFullWaits,
+              actuationDropped, executed ? (uint32_t)(latencySum / executed) : 0, actuationLatencyMax, ACTUATION_CORE);
+  });
+
+  // List Pin Groups
+  server.on("/groups", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_GROUPS);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"groups\":[");
+    for (int i = 0; i < pinGroupCount; i++) {
+      response->printf("%s{\"name\":\"%s\",\"pins\":[", i ? "," : "", pinGroups[i].name);
+      bool first = true;
+      for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+        if (pinGroups[i].mask[gpio >> 5] & (1UL << (gpio & 31))) {
+          response->printf("%s%d", first ? "" : ",", gpio);
+          first = false;
+        }
+      }
+      response->print("]}");
+    }
+    response->print("]}");
+    request->send(response);
+  });
+
+  // Save, Apply or Delete a Scene
+  server.on("/scene", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_SCENE);
+    if (!request->hasParam("name")) {
+      sendJson(request, 400, "{\"error\":\"name parameter missing\",\"status\":\"failure\"}");
+      return;
+    }
+    const String &name = request->getParam("name")->value();
+    Scene* found = findScene(name.c_str());
+
+    if (request->hasParam("operations")) {
+      if (name.length() == 0 || name.length() >= SCENE_NAME_LEN) {
+        sendJson(request, 400, "{\"error\":\"Invalid scene name\",\"status\":\"failure\"}");
+        return;
+      }
+      int slot = found ? found - scenes : -1;
+      for (int i = 0; i < MAX_SCENES && slot < 0; i++) {
+        if (scenes[i].header.name[0] == '\0') {
+          slot = i;
+        }
+      }
+      if (slot < 0) {
+        sendJson(request, 507, "{\"error\":\"Too many scenes\",\"status\":\"failure\"}");
+        return;
+      }
+      const String &operations = request->getParam("operations")->value();
+      Scene scene;
+      sceneBegin(scene, name.c_str());
+      BatchParser parser;
+      batchBegin(parser);
+      parser.scene = &scene;
+      batchFeed(parser, operations.c_str(), operations.length());
+      if (parser.state != BATCH_DONE) {
+        sendJsonf(request, 400, "{\"error\":\"Malformed operations\",\"offset\":%u,\"status\":\"failure\"}", parser.offset);
+        return;
       }
-      request->send(200, "application/json", "{\"status\":\"success\"}");
+      if (parser.failed) {
+        sendJsonf(request, 400, "{\"error\":\"%s\",\"index\":%u,\"status\":\"failure\"}",
+                  batchErrorText(parser.errorCode[0]), parser.errorIndex[0]);
+        return;
+      }
+      uint8_t blob[sizeof(Scene)];
+      sceneStore(slot, scene);
+      sendJsonf(request, 200, "{\"scene\":\"%s\",\"digital\":%d,\"pwm\":%u,\"resets\":%u,\"bytes\":%u,\"status\":\"success\"}",
+                scene.header.name, sceneDigitalPins(scene), scene.header.pwmCount, scene.header.resetCount,
+                (unsigned)sceneEncode(scene, blob));
+      return;
+    }
+
+    if (found == NULL) {
+      sendJson(request, 404, "{\"error\":\"Scene not found\",\"status\":\"failure\"}");
+    } else if (request->hasParam("delete")) {
+      Scene empty = {};
+      sceneStore(found - scenes, empty);
+      sendJson(request, 200, "{\"status\":\"deleted\"}");
+    } else if (sceneClaimed(*found)) {
+      sendJson(request, 409, CLAIMED_REPLY);
     } else {
-      request->send(400, "application/json", "{\"error\":\"operations parameter missing\",\"status\":\"failure\"}");
+      uint32_t start = micros();
+      ActuationResult result = sceneApply(*found);
+      uint32_t elapsed = micros() - start;
+      if (refuseFailed(request, result)) {
+        return;
+      }
+      sendJsonf(request, 200, "{\"scene\":\"%s\",\"apply_us\":%u,\"status\":\"success\"}", found->header.name, elapsed);
     }
   });
 
+  // List Scenes
+  server.on("/scenes", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_SCENES);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"scenes\":[");
+    bool first = true;
+    for (int i = 0; i < MAX_SCENES; i++) {
+      const Scene &scene = scenes[i];
+      if (scene.header.name[0] == '\0') continue;
+      response->printf("%s{\"name\":\"%s\",\"digital\":%d,\"pwm\":%u,\"resets\":%u}", first ? "" : ",",
+                       scene.header.name, sceneDigitalPins(scene), scene.header.pwmCount, scene.header.resetCount);
+      first = false;
+    }
+    response->printf("],\"capacity\":%d,\"applied\":%u}", MAX_SCENES, sceneApplies);
+    request->send(response);
+  });
+
   // Blink GPIO
   server.on("/blink", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_BLINK);
     if (request->hasParam("gpio") && request->hasParam("interval")) {
-      blinkPin = request->getParam("gpio")->value().toInt();
-      blinkInterval = request->getParam("interval")->value().toInt();
+      int gpio = request->getParam("gpio")->value().toInt();
+      int interval = request->getParam("interval")->value().toInt();
+      GpioCommand cmd;
+      if (refuseClaimed(request, gpio)) {
+        return;
+      }
+      if (!decodeCommand(gpio, "low", cmd) || interval <= 0) {
+        sendJson(request, 400, "{\"error\":\"Invalid GPIO pin or interval\",\"status\":\"failure\"}");
+        return;
+      }
 
       Serial.print("Setting GPIO ");
-      Serial.print(blinkPin);
+      Serial.print(gpio);
       Serial.print(" to blink with interval ");
-      Serial.println(blinkInterval);
+      Serial.println(interval);
+
+      // Toggles every interval: a 50% pattern of twice the interval
+      if (!patternStart(gpio, 2 * interval, 50, 0, 0)) {
+        sendJson(request, 507, "{\"error\":\"Too many patterns\",\"status\":\"failure\"}");
+        return;
+      }
+      sendJson(request, 200, "{\"status\":\"success\"}");
+    } else {
+      sendJson(request, 400, "{\"error\":\"gpio or interval parameter missing\",\"status\":\"failure\"}");
+    }
+  });
 
-      pinMode(blinkPin, OUTPUT);
-      blinkOperation();
-      request->send(200, "application/json", "{\"status\":\"success\"}");
+  // Start Pattern
+  server.on("/pattern", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_PATTERN);
+    if (request->hasParam("gpio") && request->hasParam("period")) {
+      int gpio = request->getParam("gpio")->value().toInt();
+      long period = request->getParam("period")->value().toInt();
+      int duty = request->hasParam("duty") ? request->getParam("duty")->value().toInt() : 50;
+      long phase = request->hasParam("phase") ? request->getParam("phase")->value().toInt() : 0;
+      long repeat = request->hasParam("repeat") ? request->getParam("repeat")->value().toInt() : 0;
+      GpioCommand cmd;
+      if (refuseClaimed(request, gpio)) {
+        return;
+      }
+      if (!decodeCommand(gpio, "low", cmd)) {
+        sendJson(request, 400, "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}");
+        return;
+      }
+      if (period < 2 || duty < 1 || duty > 99 || phase < 0 || repeat < 0) {
+        sendJson(request, 400, "{\"error\":\"Invalid pattern\",\"status\":\"failure\"}");
+        return;
+      }
+      if (!patternStart(gpio, period, duty, phase, repeat)) {
+        sendJson(request, 507, "{\"error\":\"Too many patterns\",\"status\":\"failure\"}");
+        return;
+      }
+      sendJson(request, 200, "{\"status\":\"success\"}");
     } else {
-      request->send(400, "application/json", "{\"error\":\"gpio or interval parameter missing\",\"status\":\"failure\"}");
+      sendJson(request, 400, "{\"error\":\"gpio or period parameter missing\",\"status\":\"failure\"}");
+    }
+  });
+
+  // Stop Pattern
+  server.on("/stop", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_STOP);
+    int gpio = request->hasParam("gpio") ? request->getParam("gpio")->value().toInt() : -1;
+    int stopped = patternStop(gpio);
+    if (stopped == 0 && gpio >= 0) {
+      sendJson(request, 404, "{\"error\":\"No pattern on this pin\",\"status\":\"failure\"}");
+      return;
+    }
+    sendJsonf(request, 200, "{\"stopped\":%d,\"status\":\"success\"}", stopped);
+  });
+
+  // List Patterns
+  server.on("/patterns", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_PATTERNS);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"patterns\":[");
+    bool first = true;
+    for (int i = 0; i < MAX_PATTERNS; i++) {
+      portENTER_CRITICAL(&patternMux);
+      Pattern pattern = patterns[i];
+      portEXIT_CRITICAL(&patternMux);
+      if (pattern.gpio == PATTERN_NONE) continue;
+      response->printf("%s{\"gpio\":%d,\"period\":%u,\"duty\":%d,\"phase\":%u,\"repeat\":%u,\"cycles\":%u,\"level\":%d}",
+                       first ? "" : ",", pattern.gpio, pattern.period, pattern.duty, pattern.phase,
+                       pattern.repeat, pattern.cycles, pattern.level ? 1 : 0);
+      first = false;
     }
+    response->printf("],\"capacity\":%d,\"dropped\":%u}", MAX_PATTERNS, patternDropped);
+    request->send(response);
   });
 
   // Read Analog Value
   server.on("/readadc", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_READADC);
     if (request->hasParam("gpio")) {
       int gpio = request->getParam("gpio")->value().toInt();
+      if (!pinAdcUsable(gpio)) {
+        sendJson(request, 400, "{\"error\":\"Invalid ADC pin\",\"status\":\"failure\"}");
+        return;
+      }
       int adcValue = analogRead(gpio);
-
-      DynamicJsonDocument jsonResponse(1024);
-      jsonResponse["gpio"] = gpio;
-      jsonResponse["adc_value"] = adcValue;
-      String response;
-      serializeJson(jsonResponse, response);
-      request->send(200, "application/json", response);
+      sendJsonf(request, 200, "{\"gpio\":%d,\"adc_value\":%d}", gpio, adcValue);
     } else {
-      request->send(400, "application/json", "{\"error\":\"gpio parameter missing\",\"status\":\"failure\"}");
+      sendJson(request, 400, "{\"error\":\"gpio parameter missing\",\"status\":\"failure\"}");
     }
   });
 
+  // Configure ADC Sampling
+  server.on("/sample", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_SAMPLE);
+    if (request->hasParam("gpio") && request->hasParam("rate")) {
+      int gpio = request->getParam("gpio")->value().toInt();
+      int rate = request->getParam("rate")->value().toInt();
+      int oversample = request->hasParam("oversample") ? request->getParam("oversample")->value().toInt() : 1;
+      int window = request->hasParam("window") ? request->getParam("window")->value().toInt() : 0;
+      int code = rate < 0 ? 400 : adcConfigure(gpio, rate, oversample, window);
+      if (code == 400) {
+        sendJson(request, 400, "{\"error\":\"Invalid sampling parameters\",\"status\":\"failure\"}");
+      } else if (code == 404) {
+        sendJson(request, 404, "{\"error\":\"Pin is not sampled\",\"status\":\"failure\"}");
+      } else if (code == 503) {
+        sendJson(request, 503, "{\"error\":\"Sampling rate too high\",\"status\":\"failure\"}");
+      } else if (code == 507) {
+        sendJson(request, 507, "{\"error\":\"Too many channels\",\"status\":\"failure\"}");
+      } else {
+        sendJson(request, 200, "{\"status\":\"success\"}");
+      }
+      return;
+    }
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"channels\":[");
+    bool first = true;
+    for (int i = 0; i < ADC_MAX_CHANNELS; i++) {
+      portENTER_CRITICAL(&adcMux);
+      AdcChannel channel = adcConfig[i];
+      portEXIT_CRITICAL(&adcMux);
+      if (channel.gpio == ADC_NONE) continue;
+      response->printf("%s{\"gpio\":%d,\"rate\":%d,\"oversample\":%d,\"window\":%d}", first ? "" : ",",
+                       channel.gpio, ADC_TICK_HZ / channel.interval, channel.oversample, channel.window);
+      first = false;
+    }
+    response->printf("],\"next\":%u,\"overruns\":%u,\"capacity\":%d}",
+                     __atomic_load_n(&adcHead, __ATOMIC_ACQUIRE), adcOverruns, ADC_RING_SIZE);
+    request->send(response);
+  });
+
+  // Read ADC Samples
+  server.on("/samples", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_SAMPLES);
+    SampleStream stream = {};
+    uint32_t head = __atomic_load_n(&adcHead, __ATOMIC_ACQUIRE);
+    uint32_t oldest = head > ADC_RING_SIZE ? head - ADC_RING_SIZE : 0;
+    uint32_t since = request->hasParam("since") ? strtoul(request->getParam("since")->value().c_str(), NULL, 10) : oldest;
+    if (since > head) {
+      since = head;
+    }
+    stream.next = since < oldest ? oldest : since;
+    stream.end = head;
+    stream.dropped = stream.next - since;
+    stream.gpio = request->hasParam("gpio") ? request->getParam("gpio")->value().toInt() : -1;
+    stream.first = true;
+    request->send(request->beginChunkedResponse("application/json", [stream](uint8_t *buffer, size_t maxLen, size_t) mutable -> size_t {
+      return fillChunk(stream, buffer, maxLen);
+    }));
+  });
+
+  // Configure Edge Capture
+  server.on("/edge", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_EDGE);
+    if (request->hasParam("gpio") && request->hasParam("mode")) {
+      int gpio = request->getParam("gpio")->value().toInt();
+      const String &modeName = request->getParam("mode")->value();
+      const String pullName = request->hasParam("pull") ? request->getParam("pull")->value() : "none";
+      long debounce = request->hasParam("debounce") ? request->getParam("debounce")->value().toInt() : 0;
+      int mode = EDGE_MODES;
+      for (int i = 0; i < EDGE_MODES; i++) {
+        if (modeName == edgeModeNames[i]) mode = i;
+      }
+      uint8_t pull = pullName == "up" ? INPUT_PULLUP : pullName == "down" ? INPUT_PULLDOWN : INPUT;
+      int code = debounce < 0 || (pull == INPUT && pullName != "none") ? 400 : edgeConfigure(gpio, mode, pull, debounce);
+      if (code == 400) {
+        sendJson(request, 400, "{\"error\":\"Invalid edge capture parameters\",\"status\":\"failure\"}");
+      } else if (code == 404) {
+        sendJson(request, 404, "{\"error\":\"Pin is not captured\",\"status\":\"failure\"}");
+      } else {
+        sendJson(request, 200, "{\"status\":\"success\"}");
+      }
+      return;
+    }
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"pins\":[");
+    bool first = true;
+    for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+      const EdgePin &pin = edgePins[gpio];
+      if (pin.mode == EDGE_OFF) continue;
+      response->printf("%s{\"gpio\":%d,\"mode\":\"%s\",\"pull\":\"%s\",\"debounce\":%u,\"edges\":%u,\"bounces\":%u}",
+                       first ? "" : ",", gpio, edgeModeNames[pin.mode],
+                       pin.pull == INPUT_PULLUP ? "up" : pin.pull == INPUT_PULLDOWN ? "down" : "none", pin.debounce,
+                       pin.edges, pin.bounces);
+      first = false;
+    }
+    response->printf("],\"next\":%u,\"ring\":%d,\"overflows\":%u,\"lost\":%u}",
+                     __atomic_load_n(&edgeHead, __ATOMIC_ACQUIRE), EDGE_RING_SIZE, edgeOverflows, edgeLost);
+    request->send(response);
+  });
+
+  // Read Captured Edges
+  server.on("/edges", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_EDGES);
+    EdgeStream stream = {};
+    uint32_t head = __atomic_load_n(&edgeHead, __ATOMIC_ACQUIRE);
+    uint32_t since = request->hasParam("since") ? strtoul(request->getParam("since")->value().c_str(), NULL, 10) :
+                     head > EDGE_RING_SIZE ? head - EDGE_RING_SIZE : 0;
+    long max = request->hasParam("max") ? request->getParam("max")->value().toInt() : EDGE_BATCH_MAX;
+    long wait = request->hasParam("wait") ? request->getParam("wait")->value().toInt() : 0;
+    stream.next = since > head ? head : since;
+    stream.max = max < 1 || max > EDGE_BATCH_MAX ? EDGE_BATCH_MAX : max;
+    stream.deadline = millis() + (wait < 0 ? 0 : wait > EDGE_WAIT_MAX_MS ? EDGE_WAIT_MAX_MS : wait);
+    stream.waiting = true;
+    stream.gpio = request->hasParam("gpio") ? request->getParam("gpio")->value().toInt() : -1;
+    stream.first = true;
+    request->send(request->beginChunkedResponse("application/json", [stream](uint8_t *buffer, size_t maxLen, size_t) mutable -> size_t {
+      if (!stream.ready()) {
+        return RESPONSE_TRY_AGAIN; // asked again on the next poll of the connection, within 500 ms
+      }
+      return fillChunk(stream, buffer, maxLen);
+    }));
+  });
+
+  // Configure Pulse Counter
+  server.on("/counter", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_COUNTER);
+    if (request->hasParam("gpio") && request->hasParam("mode")) {
+      int gpio = request->getParam("gpio")->value().toInt();
+      const String &modeName = request->getParam("mode")->value();
+      int ctrl = request->hasParam("ctrl") ? request->getParam("ctrl")->value().toInt() : -1;
+      long filter = request->hasParam("filter") ? request->getParam("filter")->value().toInt() : 0;
+      long window = request->hasParam("window") ? request->getParam("window")->value().toInt() : 1000;
+      long ppr = request->hasParam("ppr") ? request->getParam("ppr")->value().toInt() : 0;
+      int mode = EDGE_MODES;
+      for (int i = 0; i < EDGE_MODES; i++) {
+        if (modeName == edgeModeNames[i]) mode = i;
+      }
+      int code = filter < 0 || window < 0 || ppr < 0 ? 400 : counterConfigure(gpio, mode, ctrl, filter, window, ppr);
+      if (code == 400) {
+        sendJson(request, 400, "{\"error\":\"Invalid counter parameters\",\"status\":\"failure\"}");
+      } else if (code == 404) {
+        sendJson(request, 404, "{\"error\":\"Pin is not counted\",\"status\":\"failure\"}");
+      } else if (code == 409) {
+        sendJson(request, 409, "{\"error\":\"Pin is driven as an output\",\"status\":\"failure\"}");
+      } else if (code == 501) {
+        sendJson(request, 501, "{\"error\":\"No pulse counter on this chip\",\"status\":\"failure\"}");
+      } else if (code == 507) {
+        sendJson(request, 507, "{\"error\":\"Too many counters\",\"status\":\"failure\"}");
+      } else {
+        sendJson(request, 200, "{\"status\":\"success\"}");
+      }
+      return;
+    }
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"counters\":[");
+    bool first = true;
+    for (int unit = 0; unit < COUNTER_UNITS; unit++) {
+      portENTER_CRITICAL(&counterMux);
+      Counter counter = counters[unit];
+      portEXIT_CRITICAL(&counterMux);
+      if (counter.gpio == COUNTER_NONE) continue;
+      response->printf("%s{\"gpio\":%d,\"unit\":%d,\"mode\":\"%s\",\"ctrl\":%d,\"filter\":%u,\"window\":%u,\"ppr\":%u}",
+                       first ? "" : ",", counter.gpio, unit, edgeModeNames[counter.edge],
+                       counter.ctrl == COUNTER_NONE ? -1 : counter.ctrl, counter.filter, counter.window, counter.ppr);
+      first = false;
+    }
+    response->printf("],\"units\":%d,\"poll_us\":%d}", COUNTER_AVAILABLE, COUNTER_POLL_US);
+    request->send(response);
+  });
+
+  // Read Pulse Counters
+  server.on("/counters", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_COUNTERS);
+    int gpio = request->hasParam("gpio") ? request->getParam("gpio")->value().toInt() : -1;
+    bool reset = request->hasParam("reset") && request->getParam("reset")->value() != "0";
+    Counter snapshot[COUNTER_UNITS];
+    countersSnapshot(snapshot, gpio, reset);
+    uint32_t now = (uint32_t)esp_timer_get_time();
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"counters\":[");
+    bool first = true;
+    for (int unit = 0; unit < COUNTER_UNITS; unit++) {
+      const Counter &counter = snapshot[unit];
+      if (counter.gpio == COUNTER_NONE) continue;
+      float frequency = counter.lastUs ? counter.lastCount * 1e6f / counter.lastUs : 0;
+      response->printf("%s{\"gpio\":%d,\"count\":%lld,\"total\":%lld,\"frequency\":%.3f", first ? "" : ",",
+                       counter.gpio, (long long)(counter.total - counter.base), (long long)counter.total, frequency);
+      if (counter.ppr) {
+        response->printf(",\"rpm\":%.3f", frequency * 60 / counter.ppr);
+      }
+      response->print("}");
+      first = false;
+    }
+    response->printf("],\"time_us\":%u,\"reset\":%s}", now, reset ? "true" : "false");
+    request->send(response);
+  });
+
+  // Wi-Fi Link
+  server.on("/wifi", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_WIFI);
+    WifiLink link = wifiLink;
+    bool up = link.state == LINK_UP;
+    IPAddress ip = up ? WiFi.localIP() : IPAddress();
+    uint32_t waited = millis() - link.since;
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->printf("{\"state\":\"%s\",\"ip\":\"%u.%u.%u.%u\",\"static_ip\":%s,\"channel\":%d,\"rssi\":%d,\"cached\":%s,",
+                     linkStateNames[link.state], ip[0], ip[1], ip[2], ip[3], wifiStatic ? "true" : "false",
+                     up ? (int)WiFi.channel() : 0, up ? WiFi.RSSI() : 0, link.cached ? "true" : "false");
+    response->printf("\"connects\":%u,\"drops\":%u,\"failures\":%u,\"last_connect_ms\":%u,\"max_connect_ms\":%u,"
+                     "\"last_outage_ms\":%u,\"backoff_ms\":%u}",
+                     link.connects, link.drops, link.failed, link.lastConnectMs, link.maxConnectMs, link.lastOutageMs,
+                     link.state == LINK_BACKOFF && waited < link.wait ? link.wait - waited : 0);
+    request->send(response);
+  });
+
   // System Status
   server.on("/status", HTTP_GET, [](AsyncWebServerRequest *request){
-    DynamicJsonDocument jsonResponse(1024);
-    jsonResponse["uptime"] = esp_timer_get_time() / 1000000;
-    jsonResponse["free_heap"] = esp_get_free_heap_size();
-    jsonResponse["connected_clients"] = WiFi.softAPgetStationNum();
+    RouteTimer timer(ROUTE_STATUS);
+    // The sketch runs as a station, so softAP station counts are always 0;
+    // report the WebSocket clients instead
+    sendJsonf(request, 200, "{\"uptime\":%u,\"free_heap\":%u,\"connected_clients\":%d,\"rssi\":%d,\"restore_us\":%u}",
+              (uint32_t)(esp_timer_get_time() / 1000000), esp_get_free_heap_size(),
+              wsSubscriberCount, WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0, restoreMicros);
+  });
 
-    String response;
-    serializeJson(jsonResponse, response);
-    request->send(200, "application/json", response);
+  // Prometheus Metrics
+  server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_METRICS);
+    MetricsStream stream = {};
+    stream.freeHeap = esp_get_free_heap_size();
+    stream.minFreeHeap = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    stream.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    stream.rssi = WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0;
+    request->send(request->beginChunkedResponse("text/plain; version=0.0.4", [stream](uint8_t *buffer, size_t maxLen, size_t) mutable -> size_t {
+      return fillChunk(stream, buffer, maxLen);
+    }));
+  });
+
+  // List Pin Capabilities
+  server.on("/pins", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_PINS);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"pins\":[");
+    bool first = true;
+    for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+      uint8_t caps = pinTable[gpio].caps;
+      if (caps == 0) {
+        continue; // no such pin on this chip
+      }
+      response->printf("%s{\"gpio\":%d,\"input\":%s,\"output\":%s,\"strapping\":%s,\"flash\":%s,\"touch\":%s",
+                       first ? "" : ",", gpio, caps & PIN_INPUT ? "true" : "false", caps & PIN_OUTPUT ? "true" : "false",
+                       caps & PIN_STRAPPING ? "true" : "false", caps & PIN_FLASH ? "true" : "false",
+                       caps & PIN_TOUCH ? "true" : "false");
+      if (pinAdcUnit(gpio)) {
+        response->printf(",\"adc_unit\":%d,\"adc_channel\":%d", pinAdcUnit(gpio), pinAdcChannel(gpio));
+      }
+      response->print("}");
+      first = false;
+    }
+    response->print("]}");
+    request->send(response);
   });
 
   // Read GPIO State
   server.on("/readgpio", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_READGPIO);
     if (request->hasParam("gpio")) {
       int gpio = request->getParam("gpio")->value().toInt();
-      int state = digitalRead(gpio);
-
-      DynamicJsonDocument jsonResponse(1024);
-      jsonResponse["gpio"] = gpio;
-      jsonResponse["state"] = state == HIGH ? "HIGH" : "LOW";
-      String response;
-      serializeJson(jsonResponse, response);
-      request->send(200, "application/json", response);
+      if (!pinCanInput(gpio)) {
+        sendJson(request, 400, "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}");
+        return;
+      }
+      inputBegin(gpio, INPUT, false);
+      sendJsonf(request, 200, "{\"gpio\":%d,\"state\":\"%s\"}", gpio, pinLevel(gpio) ? "HIGH" : "LOW");
+    } else {
+      sendJson(request, 400, "{\"error\":\"gpio parameter missing\",\"status\":\"failure\"}");
+    }
+  });
+
+  // Read All GPIO
+  server.on("/readall", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_READALL);
+    uint32_t mask[GPIO_BANKS];
+    if (request->hasParam("group")) {
+      PinGroup* group = findPinGroup(request->getParam("group")->value().c_str());
+      if (group == NULL) {
+        sendJson(request, 404, "{\"error\":\"Unknown group\",\"status\":\"failure\"}");
+        return;
+      }
+      memcpy(mask, group->mask, sizeof(mask));
     } else {
-      request->send(400, "application/json", "{\"error\":\"gpio parameter missing\",\"status\":\"failure\"}");
+      for (int bank = 0; bank < GPIO_BANKS; bank++) {
+        mask[bank] = bank * 32 + 32 <= SOC_GPIO_PIN_COUNT ? 0xFFFFFFFF : (1UL << (SOC_GPIO_PIN_COUNT - bank * 32)) - 1;
+      }
     }
+    const String format = request->hasParam("format") ? request->getParam("format")->value() : "json";
+
+    PortSnapshot snap;
+    takeSnapshot(snap, mask);
+
+    if (format == "hex" || format == "bin") {
+      uint8_t packed[sizeof(PortSnapshot)];
+      size_t len = packSnapshot(snap, packed);
+      AsyncResponseStream *response = request->beginResponseStream(format == "bin" ? "application/octet-stream" : "text/plain", format == "bin" ? len : len * 2);
+      if (format == "bin") {
+        response->write(packed, len);
+      } else {
+        for (size_t i = 0; i < len; i++) {
+          response->printf("%02x", packed[i]);
+        }
+      }
+      request->send(response);
+      return;
+    }
+    if (format != "json") {
+      sendJson(request, 400, "{\"error\":\"Invalid format\",\"status\":\"failure\"}");
+      return;
+    }
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"levels\":[");
+    for (int bank = 0; bank < GPIO_BANKS; bank++) {
+      response->printf("%s%u", bank ? "," : "", snap.levels[bank]);
+    }
+    response->print("],\"pins\":[");
+    bool first = true;
+    for (int bank = 0; bank < GPIO_BANKS; bank++) {
+      uint32_t pins = snap.outputs[bank] | snap.pwm[bank];
+      while (pins) {
+        int gpio = bank * 32 + __builtin_ctz(pins);
+        uint32_t bit = pins & -pins;
+        int level = (snap.levels[bank] & bit) ? 1 : 0;
+        if (snap.pwm[bank] & bit) {
+          response->printf("%s{\"gpio\":%d,\"mode\":\"pwm\",\"level\":%d,\"pwm_value\":%u}", first ? "" : ",", gpio, level, snap.duty[gpio]);
+        } else {
+          response->printf("%s{\"gpio\":%d,\"mode\":\"output\",\"level\":%d}", first ? "" : ",", gpio, level);
+        }
+        first = false;
+        pins &= pins - 1;
+      }
+    }
+    response->print("]}");
+    request->send(response);
+  });
+
+  // Persistence Settings
+  server.on("/persist", HTTP_GET, [](AsyncWebServerRequest *request){
+    RouteTimer timer(ROUTE_PERSIST);
+    if (request->hasParam("interval")) {
+      int interval = request->getParam("interval")->value().toInt();
+      if (interval < 0 || interval > PERSIST_MAX_DELAY_MS) {
+        sendJson(request, 400, "{\"error\":\"Invalid interval\",\"status\":\"failure\"}");
+        return;
+      }
+      persistDebounceMs = interval;
+    }
+    if (request->hasParam("flush")) {
+      persistFlushRequested = true;
+    }
+    sendJsonf(request, 200, "{\"interval\":%u,\"max_delay\":%u,\"commits\":%u,\"pending\":%s,\"status\":\"success\"}",
+              persistDebounceMs, PERSIST_MAX_DELAY_MS, persistCommits, dirtyPins != 0 ? "true" : "false");
   });
 
+  // WebSocket Control and State Push
+  ws.onEvent(onWsEvent);
+  server.addHandler(&ws);
+
   // Start server
   server.begin();
   Serial.println("Server started...");
+
+  // Binary UDP control
+  udpBegin();
 }
 
 void loop() {
-  // Nothing needed here
+  wifiLoop();
+  bool force = persistFlushRequested;
+  persistFlushRequested = false;
+  persistFlush(force);
+  scenesFlush();
+  preciseStore();
+  wsPush();
+  ws.cleanupClients();
+  delay(10);
 }
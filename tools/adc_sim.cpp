@@ -0,0 +1,270 @@
+// Host test for background ADC sampling, run against the real code in
+// gpio_core.h on the host build (host/): adcConfigure(), the esp_timer tick,
+// the sampling task and the sample ring, with analogRead() answered by a
+// synthetic source.
+//
+// Build and run (Linux/macOS), ideally also under ThreadSanitizer:
+//   cmake -S . -B build && cmake --build build --target adc_sim
+//   ./build/adc_sim [-n ring records] [-d timer and sampling ms]
+//
+// ctest runs it on its own: the timer part measures how the host schedules
+// the esp_timer and sampling threads, which other tests running alongside
+// would skew.
+//
+// Three parts:
+//
+// - ring: one thread pushes records as fast as adcPush() goes while another
+//   reads them the way /samples does, first as fast as it can, then
+//   letting the writer lap it now and then. Reports records per second and
+//   the share the reader dropped. Every record read must be intact, and
+//   records read plus records dropped must equal records pushed.
+// - timer: slow reads (20 us each, 64 per sample) next to a 1 ms esp_timer
+//   probe. Sampling runs on its own task, so the probe must not be held up
+//   by it: its p99 lateness has to stay under one sample's reads, and
+//   analogRead() must only ever run on the sampling task.
+// - sampling: four pins at 2000 samples per second each, the whole read
+//   budget, for -d ms on the manual clock. The test plays the timer and the
+//   task, one adcSample() per tick, so every count below is exact. Each
+//   pin's source counts up by one per read, so a gap in a pin's values is a
+//   sample lost. Checks that each tick adds the records configured, that a
+//   reader stalled for one and a half rings drops exactly what the ring
+//   could not hold and that the gaps add up to it, and that a sampling
+//   three ticks late counts one overrun and samples each pin once.
+//
+// Throughput is reported, not checked: it is the host's, not the chip's.
+// Exits non-zero on the first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Reader {
+  uint32_t next;
+  uint64_t read;
+  uint64_t dropped;
+};
+
+// Reads what /samples would, from next up to the head, and counts the
+// records that were overwritten before they could be
+template <typename Record>
+static void drain(Reader &reader, Record record) {
+  uint32_t head = __atomic_load_n(&adcHead, __ATOMIC_ACQUIRE);
+  uint32_t oldest = head > ADC_RING_SIZE ? head - ADC_RING_SIZE : 0;
+  if ((int32_t)(reader.next - oldest) < 0) {
+    reader.dropped += oldest - reader.next;
+    reader.next = oldest;
+  }
+  for (; reader.next != head; reader.next++) {
+    AdcRecord out;
+    if (adcRead(reader.next, out)) {
+      reader.read++;
+      record(reader.next, out);
+    } else {
+      reader.dropped++;
+    }
+  }
+}
+
+// ring: adcPush() against a concurrent reader, no timer involved
+static void ring(uint32_t records, int pauseEvery) {
+  const char* part = pauseEvery ? "ring, pausing reader" : "ring";
+  uint32_t start = __atomic_load_n(&adcHead, __ATOMIC_ACQUIRE);
+  std::atomic<bool> done(false);
+  auto t0 = std::chrono::steady_clock::now();
+  std::thread writer([&] {
+    for (uint32_t i = 0; i < records; i++) {
+      uint32_t seq = start + i;
+      adcPush(seq & 0x7F, seq & 1, seq & 0xFFFF, ~seq & 0xFFFF, seq >> 16);
+    }
+    done = true;
+  });
+  Reader reader = {start, 0, 0};
+  uint64_t torn = 0;
+  auto check = [&](uint32_t seq, const AdcRecord &r) {
+    if (r.gpio != (seq & 0x7F) || r.windowed != (seq & 1) || r.value != (seq & 0xFFFF) ||
+        r.min != (~seq & 0xFFFF) || r.max != seq >> 16) {
+      torn++;
+    }
+  };
+  for (uint64_t polls = 0; !done; polls++) {
+    drain(reader, check);
+    if (pauseEvery && polls % pauseEvery == 0) {
+      while (!done && __atomic_load_n(&adcHead, __ATOMIC_ACQUIRE) - reader.next <= ADC_RING_SIZE) {
+        std::this_thread::yield(); // until the writer laps the reader
+      }
+    }
+  }
+  writer.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  drain(reader, check);
+
+  printf("%-22s %10.0f records/s, %6.2f%% dropped\n", part, records / seconds, 100.0 * reader.dropped / records);
+  if (torn) simFail(part, "torn records read", torn, 0);
+  if (reader.read + reader.dropped != records) {
+    simFail(part, "records read + dropped", reader.read + reader.dropped, records);
+  }
+  if (pauseEvery && reader.dropped == 0) simFail(part, "records dropped with the reader paused", 0, 1);
+}
+
+// The synthetic source: a count per pin, with optional slow reads
+static std::atomic<uint32_t> counts[SOC_GPIO_PIN_COUNT];
+static std::atomic<uint32_t> offTask(0);
+static std::atomic<int> readUs(0);
+static std::atomic<uint64_t> slowReads(0);
+static std::atomic<uint64_t> slowReadNs(0);
+
+static uint16_t analog(int gpio) {
+  if (readUs) {
+    if (strcmp(pcTaskGetName(NULL), "adc") != 0) offTask++;
+    // Sleeps rather than spins: on the chip the esp_timer task preempts the
+    // sampling task, on a host with one core a spin would hold it up
+    auto t0 = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::microseconds(readUs));
+    slowReadNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    slowReads++;
+  }
+  return counts[gpio]++ & 0xFFFF;
+}
+
+// timer: esp_timer lateness while slow samples are taken. A late periodic
+// timer is re-armed from when it ran, so each tick is timed from the last.
+static std::vector<int64_t> lateness;
+static int64_t probeLast = 0;
+
+static void probe(void *) {
+  int64_t now = esp_timer_get_time();
+  lateness.push_back(std::max<int64_t>(0, now - probeLast - 1000));
+  probeLast = now;
+}
+
+static void timer(int ms) {
+  const char* part = "timer";
+  const int reads = ADC_MAX_OVERSAMPLE;
+  readUs = 20;
+  for (int gpio : {32, 33}) {
+    int code = adcConfigure(gpio, ADC_MAX_READS_PER_SEC / 2 / reads, reads, 0);
+    if (code != 200) simFail(part, "adcConfigure()", code, 200);
+  }
+  esp_timer_handle_t handle;
+  esp_timer_create_args_t args = {};
+  args.callback = probe;
+  args.name = "probe";
+  esp_timer_create(&args, &handle);
+  probeLast = esp_timer_get_time();
+  esp_timer_start_periodic(handle, 1000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  esp_timer_stop(handle);
+  adcConfigure(32, 0, 1, 0);
+  adcConfigure(33, 0, 1, 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  readUs = 0;
+
+  std::sort(lateness.begin(), lateness.end());
+  int64_t p99 = lateness.empty() ? 0 : lateness[lateness.size() * 99 / 100];
+  int64_t sampleUs = slowReads ? slowReadNs / slowReads * reads / 1000 : 0; // as the sleeps came out
+  printf("%-22s probe p99 lateness %lld us, one sample's reads take %lld us\n", part, (long long)p99,
+         (long long)sampleUs);
+  if (lateness.size() < (size_t)ms / 2) simFail(part, "probe ticks", lateness.size(), ms);
+  if (p99 >= sampleUs) simFail(part, "probe p99 lateness, us", p99, sampleUs);
+  if (offTask) simFail(part, "analogRead() calls off the sampling task", offTask, 0);
+}
+
+// sampling: adcSample() driven tick by tick on the manual clock, with the
+// timer stopped so the sampling task stays asleep
+static void sampling(int ms) {
+  const char* part = "sampling";
+  const int pins[] = {32, 33, 34, 35};
+  const int pinCount = sizeof(pins) / sizeof(pins[0]);
+  const uint32_t perTick = ADC_MAX_READS_PER_SEC / ADC_TICK_HZ; // records, at the whole budget
+  const uint32_t stallTicks = 3 * ADC_RING_SIZE / 2 / perTick;
+  // Long enough for the reader to come back, and every pin samples on even ticks
+  const uint32_t ticks = std::max<uint32_t>(ms * 1000 / ADC_TICK_US, 2 * stallTicks) / 4 * 4;
+
+  simManualClock(simNowUs());
+  for (int gpio : pins) {
+    int code = adcConfigure(gpio, ADC_MAX_READS_PER_SEC / pinCount, 1, 0);
+    if (code != 200) simFail(part, "adcConfigure()", code, 200);
+  }
+  int fifth = adcConfigure(36, 1, 1, 0);
+  if (fifth != 507) simFail(part, "a fifth channel", fifth, 507);
+  esp_timer_stop(adcTimer);
+
+  Reader reader = {__atomic_load_n(&adcHead, __ATOMIC_ACQUIRE), 0, 0};
+  uint32_t start = reader.next;
+  uint32_t overruns = __atomic_load_n(&adcOverruns, __ATOMIC_RELAXED);
+  int last[SOC_GPIO_PIN_COUNT];
+  std::fill(last, last + SOC_GPIO_PIN_COUNT, -1);
+  for (int gpio : pins) {
+    last[gpio] = (uint16_t)(counts[gpio] - 1);
+  }
+  uint64_t gaps = 0;
+  auto check = [&](uint32_t, const AdcRecord &r) {
+    gaps += (uint16_t)(r.value - last[r.gpio] - 1);
+    last[r.gpio] = r.value;
+  };
+
+  // The reader keeps up, except over the stallTicks samplings from halfway
+  for (uint32_t tick = 0; tick < ticks; tick++) {
+    simAdvanceUs(ADC_TICK_US);
+    adcSample(1);
+    if (tick < ticks / 2 || tick + 1 >= ticks / 2 + stallTicks) drain(reader, check);
+  }
+  uint32_t records = __atomic_load_n(&adcHead, __ATOMIC_ACQUIRE) - start;
+  if (records != ticks * perTick) simFail(part, "records after every tick", records, ticks * perTick);
+  if (reader.read + reader.dropped != records) {
+    simFail(part, "records read + dropped", reader.read + reader.dropped, records);
+  }
+  if (reader.dropped != stallTicks * perTick - ADC_RING_SIZE) {
+    simFail(part, "records dropped by the stalled reader", reader.dropped, stallTicks * perTick - ADC_RING_SIZE);
+  }
+  if (gaps != reader.dropped) simFail(part, "samples missing from the pins' counts", gaps, reader.dropped);
+  uint32_t late = __atomic_load_n(&adcOverruns, __ATOMIC_RELAXED) - overruns;
+  if (late != 0) simFail(part, "overruns on time", late, 0);
+
+  // Three ticks in one: one overrun, each pin sampled once
+  uint32_t head = __atomic_load_n(&adcHead, __ATOMIC_ACQUIRE);
+  simAdvanceUs(3 * ADC_TICK_US);
+  adcSample(3);
+  late = __atomic_load_n(&adcOverruns, __ATOMIC_RELAXED) - overruns;
+  if (late != 1) simFail(part, "overruns after a late sampling", late, 1);
+  uint32_t lateRecords = __atomic_load_n(&adcHead, __ATOMIC_ACQUIRE) - head;
+  if (lateRecords != (uint32_t)pinCount) simFail(part, "records from a late sampling", lateRecords, pinCount);
+
+  for (int gpio : pins) {
+    adcConfigure(gpio, 0, 1, 0);
+  }
+  printf("%-22s %10u records in %u ticks, %llu dropped, %u overruns\n", part, records, ticks,
+         (unsigned long long)reader.dropped, late);
+}
+
+int main(int argc, char **argv) {
+  uint32_t records = 2000000;
+  int ms = 1000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue) {
+      records = std::max(2 * ADC_RING_SIZE, atoi(argv[++i]));
+    } else if (arg == "-d" && hasValue) {
+      ms = std::max(100, atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: adc_sim [-n ring records] [-d timer and sampling ms]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  simAnalog = analog;
+  adcBegin();
+  ring(records, 0);
+  ring(records, 64);
+  timer(ms); // on the real clock, before sampling() freezes it
+  sampling(ms);
+  return simExit();
+}
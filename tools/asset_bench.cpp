@@ -0,0 +1,193 @@
+// Benchmark of how html_GPIO_control_dashboard.cpp sends the dashboard page:
+// sendAsset() with the gzipped assets of dashboard_assets.h, against the
+// same files sent uncompressed the way the page used to be (send_P(), no
+// ETag, no caching), and against a revalidation answered with a 304. Runs on
+// the host build: setup() as gpio_host runs it, requests in-process through
+// hostRequest(), heap allocations counted by host/alloc.cpp.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target asset_bench
+//   ./build/asset_bench [-n requests per case] [-k link kbit/s]
+//
+// The uncompressed bodies are the files in dashboard/, with the links in
+// index.html renamed as tools/embed_assets.py renames them. For each asset
+// and case reports the body and wire bytes (status line, headers and body
+// as the server writes them), the TCP segments they fill, the median time
+// to the first body byte, the allocations per request and the time to the
+// last byte at -k kbit/s. The link time is computed, not measured: on the
+// device it is what the gzip saves, the first byte costs the same either way.
+//
+// Checks that:
+//
+// - dashboard/ matches dashboard_assets.h: each file is rawLen bytes, and
+//   the gzip trailer of each asset says it inflates to rawLen
+// - the gzipped body is the stored asset, smaller than the raw one, sent
+//   with Content-Encoding: gzip, its ETag and its Cache-Control
+// - a matching If-None-Match gets a 304 with no body, smaller on the wire
+//   than either 200
+// - the page loads in fewer bytes gzipped than raw
+// - the gzipped first byte is not more than twice as late as the raw one
+//
+// Exits non-zero on the first violation.
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "dashboard_assets.h"
+#include "net.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+void setup();
+extern AsyncWebServer server;
+
+struct Case {
+  const char* name;
+  int code;
+  size_t body;
+  size_t wire;
+  double firstByteUs; // median
+  double allocations;
+};
+
+static int linkKbps = 1000;
+
+static std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream bytes;
+  bytes << file.rdbuf();
+  return bytes.str();
+}
+
+// The bytes an HTTP/1.1 response puts on the wire for this one
+static size_t wireBytes(const HostResponse &response) {
+  size_t bytes = strlen("HTTP/1.1 200 OK\r\n") + strlen("Content-Length: \r\n") +
+                 std::to_string(response.body.size()).size() + strlen("\r\n") + response.body.size();
+  if (!response.type.empty()) bytes += strlen("Content-Type: \r\n") + response.type.size();
+  for (const auto &header : response.headers) {
+    bytes += header.first.size() + strlen(": \r\n") + header.second.size();
+  }
+  return bytes;
+}
+
+static Case measure(const char* name, const std::string &url, int requests,
+                    const std::vector<std::pair<std::string, std::string>> &headers, HostResponse &last) {
+  std::vector<double> us;
+  uint64_t allocations = 0;
+  for (int i = 0; i < requests; i++) {
+    last = hostRequest("GET", url.c_str(), std::string(), headers);
+    us.push_back(last.firstByteNs / 1000.0);
+    allocations += last.allocations;
+  }
+  std::sort(us.begin(), us.end());
+  return {name, last.code, last.body.size(), wireBytes(last), us[us.size() / 2], (double)allocations / requests};
+}
+
+static void report(const Case &c) {
+  size_t segments = (c.wire + SIM_TCP_SEGMENT - 1) / SIM_TCP_SEGMENT;
+  double lastByteMs = c.firstByteUs / 1000 + c.wire * 8.0 / linkKbps;
+  char firstByte[16] = "-"; // a 304 sends no body byte
+  if (c.body) snprintf(firstByte, sizeof(firstByte), "%.2f", c.firstByteUs);
+  printf("  %-6s %5d %8zu %8zu %9zu %12s %8.1f %12.2f\n", c.name, c.code, c.body, c.wire, segments, firstByte,
+         c.allocations, lastByteMs);
+}
+
+int main(int argc, char** argv) {
+  int requests = 2000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue) {
+      requests = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-k" && hasValue) {
+      linkKbps = std::max(1, atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: asset_bench [-n requests per case] [-k link kbit/s]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  setup();
+
+  // The sources, renamed as the page links them
+  std::vector<std::string> raw;
+  for (const WebAsset &asset : webAssets) {
+    std::string path = asset.path;
+    std::string file = path == "/" ? "index.html" : path.substr(1, path.find('.') - 1) + path.substr(path.rfind('.'));
+    raw.push_back(readFile(std::string(DASHBOARD_DIR) + "/" + file));
+  }
+  for (const WebAsset &asset : webAssets) {
+    std::string path = asset.path;
+    if (path == "/") continue;
+    std::string source = "\"/" + path.substr(1, path.find('.') - 1) + path.substr(path.rfind('.')) + "\"";
+    size_t at = raw[0].find(source);
+    if (at != std::string::npos) raw[0].replace(at, source.size(), "\"" + path + "\"");
+  }
+  // Raw routes, sent as the single page was
+  for (size_t i = 0; i < raw.size(); i++) {
+    const WebAsset &asset = webAssets[i];
+    const std::string &body = raw[i];
+    server.on(("/raw" + std::string(asset.path)).c_str(), HTTP_GET, [&asset, &body](AsyncWebServerRequest *request) {
+      request->send_P(200, asset.type, (const uint8_t*)body.data(), body.size());
+    });
+  }
+
+  printf("%d requests per case, link at %d kbit/s\n", requests, linkKbps);
+  printf("  %-6s %5s %8s %8s %9s %12s %8s %12s\n", "case", "code", "body", "wire", "segments", "1st byte us", "allocs",
+         "last byte ms");
+  size_t pageRaw = 0, pageGz = 0, pageRevalidate = 0;
+  for (size_t i = 0; i < raw.size(); i++) {
+    const WebAsset &asset = webAssets[i];
+    const char* path = asset.path;
+    printf("%s (%zu bytes, %zu gzipped)\n", path, asset.rawLen, asset.len);
+    if (raw[i].size() != asset.rawLen) simFail(path, "dashboard/ file bytes, run tools/embed_assets.py", raw[i].size(), asset.rawLen);
+    uint32_t inflated = 0;
+    if (asset.len >= 18) memcpy(&inflated, asset.data + asset.len - 4, 4); // ISIZE, little-endian
+    if (asset.len < 18 || asset.data[0] != 0x1f || asset.data[1] != 0x8b || inflated != asset.rawLen) {
+      simFail(path, "gzip trailer, inflated bytes", inflated, asset.rawLen);
+    }
+
+    HostResponse response;
+    Case rawCase = measure("raw", "/raw" + std::string(path), requests, {}, response);
+    if (response.code != 200 || response.body != raw[i]) simFail(path, "raw body bytes", response.body.size(), raw[i].size());
+    report(rawCase);
+
+    Case gzCase = measure("gzip", path, requests, {}, response);
+    std::string etag = hostHeader(response, "ETag");
+    if (response.code != 200 || response.body != std::string((const char*)asset.data, asset.len)) {
+      simFail(path, "gzip body bytes", response.body.size(), asset.len);
+    }
+    if (hostHeader(response, "Content-Encoding") != "gzip") simFail(path, "Content-Encoding: gzip", 0, 1);
+    if (etag.empty()) simFail(path, "ETag", 0, 1);
+    if (hostHeader(response, "Cache-Control") != asset.cacheControl) simFail(path, "Cache-Control", 0, 1);
+    report(gzCase);
+
+    Case notModified = measure("304", path, requests, {{"If-None-Match", etag}}, response);
+    if (response.code != 304 || !response.body.empty()) simFail(path, "304 body bytes", response.body.size(), 0);
+    report(notModified);
+
+    if (gzCase.body >= rawCase.body) simFail(path, "gzip body bytes", gzCase.body, rawCase.body);
+    if (notModified.wire >= gzCase.wire || notModified.wire >= rawCase.wire) {
+      simFail(path, "304 wire bytes", notModified.wire, std::min(gzCase.wire, rawCase.wire));
+    }
+    if (gzCase.firstByteUs > 2 * rawCase.firstByteUs + 20) {
+      simFail(path, "gzip first byte, median ns", gzCase.firstByteUs * 1000, rawCase.firstByteUs * 2000);
+    }
+    pageRaw += rawCase.wire;
+    pageGz += gzCase.wire;
+    // A reload: / is revalidated, the hashed names come from the cache
+    pageRevalidate += path == std::string("/") ? notModified.wire : 0;
+  }
+
+  printf("page load: %zu bytes raw, %zu gzipped, %zu on a reload (%.1f, %.1f and %.1f ms at %d kbit/s)\n", pageRaw,
+         pageGz, pageRevalidate, pageRaw * 8.0 / linkKbps, pageGz * 8.0 / linkKbps, pageRevalidate * 8.0 / linkKbps,
+         linkKbps);
+  if (pageGz >= pageRaw) simFail("page", "gzipped wire bytes", pageGz, pageRaw);
+  return simExit();
+}
@@ -0,0 +1,383 @@
+// Host test for /batch, run against the real code in gpio_core.h on the host
+// build (host/): the streaming BatchParser, groupAdd() and actuateMask()
+// writing the simulated GPIO_OUT registers, which count their reads and
+// writes per bank.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target batch_sim
+//   ./build/batch_sim [-b batches] [-n most operations per batch] [-s seed]
+//
+// Random batches of high and low operations, on single pins and on groups,
+// across both banks. Checks:
+//
+// - fed whole, a batch costs one read-modify-write of GPIO_OUT per bank it
+//   touches, however many operations it has, and no digitalWrite() calls
+// - fed in random chunks, each chunk writes each bank once if an operation
+//   it completed touches that bank, and not at all otherwise
+// - every pin ends at the level of the last operation on it
+// - a PWM group operation that runs out of LEDC channels fails with "No free
+//   PWM channel" and none of the group is stored; one that fits is stored
+// - a body of several thousand operations, with whitespace and keys /batch
+//   ignores, gives the same result fed whole, one byte at a time, split in
+//   two at random points and in random chunks
+// - trailing commas, a lone '-' and backslash escapes make a batch
+//   malformed at the offending character, wherever the body is split
+// - with the actuation ring full, the digital operations of a chunk, on a pin
+//   or a group, fail as busy, in index order among the other errors, and
+//   none of their pins is stored
+//
+// Exits non-zero on the first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+struct Op {
+  int gpio;       // -1 for a group
+  int group;
+  bool high;
+};
+
+static std::mt19937 rng(1);
+static std::vector<int> gpios;
+
+static void fail(const char* what, int batch, long got, long want) {
+  simFailf("batch %d: %s: got %ld, expected %ld", batch, what, got, want);
+}
+
+static void defineGroup(const char* name, const std::string &pins) {
+  PinGroup &group = pinGroups[pinGroupCount++];
+  snprintf(group.name, sizeof(group.name), "%s", name);
+  parsePinList(pins.c_str(), group.mask);
+}
+
+static uint32_t banksOf(const Op &op) {
+  if (op.gpio >= 0) return 1UL << (op.gpio >> 5);
+  uint32_t banks = 0;
+  for (int bank = 0; bank < GPIO_BANKS; bank++) {
+    banks |= pinGroups[op.group].mask[bank] ? 1UL << bank : 0;
+  }
+  return banks;
+}
+
+static std::string body(const std::vector<Op> &ops) {
+  std::string json = "[";
+  for (size_t i = 0; i < ops.size(); i++) {
+    char op[64];
+    if (ops[i].gpio >= 0) {
+      snprintf(op, sizeof(op), "%s{\"gpio\":%d,\"state\":\"%s\"}", i ? "," : "", ops[i].gpio,
+               ops[i].high ? "high" : "low");
+    } else {
+      snprintf(op, sizeof(op), "%s{\"group\":\"%s\",\"state\":\"%s\"}", i ? "," : "", pinGroups[ops[i].group].name,
+               ops[i].high ? "high" : "low");
+    }
+    json += op;
+  }
+  return json + "]";
+}
+
+static void runBatch(int batch, int maxOps, bool chunked) {
+  std::vector<Op> ops(1 + rng() % maxOps);
+  for (Op &op : ops) {
+    bool group = rng() % 8 == 0;
+    op.gpio = group ? -1 : gpios[rng() % gpios.size()];
+    op.group = group ? rng() % pinGroupCount : 0;
+    op.high = rng() & 1;
+  }
+  std::string json = body(ops);
+
+  // Each pin's level after the last operation on it
+  std::vector<int> level(SOC_GPIO_PIN_COUNT, -1);
+  for (int gpio : gpios) {
+    level[gpio] = simPinLevel(gpio);
+  }
+  for (const Op &op : ops) {
+    for (int gpio : gpios) {
+      bool member = op.gpio < 0 && (pinGroups[op.group].mask[gpio >> 5] >> (gpio & 31) & 1);
+      if (gpio == op.gpio || member) level[gpio] = op.high;
+    }
+  }
+
+  uint32_t digitalWritesBefore = simGpio.digitalWrites;
+  BatchParser p;
+  batchBegin(p);
+  size_t at = 0;
+  while (at < json.size()) {
+    size_t len = chunked ? std::min(json.size() - at, (size_t)(1 + rng() % 40)) : json.size();
+    uint32_t reads[2] = {simGpio.outReads[0], simGpio.outReads[1]};
+    uint32_t writes[2] = {simGpio.outWrites[0], simGpio.outWrites[1]};
+    uint32_t first = p.operations;
+    batchFeed(p, json.data() + at, len);
+    at += len;
+    uint32_t touched = 0;
+    for (uint32_t i = first; i < p.operations; i++) {
+      touched |= banksOf(ops[i]);
+    }
+    for (int bank = 0; bank < GPIO_BANKS; bank++) {
+      uint32_t wrote = simGpio.outWrites[bank] - writes[bank];
+      uint32_t read = simGpio.outReads[bank] - reads[bank];
+      if (wrote != (touched >> bank & 1)) fail("GPIO_OUT writes in a chunk", batch, wrote, touched >> bank & 1);
+      if (read != wrote) fail("GPIO_OUT reads, one per read-modify-write", batch, read, wrote);
+    }
+  }
+  if (p.state != BATCH_DONE) fail("parser state", batch, p.state, BATCH_DONE);
+  if (p.operations != ops.size() || p.failed) fail("operations applied", batch, p.operations - p.failed, ops.size());
+  if (simGpio.digitalWrites != digitalWritesBefore) {
+    fail("digitalWrite() calls", batch, simGpio.digitalWrites - digitalWritesBefore, 0);
+  }
+  for (int gpio : gpios) {
+    if (simPinLevel(gpio) != level[gpio]) fail("pin level", batch, simPinLevel(gpio), level[gpio]);
+  }
+}
+
+static uint8_t storedOp(int gpio) {
+  return stateImage.pins[gpio].op;
+}
+
+// PWM on a group needs a channel per member: "all" has more members than
+// there are channels, "pair" fits
+static void pwmGroups() {
+  BatchParser p;
+  const char* tooMany = "[{\"group\":\"all\",\"state\":\"pwm100\"}]";
+  batchBegin(p);
+  batchFeed(p, tooMany, strlen(tooMany));
+  if (p.failed != 1 || p.errorCount != 1 || p.errorCode[0] != BATCH_NO_CHANNEL) {
+    fail("group PWM without enough channels", -1, p.errorCount ? p.errorCode[0] : (int)BATCH_OK, BATCH_NO_CHANNEL);
+  }
+  for (int gpio : gpios) {
+    if (storedOp(gpio) == OP_PWM) fail("stored PWM for a failed group", -1, gpio, -1);
+  }
+
+  // Back to digital, which hands the channels back
+  const char* low = "[{\"group\":\"all\",\"state\":\"low\"}]";
+  batchBegin(p);
+  batchFeed(p, low, strlen(low));
+  const char* fits = "[{\"group\":\"pair\",\"state\":\"pwm100\"}]";
+  batchBegin(p);
+  batchFeed(p, fits, strlen(fits));
+  if (p.failed != 0) fail("group PWM that fits", -1, p.errorCode[0], BATCH_OK);
+  for (int gpio : {gpios[0], gpios[1]}) {
+    if (storedOp(gpio) != OP_PWM) fail("stored state of a PWM group member", -1, storedOp(gpio), OP_PWM);
+  }
+  printf("PWM on %zu pins with %d channels: %s; on 2 pins: stored\n", gpios.size(), LEDC_CHANNELS,
+         batchErrorText(BATCH_NO_CHANNEL));
+}
+
+// Feeds json in chunks that end at each of the given offsets, then the rest
+static void feed(BatchParser &p, const std::string &json, const std::vector<size_t> &ends) {
+  batchBegin(p);
+  size_t at = 0;
+  for (size_t end : ends) {
+    batchFeed(p, json.data() + at, end - at);
+    at = end;
+  }
+  batchFeed(p, json.data() + at, json.size() - at);
+}
+
+// Several thousand operations, spaced out and with keys /batch ignores, so
+// chunks end inside numbers, strings, keys and whitespace
+static void bigBatch(int count) {
+  std::vector<Op> ops(count);
+  std::string json = "[ ";
+  for (int i = 0; i < count; i++) {
+    Op &op = ops[i];
+    op.gpio = rng() % 8 == 0 ? -1 : gpios[rng() % gpios.size()];
+    op.group = op.gpio < 0 ? rng() % pinGroupCount : 0;
+    op.high = rng() & 1;
+    char text[128];
+    char target[48];
+    if (op.gpio >= 0) {
+      snprintf(target, sizeof(target), "\"gpio\" : %d", op.gpio);
+    } else {
+      snprintf(target, sizeof(target), "\"group\":\"%s\"", pinGroups[op.group].name);
+    }
+    snprintf(text, sizeof(text), "%s{ \"note\":-%u, %s,\n \"state\":\"%s\" , \"id\":%d }", i ? ",\r\n " : "",
+             (unsigned)(rng() % 100000), target, op.high ? "high" : "low", i);
+    json += text;
+  }
+  json += " ]";
+
+  std::vector<int> level(SOC_GPIO_PIN_COUNT, -1);
+  for (const Op &op : ops) {
+    for (int gpio : gpios) {
+      bool member = op.gpio < 0 && (pinGroups[op.group].mask[gpio >> 5] >> (gpio & 31) & 1);
+      if (gpio == op.gpio || member) level[gpio] = op.high;
+    }
+  }
+
+  std::vector<std::pair<const char*, std::vector<size_t>>> splits;
+  splits.push_back({"whole", {}});
+  std::vector<size_t> bytes;
+  for (size_t end = 1; end < json.size(); end++) bytes.push_back(end);
+  splits.push_back({"byte at a time", bytes});
+  for (int i = 0; i < 20; i++) {
+    splits.push_back({"split in two", {1 + rng() % (json.size() - 1)}});
+  }
+  std::vector<size_t> chunks;
+  for (size_t end = 1 + rng() % 1460; end < json.size(); end += 1 + rng() % 1460) chunks.push_back(end);
+  splits.push_back({"random chunks", chunks});
+
+  for (const auto &split : splits) {
+    // Every pin away from its final level, so each run has to set them all
+    for (int gpio : gpios) {
+      GpioCommand cmd = {level[gpio] == 1 ? OP_LOW : OP_HIGH, (uint8_t)gpio, 0, 0, PWM_DEFAULT_FREQ,
+                         PWM_DEFAULT_RESOLUTION, RAMP_LINEAR, 0};
+      if (level[gpio] >= 0) executeCommand(cmd);
+    }
+    uint32_t writes[2] = {simGpio.outWrites[0], simGpio.outWrites[1]};
+    BatchParser p;
+    feed(p, json, split.second);
+    if (p.state != BATCH_DONE) fail(split.first, count, p.state, BATCH_DONE);
+    if (p.offset != json.size()) fail(split.first, count, p.offset, json.size());
+    if (p.operations != (uint32_t)count || p.failed) fail(split.first, count, p.operations - p.failed, count);
+    for (int bank = 0; bank < GPIO_BANKS; bank++) {
+      uint32_t wrote = simGpio.outWrites[bank] - writes[bank];
+      if (wrote > split.second.size() + 1) fail(split.first, count, wrote, split.second.size() + 1);
+    }
+    for (int gpio : gpios) {
+      if (level[gpio] >= 0 && simPinLevel(gpio) != level[gpio]) fail(split.first, count, simPinLevel(gpio), level[gpio]);
+    }
+  }
+  printf("%d operations in %zu bytes: same result whole, byte at a time, split in two and in %zu chunks\n", count,
+         json.size(), chunks.size() + 1);
+}
+
+struct Malformed {
+  const char* json;
+  size_t offset; // where the parser stops: the offending character
+};
+
+// Each body is fed split at every point; all must stop at the same offset
+static void malformed() {
+  const Malformed cases[] = {
+    {"[{\"gpio\":1,}]", 11},
+    {"[{\"gpio\":4,\"state\":\"high\"},]", 27},
+    {"[{\"gpio\":4,\"state\":\"high\"} , ]", 29},
+    {"[{\"gpio\":-}]", 10},
+    {"[{\"gpio\":- 4,\"state\":\"high\"}]", 10},
+    {"[{\"gpio\":4,\"state\":\"high\",\"x\":-,\"y\":1}]", 31},
+    {"[{\"gpio\":4,\"state\":\"hi\\\"gh\"}]", 22},
+    {"[{\"gpio\":4,\"state\":\"hi\\u0067h\"}]", 22},
+    {"[{\"gpio\":4,\"sta\\te\":\"high\"}]", 15},
+  };
+  int checked = 0;
+  for (const Malformed &c : cases) {
+    std::string json = c.json;
+    for (size_t split = 0; split <= json.size(); split++) {
+      BatchParser p;
+      feed(p, json, split ? std::vector<size_t>{split} : std::vector<size_t>{});
+      if (p.state != BATCH_MALFORMED || p.offset != c.offset) {
+        simFailf("%s split at %zu: state %d at offset %u, expected malformed at %zu", c.json, split, p.state, p.offset,
+                 c.offset);
+        break;
+      }
+      checked++;
+    }
+  }
+
+  // What is still valid next to them
+  const char* valid[] = {
+    "[]",
+    " [ ] ",
+    "[{}]",
+    "[{\"gpio\":4,\"state\":\"high\",\"x\":-5}]",
+    "[{\"gpio\":4,\"state\":\"high\",\"x\":-0,\"y\":true}]",
+  };
+  for (const char* json : valid) {
+    BatchParser p;
+    feed(p, json, {});
+    if (p.state != BATCH_DONE) {
+      simFailf("%s: state %d at offset %u, expected done", json, p.state, p.offset);
+    }
+  }
+  printf("%zu malformed bodies rejected at the offending character, split %d ways\n",
+         sizeof(cases) / sizeof(cases[0]), checked);
+}
+
+static void stalledLoop(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+// Last, as the ring stays full: a task that never takes from it
+static void fullRing() {
+  for (uint32_t i = 0; i < ACTUATION_QUEUE_SIZE; i++) {
+    actuationRing[i].seq = i; // as actuationBegin() does
+  }
+  xTaskCreatePinnedToCore(stalledLoop, "stalled", ACTUATION_STACK, NULL, ACTUATION_PRIORITY, &actuationTask,
+                          ACTUATION_CORE);
+  Actuation filler = {ACT_MASK, {}, {}, NULL, NULL, 0};
+  while (actuationTryPush(filler)) {
+  }
+  int gpio = gpios.back();
+  uint8_t before[SOC_GPIO_PIN_COUNT];
+  for (int pin : gpios) before[pin] = storedOp(pin);
+  std::string json = "[{\"gpio\":" + std::to_string(gpio) + ",\"state\":\"high\"},{\"gpio\":6,\"state\":\"high\"}," +
+                     "{\"group\":\"pair\",\"state\":\"low\"}]";
+  BatchParser p;
+  batchBegin(p);
+  batchFeed(p, json.data(), json.size());
+  const uint8_t codes[] = {BATCH_BUSY, BATCH_INVALID, BATCH_BUSY};
+  if (p.failed != 3 || p.errorCount != 3) fail("operations failed with the ring full", -1, p.failed, 3);
+  for (int i = 0; i < p.errorCount && i < 3; i++) {
+    if (p.errorIndex[i] != (uint32_t)i) fail("error index with the ring full", -1, p.errorIndex[i], i);
+    if (p.errorCode[i] != codes[i]) fail("error with the ring full", i, p.errorCode[i], codes[i]);
+  }
+  for (int pin : gpios) {
+    if (storedOp(pin) != before[pin]) fail("stored state of a dropped operation", -1, pin, -1);
+  }
+  printf("ring full: %u of %u operations failed, %s\n", p.failed, p.operations, batchErrorText(BATCH_BUSY));
+}
+
+int main(int argc, char **argv) {
+  int batches = 2000;
+  int maxOps = 300;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-b" && hasValue) {
+      batches = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-n" && hasValue) {
+      maxOps = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-s" && hasValue) {
+      rng.seed(strtoul(argv[++i], NULL, 10));
+    } else {
+      fprintf(stderr, "usage: batch_sim [-b batches] [-n most operations per batch] [-s seed]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  ledcPoolBegin();
+  std::string all, low, high;
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+    if (!pinCanOutput(gpio)) continue;
+    gpios.push_back(gpio);
+    std::string &bank = gpio < 32 ? low : high;
+    all += (all.empty() ? "" : ",") + std::to_string(gpio);
+    bank += (bank.empty() ? "" : ",") + std::to_string(gpio);
+  }
+  defineGroup("all", all);
+  defineGroup("bank0", low);
+  if (!high.empty()) defineGroup("bank1", high);
+  defineGroup("pair", std::to_string(gpios[0]) + "," + std::to_string(gpios[1]));
+
+  uint32_t writes = simGpio.outWrites[0] + simGpio.outWrites[1];
+  for (int batch = 0; batch < batches; batch++) {
+    runBatch(batch, maxOps, batch & 1);
+  }
+  printf("%d batches of up to %d operations on %zu pins: %u GPIO_OUT writes\n", batches, maxOps, gpios.size(),
+         simGpio.outWrites[0] + simGpio.outWrites[1] - writes);
+  if ((int)gpios.size() > LEDC_CHANNELS) {
+    pwmGroups();
+  }
+  bigBatch(5000);
+  malformed();
+  fullRing();
+
+  return simExit();
+}
@@ -0,0 +1,126 @@
+// Microbenchmark of command decoding, run against the real code in
+// gpio_core.h on the host build (host/): decodeCommand(), decodeRamp(),
+// formatState() and resetCommand(), with heap allocations counted by
+// host/alloc.cpp.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target decode_bench
+//   ./build/decode_bench [-n decodes per case]
+//
+// For each wire state, valid and not, reports ns per decode, ns for all of
+// ingress (decode, fade parameters, the wire form for the response and the
+// reset command) and allocations per decode, and checks that the decoded
+// command is right and that decoding allocated nothing. Then the same for
+// what the sketches did before decoding once at ingress: a String per
+// state, compared against "high" and "low", and substring(3).toInt() for a
+// duty, as every executor, the scheduler and resume did. The host String
+// keeps short strings inline, where the Arduino core's allocates for every
+// one, so the allocations of that baseline are a lower bound. The whole
+// request, parameters and response included, is in gpio_bench. Exits
+// non-zero on a wrong decode or an allocation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <chrono>
+#include <string>
+
+struct Case {
+  const char* state;
+  int resolution;
+  uint8_t op;      // OP_NONE when the state is rejected
+  uint16_t duty;
+};
+
+static volatile uint32_t sink; // keeps the loops from being optimized out
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// What the sketches did before, for comparison
+static bool legacyDecode(const char* wire, int gpio, GpioCommand &cmd) {
+  String state = wire;
+  cmd.gpio = gpio;
+  if (state == "high") {
+    cmd.op = OP_HIGH;
+  } else if (state == "low") {
+    cmd.op = OP_LOW;
+  } else if (state.startsWith("pwm")) {
+    cmd.op = OP_PWM;
+    cmd.duty = state.substring(3).toInt();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int decodes = 1000000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-n" && i + 1 < argc) {
+      decodes = std::max(1, atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: decode_bench [-n decodes per case]\n");
+      return 2;
+    }
+  }
+
+  int gpio = 0;
+  while (!pinCanOutput(gpio)) gpio++;
+  const Case cases[] = {
+    {"high", 8, OP_HIGH, 0},
+    {"low", 8, OP_LOW, 0},
+    {"pwm128", 8, OP_PWM, 128},
+    {"pwm4095", 12, OP_PWM, 4095},
+    {"pwm256", 8, OP_NONE, 0},     // above 8 bits
+    {"pwm12a", 8, OP_NONE, 0},
+    {"toggle", 8, OP_NONE, 0},
+  };
+
+  printf("%-10s %10s %10s %8s %10s %14s\n", "state", "decode ns", "ingress ns", "allocs", "legacy ns", "legacy allocs");
+  for (const Case &c : cases) {
+    GpioCommand cmd = {};
+    bool ok = decodeCommand(gpio, c.state, cmd, PWM_DEFAULT_FREQ, c.resolution);
+    if (ok != (c.op != OP_NONE) || (ok && (cmd.op != c.op || cmd.duty != c.duty || cmd.gpio != gpio))) {
+      simFailf("%s: decoded op %d duty %u, expected op %d duty %u", c.state, ok ? cmd.op : (int)OP_NONE, cmd.duty,
+               c.op, c.duty);
+    }
+
+    uint64_t allocations = simAllocations();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < decodes; i++) {
+      sink = decodeCommand(gpio, c.state, cmd, PWM_DEFAULT_FREQ, c.resolution) + cmd.duty;
+    }
+    double ns = nsSince(t0) / decodes;
+
+    // Ingress as /setgpio does it: decode, the fade parameters, and the
+    // wire form for the response; then the reset a duration would queue
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < decodes; i++) {
+      char wire[12];
+      if (decodeCommand(gpio, c.state, cmd, PWM_DEFAULT_FREQ, c.resolution) && decodeRamp(cmd, 0, RAMP_LINEAR)) {
+        formatState(cmd, wire, sizeof(wire));
+        sink = resetCommand(cmd).op + wire[0];
+      }
+    }
+    double ingressNs = nsSince(t0) / decodes;
+    double allocs = (double)(simAllocations() - allocations) / (2.0 * decodes);
+    if (allocations != simAllocations()) {
+      simFailf("%s: %llu allocations decoding", c.state, (unsigned long long)(simAllocations() - allocations));
+    }
+
+    allocations = simAllocations();
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < decodes; i++) {
+      if (legacyDecode(c.state, gpio, cmd)) {
+        sink = cmd.duty;
+      }
+    }
+    double legacyNs = nsSince(t0) / decodes;
+    double legacyAllocs = (double)(simAllocations() - allocations) / decodes;
+    printf("%-10s %10.1f %10.1f %8.2f %10.1f %14.2f\n", c.state, ns, ingressNs, allocs, legacyNs, legacyAllocs);
+  }
+  return simExit();
+}
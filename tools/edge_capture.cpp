@@ -0,0 +1,193 @@
+// Host test for the input edge capture, run against the real code in
+// gpio_core.h on the host build (host/): edgeConfigure() arms each pin, the
+// simulated GPIO runs edgeIsr() on every change of a pad, and the drain
+// reads the ring through EdgeStream, the /edges response body.
+//
+// Build and run (Linux/macOS), ideally under ThreadSanitizer:
+//   cmake -S . -B build -DSANITIZE=thread && cmake --build build --target edge_capture
+//   TSAN_OPTIONS=suppressions=tools/tsan.supp ./build/edge_capture [-p pins] [-n bursts per pin]
+//       [-b bounces per edge] [-m batch] [-d debounce us] [-r interrupts per second, 0 for flat out]
+//
+// One thread plays the outside world: on a manual clock it drives bursts of
+// edges on every pin, each clean edge followed by contact bounces shorter
+// than the debounce. Another drains the ring in batches of up to `batch`
+// records the way /edges does and parses what EdgeStream writes. Checks
+// that each pin's levels alternate with no bounce getting through, and that
+// records read plus records reported dropped add up to the edges pushed.
+// Exits non-zero on the first violation. At the default rate the drain
+// should keep up with little or nothing lost; -r 0 injects as fast as the
+// host can, which overruns the ring and exercises the overflow path. Build without
+// SANITIZE for meaningful throughput figures. The record payload is copied
+// while the ISR may be rewriting it, which the seq check in edgeRead()
+// covers; tools/tsan.supp tells ThreadSanitizer so.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic<bool> done(false);
+
+static void fail(const char* what, uint32_t time, int gpio, int level) {
+  simFailf("record (gpio %d, level %d, time %u): %s", gpio, level, time, what);
+}
+
+int main(int argc, char **argv) {
+  int pins = 8;
+  int bursts = 200000;
+  int bounces = 3;
+  int batch = EDGE_BATCH_MAX;
+  uint32_t debounce = 200;
+  double rate = 1e6;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-p" && hasValue) {
+      pins = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-n" && hasValue) {
+      bursts = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-b" && hasValue) {
+      bounces = std::max(0, atoi(argv[++i]));
+    } else if (arg == "-m" && hasValue) {
+      batch = std::min(EDGE_BATCH_MAX, std::max(1, atoi(argv[++i])));
+    } else if (arg == "-d" && hasValue) {
+      debounce = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-r" && hasValue) {
+      rate = std::max(0.0, atof(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: edge_capture [-p pins] [-n bursts per pin] [-b bounces per edge] [-m batch] "
+                      "[-d debounce us] [-r interrupts/s]\n");
+      return 2;
+    }
+  }
+
+  std::vector<int> gpios;
+  std::vector<int> index(SOC_GPIO_PIN_COUNT, -1);
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT && (int)gpios.size() < pins; gpio++) {
+    if (pinCanInput(gpio)) {
+      index[gpio] = gpios.size();
+      gpios.push_back(gpio);
+    }
+  }
+  pins = gpios.size();
+
+  // Every pin armed for both edges, starting LOW
+  simManualClock(1000000);
+  for (int gpio : gpios) {
+    simSetInput(gpio, false);
+    if (edgeConfigure(gpio, EDGE_BOTH, INPUT, debounce) != 200) {
+      fprintf(stderr, "edgeConfigure(%d) failed\n", gpio);
+      return 1;
+    }
+  }
+
+  // Drain: batches of up to `batch` records from a cursor, as /edges hands
+  // them out, with what was overwritten skipped and counted
+  uint64_t read = 0, lost = 0, batches = 0;
+  std::vector<int> lastLevel(pins, -1);
+  std::vector<uint32_t> lastTime(pins);
+  std::thread drain([&] {
+    uint32_t next = 0;
+    for (;;) {
+      bool finished = done.load(std::memory_order_acquire);
+      if (__atomic_load_n(&edgeHead, __ATOMIC_ACQUIRE) == next) {
+        if (finished) break;
+        std::this_thread::yield();
+        continue;
+      }
+      EdgeStream stream = {};
+      stream.next = next;
+      stream.max = batch;
+      stream.gpio = -1;
+      stream.waiting = true;
+      stream.deadline = millis();
+      stream.first = true;
+      stream.ready();
+      batches++;
+      uint32_t dropped = 0;
+      while (stream.nextLine()) {
+        if (stream.dropped != dropped) {
+          // Records were overwritten here: levels after the gap need not
+          // follow the ones before it
+          std::fill(lastLevel.begin(), lastLevel.end(), -1);
+          dropped = stream.dropped;
+        }
+        stream.line[stream.lineLen] = 0;
+        unsigned time, gpio, level;
+        if (sscanf(stream.line, "%*[,[]%u,%u,%u]", &time, &gpio, &level) != 3) {
+          continue; // header or footer
+        }
+        int pin = gpio < index.size() ? index[gpio] : -1;
+        if (pin < 0) {
+          fail("unknown pin", time, gpio, level);
+        } else if (lastLevel[pin] >= 0) {
+          if ((int)level == lastLevel[pin]) fail("level did not alternate", time, gpio, level);
+          if (time - lastTime[pin] < debounce) fail("bounce got through", time, gpio, level);
+        }
+        if (pin >= 0) {
+          lastLevel[pin] = level;
+          lastTime[pin] = time;
+        }
+        read++;
+      }
+      lost += stream.dropped;
+      next = stream.next;
+    }
+  });
+
+  // Interrupts: a clean edge on each pin in turn, then its bounces a few
+  // microseconds apart, well inside the debounce
+  auto begin = std::chrono::steady_clock::now();
+  uint64_t interrupts = 0;
+  for (int burst = 0; burst < bursts; burst++) {
+    bool level = !(burst & 1);
+    for (int gpio : gpios) {
+      simAdvanceUs(debounce / pins + 1);
+      simSetInput(gpio, level);
+      interrupts++;
+      for (int b = 0; b < bounces; b++) {
+        simAdvanceUs(1);
+        simSetInput(gpio, b & 1 ? level : !level);
+        interrupts++;
+      }
+      if (bounces & 1) {
+        simSetInput(gpio, level); // the contact settles: one more bounce
+        interrupts++;
+      }
+    }
+    while (rate > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() < interrupts / rate) {
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  done.store(true, std::memory_order_release);
+  drain.join();
+
+  uint64_t edges = 0, dropped = 0;
+  for (int gpio : gpios) {
+    edges += edgePins[gpio].edges;
+    dropped += edgePins[gpio].bounces;
+  }
+  uint64_t expected = (uint64_t)bursts * pins;
+  if (edges != expected) {
+    simFailf("%llu edges reported, %llu expected", (unsigned long long)edges, (unsigned long long)expected);
+  }
+  if (read + lost != edgeHead) {
+    simFailf("%llu read + %llu lost != %u pushed", (unsigned long long)read, (unsigned long long)lost, edgeHead);
+  }
+
+  printf("%llu interrupts on %d pins: %llu edges, %llu bounces dropped\n", (unsigned long long)interrupts, pins,
+         (unsigned long long)edges, (unsigned long long)dropped);
+  printf("drained %llu in %llu batches, %llu lost to overflow\n", (unsigned long long)read,
+         (unsigned long long)batches, (unsigned long long)lost);
+  if (rate > 0) {
+    printf("injected at %.2f M interrupts/s\n", interrupts / seconds / 1e6);
+  } else {
+    printf("capture: %.1f M interrupts/s, %.0f ns per interrupt on this host\n", interrupts / seconds / 1e6,
+           seconds * 1e9 / interrupts);
+  }
+  return simExit();
+}
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Gzips the dashboard sources into a header of PROGMEM byte arrays.
+
+Run it after changing anything in dashboard/:
+
+    python3 tools/embed_assets.py [source_dir] [output_header]
+
+(defaults: dashboard/ and dashboard_assets.h). The output is deterministic, so
+the header only changes when an asset does.
+
+index.html is served at "/" and revalidated on every load. The CSS and JS are
+renamed after their content hash ("/dashboard.3fa2c1d0.js") and the links in
+index.html rewritten to match, so browsers may cache them for a year: a new
+firmware with changed assets links to new names.
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+}
+
+CACHE_INDEX = "no-cache"
+CACHE_HASHED = "public, max-age=31536000, immutable"
+
+
+def compress(data):
+    # mtime=0 keeps the output stable across runs
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def c_name(filename):
+    parts = re.split(r"[^A-Za-z0-9]", filename)
+    return "asset" + "".join(part[:1].upper() + part[1:] for part in parts if part)
+
+
+def c_array(name, data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("  " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "const uint8_t %s[] PROGMEM = {\n%s\n};\n" % (name, "\n".join(lines))
+
+
+def main():
+    source_dir = sys.argv[1] if len(sys.argv) > 1 else "dashboard"
+    output = sys.argv[2] if len(sys.argv) > 2 else "dashboard_assets.h"
+
+    index = None
+    assets = []  # (filename, path, raw bytes)
+    for filename in sorted(os.listdir(source_dir)):
+        ext = os.path.splitext(filename)[1]
+        if ext not in TYPES:
+            continue
+        with open(os.path.join(source_dir, filename), "rb") as f:
+            raw = f.read()
+        if filename == "index.html":
+            index = raw
+            continue
+        stem, ext = os.path.splitext(filename)
+        path = "/%s.%s%s" % (stem, hashlib.sha256(raw).hexdigest()[:8], ext)
+        assets.append((filename, path, raw))
+    if index is None:
+        sys.exit("%s/index.html not found" % source_dir)
+
+    for filename, path, _ in assets:
+        index = index.replace(('"/%s"' % filename).encode(), ('"%s"' % path).encode())
+    assets.insert(0, ("index.html", "/", index))
+
+    arrays = []
+    entries = []
+    total_raw = total_gz = 0
+    for filename, path, raw in assets:
+        gz = compress(raw)
+        name = c_name(filename)
+        etag = '\\"%s\\"' % hashlib.sha256(gz).hexdigest()[:16]
+        cache = CACHE_INDEX if path == "/" else CACHE_HASHED
+        arrays.append(c_array(name, gz))
+        entries.append('  {"%s", "%s", "%s", "%s", %s, sizeof(%s), %d},' %
+                       (path, TYPES[os.path.splitext(filename)[1]], cache, etag, name, name, len(raw)))
+        total_raw += len(raw)
+        total_gz += len(gz)
+        print("%-24s %6d -> %6d bytes  %s" % (filename, len(raw), len(gz), path))
+    print("%-24s %6d -> %6d bytes" % ("total", total_raw, total_gz))
+
+    with open(output, "w") as f:
+        f.write("// Generated by tools/embed_assets.py from %s/. Do not edit: change the\n"
+                "// sources and run the script again.\n"
+                "#pragma once\n\n"
+                "struct WebAsset {\n"
+                "  const char* path;\n"
+                "  const char* type;\n"
+                "  const char* cacheControl;\n"
+                "  const char* etag;\n"
+                "  const uint8_t* data;  // gzip\n"
+                "  size_t len;\n"
+                "  size_t rawLen;        // before compression\n"
+                "};\n\n" % source_dir)
+        f.write("\n".join(arrays))
+        f.write("\nconst WebAsset webAssets[] = {\n%s\n};\n" % "\n".join(entries))
+
+
+if __name__ == "__main__":
+    main()
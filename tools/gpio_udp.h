@@ -0,0 +1,220 @@
+// Host-side client for the binary UDP control protocol of
+// html_GPIO_control_dashboard.cpp. Header only, POSIX sockets.
+//
+//   gpioudp::Client client;
+//   if (client.open("192.168.1.50")) {
+//     client.set(4, true);
+//     uint32_t id;
+//     client.schedule(5, gpioudp::OP_HIGH, 1000, 500, &id);
+//   }
+//
+// Every call sends one frame and waits for its ack. A frame that is not
+// acknowledged in time is resent with the same sequence number, so the
+// device runs it at most once. A BUSY ack means the device ran nothing, so the
+// frame is resent the same way after a timeout's wait; BUSY is returned once
+// the retries are used up. The frame layouts below must match the sketch.
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace gpioudp {
+
+const uint16_t DEFAULT_PORT = 4210;
+const uint8_t MAGIC = 'G';
+const uint8_t VERSION = 1;
+
+enum Type : uint8_t { SET = 1, MASK = 2, PWM = 3, SCHEDULE = 4, CANCEL = 5, ACK = 0x80 };
+
+enum Op : uint8_t { OP_HIGH = 1, OP_LOW = 2, OP_PWM = 3 };
+
+enum Status : uint8_t {
+  OK,
+  BAD_FRAME,
+  INVALID,
+  NO_CHANNEL,
+  FULL,
+  NOT_FOUND,
+  STALE,
+  BUSY,           // the device's actuation queue was full and nothing ran
+  TIMEOUT = 0xFF  // client side: no ack after every retry
+};
+
+inline const char* statusText(Status status) {
+  switch (status) {
+    case OK: return "ok";
+    case BAD_FRAME: return "bad frame";
+    case INVALID: return "invalid pin or value";
+    case NO_CHANNEL: return "no free PWM channel";
+    case FULL: return "scheduler full";
+    case NOT_FOUND: return "schedule not found";
+    case STALE: return "stale sequence number";
+    case BUSY: return "device busy, nothing done";
+    case TIMEOUT: return "timeout";
+  }
+  return "unknown";
+}
+
+#pragma pack(push, 1)
+struct Header {
+  uint8_t magic;
+  uint8_t version;
+  uint8_t type;
+  uint8_t status;
+  uint32_t seq;
+};
+
+struct Set {
+  uint8_t gpio;
+  uint8_t level;
+  uint8_t reserved[2];
+};
+
+struct Mask {
+  uint32_t set[2];
+  uint32_t clear[2];
+};
+
+struct Pwm {
+  uint8_t gpio;
+  uint8_t resolution;
+  uint16_t duty;
+  uint32_t frequency;
+};
+
+struct Schedule {
+  uint8_t gpio;
+  uint8_t op;
+  uint8_t resolution;
+  uint8_t reserved;
+  uint16_t duty;
+  uint16_t reserved2;
+  uint32_t frequency;
+  uint32_t delay;
+  uint32_t duration;
+};
+
+struct Cancel {
+  uint32_t id;
+};
+
+struct Ack {
+  Header header;
+  uint32_t value;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(Header) == 8 && sizeof(Set) == 4 && sizeof(Mask) == 16 && sizeof(Pwm) == 8 &&
+              sizeof(Schedule) == 20 && sizeof(Cancel) == 4 && sizeof(Ack) == 12, "UDP frame layout");
+
+class Client {
+ public:
+  Client() : seq_(std::random_device()()) {}
+  ~Client() { close(); }
+  Client(const Client&) = delete;
+  Client &operator=(const Client&) = delete;
+
+  bool open(const char* host, uint16_t port = DEFAULT_PORT) {
+    close();
+    addrinfo hints = {}, *resolved;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &resolved) != 0) return false;
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    bool connected = fd_ >= 0 && connect(fd_, resolved->ai_addr, resolved->ai_addrlen) == 0;
+    freeaddrinfo(resolved);
+    if (!connected) close();
+    return connected;
+  }
+
+  void close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+  }
+
+  // Wait per attempt, and how many times a frame is resent
+  void setTimeout(int ms) { timeoutMs_ = ms; }
+  void setRetries(int retries) { retries_ = retries; }
+  uint32_t resent() const { return resent_; }
+
+  Status set(uint8_t gpio, bool level) {
+    Set body = {gpio, (uint8_t)(level ? 1 : 0), {0, 0}};
+    return transact(SET, &body, sizeof(body), nullptr);
+  }
+
+  // Sets and clears any number of pins with one register write per bank
+  Status maskWrite(const uint32_t set[2], const uint32_t clear[2]) {
+    Mask body = {{set[0], set[1]}, {clear[0], clear[1]}};
+    return transact(MASK, &body, sizeof(body), nullptr);
+  }
+
+  // frequency and resolution 0 use the device defaults (5 kHz, 8 bits)
+  Status pwm(uint8_t gpio, uint16_t duty, uint32_t frequency = 0, uint8_t resolution = 0) {
+    Pwm body = {gpio, resolution, duty, frequency};
+    return transact(PWM, &body, sizeof(body), nullptr);
+  }
+
+  Status schedule(uint8_t gpio, Op op, uint32_t delayMs, uint32_t durationMs, uint32_t* id, uint16_t duty = 0,
+                  uint32_t frequency = 0, uint8_t resolution = 0) {
+    Schedule body = {gpio, op, resolution, 0, duty, 0, frequency, delayMs, durationMs};
+    return transact(SCHEDULE, &body, sizeof(body), id);
+  }
+
+  Status cancel(uint32_t id) {
+    Cancel body = {id};
+    return transact(CANCEL, &body, sizeof(body), nullptr);
+  }
+
+ private:
+  Status transact(uint8_t type, const void* body, size_t len, uint32_t* value) {
+    if (fd_ < 0) return TIMEOUT;
+    uint8_t frame[sizeof(Header) + sizeof(Schedule)];
+    Header header = {MAGIC, VERSION, type, 0, ++seq_};
+    memcpy(frame, &header, sizeof(header));
+    memcpy(frame + sizeof(header), body, len);
+
+    for (int attempt = 0; attempt <= retries_; attempt++) {
+      if (attempt > 0) resent_++;
+      if (send(fd_, frame, sizeof(header) + len, 0) < 0) continue;
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs_);
+      for (;;) {
+        int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                       deadline - std::chrono::steady_clock::now()).count();
+        pollfd pfd = {fd_, POLLIN, 0};
+        if (left <= 0 || poll(&pfd, 1, left) <= 0) break;
+        Ack ack;
+        if (recv(fd_, &ack, sizeof(ack), 0) != sizeof(ack)) continue;
+        if (ack.header.magic != MAGIC || ack.header.seq != header.seq || ack.header.type != (type | ACK)) {
+          continue;  // a late ack of an earlier frame
+        }
+        if (ack.header.status == BUSY && attempt < retries_) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs_));
+          break;
+        }
+        if (value) *value = ack.value;
+        return (Status)ack.header.status;
+      }
+    }
+    return TIMEOUT;
+  }
+
+  int fd_ = -1;
+  uint32_t seq_;
+  int timeoutMs_ = 50;
+  int retries_ = 3;
+  uint32_t resent_ = 0;
+};
+
+}  // namespace gpioudp
@@ -0,0 +1,265 @@
+// Host test for the LEDC channel pool, run against the real code in
+// gpio_core.h on the host build (host/): executeCommand() handing channels
+// out through pwmWrite() and taking them back on digital writes, over the
+// simulated LEDC, which counts timer setups, attaches and duty writes and
+// keeps channel pairs on one timer as the chip does.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target ledc_sim
+//   ./build/ledc_sim [-n random commands] [-s seed]
+//
+// Checks, each against the counts it should cost:
+//
+// - reuse: repeated duties on a pin set its timer up once and attach it once
+// - sharing: pins with the same timing fill channel pairs two at a time, so
+//   LEDC_CHANNELS pins take LEDC_TIMERS setups
+// - exhaustion: a pin past the last channel, or a timing with no pair left,
+//   fails without touching the hardware; a timing that matches a pair with
+//   a free channel still fits
+// - retiming: the only pin on a pair retimes it in place, a pin that shares
+//   one moves to another pair and leaves its partner's timing alone
+// - release: high or low hands the channel back for the next pin
+// - a random run of PWM and digital commands with a few timings: after
+//   each one, every PWM pin is attached to a channel of its own at its
+//   timing and duty, a command fails only when no channel could take it,
+//   and a timer is set up only when no running one matched
+//
+// Exits non-zero on the first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+struct Timing {
+  uint32_t frequency;
+  uint8_t resolution;
+};
+
+struct Counts {
+  uint32_t setups, attaches, writes;
+};
+
+static std::mt19937 rng(1);
+static std::vector<int> gpios;
+
+static Counts counts() {
+  return {simLedc.setups, simLedc.attaches, simLedc.writes};
+}
+
+static void expectCounts(const char* check, const Counts &before, Counts want) {
+  Counts now = counts();
+  if (now.setups - before.setups != want.setups) {
+    simFail(check, "timer setups", now.setups - before.setups, want.setups);
+  }
+  if (now.attaches - before.attaches != want.attaches) {
+    simFail(check, "attaches", now.attaches - before.attaches, want.attaches);
+  }
+  if (now.writes - before.writes != want.writes) simFail(check, "duty writes", now.writes - before.writes, want.writes);
+}
+
+static bool pwm(int gpio, uint16_t duty, Timing timing) {
+  GpioCommand cmd = {OP_PWM, (uint8_t)gpio, duty, 0, timing.frequency, timing.resolution, RAMP_LINEAR, 0};
+  return executeCommand(cmd) == ACTUATED;
+}
+
+static void low(int gpio) {
+  GpioCommand cmd = {OP_LOW, (uint8_t)gpio, 0, 0, PWM_DEFAULT_FREQ, PWM_DEFAULT_RESOLUTION, RAMP_LINEAR, 0};
+  executeCommand(cmd);
+}
+
+static void reset() {
+  for (int gpio : gpios) low(gpio);
+  for (int channel = 0; channel < LEDC_CHANNELS; channel++) {
+    if (ledcChannelPin[channel] != LEDC_NONE) simFail("reset", "channel still owned", channel, -1);
+  }
+}
+
+static const Timing defaultTiming = {PWM_DEFAULT_FREQ, PWM_DEFAULT_RESOLUTION};
+
+static void reuse() {
+  Counts before = counts();
+  uint32_t reconfigs = ledcReconfigs;
+  for (int duty = 0; duty < 100; duty++) {
+    if (!pwm(gpios[0], duty, defaultTiming)) simFail("reuse", "write failed", duty, -1);
+  }
+  expectCounts("reuse", before, {1, 1, 100});
+  if (ledcReconfigs - reconfigs != 1) simFail("reuse", "ledcReconfigs", ledcReconfigs - reconfigs, 1);
+  reset();
+}
+
+// Fills the pool with one timing, then asks for one pin more
+static void sharing() {
+  Counts before = counts();
+  for (int i = 0; i < LEDC_CHANNELS; i++) {
+    if (!pwm(gpios[i], 10, defaultTiming)) simFail("sharing", "write failed", gpios[i], -1);
+  }
+  expectCounts("sharing", before, {LEDC_TIMERS, LEDC_CHANNELS, LEDC_CHANNELS});
+  before = counts();
+  if (pwm(gpios[LEDC_CHANNELS], 10, defaultTiming)) simFail("exhaustion", "pin past the last channel", 1, 0);
+  expectCounts("exhaustion", before, {0, 0, 0});
+  if (pinChannel[gpios[LEDC_CHANNELS]] != LEDC_NONE) simFail("exhaustion", "channel given", 1, 0);
+
+  // Release one: the next pin gets its channel without a setup
+  low(gpios[3]);
+  before = counts();
+  if (!pwm(gpios[LEDC_CHANNELS], 10, defaultTiming)) simFail("release", "write after a release failed", 0, 1);
+  expectCounts("release", before, {0, 1, 1});
+  reset();
+}
+
+// One pin per timing uses every pair with one channel free on each
+static void timings() {
+  std::vector<Timing> distinct;
+  for (int i = 0; i < LEDC_TIMERS; i++) {
+    distinct.push_back({1000u + 1000u * i, 8});
+  }
+  Counts before = counts();
+  for (int i = 0; i < LEDC_TIMERS; i++) {
+    if (!pwm(gpios[i], 10, distinct[i])) simFail("timings", "write failed", i, -1);
+  }
+  expectCounts("timings", before, {LEDC_TIMERS, LEDC_TIMERS, LEDC_TIMERS});
+
+  before = counts();
+  if (pwm(gpios[LEDC_TIMERS], 10, {50000, 8})) simFail("exhaustion", "timing with no pair left", 1, 0);
+  expectCounts("exhaustion, new timing", before, {0, 0, 0});
+  before = counts();
+  if (!pwm(gpios[LEDC_TIMERS], 10, distinct[2])) simFail("exhaustion", "timing with a free channel", 0, 1);
+  expectCounts("exhaustion, matching timing", before, {0, 1, 1});
+
+  // gpios[2] and gpios[LEDC_TIMERS] share a pair. Retiming one of them
+  // needs a pair nobody uses, and there is none.
+  before = counts();
+  if (pwm(gpios[2], 10, {50000, 8})) simFail("retiming", "shared pin moved to a full pool", 1, 0);
+  expectCounts("retiming, full pool", before, {0, 0, 0});
+  if (simLedc.channel[pinChannel[gpios[2]]].frequency != distinct[2].frequency) {
+    simFail("retiming", "frequency after a failed move", simLedc.channel[pinChannel[gpios[2]]].frequency,
+         distinct[2].frequency);
+  }
+
+  // The only pin on its pair retimes it in place
+  before = counts();
+  uint8_t channel = pinChannel[gpios[0]];
+  if (!pwm(gpios[0], 10, {50000, 8})) simFail("retiming", "sole user", 0, 1);
+  expectCounts("retiming, sole user", before, {1, 0, 1});
+  if (pinChannel[gpios[0]] != channel) simFail("retiming", "sole user changed channel", pinChannel[gpios[0]], channel);
+
+  // Free a pair: the shared pin moves there and its partner keeps its timing
+  low(gpios[1]);
+  before = counts();
+  if (!pwm(gpios[2], 10, {60000, 8})) simFail("retiming", "shared pin", 0, 1);
+  expectCounts("retiming, shared pin", before, {1, 1, 1});
+  int partner = gpios[LEDC_TIMERS];
+  if (simLedc.channel[pinChannel[partner]].frequency != distinct[2].frequency) {
+    simFail("retiming", "partner's frequency", simLedc.channel[pinChannel[partner]].frequency, distinct[2].frequency);
+  }
+  if (pinChannel[gpios[2]] / 2 == pinChannel[partner] / 2) simFail("retiming", "still on the partner's pair", 1, 0);
+  reset();
+}
+
+// Random PWM and digital commands, checked against the simulated hardware
+static void randomRun(int commands) {
+  const Timing choices[] = {{5000, 8}, {5000, 8}, {5000, 10}, {1000, 8}, {20000, 8}, {20000, 10}};
+  std::vector<int> pins(gpios.begin(), gpios.begin() + std::min<size_t>(gpios.size(), LEDC_CHANNELS + 8));
+  std::vector<Timing> timing(SOC_GPIO_PIN_COUNT, Timing{0, 0});
+  std::vector<int> duty(SOC_GPIO_PIN_COUNT, -1); // -1 when digital
+  uint32_t setups = simLedc.setups;
+  uint32_t writes = 0;
+  uint32_t refused = 0;
+  for (int n = 0; n < commands; n++) {
+    int gpio = pins[rng() % pins.size()];
+    if (rng() % 4 == 0) {
+      low(gpio);
+      duty[gpio] = -1;
+    } else {
+      Timing t = choices[rng() % (sizeof(choices) / sizeof(choices[0]))];
+      uint16_t d = rng() % 256;
+
+      // What the hardware allows, from the channels in use
+      bool matches = false;   // a free channel on a pair running at t
+      bool freePair = false;
+      bool alone = false;     // the pin is the only one on its pair
+      bool same = duty[gpio] >= 0 && timing[gpio].frequency == t.frequency && timing[gpio].resolution == t.resolution;
+      for (int pair = 0; pair < LEDC_TIMERS; pair++) {
+        const SimLedcChannel &a = simLedc.channel[2 * pair];
+        const SimLedcChannel &b = simLedc.channel[2 * pair + 1];
+        if (a.gpio < 0 && b.gpio < 0) freePair = true;
+        bool running = a.frequency == t.frequency && a.resolution == t.resolution && (a.gpio >= 0 || b.gpio >= 0);
+        if (running && (a.gpio < 0 || b.gpio < 0)) matches = true;
+        if ((a.gpio == gpio && b.gpio < 0) || (b.gpio == gpio && a.gpio < 0)) alone = true;
+      }
+      bool fits = same || alone || matches || freePair;
+      uint32_t wantSetups = same || (!alone && matches) || !fits ? 0 : 1;
+
+      uint32_t before = simLedc.setups;
+      bool ok = pwm(gpio, d, t);
+      if (ok != fits) simFail("random", "write result", ok, fits);
+      if (simLedc.setups - before != wantSetups) simFail("random", "timer setups", simLedc.setups - before, wantSetups);
+      if (ok) {
+        timing[gpio] = t;
+        duty[gpio] = d;
+        writes++;
+      } else {
+        refused++;
+      }
+    }
+
+    // Every PWM pin on its own channel, at its timing and duty
+    for (int pin : pins) {
+      uint8_t channel = pinChannel[pin];
+      if (duty[pin] < 0) {
+        if (channel != LEDC_NONE) simFail("random", "digital pin holds a channel", pin, -1);
+        continue;
+      }
+      if (channel == LEDC_NONE || simLedc.channel[channel].gpio != pin) {
+        simFail("random", "PWM pin not attached", pin, -1);
+        continue;
+      }
+      const SimLedcChannel &c = simLedc.channel[channel];
+      if (c.frequency != timing[pin].frequency || c.resolution != timing[pin].resolution) {
+        simFail("random", "channel timing", c.frequency, timing[pin].frequency);
+      }
+      if (c.duty != (uint32_t)duty[pin]) simFail("random", "channel duty", c.duty, duty[pin]);
+    }
+  }
+  printf("random: %d commands on %zu pins, %u PWM writes, %u refused, %u timer setups\n", commands, pins.size(), writes,
+         refused, simLedc.setups - setups);
+  reset();
+}
+
+int main(int argc, char **argv) {
+  int commands = 200000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue) {
+      commands = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-s" && hasValue) {
+      rng.seed(strtoul(argv[++i], NULL, 10));
+    } else {
+      fprintf(stderr, "usage: ledc_sim [-n random commands] [-s seed]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  ledcPoolBegin();
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+    if (pinCanOutput(gpio)) gpios.push_back(gpio);
+  }
+  if ((int)gpios.size() <= LEDC_CHANNELS) {
+    fprintf(stderr, "needs more than %d output pins, has %zu\n", LEDC_CHANNELS, gpios.size());
+    return 2;
+  }
+
+  reuse();
+  sharing();
+  timings();
+  printf("%d channels, %d timers: reuse, sharing, exhaustion, retiming and release checked\n", LEDC_CHANNELS,
+         LEDC_TIMERS);
+  randomRun(commands);
+  printf("%u timer (re)configurations in all\n", ledcReconfigs);
+  return simExit();
+}
@@ -0,0 +1,112 @@
+// Microbenchmark of the /metrics recording path, run against the real code
+// in gpio_core.h on the host build (host/): histogramObserve() and the
+// ScopeTimer the dashboard's RouteTimer is, with heap allocations counted by
+// host/alloc.cpp.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target metrics_bench
+//   ./build/metrics_bench [-n records per case]
+//
+// Reports ns per record and the same time on ESP.getCycleCount(), which the
+// host counts at 240 MHz, for:
+//
+// - histogramObserve() with values spread over every bucket and +Inf
+// - an empty scope timed by a ScopeTimer: two cycle counter reads, the
+//   division by cyclesPerMicro and the observe
+//
+// Checks that neither allocates, and, on the manual clock, that a timed scope
+// lands in the bucket of its length and adds its length in microseconds to
+// the sum. The host counter follows the wall clock, so a case over
+// RECORD_BUDGET_CYCLES is only reported: a loaded machine (ctest -j) gets
+// there without any change to the path. It fails above RECORD_REGRESSION
+// times the budget, which takes a wait or a slow call added to the path, not
+// a busy host. Allocations are counted exactly. Exits non-zero on the first
+// violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#define RECORD_BUDGET_CYCLES 300
+#define RECORD_REGRESSION 10
+
+struct Result {
+  double ns;
+  double cycles;
+  double allocations;
+};
+
+// Runs record() n times and returns the cost of one
+template <typename Record>
+static Result measure(int n, Record record) {
+  uint64_t allocations = simAllocations();
+  uint32_t cycles = ESP.getCycleCount();
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) {
+    record(i);
+    asm volatile("" ::: "memory"); // one record per iteration, not folded into the loop
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  return {ns / n, (double)(ESP.getCycleCount() - cycles) / n, (double)(simAllocations() - allocations) / n};
+}
+
+static void report(const char* name, const Result &result) {
+  printf("%-26s %10.1f %10.1f %10.2f%s\n", name, result.ns, result.cycles, result.allocations,
+         result.cycles > RECORD_BUDGET_CYCLES ? "  over budget" : "");
+  if (result.cycles > RECORD_BUDGET_CYCLES * RECORD_REGRESSION) {
+    simFail(name, result.cycles, RECORD_BUDGET_CYCLES * RECORD_REGRESSION);
+  }
+  if (result.allocations != 0) simFail(name, result.allocations, 0);
+}
+
+int main(int argc, char** argv) {
+  int records = 2000000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-n" && i + 1 < argc) {
+      records = std::max(1, atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: metrics_bench [-n records per case]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  // Every bit length up to HIST_BUCKETS + 1, so some land in +Inf
+  std::mt19937 rng(1);
+  std::vector<uint32_t> values(4096);
+  for (uint32_t &value : values) {
+    value = rng() & ((1u << (rng() % (HIST_BUCKETS + 2))) - 1);
+  }
+  Histogram histogram = {};
+
+  printf("%-26s %10s %10s %10s\n", "record", "ns", "cycles", "allocs");
+  report("histogramObserve()", measure(records, [&](int i) { histogramObserve(histogram, values[i & 4095], 0); }));
+  report("ScopeTimer, empty scope", measure(records, [&](int) { ScopeTimer timer(histogram, 0); }));
+  if (histogram.count != 2 * (uint32_t)records) simFail("histogram count", histogram.count, 2 * records);
+
+  // Lengths on the manual clock, in 16 us steps as the routes record them
+  simManualClock(0);
+  const int shift = 4;
+  for (uint32_t us : {0u, 15u, 16u, 100u, 1500u, 32767u, 32768u, 1000000u}) {
+    Histogram timed = {};
+    {
+      ScopeTimer timer(timed, shift);
+      simAdvanceUs(us);
+    }
+    uint32_t scaled = us >> shift;
+    int bucket = 0;
+    while (bucket < 32 && (1ULL << bucket) <= scaled) bucket++;
+    int got = -1;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+      if (timed.buckets[i]) got = i;
+    }
+    if (got != (bucket < HIST_BUCKETS ? bucket : -1)) simFail("bucket of a timed scope, us", us, bucket);
+    if (timed.count != 1 || timed.sum != us) simFail("sum of a timed scope, us", timed.sum, us);
+  }
+  return simExit();
+}
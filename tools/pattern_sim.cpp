@@ -0,0 +1,337 @@
+// Host test for the blink pattern engine, run against the real code in
+// gpio_core.h on the host build (host/): patternStart(), patternStop() and
+// the 1 ms patternTick(), on a manual clock.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target pattern_sim
+//   ./build/pattern_sim [-d ms] [-t ticks per pin count] [-s seed]
+//
+// Checks:
+//
+// - phase: MAX_PATTERNS pins with random periods, duty cycles, phase
+//   offsets and repeat counts, started at random times, two of them with
+//   the same period started far apart. Every edge must be written on the
+//   tick of the millisecond the pattern puts it at, counted from millis()
+//   0, and no other edge may be written.
+// - late ticks: the same with ticks delayed by up to 3 ms. After each write
+//   every pin must be at the level its pattern has at that millisecond, and
+//   once the ticks are on time again every edge must be written in its
+//   millisecond again. The ticker is then off the millisecond grid, which
+//   the patterns, aligned to millis(), do not follow.
+// - cost: the tick with 1 to MAX_PATTERNS pins, all toggling every tick and
+//   all idle. Reports the time per tick. Each tick must write GPIO_OUT at
+//   most once per bank, and stay under 5% of PATTERN_TICK_MS on this host.
+// - full ring: with the actuation task stalled and its ring full, a tick
+//   with an edge due must not wait for room: it returns at once, its write
+//   counted in patternDropped, and the pin keeps its level. Once the task
+//   runs again, the next tick sends the dropped level.
+//
+// Exits non-zero on the first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Spec {
+  int gpio;
+  uint32_t period;
+  int duty;
+  uint32_t phase;
+  uint32_t repeat;
+  uint32_t startMs;
+  uint32_t first; // millis() of the first cycle
+  uint32_t high;  // ms high per cycle
+};
+
+struct Edge {
+  int gpio;
+  bool level;
+  int64_t us;
+};
+
+static std::mt19937 rng(1);
+static std::vector<Spec> specs;
+static std::vector<Edge> edges;
+static uint32_t outSeen[GPIO_BANKS];
+static uint32_t outWrites = 0;
+static bool starting = false;
+static bool lateTicks = false;
+
+// The level a pattern gives its pin at millisecond ms
+static bool model(const Spec &spec, uint32_t ms) {
+  if (ms < spec.first) return false;
+  uint32_t cycle = (ms - spec.first) / spec.period;
+  if (spec.repeat != 0 && cycle >= spec.repeat) return false;
+  return (ms - spec.first) % spec.period < spec.high;
+}
+
+static const Spec* specOf(int gpio) {
+  for (const Spec &spec : specs) {
+    if (spec.gpio == gpio) return &spec;
+  }
+  return nullptr;
+}
+
+static void onOutWrite(int bank, uint32_t out) {
+  outWrites++;
+  uint32_t changed = out ^ outSeen[bank];
+  outSeen[bank] = out;
+  if (starting) return; // patternStart() driving its pin low
+  while (changed) {
+    int gpio = bank * 32 + __builtin_ctz(changed);
+    if (specOf(gpio)) edges.push_back({gpio, (bool)((out >> (gpio & 31)) & 1), simNowUs()});
+    changed &= changed - 1;
+  }
+}
+
+static std::vector<int> outputGpios() {
+  std::vector<int> gpios;
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+    if (pinCanOutput(gpio)) gpios.push_back(gpio);
+  }
+  return gpios;
+}
+
+// Random patterns on MAX_PATTERNS pins, started from the current millis()
+static void makeSpecs(uint32_t now) {
+  std::vector<int> gpios = outputGpios();
+  std::shuffle(gpios.begin(), gpios.end(), rng);
+  gpios.resize(MAX_PATTERNS);
+  specs.clear();
+  for (int gpio : gpios) {
+    Spec spec = {gpio, 0, 0, 0, 0, 0, 0, 0};
+    do {
+      spec.period = 2 + rng() % 399;
+      spec.duty = 1 + rng() % 99;
+      spec.high = (uint64_t)spec.period * spec.duty / 100;
+    } while (spec.high == 0);
+    spec.phase = rng() % (2 * spec.period);
+    spec.repeat = rng() % 2 ? 0 : 1 + rng() % 10;
+    spec.startMs = now + rng() % 1000;
+    specs.push_back(spec);
+  }
+  // Same period and phase grid, started 700 ms apart
+  specs[1].period = specs[0].period = 200;
+  specs[1].duty = specs[0].duty = 50;
+  specs[1].high = specs[0].high = 100;
+  specs[0].phase = 0;
+  specs[1].phase = 50;
+  specs[1].startMs = specs[0].startMs + 700;
+  for (Spec &spec : specs) {
+    // Not on a cycle start: the first edge would wait for the next tick
+    if ((spec.startMs + spec.period - spec.phase % spec.period) % spec.period == 0) spec.startMs++;
+    spec.first = spec.startMs + (spec.phase % spec.period + spec.period - spec.startMs % spec.period) % spec.period;
+  }
+  std::sort(specs.begin(), specs.end(), [](const Spec &a, const Spec &b) { return a.startMs < b.startMs; });
+}
+
+// Starts the patterns at their times, between ticks, and runs to endMs
+static void run(uint32_t endMs) {
+  for (const Spec &spec : specs) {
+    simAdvanceUs((int64_t)spec.startMs * 1000 + 500 - simNowUs());
+    starting = true;
+    if (!patternStart(spec.gpio, spec.period, spec.duty, spec.phase, spec.repeat)) simFail("start", "slot", 0, 1);
+    starting = false;
+  }
+  simAdvanceUs((int64_t)endMs * 1000 + 500 - simNowUs());
+}
+
+// Compares the edges written in [fromMs, toMs] with the ones the model puts
+// there, to the us on the tick grid or else to the millisecond; returns the
+// largest error in us
+static int64_t exactEdges(const char* part, uint32_t fromMs, uint32_t toMs, bool onGrid) {
+  int64_t worst = 0;
+  for (const Spec &spec : specs) {
+    std::vector<std::pair<uint32_t, bool>> want;
+    for (uint32_t ms = std::max(fromMs, spec.startMs + 1); ms <= toMs; ms++) {
+      if (model(spec, ms) != model(spec, ms - 1)) want.push_back({ms, model(spec, ms)});
+    }
+    std::vector<const Edge*> got;
+    for (const Edge &edge : edges) {
+      if (edge.gpio == spec.gpio && edge.us >= (int64_t)fromMs * 1000 && edge.us < (int64_t)(toMs + 1) * 1000) {
+        got.push_back(&edge);
+      }
+    }
+    if (got.size() != want.size()) simFail(part, "edges on a pin", got.size(), want.size());
+    for (size_t i = 0; i < got.size() && i < want.size(); i++) {
+      int64_t error = got[i]->us - (int64_t)want[i].first * 1000;
+      worst = std::max(worst, std::abs(error));
+      if (got[i]->level != want[i].second || (onGrid ? error != 0 : got[i]->us / 1000 != want[i].first)) {
+        simFail(part, "edge time in us, pin", got[i]->us, (int64_t)want[i].first * 1000);
+        break;
+      }
+    }
+  }
+  return worst;
+}
+
+static void phase(uint32_t ms) {
+  patternStop(-1);
+  edges.clear();
+  uint32_t now = millis();
+  makeSpecs(now);
+  run(now + ms);
+  int64_t worst = exactEdges("phase", now, now + ms, true);
+  printf("%-10s %zu edges on %d pins in %u ms, largest error %lld us\n", "phase", edges.size(), MAX_PATTERNS, ms,
+         (long long)worst);
+}
+
+static void late(uint32_t ms) {
+  const char* part = "late ticks";
+  patternStop(-1);
+  edges.clear();
+  uint32_t now = millis();
+  makeSpecs(now);
+  lateTicks = true;
+  run(now + ms);
+  lateTicks = false;
+
+  // Each write leaves every pin at its pattern's level at that millisecond
+  int64_t worst = 0;
+  for (const Edge &edge : edges) {
+    uint32_t at = edge.us / 1000;
+    if (edge.level != model(*specOf(edge.gpio), at)) simFail(part, "level written at ms", at, model(*specOf(edge.gpio), at));
+    // How late this edge is: back to the millisecond its pattern changed
+    uint32_t since = at;
+    while (since > 0 && model(*specOf(edge.gpio), since - 1) == edge.level) since--;
+    worst = std::max<int64_t>(worst, edge.us - (int64_t)since * 1000);
+  }
+  // On time again: exact once the ticks armed late have run
+  uint32_t resumed = millis() + 4;
+  simAdvanceUs(1000000);
+  int64_t after = exactEdges(part, resumed, millis(), false);
+  for (const Spec &spec : specs) {
+    bool level = (outSeen[spec.gpio >> 5] >> (spec.gpio & 31)) & 1;
+    if (level != model(spec, millis())) simFail(part, "level at the end, pin", spec.gpio, model(spec, millis()));
+  }
+  printf("%-10s %zu edges, latest %lld us after their ms; %lld us once on time again\n", part, edges.size(),
+         (long long)worst, (long long)after);
+  if (worst > 4000) simFail(part, "latest edge, us", worst, 4000);
+}
+
+static void cost(int ticks) {
+  const char* part = "cost";
+  patternTicker.detach(); // the ticks are called here
+  specs.clear();
+  std::vector<int> gpios = outputGpios();
+  printf("%-10s %8s %14s %14s %12s\n", part, "pins", "toggling ns", "idle ns", "writes/tick");
+  for (int pins = 1; pins <= MAX_PATTERNS; pins *= 2) {
+    double ns[2];
+    uint32_t writes = 0;
+    for (int idle = 0; idle < 2; idle++) {
+      patternStop(-1);
+      for (int i = 0; i < pins; i++) {
+        // Period 2 and 50% toggles every ms; period 100000 leaves the tick nothing to do
+        patternStart(gpios[gpios.size() - 1 - i], idle ? 100000 : 2, 50, 0, 0);
+      }
+      uint32_t banks = 0;
+      for (int i = 0; i < pins; i++) banks |= 1UL << (gpios[gpios.size() - 1 - i] >> 5);
+      double total = 0;
+      uint32_t before = outWrites;
+      for (int t = 0; t < ticks; t++) {
+        simAdvanceUs(1000);
+        uint32_t tickWrites = outWrites;
+        auto t0 = std::chrono::steady_clock::now();
+        patternTick();
+        total += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        if (outWrites - tickWrites > (uint32_t)__builtin_popcount(banks)) {
+          simFail(part, "GPIO_OUT writes in one tick", outWrites - tickWrites, __builtin_popcount(banks));
+        }
+      }
+      ns[idle] = total / ticks;
+      if (!idle) writes = outWrites - before;
+    }
+    printf("%-10s %8d %14.0f %14.0f %12.2f\n", "", pins, ns[0], ns[1], (double)writes / ticks);
+    if (ns[0] > PATTERN_TICK_MS * 1e6 * 0.05) simFail(part, "tick with every pin toggling, ns", ns[0], PATTERN_TICK_MS * 1e6 * 0.05);
+  }
+  patternStop(-1);
+}
+
+// A consumer that never runs anything, so the ring stays full
+static void stalledLoop(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+static void drain() {
+  for (int i = 0; i < 1000 && __atomic_load_n(&actuationHead, __ATOMIC_ACQUIRE) != actuationTail; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(5)); // the last one run, not just taken
+}
+
+static void fullRing() {
+  const char* part = "full ring";
+  int gpio = outputGpios().back();
+  for (uint32_t i = 0; i < ACTUATION_QUEUE_SIZE; i++) {
+    actuationRing[i].seq = i; // as actuationBegin() does
+  }
+  xTaskCreatePinnedToCore(stalledLoop, "stalled", ACTUATION_STACK, NULL, ACTUATION_PRIORITY, &actuationTask,
+                          ACTUATION_CORE);
+  patternStart(gpio, 1000, 50, 0, 0);
+  Actuation filler = {ACT_MASK, {}, {}, NULL, NULL, 0};
+  while (actuationTryPush(filler)) {
+  }
+  uint32_t fullWaits = actuationFullWaits;
+  uint32_t dropped = patternDropped;
+  simAdvanceUs(((1000 - millis() % 1000) % 1000 + 1) * 1000); // 1 ms into the first cycle, high
+  auto t0 = std::chrono::steady_clock::now();
+  patternTick();
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  printf("%-10s tick with the ring full took %.3f ms, %u write dropped\n", part, ms, patternDropped - dropped);
+  if (actuationFullWaits != fullWaits) simFail(part, "ticks that waited for room", actuationFullWaits - fullWaits, 0);
+  if (ms >= ACTUATION_WAIT_MS) simFail(part, "tick with the ring full, ms", ms, 0);
+  if (patternDropped != dropped + 1) simFail(part, "dropped tick writes", patternDropped - dropped, 1);
+
+  // The real task drains the ring; the pin has not moved until the next tick
+  xTaskCreatePinnedToCore(actuationLoop, "actuation", ACTUATION_STACK, NULL, ACTUATION_PRIORITY, &actuationTask,
+                          ACTUATION_CORE);
+  xTaskNotifyGive(actuationTask);
+  drain();
+  if (simPinLevel(gpio)) simFail(part, "level before the next tick", 1, 0);
+  patternTick();
+  drain();
+  if (!simPinLevel(gpio)) simFail(part, "level once the dropped write was sent again", 0, 1);
+  patternStop(gpio);
+  drain();
+  if (simPinLevel(gpio)) simFail(part, "level after stop", 1, 0);
+}
+
+int main(int argc, char **argv) {
+  uint32_t ms = 5000;
+  int ticks = 20000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-d" && hasValue) {
+      ms = std::max(1000, atoi(argv[++i]));
+    } else if (arg == "-t" && hasValue) {
+      ticks = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-s" && hasValue) {
+      rng.seed(strtoul(argv[++i], NULL, 10));
+    } else {
+      fprintf(stderr, "usage: pattern_sim [-d ms] [-t ticks per pin count] [-s seed]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  simManualClock(0);
+  simOnOutWrite = onOutWrite;
+  simTimerLatency = [](const char* timer) -> int64_t {
+    return lateTicks && strcmp(timer, "Ticker") == 0 && rng() % 5 == 0 ? rng() % 3000 : 0;
+  };
+  patternsBegin();
+  phase(ms);
+  late(ms);
+  cost(ticks);
+  fullRing();
+  return simExit();
+}
@@ -0,0 +1,295 @@
+// Host simulation of the pulse counters, run against the real code in
+// gpio_core.h on the host build (host/): counterConfigure(), the
+// counterTick() poll on its esp_timer, counterFold() and countersSnapshot(),
+// reading the simulated PCNT unit: a 16-bit counter that returns to 0 at its
+// limits, a glitch filter that passes only levels held for the filter time,
+// and a control pin that reverses counting while low.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target pcnt_sim
+//   ./build/pcnt_sim [-j poll jitter us] [-s seed]
+//
+// Feeds the unit synthetic pulse trains on a manual clock: steady
+// flow-meter rates from 1 Hz to 5 MHz, a frequency sweep, a train riddled
+// with glitches shorter than the filter, an encoder whose direction pin
+// flips, and one read with reset-on-read now and then. Each poll runs up to
+// the jitter late (default 200 us). Checks that each 64-bit total equals the
+// edges the train should count, that the windowed frequency matches the
+// train's rate, and that counts read with reset add up to the total. Prints
+// the largest change seen between two polls, which must stay below what a
+// poll can tell apart: COUNTER_LIMIT, or COUNTER_LIMIT / 2 with a direction
+// pin.
+//
+// Then checks that the pins a counter or edge capture holds as inputs are
+// refused to everything that drives pins: decodeCommand() fails, a batch
+// operation gets BATCH_PIN_CLAIMED, and a mask write already queued leaves
+// them alone. A pin edge capture only reads back because the sketch drives
+// it stays the sketch's, and a pin is free again once its last owner lets go.
+// Exits non-zero on any mismatch.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#define PULSE_PIN 4
+#define CTRL_PIN 5
+
+struct Input {
+  int64_t at;    // ns
+  bool ctrl;     // control pin, else pulse pin
+  bool level;
+  bool clean;    // a pulse pin change the filter lets through
+};
+
+// A square wave whose half period at time t is half(t) ns. glitch > 0 adds a
+// pulse of that many ns in the middle of every half period, which the filter
+// must swallow; flip > 0 toggles the control pin every flip ns, a quarter
+// period away from any pulse edge.
+struct Train {
+  const char* name;
+  uint8_t edge;
+  uint32_t filter;               // ns
+  int64_t length;                // ns
+  double frequency;              // counted edges per second to check, 0 to skip
+  bool resets;                   // read with reset-on-read now and then
+  std::function<double(int64_t)> half;
+  int64_t glitch;
+  int64_t flip;
+
+  double t;                      // ns, kept fractional so the rate is exact
+  bool level;
+  bool ctrl;
+  int64_t nextFlip;
+  int64_t expected;
+  std::vector<Input> pending;
+  size_t pos;
+
+  bool next(Input &in) {
+    while (pos == pending.size()) {
+      pending.clear();
+      pos = 0;
+      double h = half((int64_t)t);
+      double end = t + h;
+      if (end >= length) return false;
+      if (flip > 0 && end > nextFlip) {
+        ctrl = !ctrl;
+        pending.push_back({std::llround(t + h / 4), true, ctrl, false});
+        nextFlip += flip;
+      }
+      if (glitch > 0) {
+        int64_t start = std::llround(t + h / 2) - glitch / 2;
+        pending.push_back({start, false, !level, false});
+        pending.push_back({start + glitch, false, level, false});
+      }
+      level = !level;
+      pending.push_back({std::llround(end), false, level, true});
+      t = end;
+    }
+    in = pending[pos++];
+    if (in.clean && (in.level ? edge != EDGE_FALLING : edge != EDGE_RISING)) {
+      expected += flip > 0 && !ctrl ? -1 : 1;
+    }
+    return true;
+  }
+};
+
+static Train train(const char* name, uint8_t edge, double seconds, std::function<double(int64_t)> half) {
+  Train train = {};
+  train.name = name;
+  train.edge = edge;
+  train.length = (int64_t)(seconds * 1e9);
+  train.half = half;
+  train.ctrl = true;
+  return train;
+}
+
+static std::function<double(int64_t)> steady(double hz) {
+  return [hz](int64_t) { return 0.5e9 / hz; };
+}
+
+// Observations between polls: the clock moves at most 1 ms at a time, less
+// than the gap between two polls, so each step sees at most one
+struct Watch {
+  const Train* train;
+  int64_t startNs;
+  int64_t lastTotal;
+  int64_t lastWindow;
+  int64_t maxDelta;
+  int64_t readSum;
+  double measured;
+};
+
+static void advanceTo(Watch &watch, int64_t atNs, std::mt19937 &rng) {
+  while (simNowUs() < atNs / 1000) {
+    simAdvanceUs(std::min<int64_t>(atNs / 1000 - simNowUs(), 1000));
+    const Counter &counter = counters[0];
+    watch.maxDelta = std::max(watch.maxDelta, (int64_t)std::llabs(counter.total - watch.lastTotal));
+    watch.lastTotal = counter.total;
+    // Keep the last window that closed inside the train
+    if (counter.windowStart != watch.lastWindow) {
+      watch.lastWindow = counter.windowStart;
+      if (counter.windowStart * 1000 <= watch.startNs + watch.train->length) {
+        watch.measured = counter.lastCount * 1e6 / counter.lastUs;
+      }
+    }
+    if (watch.train->resets && rng() % 250 == 0) {
+      Counter snapshot[COUNTER_UNITS];
+      countersSnapshot(snapshot, PULSE_PIN, true);
+      watch.readSum += snapshot[0].total - snapshot[0].base;
+    }
+  }
+}
+
+static void run(Train &train, std::mt19937 &rng) {
+  int status = counterConfigure(PULSE_PIN, train.edge, train.flip > 0 ? CTRL_PIN : -1, train.filter, 1000, 0);
+  if (status != 200) {
+    simFailf("%s: counterConfigure answered %d", train.name, status);
+    return;
+  }
+  Watch watch = {&train, simNowUs() * 1000, 0, counters[0].windowStart, 0, 0, 0};
+  Input in;
+  while (train.next(in)) {
+    int64_t at = watch.startNs + in.at;
+    advanceTo(watch, at, rng);
+    simPcntInput(in.ctrl ? CTRL_PIN : PULSE_PIN, in.level, at);
+  }
+  advanceTo(watch, watch.startNs + train.length + 100000000LL, rng);
+
+  Counter snapshot[COUNTER_UNITS];
+  countersSnapshot(snapshot, PULSE_PIN, false);
+  const Counter &result = snapshot[0];
+  bool ok = result.total == train.expected && watch.maxDelta < (train.flip > 0 ? COUNTER_LIMIT / 2 : COUNTER_LIMIT);
+  // One edge more or less in a window of about a second
+  if (train.frequency > 0 && std::fabs(watch.measured - train.frequency) > train.frequency * 1e-3 + 1.5) {
+    ok = false;
+  }
+  long long readTotal = watch.readSum + result.total - result.base;
+  bool readOk = !train.resets || readTotal == result.total;
+  printf("%-26s %7s %11lld %11lld %8lld %12.1f %12.1f  %s\n", train.name, edgeModeNames[train.edge],
+         (long long)train.expected, (long long)result.total, (long long)watch.maxDelta, train.frequency,
+         watch.measured, ok && readOk ? "ok" : "MISMATCH");
+  if (!readOk) {
+    simFailf("%s: counts read with reset add up to %lld", train.name, readTotal);
+  } else if (!ok) {
+    simFailf("%s: total %lld of %lld, %lld per poll at most, %.1f Hz measured", train.name, (long long)result.total,
+             (long long)train.expected, (long long)watch.maxDelta, watch.measured);
+  }
+  counterConfigure(PULSE_PIN, EDGE_OFF, -1, 0, 1000, 0);
+}
+
+static void expectClaimed(const char* what, int gpio, bool claimed) {
+  if (pinClaimed(gpio) != claimed) {
+    simFailf("%s: GPIO %d %s", what, gpio, claimed ? "not claimed" : "still claimed");
+  }
+}
+
+static void claims() {
+  const int free = 13;
+  const int edge = 14;
+  int failures = simFailures;
+  if (counterConfigure(PULSE_PIN, EDGE_RISING, CTRL_PIN, 0, 1000, 0) != 200) {
+    simFailf("claims: counterConfigure refused");
+  }
+  expectClaimed("counter", PULSE_PIN, true);
+  expectClaimed("counter", CTRL_PIN, true);
+  expectClaimed("counter", free, false);
+
+  GpioCommand cmd;
+  if (decodeCommand(PULSE_PIN, "high", cmd) || decodeCommand(CTRL_PIN, "pwm128", cmd) ||
+      !decodeCommand(free, "high", cmd)) {
+    simFailf("claims: decodeCommand on the counter's pins");
+  }
+  const char operations[] = "[{\"gpio\":4,\"state\":\"high\"},{\"gpio\":13,\"state\":\"high\"}]";
+  BatchParser parser;
+  batchBegin(parser);
+  batchFeed(parser, operations, strlen(operations));
+  if (parser.failed != 1 || parser.errorCode[0] != BATCH_PIN_CLAIMED || parser.errorIndex[0] != 0) {
+    simFailf("claims: batch on the counter's pulse pin failed %u operations", (unsigned)parser.failed);
+  }
+  // Queued before the counter took its pins
+  GpioMaskWrite write = {};
+  maskAdd(write, PULSE_PIN, true);
+  maskAdd(write, CTRL_PIN, true);
+  maskAdd(write, free, false);
+  actuateMask(write);
+  if (simGpio.out[0] & ((1UL << PULSE_PIN) | (1UL << CTRL_PIN))) {
+    simFailf("claims: mask write drove the counter's pins");
+  }
+
+  // Edge capture claims the pin it switches to input, not one the sketch drives
+  edgeConfigure(edge, EDGE_BOTH, INPUT, 0);
+  edgeConfigure(free, EDGE_BOTH, INPUT, 0);
+  edgeConfigure(PULSE_PIN, EDGE_BOTH, INPUT, 0);
+  expectClaimed("edge capture", edge, true);
+  expectClaimed("edge capture on a driven pin", free, false);
+  counterConfigure(PULSE_PIN, EDGE_OFF, -1, 0, 1000, 0);
+  expectClaimed("counter off, edge capture on", PULSE_PIN, true);
+  expectClaimed("counter off", CTRL_PIN, false);
+  for (int gpio : {edge, free, (int)PULSE_PIN}) {
+    edgeConfigure(gpio, EDGE_OFF, INPUT, 0);
+    expectClaimed("edge capture off", gpio, false);
+  }
+  printf("claims %s\n", simFailures != failures ? "MISMATCH" : "ok");
+}
+
+int main(int argc, char **argv) {
+  int jitter = 200;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-j" && hasValue) {
+      jitter = std::max(0, atoi(argv[++i]));
+    } else if (arg == "-s" && hasValue) {
+      seed = strtoul(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "usage: pcnt_sim [-j poll jitter us] [-s seed]\n");
+      return 2;
+    }
+  }
+  std::mt19937 rng(seed);
+  simManualClock();
+  simTimerLatency = [&](const char* timer) -> int64_t {
+    return jitter && strcmp(timer, "counter") == 0 ? rng() % (jitter + 1) : 0;
+  };
+  countersBegin();
+
+  std::vector<Train> trains;
+  trains.push_back(train("1 Hz", EDGE_RISING, 20, steady(1)));
+  trains.back().frequency = 1;
+  trains.push_back(train("1 kHz", EDGE_RISING, 10, steady(1000)));
+  trains.back().frequency = 1000;
+  trains.push_back(train("50 kHz", EDGE_BOTH, 5, steady(50000)));
+  trains.back().frequency = 100000;
+  trains.push_back(train("200 kHz", EDGE_FALLING, 3, steady(200000)));
+  trains.back().frequency = 200000;
+  trains.push_back(train("5 MHz", EDGE_RISING, 2, steady(5e6)));
+  trains.back().frequency = 5e6;
+  trains.push_back(train("sweep 10 Hz to 1 MHz", EDGE_RISING, 4, [](int64_t t) {
+    return 0.5e9 / (10 + (1e6 - 10) * t / 4e9);
+  }));
+  trains.push_back(train("5 kHz, 300 ns glitches", EDGE_BOTH, 5, steady(5000)));
+  trains.back().glitch = 300;
+  trains.back().filter = 1000;
+  trains.back().frequency = 10000;
+  trains.push_back(train("encoder, direction flips", EDGE_RISING, 10, steady(20000)));
+  trains.back().flip = 700000000;
+  trains.push_back(train("encoder at 2 MHz", EDGE_RISING, 2, steady(2e6)));
+  trains.back().flip = 700000000;
+  trains.push_back(train("1 kHz, reset on read", EDGE_RISING, 10, steady(1000)));
+  trains.back().resets = true;
+
+  printf("%-26s %7s %11s %11s %8s %12s %12s\n", "train", "edge", "expected", "total", "max/poll", "freq_hz",
+         "measured_hz");
+  for (Train &t : trains) {
+    run(t, rng);
+  }
+  claims();
+  return simExit();
+}
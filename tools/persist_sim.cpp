@@ -0,0 +1,171 @@
+// Host test for the write-behind pin state store, run against the real code
+// in gpio_core.h on the host build (host/): storeCommand() and
+// persistFlush() over the simulated Preferences, which counts NVS commits
+// and bytes written, on a manual clock.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target persist_sim
+//   ./build/persist_sim [-s seed]
+//
+// Each scenario stores commands the way the handlers do, and calls
+// persistFlush() every millisecond, as loop() does. Checks the number of
+// commits of each, that every change is committed within
+// PERSIST_MAX_DELAY_MS, and that what a restart would load is the last
+// state of every pin:
+//
+// - one change: one commit, persistDebounceMs after it
+// - a burst of changes less than persistDebounceMs apart: one commit
+// - changes that never pause: one commit every PERSIST_MAX_DELAY_MS
+// - changes that end where the last commit left off: no commit
+// - a change pending at shutdown: committed by persistShutdown()
+//
+// Exits non-zero on the first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+static std::mt19937 rng(1);
+static std::vector<int> gpios;
+static StoredPin expected[SOC_GPIO_PIN_COUNT]; // the last state stored
+
+static void store(int gpio, uint8_t op, uint16_t duty) {
+  GpioCommand cmd = {op, (uint8_t)gpio, duty, 0, PWM_DEFAULT_FREQ, PWM_DEFAULT_RESOLUTION, RAMP_LINEAR, 0};
+  storeCommand(cmd);
+  expected[gpio] = {cmd.op, cmd.resolution, cmd.duty, cmd.frequency};
+}
+
+static void randomStore() {
+  int gpio = gpios[rng() % gpios.size()];
+  uint8_t op = rng() % 3 == 0 ? OP_PWM : rng() & 1 ? OP_HIGH : OP_LOW;
+  store(gpio, op, op == OP_PWM ? rng() % 256 : 0);
+}
+
+struct Run {
+  uint32_t commits;
+  uint32_t worstWait;   // ms from a change to the commit that saved it
+};
+
+// Runs loop()'s flush for ms milliseconds, storing a change at each of the
+// given times (ms from now, ascending)
+static Run run(uint32_t ms, const std::vector<uint32_t> &changes) {
+  Run result = {0, 0};
+  uint32_t commits = simNvs.commits;
+  uint32_t oldest = 0;        // when the oldest uncommitted change was made
+  bool pending = false;
+  size_t next = 0;
+  for (uint32_t t = 0; t <= ms; t++) {
+    while (next < changes.size() && changes[next] == t) {
+      randomStore();
+      if (!pending) oldest = millis();
+      pending = true;
+      next++;
+    }
+    persistFlush(false);
+    if (simNvs.commits != commits) {
+      result.commits += simNvs.commits - commits;
+      commits = simNvs.commits;
+      result.worstWait = std::max(result.worstWait, (uint32_t)millis() - oldest);
+      pending = false;
+    }
+    simAdvanceUs(1000);
+  }
+  return result;
+}
+
+// What a restart would load matches the last state stored for every pin
+static void checkStored(const char* scenario) {
+  StateImage loaded;
+  if (preferences.getBytes(PERSIST_KEY, &loaded, sizeof(loaded)) != sizeof(loaded)) {
+    simFail(scenario, "stored image size", preferences.getBytesLength(PERSIST_KEY), sizeof(loaded));
+    return;
+  }
+  for (int gpio : gpios) {
+    const StoredPin &pin = loaded.pins[gpio];
+    if (pin.op != expected[gpio].op || pin.duty != expected[gpio].duty) {
+      simFail(scenario, "stored state", pin.op * 10000 + pin.duty, expected[gpio].op * 10000 + expected[gpio].duty);
+    }
+  }
+}
+
+static void report(const char* scenario, size_t changes, const Run &r) {
+  printf("%-28s %8zu %8u %10u\n", scenario, changes, r.commits, r.worstWait);
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-s" && i + 1 < argc) {
+      rng.seed(strtoul(argv[++i], NULL, 10));
+    } else {
+      fprintf(stderr, "usage: persist_sim [-s seed]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  simManualClock(1000000);
+  simNvsErase();
+  persistBegin();
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+    if (pinCanOutput(gpio)) gpios.push_back(gpio);
+  }
+  printf("%-28s %8s %8s %10s\n", "scenario", "changes", "commits", "worst ms");
+
+  // One change
+  Run one = run(2 * persistDebounceMs, {10});
+  report("one change", 1, one);
+  if (one.commits != 1) simFail("one change", "commits", one.commits, 1);
+  if (one.worstWait != persistDebounceMs) simFail("one change", "committed after ms", one.worstWait, persistDebounceMs);
+  checkStored("one change");
+
+  // A burst with gaps shorter than the debounce
+  std::vector<uint32_t> burst;
+  for (uint32_t t = 0; t < 3000; t += 1 + rng() % (persistDebounceMs / 2)) {
+    for (int i = rng() % 20; i >= 0; i--) burst.push_back(t);
+  }
+  Run b = run(3000 + 2 * persistDebounceMs, burst);
+  report("burst, short gaps", burst.size(), b);
+  if (b.commits != 1) simFail("burst", "commits", b.commits, 1);
+  checkStored("burst");
+
+  // Changes that never pause long enough: the cap commits anyway
+  std::vector<uint32_t> steady;
+  const uint32_t steadyMs = 30000;
+  for (uint32_t t = 0; t < steadyMs; t += 10) {
+    steady.push_back(t);
+  }
+  Run s = run(steadyMs + 2 * persistDebounceMs, steady);
+  report("steady, every 10 ms", steady.size(), s);
+  uint32_t capped = steadyMs / PERSIST_MAX_DELAY_MS + 1;
+  if (s.commits < capped - 1 || s.commits > capped) simFail("steady", "commits", s.commits, capped);
+  if (s.worstWait > PERSIST_MAX_DELAY_MS) simFail("steady", "longest wait ms", s.worstWait, PERSIST_MAX_DELAY_MS);
+  checkStored("steady");
+
+  // Back to what is committed: nothing to write
+  int gpio = gpios[0];
+  StoredPin committed = expected[gpio];
+  uint32_t commits = simNvs.commits;
+  store(gpio, committed.op == OP_HIGH ? OP_LOW : OP_HIGH, 0);
+  store(gpio, committed.op, committed.duty);
+  run(2 * persistDebounceMs, {});
+  report("change and change back", 2, {simNvs.commits - commits, 0});
+  if (simNvs.commits != commits) simFail("change back", "commits", simNvs.commits - commits, 0);
+
+  // Shutdown with a change pending
+  commits = simNvs.commits;
+  gpio = gpios[1];
+  store(gpio, expected[gpio].op == OP_HIGH ? OP_LOW : OP_HIGH, 0);
+  persistShutdown();
+  report("shutdown", 1, {simNvs.commits - commits, 0});
+  if (simNvs.commits - commits != 1) simFail("shutdown", "commits", simNvs.commits - commits, 1);
+  checkStored("shutdown");
+
+  size_t changes = 1 + burst.size() + steady.size() + 3;
+  printf("%zu changes, %u commits, %llu bytes written to NVS\n", changes, persistCommits,
+         (unsigned long long)simNvs.bytesWritten);
+  return simExit();
+}
@@ -0,0 +1,285 @@
+// Host test for precise pulses, run against the real code in gpio_core.h on
+// the host build (host/): preciseAdd(), preciseArm() and preciseRun(), on a
+// manual clock.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target precise_sim
+//   ./build/precise_sim [-l alarm to task latency us] [-j latency jitter us] [-s seed]
+//
+// The tool plays the precise task: it steps the clock a microsecond at a
+// time and calls preciseRun() as soon as the hardware timer alarm goes off,
+// which simTimerLatency delays by the given latency plus jitter, the time an
+// interrupt takes to wake the task. Every clock read costs 100 ns, so the
+// busy-wait gets somewhere. Checks:
+//
+// - ordering: overlapping pulses on several pins, some sharing deadlines.
+//   No edge is written before its deadline, edges are written in deadline
+//   order, edges that share a deadline go out in one GPIO_OUT write, each
+//   pin ends at the level of its last edge, and a reset is due exactly
+//   duration_us after its set edge. With a latency the lead has not caught
+//   up with, or a lot of jitter, a late wake writes several deadlines at once.
+// - compensation: one pulse at a time at several alarm latencies below the
+//   200 us the lead learns from. The first edges are late by the latency the
+//   lead does not cover yet; once it has adapted, edges land within a few
+//   microseconds of their deadline.
+// - skipping: an edge whose pin went to PWM after it was scheduled is not
+//   written and is counted in preciseSkipped.
+// - no timer: a timer number past the chip's last one gives NULL, and
+//   without a timer preciseAdd() refuses pulses and leaves the pin alone.
+//
+// Exits non-zero on the first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+static bool alarmed = false;
+static int64_t latencyUs = 40;
+static int jitterUs = 3;
+static std::mt19937 rng(1);
+static uint32_t logged = 0;               // preciseLog entries copied so far
+static std::vector<PreciseEdge> edges;    // every edge written, in order
+static uint32_t registerWrites = 0;
+
+static void fail(const char* what, uint32_t id, long got, long want) {
+  simFailf("%s: id %u got %ld, expected %ld", what, id, got, want);
+}
+
+static void onAlarm() {
+  alarmed = true;
+}
+
+static bool pending() {
+  for (int i = 0; i < PRECISE_CAPACITY; i++) {
+    if (preciseEntries[i].id != 0) return true;
+  }
+  return false;
+}
+
+// Runs the task each time the alarm goes off until nothing is pending.
+// Returns the edges each wake wrote, one list per wake.
+static std::vector<std::vector<PreciseEdge>> runUntilIdle() {
+  std::vector<std::vector<PreciseEdge>> wakes;
+  for (int64_t steps = 0; pending() && steps < 10000000; steps++) {
+    simAdvanceUs(1);
+    if (!alarmed) {
+      continue;
+    }
+    alarmed = false;
+    uint32_t writes = simGpio.outWrites[0] + simGpio.outWrites[1];
+    preciseRun();
+    registerWrites += simGpio.outWrites[0] + simGpio.outWrites[1] - writes;
+    std::vector<PreciseEdge> wake;
+    for (; logged != preciseFired; logged++) {
+      wake.push_back(preciseLog[logged % PRECISE_LOG]);
+      edges.push_back(wake.back());
+    }
+    wakes.push_back(wake);
+  }
+  if (pending()) {
+    fail("still pending", 0, 1, 0);
+  }
+  return wakes;
+}
+
+// The clock stands still while scheduling, so equal delays give equal
+// deadlines
+static uint32_t schedule(int gpio, bool high, uint32_t delayUs, uint32_t durationUs) {
+  GpioCommand cmd = {};
+  cmd.op = high ? OP_HIGH : OP_LOW;
+  cmd.gpio = gpio;
+  uint32_t cost = simReadCostNs;
+  simReadCostNs = 0;
+  uint32_t id = preciseAdd(cmd, delayUs, durationUs);
+  simReadCostNs = cost;
+  if (id == 0) fail("not scheduled", 0, gpio, 0);
+  return id;
+}
+
+static bool edgeLevel(const PreciseEdge &edge) {
+  return (edge.op == OP_HIGH) == (edge.phase == PHASE_SET);
+}
+
+static void ordering(const std::vector<int> &gpios) {
+  struct Pulse {
+    uint32_t id;
+    uint32_t duration;
+  };
+  std::vector<Pulse> pulses;
+  for (int i = 0; i < PRECISE_CAPACITY - 4; i++) {
+    int gpio = gpios[rng() % gpios.size()];
+    // Every fourth pulse shares its deadline with the one before
+    uint32_t delayUs = i % 4 == 3 ? 1000 + (i - 1) * 397 % 20000 : 1000 + i * 397 % 20000;
+    uint32_t duration = rng() % 4 ? 100 + rng() % 3000 : 0;
+    uint32_t id = schedule(gpio, rng() & 1, delayUs, duration);
+    pulses.push_back({id, duration});
+  }
+  uint32_t writesBefore = registerWrites;
+  size_t first = edges.size();
+  std::vector<std::vector<PreciseEdge>> wakes = runUntilIdle();
+
+  // Edges written together share their write time, deadline plus lateness.
+  // All pins are in one bank here, so each such group is one register write.
+  int64_t lastDeadline = 0;
+  int64_t lastWritten = 0;
+  uint32_t groups = 0;
+  for (size_t i = first; i < edges.size(); i++) {
+    const PreciseEdge &edge = edges[i];
+    int64_t written = edge.deadline + edge.lateness;
+    if (edge.lateness < 0) fail("written before its deadline", edge.id, edge.lateness, 0);
+    if (edge.deadline < lastDeadline) fail("out of deadline order", edge.id, edge.deadline, lastDeadline);
+    if (i > first && edge.deadline == lastDeadline && written != lastWritten) {
+      fail("same deadline, separate writes", edge.id, written, lastWritten);
+    }
+    groups += i == first || written != lastWritten;
+    lastDeadline = edge.deadline;
+    lastWritten = written;
+  }
+  if (registerWrites - writesBefore != groups) {
+    fail("register writes", 0, registerWrites - writesBefore, groups);
+  }
+  // Each pin ends at the level of its last edge
+  std::vector<int> finalLevel(SOC_GPIO_PIN_COUNT, -1);
+  for (size_t i = first; i < edges.size(); i++) {
+    finalLevel[edges[i].gpio] = edgeLevel(edges[i]);
+  }
+  for (int gpio : gpios) {
+    if (finalLevel[gpio] >= 0 && simPinLevel(gpio) != (bool)finalLevel[gpio]) {
+      fail("pin level after its last edge", gpio, simPinLevel(gpio), finalLevel[gpio]);
+    }
+  }
+  // Resets are due duration after the deadline of their set edge, however
+  // late the set edge ran
+  for (const Pulse &pulse : pulses) {
+    const PreciseEdge* set = nullptr;
+    const PreciseEdge* reset = nullptr;
+    for (size_t i = first; i < edges.size(); i++) {
+      if (edges[i].id != pulse.id) continue;
+      (edges[i].phase == PHASE_SET ? set : reset) = &edges[i];
+    }
+    if (set == nullptr) {
+      fail("set edge missing", pulse.id, 0, 1);
+    } else if ((pulse.duration > 0) != (reset != nullptr)) {
+      fail("reset edge", pulse.id, reset != nullptr, pulse.duration > 0);
+    } else if (reset && reset->deadline - set->deadline != pulse.duration) {
+      fail("reset deadline", pulse.id, (long)(reset->deadline - set->deadline), pulse.duration);
+    }
+  }
+  printf("ordering: %zu pulses, %zu edges in %zu wakes, %u register writes\n", pulses.size(), edges.size() - first,
+         wakes.size(), registerWrites - writesBefore);
+}
+
+static void compensation(int gpio) {
+  const int pulses = 60;
+  const int settled = 20; // the last this many are checked
+  printf("%10s %8s %10s %14s %14s\n", "latency us", "lead us", "first late", "settled max", "settled mean");
+  for (int64_t latency : {latencyUs / 4, latencyUs, latencyUs * 2}) {
+    if (latency + jitterUs >= PRECISE_SPIN_US * 4) {
+      continue; // taken as a stall, not learnt
+    }
+    int64_t saved = latencyUs;
+    latencyUs = latency;
+    preciseLead = PRECISE_LEAD_INIT_US * 8;
+    std::vector<int32_t> lateness;
+    for (int i = 0; i < pulses; i++) {
+      size_t first = edges.size();
+      schedule(gpio, i & 1, 1000, 0);
+      runUntilIdle();
+      for (size_t e = first; e < edges.size(); e++) {
+        lateness.push_back(edges[e].lateness);
+      }
+    }
+    latencyUs = saved;
+    int32_t worst = *std::max_element(lateness.end() - settled, lateness.end());
+    double mean = 0;
+    for (auto it = lateness.end() - settled; it != lateness.end(); ++it) {
+      mean += *it;
+      if (*it < 0) fail("edge before its deadline", 0, *it, 0);
+    }
+    mean /= settled;
+    printf("%10lld %8d %10d %14d %14.1f\n", (long long)latency, preciseLead / 8, lateness.front(), worst, mean);
+    // The 1 us clock steps and jitter beyond the margin are all that is left
+    if (worst > 2 + std::max(0, jitterUs - PRECISE_MARGIN_US)) {
+      fail("settled lateness", 0, worst, 2);
+    }
+    if (latency > PRECISE_LEAD_INIT_US + PRECISE_MARGIN_US + jitterUs &&
+        lateness.front() < latency - PRECISE_LEAD_INIT_US - PRECISE_MARGIN_US - 1) {
+      fail("first edge not late by the uncovered latency", 0, lateness.front(),
+           (long)(latency - PRECISE_LEAD_INIT_US - PRECISE_MARGIN_US));
+    }
+  }
+}
+
+static void skipping(int gpio) {
+  uint32_t skipped = preciseSkipped;
+  size_t first = edges.size();
+  schedule(gpio, true, 2000, 500);
+  GpioCommand pwm = {};
+  pwm.op = OP_PWM;
+  pwm.gpio = gpio;
+  pwm.duty = 100;
+  pwm.frequency = PWM_DEFAULT_FREQ;
+  pwm.resolution = PWM_DEFAULT_RESOLUTION;
+  executeCommand(pwm); // inline: no actuation task
+  runUntilIdle();
+  if (preciseSkipped - skipped != 2) fail("skipped edges", 0, preciseSkipped - skipped, 2);
+  if (edges.size() != first) fail("edges written to a PWM pin", 0, edges.size() - first, 0);
+  if (pinChannel[gpio] == LEDC_NONE) fail("PWM pin lost its channel", gpio, 0, 1);
+  printf("skipping: %u edges on a pin that went to PWM skipped\n", preciseSkipped - skipped);
+}
+
+// Before the timer is set up, as when preciseBegin() found none
+static void noTimer(int gpio) {
+  if (timerBegin(SOC_TIMER_GROUP_TOTAL_TIMERS, 80, true) != NULL) fail("timer past the last one", 0, 1, 0);
+  GpioCommand cmd = {};
+  cmd.op = OP_HIGH;
+  cmd.gpio = gpio;
+  uint32_t id = preciseAdd(cmd, 100, 100);
+  if (id != 0) fail("scheduled without a timer", id, 1, 0);
+  if (outputPins[gpio >> 5] & (1UL << (gpio & 31))) fail("pin made an output without a timer", 0, 1, 0);
+  printf("no timer: precise pulses refused\n");
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-l" && hasValue) {
+      latencyUs = std::max(0, atoi(argv[++i]));
+    } else if (arg == "-j" && hasValue) {
+      jitterUs = std::max(0, atoi(argv[++i]));
+    } else if (arg == "-s" && hasValue) {
+      rng.seed(strtoul(argv[++i], NULL, 10));
+    } else {
+      fprintf(stderr, "usage: precise_sim [-l alarm to task latency us] [-j latency jitter us] [-s seed]\n");
+      return 2;
+    }
+  }
+
+  simManualClock(1000000);
+  simReadCostNs = 100;
+  simTimerLatency = [](const char* timer) -> int64_t {
+    return strcmp(timer, "hw_timer") == 0 ? latencyUs + (jitterUs ? rng() % (jitterUs + 1) : 0) : 0;
+  };
+  ledcPoolBegin();
+  std::vector<int> gpios;
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT && gpios.size() < 6; gpio++) {
+    if (pinCanOutput(gpio) && gpio < 32) gpios.push_back(gpio);
+  }
+  noTimer(gpios[0]);
+
+  // What preciseBegin() sets up, minus the task: this thread plays it
+  preciseArmLock = xSemaphoreCreateMutex();
+  preciseTimer = timerBegin(PRECISE_TIMER, 80, true);
+  timerAttachInterrupt(preciseTimer, onAlarm, false);
+
+  ordering(gpios);
+  compensation(gpios[0]);
+  skipping(gpios[1]);
+
+  return simExit();
+}
@@ -0,0 +1,194 @@
+// Host simulation of the PWM fades, run against the real code in
+// gpio_core.h on the host build (host/): rampStart(), rampStep() and
+// rampValue() driving the simulated LEDC, on a manual clock.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target ramp_sim
+//   ./build/ramp_sim [-p fading pins] [-j tick jitter ms] [--csv gpio]
+//
+// Fades every shape up and down at 8 and 12 bits on several pins at once,
+// stepping the clock by RAMP_TICK_MS plus random jitter. Each pin is first
+// written at the from duty, so the fade also picks its start up from the
+// pin. Checks that each trajectory starts at its from duty, never moves away
+// from its target, never overshoots and ends exactly on the target once its
+// length has passed, and that an S-curve is symmetric about its midpoint.
+// Then times the step with all pins fading. Exits non-zero on the first
+// violation. --csv prints the trajectory of one pin as ms,duty lines instead.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Case {
+  uint8_t shape;
+  uint16_t from;
+  uint16_t to;
+  uint32_t length;
+};
+
+static void fail(int pin, const Case &c, const char* what, uint32_t at, int duty) {
+  simFailf("gpio %d %s %u->%u over %u ms: %s at %u ms (duty %d)", pin, rampShapeNames[c.shape], c.from, c.to,
+           c.length, what, at, duty);
+}
+
+// What the pin's LEDC channel is set to
+static int channelDuty(int gpio) {
+  return pinChannel[gpio] == LEDC_NONE ? -1 : (int)simLedc.channel[pinChannel[gpio]].duty;
+}
+
+static bool fading(int gpio) {
+  return rampPins[gpio >> 5] & (1UL << (gpio & 31));
+}
+
+static void start(int gpio, const Case &c, uint8_t resolution) {
+  GpioCommand cmd = {};
+  cmd.op = OP_PWM;
+  cmd.gpio = gpio;
+  cmd.duty = c.from;
+  cmd.frequency = 1000;
+  cmd.resolution = resolution;
+  executeCommand(cmd); // runs inline: no actuation task
+  cmd.duty = c.to;
+  cmd.shape = c.shape;
+  cmd.ramp = c.length;
+  if (executeCommand(cmd) != ACTUATED) {
+    fail(gpio, c, "no channel", 0, 0);
+  }
+}
+
+int main(int argc, char **argv) {
+  int pins = MAX_RAMPS;
+  int jitter = 3;
+  int csvPin = -1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-p" && hasValue) {
+      pins = std::min(MAX_RAMPS, std::max(1, atoi(argv[++i])));
+    } else if (arg == "-j" && hasValue) {
+      jitter = std::max(0, atoi(argv[++i]));
+    } else if (arg == "--csv" && hasValue) {
+      csvPin = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: ramp_sim [-p fading pins] [-j tick jitter ms] [--csv gpio]\n");
+      return 2;
+    }
+  }
+
+  simManualClock(1000000);
+  ledcPoolBegin();
+  rampsBegin();
+
+  std::vector<Case> cases;
+  for (uint8_t shape = 0; shape < RAMP_SHAPES; shape++) {
+    cases.push_back({shape, 0, 255, 1000});
+    cases.push_back({shape, 255, 0, 1000});
+    cases.push_back({shape, 10, 4000, 2500});
+    cases.push_back({shape, 4095, 100, 333});
+    cases.push_back({shape, 128, 128, 200});
+    cases.push_back({shape, 0, 1, 50});
+  }
+
+  std::vector<int> gpios;
+  for (int gpio = 0; (int)gpios.size() < pins; gpio++) {
+    if (pinCanOutput(gpio)) gpios.push_back(gpio);
+  }
+  std::mt19937 rng(1);
+  std::vector<Case> running(pins);
+  for (int i = 0; i < pins; i++) {
+    running[i] = cases[i % cases.size()];
+    start(gpios[i], running[i], std::max(running[i].from, running[i].to) > 255 ? 12 : 8);
+  }
+
+  // Ramps started before a tick take their start from it, so they all
+  // start on the same step
+  std::vector<int> last(pins);
+  for (int i = 0; i < pins; i++) {
+    last[i] = running[i].from;
+  }
+  uint32_t begin = millis();
+  bool any = true;
+  while (any) {
+    rampStep();
+    any = false;
+    for (int i = 0; i < pins; i++) {
+      const Case &c = running[i];
+      int gpio = gpios[i];
+      uint32_t at = millis() - begin;
+      int duty = channelDuty(gpio);
+      bool rising = c.to >= c.from;
+      if (at == 0 && duty != c.from) fail(gpio, c, "does not start at from", at, duty);
+      if (rising ? duty < last[i] : duty > last[i]) fail(gpio, c, "moves away from target", at, duty);
+      if (rising ? duty > c.to : duty < c.to) fail(gpio, c, "overshoots", at, duty);
+      if (at >= c.length && duty != c.to) fail(gpio, c, "misses target", at, duty);
+      if (at >= c.length && fading(gpio)) fail(gpio, c, "still running", at, duty);
+      if (gpio == csvPin) printf("%u,%d\n", at, duty);
+      last[i] = duty;
+      any = any || fading(gpio);
+    }
+    simAdvanceUs((RAMP_TICK_MS + (jitter ? rng() % (jitter + 1) : 0)) * 1000);
+  }
+
+  // An S-curve passes the midpoint duty at half its length, and the duty at
+  // t and length - t add up to from + to
+  for (int length : {200, 1000, 4000}) {
+    Ramp ramp = {0, RAMP_SCURVE, true, 0, 4095, 0, (uint32_t)length, 0};
+    for (int t = 0; t <= length; t++) {
+      int sum = rampValue(ramp, t) + rampValue(ramp, length - t);
+      if (std::abs(sum - 4095) > 1) {
+        Case c = {RAMP_SCURVE, 0, 4095, (uint32_t)length};
+        fail(0, c, "not symmetric", t, sum);
+        break;
+      }
+    }
+  }
+  // Exponential keeps the ratio between steps constant
+  {
+    Ramp ramp = {0, RAMP_EXP, true, 0, 1023, 0, 1000, logf(1024.0f)};
+    double first = (rampValue(ramp, 100) + 1.0) / (rampValue(ramp, 0) + 1.0);
+    double later = (rampValue(ramp, 900) + 1.0) / (rampValue(ramp, 800) + 1.0);
+    if (std::fabs(first - later) / first > 0.1) {
+      Case c = {RAMP_EXP, 0, 1023, 1000};
+      fail(0, c, "ratio not constant", 900, rampValue(ramp, 900));
+    }
+  }
+  if (csvPin >= 0) {
+    return simExit();
+  }
+
+  // CPU time of one step with every pin mid-fade, over the longest fades
+  const int rounds = 15;
+  const int steps = RAMP_MAX_MS / RAMP_TICK_MS - 1;
+  double ns = 0;
+  uint32_t writes = simLedc.writes;
+  for (int round = 0; round < rounds; round++) {
+    for (int i = 0; i < pins; i++) {
+      // A digital write hands the channel back, so the pool can regroup
+      // every pin on timers at the new resolution
+      GpioCommand low = {};
+      low.op = OP_LOW;
+      low.gpio = gpios[i];
+      executeCommand(low);
+    }
+    for (int i = 0; i < pins; i++) {
+      Case c = {(uint8_t)(i % RAMP_SHAPES), 0, 65535, RAMP_MAX_MS};
+      start(gpios[i], c, PWM_MAX_RESOLUTION);
+    }
+    for (int i = 0; i < steps; i++) {
+      simAdvanceUs(RAMP_TICK_MS * 1000);
+      auto t0 = std::chrono::steady_clock::now();
+      rampStep();
+      ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    }
+  }
+  ns /= (double)rounds * steps;
+
+  printf("%zu trajectories on %d pins\n", cases.size(), pins);
+  printf("step with %d pins fading: %.0f ns on this host, %u duty writes\n", pins, ns, simLedc.writes - writes);
+  return simExit();
+}
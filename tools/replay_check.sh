@@ -0,0 +1,67 @@
+#!/bin/sh
+# Host test for tools/trace_replay.cpp against the dashboard sketch: starts
+# gpio_host on a free port, replays a trace against it and checks the CSV
+# and JSON summaries. CMake runs it as the trace_replay test.
+#
+# Build and run (Linux/macOS):
+#   cmake -S . -B build && cmake --build build --target gpio_host trace_replay
+#   sh tools/replay_check.sh build/gpio_host build/trace_replay tools/example.trace
+#
+# Checks:
+#
+# - gpio_host prints the port it took, and trace_replay exits 0 against it
+# - the CSV has its header, the "*" total and one row per method and path
+#   of the trace, each with the trace's request count and no HTTP or I/O
+#   errors
+# - the JSON has the same endpoints with the same counts
+#
+# Exits non-zero on the first violation.
+
+if [ $# -ne 3 ]; then
+  echo "usage: replay_check.sh <gpio_host> <trace_replay> <trace>" >&2
+  exit 2
+fi
+host=$1
+replay=$2
+trace=$3
+dir=$(mktemp -d)
+pid=
+trap 'if [ -n "$pid" ]; then kill $pid 2>/dev/null; fi; rm -rf "$dir"' EXIT
+
+fail() {
+  echo "$1" >&2
+  echo "1 violations"
+  exit 1
+}
+
+"$host" -p 0 -u 0 >"$dir/host.out" 2>&1 &
+pid=$!
+port=
+tries=0
+while [ -z "$port" ] && [ $tries -lt 100 ]; do
+  sleep 0.1
+  port=$(sed -n 's|^gpio_host: http://localhost:\([0-9]*\)/.*|\1|p' "$dir/host.out")
+  tries=$((tries + 1))
+done
+[ -n "$port" ] || fail "gpio_host did not report a port"
+
+"$replay" -p "$port" -c 2 -s 0 --csv "$dir/run.csv" --json "$dir/run.json" 127.0.0.1 "$trace" ||
+  fail "trace_replay exited $?"
+
+# "METHOD /path" and its request count, for every request line of the trace
+awk '!/^[ \t]*(#|$)/ { sub(/\?.*/, "", $3); n[$2 " " $3]++; total++ }
+     END { print "*\t" total; for (e in n) print e "\t" n[e] }' "$trace" >"$dir/expected"
+
+head -n 1 "$dir/run.csv" | grep -q '^endpoint,requests,http_errors,io_errors,' || fail "CSV header"
+rows=$(($(wc -l <"$dir/run.csv") - 1))
+endpoints=$(wc -l <"$dir/expected")
+[ $rows -eq $endpoints ] || fail "CSV rows: got $rows, expected $endpoints"
+while IFS="$(printf '\t')" read -r endpoint requests; do
+  grep -qF "\"$endpoint\",$requests,0,0," "$dir/run.csv" ||
+    fail "CSV row for $endpoint: expected $requests requests and no errors"
+  grep -qF "{\"endpoint\":\"$endpoint\",\"requests\":$requests,\"http_errors\":0,\"io_errors\":0," "$dir/run.json" ||
+    fail "JSON entry for $endpoint: expected $requests requests and no errors"
+done <"$dir/expected"
+
+echo "$rows summary rows checked"
+echo "0 violations"
@@ -0,0 +1,134 @@
+// Microbenchmark of the JSON reply helpers of html_GPIO_control_dashboard.cpp
+// on the host build: sendJson() and sendJsonf() called on a request the way
+// the handlers call them, with heap allocations counted by host/alloc.cpp.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target reply_bench
+//   ./build/reply_bench [-n replies per case]
+//
+// For each reply, a fixed error body from flash and formatted ones of the
+// sizes /readgpio and /setgpio send, reports replies per second and
+// allocations per reply for:
+//
+// - the helper
+// - the web server alone: send_P() or send() of the finished body, which
+//   is what any reply costs
+// - what the handlers did before: a 1 KB JSON document pool and a String
+//   the document was serialized into. The host String keeps short strings
+//   inline, where the Arduino core's allocates for each one, so the
+//   allocations of that baseline are a lower bound.
+//
+// Checks that each helper sends the expected body and allocates nothing
+// beyond what the web server does for the same reply. Exits non-zero
+// otherwise. The whole request path is in gpio_bench.
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "sim.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+void sendJson(AsyncWebServerRequest *request, int code, PGM_P body);
+void sendJsonf(AsyncWebServerRequest *request, int code, const char* format, ...);
+
+struct Result {
+  double perSecond;
+  double allocations; // per reply
+  std::string body;   // of the last reply
+};
+
+// Runs reply() on a fresh request n times; only the reply is counted
+template <typename Reply>
+static Result run(int n, Reply reply) {
+  Result result = {0, 0, ""};
+  uint64_t allocations = 0;
+  double ns = 0;
+  for (int i = 0; i < n; i++) {
+    AsyncWebServerRequest* request = new AsyncWebServerRequest(HTTP_GET, "/");
+    uint64_t before = simAllocations();
+    auto t0 = std::chrono::steady_clock::now();
+    reply(request);
+    ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    allocations += simAllocations() - before;
+    if (i == n - 1 && request->response_ != nullptr) {
+      uint8_t buffer[256];
+      size_t len = request->response_->produce(buffer, sizeof(buffer));
+      result.body.assign((const char*)buffer, len);
+    }
+    delete request;
+  }
+  result.perSecond = n / (ns / 1e9);
+  result.allocations = (double)allocations / n;
+  return result;
+}
+
+// What a handler did before: a document pool on the heap, serialized into
+// a String
+static void legacyReply(AsyncWebServerRequest* request, int code, const char* body) {
+  std::unique_ptr<char[]> document(new char[1024]);
+  memcpy(document.get(), body, strlen(body) + 1);
+  String response;
+  response += document.get();
+  request->send(code, "application/json", response);
+}
+
+int main(int argc, char** argv) {
+  int replies = 200000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-n" && i + 1 < argc) {
+      replies = std::max(1, atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: reply_bench [-n replies per case]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  static const char invalidPin[] PROGMEM = "{\"error\":\"Invalid GPIO pin\",\"status\":\"failure\"}";
+  const char* readgpio = "{\"gpio\":4,\"state\":\"HIGH\"}";
+  const char* setgpio =
+      "{\"gpio\":18,\"state\":\"PWM\",\"pwm_value\":200,\"frequency\":5000,\"resolution\":8,\"ramp\":0,\"status\":\"success\"}";
+
+  printf("%-22s %12s %10s %12s %10s %12s %10s\n", "reply", "helper/s", "allocs", "server/s", "allocs", "legacy/s",
+         "allocs");
+  struct Case {
+    const char* name;
+    const char* body;
+    Result helper;
+    Result server;
+  };
+  Case cases[] = {
+    {"sendJson error", invalidPin,
+     run(replies, [&](AsyncWebServerRequest* r) { sendJson(r, 400, invalidPin); }),
+     run(replies, [&](AsyncWebServerRequest* r) { r->send_P(400, "application/json", invalidPin); })},
+    {"sendJsonf /readgpio", readgpio,
+     run(replies, [](AsyncWebServerRequest* r) { sendJsonf(r, 200, "{\"gpio\":%d,\"state\":\"%s\"}", 4, "HIGH"); }),
+     run(replies, [&](AsyncWebServerRequest* r) { r->send(200, "application/json", readgpio); })},
+    {"sendJsonf /setgpio pwm", setgpio,
+     run(replies,
+         [](AsyncWebServerRequest* r) {
+           sendJsonf(r, 200,
+                     "{\"gpio\":%d,\"state\":\"PWM\",\"pwm_value\":%u,\"frequency\":%u,\"resolution\":%u,"
+                     "\"ramp\":%u,\"status\":\"success\"}",
+                     18, 200u, 5000u, 8u, 0u);
+         }),
+     run(replies, [&](AsyncWebServerRequest* r) { r->send(200, "application/json", setgpio); })},
+  };
+  for (Case &c : cases) {
+    Result legacy = run(replies, [&](AsyncWebServerRequest* r) { legacyReply(r, 200, c.body); });
+    printf("%-22s %12.0f %10.2f %12.0f %10.2f %12.0f %10.2f\n", c.name, c.helper.perSecond, c.helper.allocations,
+           c.server.perSecond, c.server.allocations, legacy.perSecond, legacy.allocations);
+    if (c.helper.body != c.body) {
+      simFailf("%s: sent %s", c.name, c.helper.body.c_str());
+    }
+    if (c.helper.allocations > c.server.allocations) {
+      simFailf("%s: %.2f allocations per reply, the web server alone makes %.2f", c.name, c.helper.allocations,
+               c.server.allocations);
+    }
+  }
+  return simExit();
+}
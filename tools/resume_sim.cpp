@@ -0,0 +1,147 @@
+// Host test for the boot resume, run against the real code in gpio_core.h on
+// the host build (host/): persistBegin() and resumeStates() over the
+// simulated Preferences, GPIO_OUT registers and LEDC.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target resume_sim
+//   ./build/resume_sim [-r restarts] [-s seed]
+//
+// Stores random states for every output pin, digital and PWM on both banks,
+// plus one for a flash pin as an image from before pins were checked would
+// have, and commits them. Then "restarts": the hardware models and the
+// sketch's pin state go back to reset, NVS keeps what was committed, and
+// setup()'s first steps run. Checks that:
+//
+// - loading the image is a single NVS lookup
+// - the digital pins come first, with one GPIO_OUT write per bank that has
+//   any, and before any LEDC duty is written
+// - every stored pin ends at its stored level or duty, and the flash pin
+//   is not touched
+//
+// Reports how long the resume takes on this host. Exits non-zero on the
+// first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+struct OutWrite {
+  int bank;
+  uint32_t ledcWrites;  // LEDC duty writes before this register write
+};
+
+static std::mt19937 rng(1);
+static std::vector<int> gpios;
+static std::vector<OutWrite> outWrites;
+
+static void fail(int restart, const char* what, long got, long want) {
+  simFailf("restart %d: %s: got %ld, expected %ld", restart, what, got, want);
+}
+
+// Power cycle: registers, LEDC and the sketch's RAM state back to reset
+static void restart() {
+  preferences.end();
+  simResetHardware();
+  memset(outputPins, 0, sizeof(outputPins));
+  memset(pwmPins, 0, sizeof(pwmPins));
+  memset(rampPins, 0, sizeof(rampPins));
+  memset(&stateImage, 0, sizeof(stateImage));
+  dirtyPins = 0;
+}
+
+int main(int argc, char **argv) {
+  int restarts = 200;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-r" && hasValue) {
+      restarts = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-s" && hasValue) {
+      rng.seed(strtoul(argv[++i], NULL, 10));
+    } else {
+      fprintf(stderr, "usage: resume_sim [-r restarts] [-s seed]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+    if (pinCanOutput(gpio)) gpios.push_back(gpio);
+  }
+  int flashPin = 6;
+  simOnOutWrite = [](int bank, uint32_t) { outWrites.push_back({bank, simLedc.writes}); };
+
+  double worstUs = 0;
+  double totalUs = 0;
+  for (int r = 0; r < restarts; r++) {
+    // Before the restart: states for every pin, at most LEDC_CHANNELS PWM
+    simNvsErase();
+    ledcPoolBegin();
+    persistBegin();
+    std::vector<StoredPin> want(SOC_GPIO_PIN_COUNT, StoredPin{OP_NONE, 0, 0, 0});
+    int pwm = 0;
+    int stored = 0;
+    for (int gpio : gpios) {
+      int kind = rng() % 4;
+      GpioCommand cmd = {OP_LOW, (uint8_t)gpio, 0, 0, PWM_DEFAULT_FREQ, PWM_DEFAULT_RESOLUTION, RAMP_LINEAR, 0};
+      if (kind == 0) {
+        continue; // nothing stored
+      } else if (kind == 1 && pwm < LEDC_CHANNELS) {
+        cmd.op = OP_PWM;
+        cmd.duty = rng() % 256;
+        pwm++;
+      } else {
+        cmd.op = rng() & 1 ? OP_HIGH : OP_LOW;
+      }
+      storeCommand(cmd);
+      want[gpio] = {cmd.op, cmd.resolution, cmd.duty, cmd.frequency};
+      stored++;
+    }
+    markPin(flashPin, StoredPin{OP_HIGH, 0, 0, 0});
+    persistFlush(true);
+
+    restart();
+    uint32_t reads = simNvs.reads;
+    outWrites.clear();
+    auto t0 = std::chrono::steady_clock::now();
+    ledcPoolBegin();
+    persistBegin();
+    int restored = resumeStates();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    worstUs = std::max(worstUs, us);
+    totalUs += us;
+
+    if (simNvs.reads - reads != 1) fail(r, "NVS lookups", simNvs.reads - reads, 1);
+    if (restored != stored) fail(r, "pins restored", restored, stored);
+    uint32_t banks = 0;
+    for (int gpio : gpios) {
+      if (want[gpio].op == OP_HIGH || want[gpio].op == OP_LOW) banks |= 1UL << (gpio >> 5);
+    }
+    if (outWrites.size() != (size_t)__builtin_popcount(banks)) {
+      fail(r, "GPIO_OUT writes", outWrites.size(), __builtin_popcount(banks));
+    }
+    for (size_t i = 0; i < outWrites.size(); i++) {
+      if (outWrites[i].ledcWrites != 0) fail(r, "LEDC duties written before GPIO_OUT", outWrites[i].ledcWrites, 0);
+      if (i > 0 && outWrites[i].bank == outWrites[i - 1].bank) fail(r, "bank written twice", outWrites[i].bank, -1);
+    }
+    if (simLedc.writes != (uint32_t)pwm) fail(r, "LEDC duty writes", simLedc.writes, pwm);
+    for (int gpio : gpios) {
+      const StoredPin &pin = want[gpio];
+      if (pin.op == OP_HIGH || pin.op == OP_LOW) {
+        if (simPinLevel(gpio) != (pin.op == OP_HIGH)) fail(r, "restored level", simPinLevel(gpio), pin.op == OP_HIGH);
+      } else if (pin.op == OP_PWM) {
+        int duty = pinChannel[gpio] == LEDC_NONE ? -1 : (int)simLedc.channel[pinChannel[gpio]].duty;
+        if (duty != pin.duty) fail(r, "restored duty", duty, pin.duty);
+      }
+    }
+    if (simGpio.mode[flashPin] != 0) fail(r, "flash pin touched", simGpio.mode[flashPin], 0);
+  }
+
+  printf("%d restarts: 1 NVS lookup each, resume %.1f us mean, %.1f us worst on this host\n", restarts,
+         totalUs / restarts, worstUs);
+  return simExit();
+}
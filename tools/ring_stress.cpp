@@ -0,0 +1,157 @@
+// Stress test for the actuation ring, run against the real code in
+// gpio_core.h on the host build (host/): actuationTryPush(),
+// actuationPush(), actuationCall() and the actuation task's
+// actuationLoop(), with the GPIO_OUT register simulated.
+//
+// Build and run (Linux/macOS), ideally under ThreadSanitizer:
+//   cmake -S . -B build -DSANITIZE=thread && cmake --build build --target ring_stress
+//   ./build/ring_stress [-p producers] [-n pushes per producer] [-w every Nth push waits]
+//
+// Each producer owns two output pins and steps them through a 2-bit Gray
+// code, so every actuation changes exactly one of its pins: alternately as
+// a queued digital command, as a masked write of both pins, and every Nth
+// one as a command it waits on. Producers also queue fade steps, which run
+// the ACT_RAMP branch with no fade active. A hook on the simulated register
+// checks that each pin pair only ever moves to the next code, and at the
+// end that it moved once per accepted push; the tool exits non-zero on the
+// first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int MAX_PRODUCERS = 12;
+int pinA[MAX_PRODUCERS];
+int pinB[MAX_PRODUCERS];
+uint32_t seen[MAX_PRODUCERS];   // codes observed, actuation task only
+uint32_t observed[MAX_PRODUCERS]; // the pair's last level, bit 0 pin A
+int producers = 4;
+
+// 0, 1, 3, 2, 0, ...
+uint32_t grayCode(uint32_t n) {
+  n &= 3;
+  return n ^ (n >> 1);
+}
+
+void violation(const char* what, int producer, uint32_t got, uint32_t want) {
+  simFailf("%s: producer %d got %u, expected %u", what, producer, got, want);
+}
+
+void observe(int bank, uint32_t out) {
+  for (int p = 0; p < producers; p++) {
+    uint32_t level = 0;
+    if (pinA[p] >> 5 == bank) level |= (out >> (pinA[p] & 31)) & 1;
+    else level |= observed[p] & 1;
+    if (pinB[p] >> 5 == bank) level |= ((out >> (pinB[p] & 31)) & 1) << 1;
+    else level |= observed[p] & 2;
+    if (level == observed[p]) {
+      continue;
+    }
+    if (level != grayCode(seen[p] + 1)) {
+      violation("out of order", p, level, grayCode(seen[p] + 1));
+    }
+    observed[p] = level;
+    seen[p]++;
+  }
+}
+
+int main(int argc, char **argv) {
+  uint32_t pushes = 200000;
+  uint32_t waitEvery = 16;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-p" && i + 1 < argc) {
+      producers = atoi(argv[++i]);
+    } else if (arg == "-n" && i + 1 < argc) {
+      pushes = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "-w" && i + 1 < argc) {
+      waitEvery = strtoul(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "usage: ring_stress [-p producers] [-n pushes per producer] [-w every Nth push waits]\n");
+      return 2;
+    }
+  }
+  std::vector<int> outputs;
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+    if (pinCanOutput(gpio)) outputs.push_back(gpio);
+  }
+  int most = std::min(MAX_PRODUCERS, (int)outputs.size() / 2);
+  if (producers < 1 || producers > most) {
+    fprintf(stderr, "producers must be 1-%d, two output pins each\n", most);
+    return 2;
+  }
+  for (int p = 0; p < producers; p++) {
+    pinA[p] = outputs[2 * p];
+    pinB[p] = outputs[2 * p + 1];
+  }
+  simSerialQuiet = true;
+  simOnOutWrite = observe;
+  actuationBegin();
+
+  std::vector<uint32_t> sent(producers);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&, p] {
+      for (uint32_t n = 0; n < pushes; n++) {
+        uint32_t target = grayCode(sent[p] + 1);
+        uint32_t changed = target ^ grayCode(sent[p]);
+        GpioCommand cmd = {};
+        cmd.gpio = changed == 1 ? pinA[p] : pinB[p];
+        cmd.op = target & changed ? OP_HIGH : OP_LOW;
+        bool ok;
+        if (waitEvery && n % waitEvery == 0) {
+          Actuation actuation = {ACT_COMMAND, cmd, {}, NULL, NULL, 0};
+          ok = actuationCall(actuation); // the pins have moved once this returns true
+          if (ok && (observed[p] != target)) {
+            violation("returned before done", p, observed[p], target);
+          }
+        } else if (n % 2) {
+          ok = executeCommand(cmd) == ACTUATED;
+        } else {
+          GpioMaskWrite write = {};
+          maskAdd(write, pinA[p], target & 1);
+          maskAdd(write, pinB[p], target & 2);
+          ok = applyMaskWrite(write);
+        }
+        if (ok) {
+          sent[p]++; // dropped pushes never reach the pins, so they take no step
+        }
+        if (n % 64 == 63) {
+          Actuation step = {ACT_RAMP, {}, {}, NULL, NULL, 0};
+          actuationTryPush(step);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  while (__atomic_load_n(&actuationExecuted, __ATOMIC_ACQUIRE) < __atomic_load_n(&actuationEnqueued, __ATOMIC_RELAXED)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  simOnOutWrite = nullptr;
+
+  uint64_t total = 0;
+  uint64_t stepped = 0;
+  for (int p = 0; p < producers; p++) {
+    total += sent[p];
+    stepped += seen[p];
+    if (seen[p] != sent[p]) {
+      violation("lost actuations", p, seen[p], sent[p]);
+    }
+  }
+  uint32_t executed = actuationExecuted;
+  printf("producers %d, actuations %u in %.2f s (%.0f/s)\n", producers, executed, seconds, executed / seconds);
+  printf("max depth %u/%d, full waits %u, dropped %u, latency avg %.1f us max %u us\n", actuationMaxDepth,
+         ACTUATION_QUEUE_SIZE, actuationFullWaits, actuationDropped,
+         executed ? (double)actuationLatencySum / executed : 0.0, actuationLatencyMax);
+  printf("%llu steps seen of %llu pushed\n", (unsigned long long)stepped, (unsigned long long)total);
+  return simExit();
+}
@@ -0,0 +1,210 @@
+// Benchmark of applying a saved scene against sending the same operations as
+// a /batch, run against the real code in gpio_core.h on the host build
+// (host/): the BatchParser compiling a scene once, sceneApply() on the
+// compiled masks and PWM list, and batchFeed() parsing and applying the
+// operations each time. Heap allocations are counted by host/alloc.cpp.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target scene_bench
+//   ./build/scene_bench [-n applies per round] [-r rounds]
+//
+// The operations are the mode of tools/scene.trace: six digital pins over
+// GPIO 4 to 17 and two PWM pins. Both paths run without the actuation task,
+// as its queue costs the same for either. Reports the median ns per apply,
+// GPIO_OUT writes and LEDC duty writes per apply, and allocations.
+//
+// Checks that:
+//
+// - the scene compiles to six digital pins and two PWM entries
+// - applied from the same start, the scene and the batch leave GPIO_OUT and
+//   the LEDC duties the same
+// - the scene writes GPIO_OUT once per bank it touches, and allocates nothing
+// - the median scene apply is faster than the median batch
+// - with every LEDC channel taken, a scene's PWM pin is neither stored nor
+//   given its reset, while its digital pin is both; with the actuation ring
+//   full, the scene is busy and nothing is stored or scheduled
+//
+// Exits non-zero on the first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// As in tools/scene.trace
+static const char MODE[] =
+  "[{\"gpio\":4,\"state\":\"high\"},{\"gpio\":5,\"state\":\"low\"},{\"gpio\":13,\"state\":\"high\"},"
+  "{\"gpio\":14,\"state\":\"low\"},{\"gpio\":16,\"state\":\"high\"},{\"gpio\":17,\"state\":\"low\"},"
+  "{\"gpio\":18,\"state\":\"pwm128\"},{\"gpio\":19,\"state\":\"pwm64\"}]";
+// Every pin of MODE the other way, so applying it changes something
+static const char INVERSE[] =
+  "[{\"gpio\":4,\"state\":\"low\"},{\"gpio\":5,\"state\":\"high\"},{\"gpio\":13,\"state\":\"low\"},"
+  "{\"gpio\":14,\"state\":\"high\"},{\"gpio\":16,\"state\":\"low\"},{\"gpio\":17,\"state\":\"high\"},"
+  "{\"gpio\":18,\"state\":\"pwm1\"},{\"gpio\":19,\"state\":\"pwm2\"}]";
+
+struct Path {
+  const char* name;
+  std::vector<double> ns; // per apply, one entry per round
+  uint64_t outWrites;
+  uint64_t dutyWrites;
+  uint64_t allocations;
+};
+
+static void batch(const char* operations) {
+  BatchParser parser;
+  batchBegin(parser);
+  batchFeed(parser, operations, strlen(operations));
+  if (parser.state != BATCH_DONE || parser.failed) simFail("batch operations failed", parser.failed, 0);
+}
+
+static uint64_t outWrites() {
+  return (uint64_t)simGpio.outWrites[0] + simGpio.outWrites[1];
+}
+
+static uint64_t dutyWrites() {
+  return simLedc.writes;
+}
+
+// GPIO_OUT and the channel duties, to compare the paths by
+static std::vector<uint32_t> state() {
+  std::vector<uint32_t> out = {simGpio.out[0], simGpio.out[1]};
+  for (const SimLedcChannel &channel : simLedc.channel) out.push_back(channel.duty);
+  return out;
+}
+
+static Scene compile(const char* name, const char* operations) {
+  Scene scene;
+  sceneBegin(scene, name);
+  BatchParser parser;
+  batchBegin(parser);
+  parser.scene = &scene;
+  batchFeed(parser, operations, strlen(operations));
+  if (parser.state != BATCH_DONE || parser.failed) simFail("scene operations failed", parser.failed, 0);
+  return scene;
+}
+
+static bool resetPending(int gpio) {
+  for (const ScheduledEntry &entry : scheduleEntries) {
+    if (entry.phase == PHASE_RESET && entry.cmd.gpio == gpio) return true;
+  }
+  return false;
+}
+
+static void stalledLoop(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+// Every channel taken by pins outside the scene: GPIO 22 gets none, GPIO 21
+// is still driven. Long durations, so the resets stay pending.
+static void noChannel() {
+  Scene scene = compile("partial", "[{\"gpio\":21,\"state\":\"high\",\"duration\":60000},"
+                                   "{\"gpio\":22,\"state\":\"pwm100\",\"duration\":60000}]");
+  for (int gpio = 0, taken = 0; gpio < SOC_GPIO_PIN_COUNT && taken < LEDC_CHANNELS; gpio++) {
+    if (!pinCanOutput(gpio) || gpio == 21 || gpio == 22) continue;
+    GpioCommand cmd = {OP_PWM, (uint8_t)gpio, 10, 0, PWM_DEFAULT_FREQ, PWM_DEFAULT_RESOLUTION, RAMP_LINEAR, 0};
+    if (pinChannel[gpio] != LEDC_NONE || executeCommand(cmd) == ACTUATED) taken++;
+  }
+  ActuationResult result = sceneApply(scene);
+  if (result != ACTUATION_NO_CHANNEL) simFail("scene apply without a channel", result, ACTUATION_NO_CHANNEL);
+  if (!simPinLevel(21)) simFail("digital pin of a scene without a channel", 0, 1);
+  if (stateImage.pins[21].op != OP_HIGH) simFail("stored digital pin", stateImage.pins[21].op, OP_HIGH);
+  if (stateImage.pins[22].op != OP_NONE) simFail("stored PWM pin without a channel", stateImage.pins[22].op, OP_NONE);
+  if (!resetPending(21)) simFail("reset of the digital pin", 0, 1);
+  if (resetPending(22)) simFail("reset of the PWM pin without a channel", 1, 0);
+}
+
+// Last, as the ring stays full: a task that never takes from it
+static void busy() {
+  Scene scene = compile("busy", "[{\"gpio\":27,\"state\":\"high\",\"duration\":60000}]");
+  for (uint32_t i = 0; i < ACTUATION_QUEUE_SIZE; i++) {
+    actuationRing[i].seq = i; // as actuationBegin() does
+  }
+  xTaskCreatePinnedToCore(stalledLoop, "stalled", ACTUATION_STACK, NULL, ACTUATION_PRIORITY, &actuationTask,
+                          ACTUATION_CORE);
+  Actuation filler = {ACT_MASK, {}, {}, NULL, NULL, 0};
+  while (actuationTryPush(filler)) {
+  }
+  ActuationResult result = sceneApply(scene);
+  if (result != ACTUATION_BUSY) simFail("scene apply with the ring full", result, ACTUATION_BUSY);
+  if (simPinLevel(27)) simFail("pin of a dropped scene", 1, 0);
+  if (stateImage.pins[27].op != OP_NONE) simFail("stored pin of a dropped scene", stateImage.pins[27].op, OP_NONE);
+  if (resetPending(27)) simFail("reset of a dropped scene", 1, 0);
+}
+
+template <typename Apply>
+static void measure(Path &path, int applies, Apply apply) {
+  uint64_t writes = outWrites(), duties = dutyWrites(), allocations = simAllocations();
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < applies; i++) {
+    apply();
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  path.allocations += simAllocations() - allocations; // before the push_back below
+  path.outWrites += outWrites() - writes;
+  path.dutyWrites += dutyWrites() - duties;
+  path.ns.push_back(ns / applies);
+}
+
+int main(int argc, char** argv) {
+  int applies = 1000;
+  int rounds = 50;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue) {
+      applies = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-r" && hasValue) {
+      rounds = std::max(1, atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: scene_bench [-n applies per round] [-r rounds]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  ledcPoolBegin();
+
+  // Compiled once, as /scene?name=mode1&operations=... does
+  Scene scene = compile("mode1", MODE);
+  if (sceneDigitalPins(scene) != 6) simFail("digital pins in the scene", sceneDigitalPins(scene), 6);
+  if (scene.header.pwmCount != 2) simFail("PWM entries in the scene", scene.header.pwmCount, 2);
+
+  batch(INVERSE);
+  uint64_t before = outWrites();
+  if (sceneApply(scene) != ACTUATED) simFail("sceneApply()", 0, 1);
+  if (outWrites() - before != 1) simFail("GPIO_OUT writes per scene apply, one bank", outWrites() - before, 1);
+  std::vector<uint32_t> applied = state();
+  batch(INVERSE);
+  batch(MODE);
+  if (state() != applied) simFail("GPIO_OUT bank 0 after the batch, scene gave", simGpio.out[0], applied[0]);
+
+  // Alternating rounds, so both paths see the same conditions
+  Path paths[] = {{"/batch, parsed", {}, 0, 0, 0}, {"/scene, compiled", {}, 0, 0, 0}};
+  for (int r = 0; r < rounds; r++) {
+    measure(paths[0], applies, [] { batch(MODE); });
+    measure(paths[1], applies, [&] { sceneApply(scene); });
+  }
+
+  uint64_t total = (uint64_t)applies * rounds;
+  printf("%d operations, %d rounds of %d applies\n", 8, rounds, applies);
+  printf("%-18s %12s %12s %12s %10s\n", "path", "median ns", "GPIO_OUT", "duty writes", "allocs");
+  for (Path &path : paths) {
+    std::sort(path.ns.begin(), path.ns.end());
+    printf("%-18s %12.1f %12.2f %12.2f %10.2f\n", path.name, path.ns[rounds / 2], (double)path.outWrites / total,
+           (double)path.dutyWrites / total, (double)path.allocations / total);
+  }
+  if (paths[1].allocations) simFail("allocations applying the scene", paths[1].allocations, 0);
+  if (paths[1].outWrites != total) simFail("GPIO_OUT writes applying the scene", paths[1].outWrites, total);
+  if (paths[1].ns[rounds / 2] >= paths[0].ns[rounds / 2]) {
+    simFail("scene apply slower than the batch, median ns", paths[1].ns[rounds / 2], paths[0].ns[rounds / 2]);
+  }
+
+  schedulerBegin();
+  noChannel();
+  busy();
+  return simExit();
+}
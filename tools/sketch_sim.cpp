@@ -0,0 +1,169 @@
+// Host test for the two smaller sketches, `Dynamic GPIO for esp32.cpp` and
+// Resuming_state_for_GPIO.cpp, built on gpio_core.h and gpio_web.h like the
+// dashboard. CMake links this file with each sketch in turn; it runs setup()
+// as gpio_host does and sends requests in-process through hostRequest().
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target dynamic_sim resuming_sim
+//   ./build/dynamic_sim
+//   ./build/resuming_sim
+//
+// Checks:
+//
+// - /setgpio drives a pin high and /readgpio reads it back; a PWM state gets
+//   an LEDC channel with its duty; a bad pin and a bad state answer 400
+// - /batch applies its operations, and a /group operation drives every member
+// - a POST /batch body is applied as application/json, and answered 415
+//   without being applied as a form or as text/plain
+// - a /schedule fires after its delay and resets after its duration
+// - once every LEDC channel is taken, /setgpio pwm answers 503 "No free PWM
+//   channel" without Retry-After
+// - with the actuation task held up and its ring full, /setgpio high and pwm
+//   answer 503 busy with Retry-After, and neither reaches its pin
+// - /pins, /ledc, /queue, /groups, /schedules and /wifi answer 200
+// - Resuming only: a /persist flush from loop() commits the state
+//
+// Exits non-zero on the first violation.
+
+#include <Arduino.h>
+
+#include "net.h"
+#include "sim.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+static std::mutex stallLock;
+static std::condition_variable stallDone;
+static bool stalled = false;
+
+static HostResponse get(const char* url, int want = 200) {
+  HostResponse response = hostRequest("GET", url);
+  if (response.code != want) simFail(url, response.code, want);
+  return response;
+}
+
+// The duty of the LEDC channel driving a pin, or -1 when none is
+static long duty(int gpio) {
+  for (const SimLedcChannel &channel : simLedc.channel) {
+    if (channel.gpio == gpio) return channel.duty;
+  }
+  return -1;
+}
+
+// Lets the actuation task and the scheduler finish what is queued
+static void settle(int ms = 20) {
+  delay(ms);
+}
+
+int main(int argc, char**) {
+  if (argc > 1) {
+    fprintf(stderr, "usage: %s\n", SKETCH);
+    return 2;
+  }
+  simSerialQuiet = true;
+  simWifi.scanJoinMs = 1; // joined during the run, not while the process exits
+  setup();
+
+  get("/setgpio?gpio=4&state=high");
+  settle();
+  if (!simPinLevel(4)) simFail("GPIO 4 after /setgpio high", 0, 1);
+  if (get("/readgpio?gpio=4").body.find("HIGH") == std::string::npos) simFail("/readgpio?gpio=4 HIGH", 0, 1);
+  get("/setgpio?gpio=18&state=pwm100");
+  settle();
+  if (duty(18) != 100) simFail("GPIO 18 duty after /setgpio pwm100", duty(18), 100);
+  get("/setgpio?gpio=6&state=high", 400);
+  get("/setgpio?gpio=4&state=sideways", 400);
+
+  get("/batch?operations=[{\"gpio\":4,\"state\":\"low\"},{\"gpio\":13,\"state\":\"high\"}]");
+  get("/group?name=pair&pins=14,16");
+  get("/batch?operations=[{\"group\":\"pair\",\"state\":\"high\"}]");
+  settle();
+  if (simPinLevel(4) || !simPinLevel(13)) {
+    simFail("GPIO 4 and 13 after /batch", simPinLevel(4) * 2 + simPinLevel(13), 1);
+  }
+  if (!simPinLevel(14) || !simPinLevel(16)) simFail("group pins after /batch", simPinLevel(14) + simPinLevel(16), 2);
+
+  const char* high4 = "[{\"gpio\":4,\"state\":\"high\"}]";
+  for (const char* type : {"application/x-www-form-urlencoded", "text/plain"}) {
+    HostResponse response = hostRequest("POST", "/batch", high4, {{"Content-Type", type}});
+    if (response.code != 415) simFail(type, response.code, 415);
+  }
+  settle();
+  if (simPinLevel(4)) simFail("GPIO 4 after POST /batch bodies answered 415", 1, 0);
+  HostResponse json = hostRequest("POST", "/batch", high4, {{"Content-Type", "application/json"}});
+  if (json.code != 200) simFail("POST /batch as application/json", json.code, 200);
+  settle();
+  if (!simPinLevel(4)) simFail("GPIO 4 after POST /batch", 0, 1);
+
+  get("/schedule?gpio=17&state=high&delay=20&duration=40");
+  settle(40);
+  if (!simPinLevel(17)) simFail("GPIO 17 after its schedule fired", 0, 1);
+  settle(60);
+  if (simPinLevel(17)) simFail("GPIO 17 after its duration", 1, 0);
+
+  // Every channel taken, then one PWM pin more
+  std::vector<int> pwmPins;
+  HostResponse refused = {};
+  for (int gpio = 0; gpio < 40 && refused.code == 0; gpio++) {
+    if (gpio == 4 || gpio == 13 || gpio == 14 || gpio == 16 || gpio == 17 || duty(gpio) >= 0) continue;
+    std::string url = "/setgpio?gpio=" + std::to_string(gpio) + "&state=pwm50";
+    HostResponse response = hostRequest("GET", url.c_str());
+    if (response.code == 200) {
+      pwmPins.push_back(gpio);
+    } else if (response.code == 503) {
+      refused = response;
+    }
+  }
+  if (refused.code != 503) simFail("/setgpio pwm without a channel", refused.code, 503);
+  if (refused.body.find("No free PWM channel") == std::string::npos) simFail("no channel reply", 0, 1);
+  if (!hostHeader(refused, "Retry-After").empty()) simFail("Retry-After without a channel", 1, 0);
+  for (int gpio : pwmPins) {
+    get(("/setgpio?gpio=" + std::to_string(gpio) + "&state=low").c_str());
+  }
+
+  // The actuation task held in its next GPIO_OUT write, and the ring filled
+  simOnOutWrite = [](int, uint32_t) {
+    std::unique_lock<std::mutex> lock(stallLock);
+    stallDone.wait(lock, [] { return !stalled; });
+  };
+  {
+    std::lock_guard<std::mutex> lock(stallLock);
+    stalled = true;
+  }
+  HostResponse busy = {};
+  for (int queued = 0; queued < 200 && busy.code != 503; queued++) {
+    busy = hostRequest("GET", queued & 1 ? "/setgpio?gpio=13&state=high" : "/setgpio?gpio=13&state=low");
+  }
+  HostResponse busyPwm = hostRequest("GET", "/setgpio?gpio=19&state=pwm100");
+  for (const HostResponse &response : {busy, busyPwm}) {
+    if (response.code != 503) simFail("/setgpio with the ring full", response.code, 503);
+    if (response.body.find("Busy") == std::string::npos) simFail("busy reply with the ring full", 0, 1);
+    if (hostHeader(response, "Retry-After").empty()) simFail("Retry-After with the ring full", 0, 1);
+  }
+  {
+    std::lock_guard<std::mutex> lock(stallLock);
+    stalled = false;
+  }
+  stallDone.notify_all();
+  settle();
+  simOnOutWrite = nullptr;
+  if (duty(19) >= 0) simFail("GPIO 19 duty after a busy /setgpio", duty(19), -1);
+
+  for (const char* url : {"/pins", "/ledc", "/queue", "/groups", "/schedules", "/wifi"}) {
+    get(url);
+  }
+
+  if (SKETCH_PERSISTS) {
+    get("/persist?flush=1");
+    loop();
+    if (get("/persist").body.find("\"commits\":0") != std::string::npos) simFail("commits after a flush", 0, 1);
+  }
+
+  return simExit(SKETCH);
+}
@@ -0,0 +1,199 @@
+// Benchmark of the /readall snapshot of html_GPIO_control_dashboard.cpp
+// against reading the same pins one /readgpio request at a time, on the
+// host build: setup() as gpio_host runs it, requests in-process through
+// hostRequest(), GPIO_IN reads counted by the register model and heap
+// allocations by host/alloc.cpp.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target snapshot_bench
+//   ./build/snapshot_bench [-n rounds] [-s seed]
+//
+// Drives a mix of digital and PWM outputs and sets the other pads to random
+// levels, then each round reads every pin the dashboard shows with one
+// /readgpio per pin, and with one /readall in each format. Reports per path
+// the requests, GPIO_IN reads, body bytes, heap allocations and latency.
+// Each request on the wire also carries its own request line and headers,
+// and on the device its own TCP round trip, which this does not count.
+//
+// Checks that:
+//
+// - a snapshot reads GPIO_IN once per bank, whatever the pin count
+// - its levels match the per-pin reads, and its duties the PWM values set
+// - hex is the bin bytes, and both are smaller than the per-pin bodies
+// - a snapshot takes less time than the per-pin sweep
+//
+// Exits non-zero on the first violation.
+
+#include <Arduino.h>
+
+#include "net.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+void setup();
+
+struct Path {
+  const char* name;
+  uint32_t requests;     // per read of every pin
+  uint64_t inReads;
+  uint64_t bytes;
+  uint64_t allocations;
+  std::vector<double> us; // per read of every pin
+};
+
+static std::mt19937 rng(1);
+
+static void fail(int round, const char* what, long got, long want) {
+  simFailf("round %d: %s: got %ld, expected %ld", round, what, got, want);
+}
+
+static uint64_t inReads() {
+  return (uint64_t)simGpio.inReads[0] + simGpio.inReads[1];
+}
+
+// Runs the requests of one read of every pin and adds them to the path
+static std::vector<HostResponse> measure(Path &path, const std::vector<std::string> &urls) {
+  std::vector<HostResponse> responses;
+  uint64_t reads = inReads();
+  auto t0 = std::chrono::steady_clock::now();
+  for (const std::string &url : urls) {
+    responses.push_back(hostRequest("GET", url.c_str()));
+  }
+  path.us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+  path.inReads += inReads() - reads;
+  for (const HostResponse &response : responses) {
+    path.bytes += response.body.size();
+    path.allocations += response.allocations;
+  }
+  path.requests = urls.size();
+  return responses;
+}
+
+static std::string hex(const std::string &bytes) {
+  std::string out;
+  char digits[3];
+  for (unsigned char c : bytes) {
+    snprintf(digits, sizeof(digits), "%02x", c);
+    out += digits;
+  }
+  return out;
+}
+
+int main(int argc, char** argv) {
+  int rounds = 2000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue) {
+      rounds = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-s" && hasValue) {
+      rng.seed(strtoul(argv[++i], NULL, 10));
+    } else {
+      fprintf(stderr, "usage: snapshot_bench [-n rounds] [-s seed]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  setup();
+
+  // Outputs first, so /readgpio leaves them as they are
+  const int digital[] = {2, 4, 5, 13, 14, 21, 22, 23, 25, 26, 27, 32};
+  const int pwm[] = {18, 19, 33};
+  for (int gpio : digital) {
+    std::string url = "/setgpio?gpio=" + std::to_string(gpio) + "&state=" + (rng() & 1 ? "high" : "low");
+    hostRequest("GET", url.c_str());
+  }
+  std::vector<int> duties;
+  for (int gpio : pwm) {
+    duties.push_back(1 + rng() % 255);
+    std::string url = "/setgpio?gpio=" + std::to_string(gpio) + "&state=pwm" + std::to_string(duties.back());
+    hostRequest("GET", url.c_str());
+  }
+
+  // The pins the dashboard shows are the ones /readgpio accepts
+  std::vector<std::string> perPin;
+  std::vector<int> pins;
+  for (int gpio = 0; gpio < 40; gpio++) {
+    simSetInput(gpio, rng() & 1);
+    std::string url = "/readgpio?gpio=" + std::to_string(gpio);
+    if (hostRequest("GET", url.c_str()).code == 200) {
+      perPin.push_back(url);
+      pins.push_back(gpio);
+    }
+  }
+
+  Path paths[] = {
+    {"/readgpio per pin", 0, 0, 0, 0, {}},
+    {"/readall", 0, 0, 0, 0, {}},
+    {"/readall?format=hex", 0, 0, 0, 0, {}},
+    {"/readall?format=bin", 0, 0, 0, 0, {}},
+  };
+  for (int r = 0; r < rounds; r++) {
+    // New levels on a few input pads each round
+    for (int i = 0; i < 4; i++) {
+      simSetInput(pins[rng() % pins.size()], rng() & 1);
+    }
+    uint32_t levels[2] = {0, 0};
+    for (const HostResponse &response : measure(paths[0], perPin)) {
+      int gpio = 0;
+      char state[8] = "";
+      if (sscanf(response.body.c_str(), "{\"gpio\":%d,\"state\":\"%7[A-Z]", &gpio, state) == 2 && !strcmp(state, "HIGH")) {
+        levels[gpio >> 5] |= 1UL << (gpio & 31);
+      }
+    }
+
+    uint64_t before = paths[1].inReads;
+    std::string json = measure(paths[1], {"/readall"})[0].body;
+    if (paths[1].inReads - before != 2) fail(r, "GPIO_IN reads per snapshot", paths[1].inReads - before, 2);
+    uint32_t snap[2] = {0, 0};
+    if (sscanf(json.c_str(), "{\"levels\":[%u,%u]", &snap[0], &snap[1]) != 2) fail(r, "levels in the snapshot", 0, 2);
+    for (int gpio : pins) {
+      uint32_t bit = 1UL << (gpio & 31);
+      if ((snap[gpio >> 5] & bit) != (levels[gpio >> 5] & bit)) {
+        fail(r, "snapshot level of a pin", gpio, (levels[gpio >> 5] & bit) != 0);
+      }
+    }
+    for (size_t i = 0; i < duties.size(); i++) {
+      std::string entry = "{\"gpio\":" + std::to_string(pwm[i]) + ",\"mode\":\"pwm\"";
+      size_t at = json.find(entry);
+      unsigned duty = 0;
+      if (at == std::string::npos || sscanf(json.c_str() + json.find("\"pwm_value\":", at), "\"pwm_value\":%u", &duty) != 1 ||
+          duty != (unsigned)duties[i]) {
+        fail(r, "snapshot duty of a PWM pin", pwm[i], duties[i]);
+      }
+    }
+
+    std::string text = measure(paths[2], {"/readall?format=hex"})[0].body;
+    std::string bin = measure(paths[3], {"/readall?format=bin"})[0].body;
+    if (text != hex(bin)) fail(r, "hex and bin snapshots differ, hex bytes", text.size(), bin.size() * 2);
+    uint32_t packed[2] = {0, 0};
+    if (bin.size() >= sizeof(packed)) memcpy(packed, bin.data(), sizeof(packed));
+    if (packed[0] != snap[0] || packed[1] != snap[1]) fail(r, "bin levels, bank 0 word", packed[0], snap[0]);
+  }
+
+  printf("%d pins, %d rounds\n", (int)pins.size(), rounds);
+  printf("%-22s %9s %10s %8s %8s %10s %10s\n", "path", "requests", "GPIO_IN", "bytes", "allocs", "mean us", "p99 us");
+  for (Path &path : paths) {
+    std::sort(path.us.begin(), path.us.end());
+    double mean = 0;
+    for (double us : path.us) mean += us;
+    printf("%-22s %9u %10.1f %8.0f %8.1f %10.2f %10.2f\n", path.name, path.requests, (double)path.inReads / rounds,
+           (double)path.bytes / rounds, (double)path.allocations / rounds, mean / rounds, path.us[path.us.size() * 99 / 100]);
+  }
+  for (int i = 2; i < 4; i++) {
+    if (paths[i].bytes >= paths[0].bytes) fail(-1, paths[i].name, paths[i].bytes / rounds, paths[0].bytes / rounds);
+  }
+  // Medians, so a descheduled round does not decide it
+  for (int i = 1; i < 4; i++) {
+    double snapshot = paths[i].us[rounds / 2];
+    double sweep = paths[0].us[rounds / 2];
+    if (snapshot >= sweep) fail(-1, "snapshot slower than the per-pin sweep, median ns", snapshot * 1000, sweep * 1000);
+  }
+  return simExit();
+}
@@ -0,0 +1,520 @@
+// Replays a recorded request trace against the controller's HTTP API and
+// reports latency percentiles, error rates and throughput per endpoint.
+//
+// Build (Linux/macOS):
+//   g++ -O2 -std=c++17 -pthread -o trace_replay tools/trace_replay.cpp
+//
+// Trace format, one request per line ('#' starts a comment):
+//   <offset_ms> <METHOD> <path> [body]
+//   0    GET  /setgpio?gpio=4&state=high
+//   2    POST /batch [{"gpio":4,"state":"low"},{"gpio":5,"state":"high"}]
+//
+// Usage:
+//   trace_replay [options] <host> <trace>
+//     -p, --port N         HTTP port (default 80)
+//     -c, --concurrency N  parallel connections (default 1)
+//     -s, --speed X        replay speed; 1 keeps the recorded pacing, 2 is
+//                          twice as fast, 0 sends as fast as possible (default 1)
+//     -n, --loops N        replay the trace N times (default 1)
+//     -t, --timeout MS     per-request timeout (default 5000)
+//     --no-keep-alive      open a new connection for every request
+//     --csv FILE           write the per-endpoint summary as CSV
+//     --json FILE          write the per-endpoint summary as JSON
+//   trace_replay --mock [port]
+//     Serves canned replies for the endpoints of "Dynamic GPIO for esp32.cpp"
+//     (default port 8080), to check a trace or the tool itself off-device.
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct TraceRequest {
+  double offsetMs;
+  std::string method;
+  std::string path;
+  std::string body;
+  std::string endpoint;  // path without the query string
+};
+
+struct Sample {
+  double latencyMs;
+  int status;            // HTTP status, 0 on a transport error
+};
+
+struct Options {
+  std::string host;
+  std::string tracePath;
+  int port = 80;
+  int concurrency = 1;
+  double speed = 1.0;
+  int loops = 1;
+  int timeoutMs = 5000;
+  bool keepAlive = true;
+  std::string csvPath;
+  std::string jsonPath;
+};
+
+static bool loadTrace(const std::string &path, std::vector<TraceRequest> &trace) {
+  std::ifstream in(path);
+  if (!in) {
+    fprintf(stderr, "cannot open trace %s\n", path.c_str());
+    return false;
+  }
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(in, line)) {
+    lineNo++;
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') continue;
+    std::istringstream fields(line);
+    TraceRequest request;
+    if (!(fields >> request.offsetMs >> request.method >> request.path) || request.path[0] != '/') {
+      fprintf(stderr, "%s:%d: expected <offset_ms> <METHOD> <path> [body]\n", path.c_str(), lineNo);
+      return false;
+    }
+    std::getline(fields, request.body);
+    size_t bodyStart = request.body.find_first_not_of(" \t");
+    request.body = bodyStart == std::string::npos ? "" : request.body.substr(bodyStart);
+    while (!request.body.empty() && request.body.back() == '\r') request.body.pop_back();
+    request.endpoint = request.method + " " + request.path.substr(0, request.path.find('?'));
+    trace.push_back(request);
+  }
+  std::stable_sort(trace.begin(), trace.end(),
+                   [](const TraceRequest &a, const TraceRequest &b) { return a.offsetMs < b.offsetMs; });
+  return !trace.empty();
+}
+
+// One client connection, reopened whenever the server closes it
+class Connection {
+ public:
+  Connection(const sockaddr_in &address, int timeoutMs) : address_(address), timeoutMs_(timeoutMs) {}
+  ~Connection() { close(); }
+
+  // Sends a request and reads the whole response. Returns the HTTP status,
+  // or 0 when the connection failed or timed out.
+  int roundTrip(const std::string &request, bool keepAlive) {
+    if (fd_ < 0 && !open()) return 0;
+    if (!sendAll(request)) {
+      // A kept-alive connection may have been closed by the server; retry once
+      close();
+      if (!open() || !sendAll(request)) return 0;
+    }
+    int status = readResponse();
+    if (status == 0 || !keepAlive || serverClosing_) close();
+    return status;
+  }
+
+ private:
+  bool open() {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) return false;
+    timeval tv = {timeoutMs_ / 1000, (timeoutMs_ % 1000) * 1000};
+    setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd_, (const sockaddr*)&address_, sizeof(address_)) != 0) {
+      close();
+      return false;
+    }
+    buffer_.clear();
+    return true;
+  }
+
+  void close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+  }
+
+  bool sendAll(const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t n = send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) return false;
+      sent += n;
+    }
+    return true;
+  }
+
+  // Makes sure buffer_ holds at least `want` bytes; false on EOF or timeout
+  bool fill(size_t want) {
+    char chunk[4096];
+    while (buffer_.size() < want) {
+      ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+      if (n <= 0) return false;
+      buffer_.append(chunk, n);
+    }
+    return true;
+  }
+
+  bool readLine(std::string &line) {
+    size_t end;
+    while ((end = buffer_.find("\r\n")) == std::string::npos) {
+      if (!fill(buffer_.size() + 1)) return false;
+    }
+    line = buffer_.substr(0, end);
+    buffer_.erase(0, end + 2);
+    return true;
+  }
+
+  int readResponse() {
+    std::string line;
+    if (!readLine(line) || line.compare(0, 5, "HTTP/") != 0) return 0;
+    int status = atoi(line.c_str() + line.find(' ') + 1);
+    long contentLength = -1;
+    bool chunked = false;
+    serverClosing_ = line.compare(0, 8, "HTTP/1.0") == 0;
+    while (readLine(line) && !line.empty()) {
+      std::string name = line.substr(0, line.find(':'));
+      std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+      std::string value = line.substr(std::min(line.size(), name.size() + 1));
+      value.erase(0, value.find_first_not_of(' '));
+      std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+      if (name == "content-length") contentLength = atol(value.c_str());
+      if (name == "transfer-encoding" && value.find("chunked") != std::string::npos) chunked = true;
+      if (name == "connection") serverClosing_ = value == "close";
+    }
+    if (!line.empty()) return 0;
+
+    if (chunked) {
+      for (;;) {
+        if (!readLine(line)) return 0;
+        long size = strtol(line.c_str(), NULL, 16);
+        if (!fill(size + 2)) return 0;
+        buffer_.erase(0, size + 2);
+        if (size == 0) break;
+      }
+    } else if (contentLength >= 0) {
+      if (!fill(contentLength)) return 0;
+      buffer_.erase(0, contentLength);
+    } else {
+      while (fill(buffer_.size() + 1)) {}  // body runs to the end of the connection
+      buffer_.clear();
+      serverClosing_ = true;
+    }
+    return status;
+  }
+
+  sockaddr_in address_;
+  int timeoutMs_;
+  int fd_ = -1;
+  bool serverClosing_ = false;
+  std::string buffer_;
+};
+
+static std::string buildRequest(const TraceRequest &request, const std::string &host, bool keepAlive) {
+  std::string out = request.method + " " + request.path + " HTTP/1.1\r\nHost: " + host + "\r\n";
+  out += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  if (!request.body.empty() || request.method == "POST") {
+    out += "Content-Type: application/json\r\nContent-Length: " + std::to_string(request.body.size()) + "\r\n";
+  }
+  return out + "\r\n" + request.body;
+}
+
+static double percentile(std::vector<double> &sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+struct Summary {
+  std::string endpoint;
+  size_t requests = 0;
+  size_t httpErrors = 0;  // status >= 400
+  size_t ioErrors = 0;    // connect, send, receive or timeout failures
+  double p50 = 0, p99 = 0, p999 = 0, max = 0;
+  double throughput = 0;  // requests per second over the whole run
+};
+
+static std::vector<Summary> summarize(const std::vector<TraceRequest> &trace, const std::vector<Sample> &samples,
+                                      double elapsedSec) {
+  std::map<std::string, std::vector<size_t>> byEndpoint;
+  for (size_t i = 0; i < samples.size(); i++) {
+    byEndpoint[trace[i % trace.size()].endpoint].push_back(i);
+    byEndpoint["*"].push_back(i);
+  }
+  std::vector<Summary> summaries;
+  for (auto &entry : byEndpoint) {
+    Summary summary;
+    summary.endpoint = entry.first;
+    std::vector<double> latencies;
+    for (size_t i : entry.second) {
+      summary.requests++;
+      if (samples[i].status == 0) {
+        summary.ioErrors++;
+        continue;
+      }
+      if (samples[i].status >= 400) summary.httpErrors++;
+      latencies.push_back(samples[i].latencyMs);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    summary.p50 = percentile(latencies, 0.50);
+    summary.p99 = percentile(latencies, 0.99);
+    summary.p999 = percentile(latencies, 0.999);
+    summary.max = latencies.empty() ? 0 : latencies.back();
+    summary.throughput = elapsedSec > 0 ? summary.requests / elapsedSec : 0;
+    summaries.push_back(summary);
+  }
+  return summaries;
+}
+
+static int replay(const Options &options) {
+  std::vector<TraceRequest> trace;
+  if (!loadTrace(options.tracePath, trace)) return 1;
+
+  addrinfo hints = {}, *resolved;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(options.host.c_str(), std::to_string(options.port).c_str(), &hints, &resolved) != 0) {
+    fprintf(stderr, "cannot resolve %s\n", options.host.c_str());
+    return 1;
+  }
+  sockaddr_in address = *(sockaddr_in*)resolved->ai_addr;
+  freeaddrinfo(resolved);
+
+  std::vector<std::string> wire;
+  for (const TraceRequest &request : trace) {
+    wire.push_back(buildRequest(request, options.host, options.keepAlive));
+  }
+
+  // Requests are issued in trace order; each worker takes the next one and
+  // waits for its offset, so pacing holds as long as enough connections are
+  // free to absorb the overlap.
+  const double traceLength = trace.back().offsetMs;
+  const size_t total = trace.size() * options.loops;
+  std::vector<Sample> samples(total);
+  std::atomic<size_t> next(0);
+  Clock::time_point start = Clock::now();
+
+  std::vector<std::thread> workers;
+  for (int w = 0; w < options.concurrency; w++) {
+    workers.emplace_back([&]() {
+      Connection connection(address, options.timeoutMs);
+      for (size_t i; (i = next.fetch_add(1)) < total;) {
+        size_t index = i % trace.size();
+        if (options.speed > 0) {
+          double offset = (i / trace.size()) * (traceLength + 1) + trace[index].offsetMs;
+          std::this_thread::sleep_until(start + std::chrono::microseconds((long long)(offset * 1000 / options.speed)));
+        }
+        Clock::time_point sent = Clock::now();
+        int status = connection.roundTrip(wire[index], options.keepAlive);
+        samples[i].latencyMs = std::chrono::duration<double, std::milli>(Clock::now() - sent).count();
+        samples[i].status = status;
+      }
+    });
+  }
+  for (std::thread &worker : workers) worker.join();
+  double elapsedSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<Summary> summaries = summarize(trace, samples, elapsedSec);
+  printf("%-28s %9s %7s %7s %10s %9s %9s %9s %9s\n", "endpoint", "requests", "http_err", "io_err", "req/s",
+         "p50_ms", "p99_ms", "p999_ms", "max_ms");
+  for (const Summary &s : summaries) {
+    printf("%-28s %9zu %7zu %7zu %10.1f %9.2f %9.2f %9.2f %9.2f\n", s.endpoint.c_str(), s.requests, s.httpErrors,
+           s.ioErrors, s.throughput, s.p50, s.p99, s.p999, s.max);
+  }
+  printf("%zu requests in %.2f s\n", total, elapsedSec);
+
+  if (!options.csvPath.empty()) {
+    FILE *csv = fopen(options.csvPath.c_str(), "w");
+    if (csv == NULL) {
+      fprintf(stderr, "cannot write %s\n", options.csvPath.c_str());
+      return 1;
+    }
+    fprintf(csv, "endpoint,requests,http_errors,io_errors,error_rate,throughput_rps,p50_ms,p99_ms,p999_ms,max_ms\n");
+    for (const Summary &s : summaries) {
+      fprintf(csv, "\"%s\",%zu,%zu,%zu,%.6f,%.3f,%.3f,%.3f,%.3f,%.3f\n", s.endpoint.c_str(), s.requests,
+              s.httpErrors, s.ioErrors, (double)(s.httpErrors + s.ioErrors) / s.requests, s.throughput, s.p50,
+              s.p99, s.p999, s.max);
+    }
+    fclose(csv);
+  }
+  if (!options.jsonPath.empty()) {
+    FILE *json = fopen(options.jsonPath.c_str(), "w");
+    if (json == NULL) {
+      fprintf(stderr, "cannot write %s\n", options.jsonPath.c_str());
+      return 1;
+    }
+    fprintf(json, "{\"elapsed_s\":%.3f,\"concurrency\":%d,\"keep_alive\":%s,\"speed\":%g,\"endpoints\":[",
+            elapsedSec, options.concurrency, options.keepAlive ? "true" : "false", options.speed);
+    for (size_t i = 0; i < summaries.size(); i++) {
+      const Summary &s = summaries[i];
+      fprintf(json,
+              "%s{\"endpoint\":\"%s\",\"requests\":%zu,\"http_errors\":%zu,\"io_errors\":%zu,\"error_rate\":%.6f,"
+              "\"throughput_rps\":%.3f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,\"max_ms\":%.3f}",
+              i ? "," : "", s.endpoint.c_str(), s.requests, s.httpErrors, s.ioErrors,
+              (double)(s.httpErrors + s.ioErrors) / s.requests, s.throughput, s.p50, s.p99, s.p999, s.max);
+    }
+    fprintf(json, "]}\n");
+    fclose(json);
+  }
+  return 0;
+}
+
+// Canned replies shaped like the firmware's, for the endpoints of the basic
+// sketch. One thread per connection, keep-alive honoured.
+static std::string mockReply(const std::string &method, const std::string &path) {
+  std::string endpoint = path.substr(0, path.find('?'));
+  std::string query = path.find('?') == std::string::npos ? "" : path.substr(path.find('?') + 1);
+  auto param = [&](const char* name) -> std::string {
+    std::string key = std::string(name) + "=";
+    size_t at = ("&" + query).find("&" + key);
+    if (at == std::string::npos) return "";
+    std::string value = query.substr(at + key.size());
+    return value.substr(0, value.find('&'));
+  };
+  if (endpoint == "/setgpio" && !param("gpio").empty() && !param("state").empty()) {
+    return "200 {\"gpio\":" + param("gpio") + ",\"state\":\"HIGH\",\"status\":\"success\"}";
+  }
+  if (endpoint == "/readgpio" && !param("gpio").empty()) {
+    return "200 {\"gpio\":" + param("gpio") + ",\"state\":\"LOW\"}";
+  }
+  if (endpoint == "/schedule" && !param("delay").empty()) {
+    static std::atomic<unsigned> id(1);
+    return "200 {\"id\":" + std::to_string(id++) + ",\"status\":\"scheduled\"}";
+  }
+  if (endpoint == "/batch" && (method == "POST" || !param("operations").empty())) {
+    return "200 {\"operations\":1,\"applied\":1,\"failed\":0,\"errors\":[],\"status\":\"success\"}";
+  }
+  if (endpoint == "/cancel" || endpoint == "/group") {
+    return "200 {\"status\":\"success\"}";
+  }
+  if (endpoint == "/schedules") {
+    return "200 {\"scheduled\":[],\"pending\":0,\"capacity\":2048}";
+  }
+  return "404 {\"error\":\"Not found\",\"status\":\"failure\"}";
+}
+
+static void mockConnection(int fd) {
+  std::string buffer;
+  char chunk[4096];
+  for (;;) {
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) {
+        close(fd);
+        return;
+      }
+      buffer.append(chunk, n);
+    }
+    std::string head = buffer.substr(0, headerEnd);
+    std::string lower = head;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    size_t lengthAt = lower.find("content-length:");
+    size_t bodyLength = lengthAt == std::string::npos ? 0 : atol(head.c_str() + lengthAt + 15);
+    while (buffer.size() < headerEnd + 4 + bodyLength) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) {
+        close(fd);
+        return;
+      }
+      buffer.append(chunk, n);
+    }
+    buffer.erase(0, headerEnd + 4 + bodyLength);
+
+    std::istringstream requestLine(head);
+    std::string method, path;
+    requestLine >> method >> path;
+    bool keepAlive = lower.find("connection: close") == std::string::npos;
+    std::string reply = mockReply(method, path);
+    std::string body = reply.substr(4);
+    std::string response = "HTTP/1.1 " + reply.substr(0, 3) + (reply[0] == '2' ? " OK" : " Not Found") +
+                           "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) +
+                           (keepAlive ? "\r\n\r\n" : "\r\nConnection: close\r\n\r\n") + body;
+    if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) != (ssize_t)response.size() || !keepAlive) {
+      close(fd);
+      return;
+    }
+  }
+}
+
+static int serveMock(int port) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 128) != 0) {
+    fprintf(stderr, "cannot listen on port %d\n", port);
+    return 1;
+  }
+  printf("mock endpoints listening on port %d\n", port);
+  for (;;) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) continue;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::thread(mockConnection, fd).detach();
+  }
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: trace_replay [-p port] [-c concurrency] [-s speed] [-n loops] [-t timeout_ms]\n"
+          "                    [--no-keep-alive] [--csv file] [--json file] <host> <trace>\n"
+          "       trace_replay --mock [port]\n");
+}
+
+int main(int argc, char **argv) {
+  signal(SIGPIPE, SIG_IGN);
+  Options options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--mock") {
+      return serveMock(hasValue ? atoi(argv[i + 1]) : 8080);
+    } else if ((arg == "-p" || arg == "--port") && hasValue) {
+      options.port = atoi(argv[++i]);
+    } else if ((arg == "-c" || arg == "--concurrency") && hasValue) {
+      options.concurrency = std::max(1, atoi(argv[++i]));
+    } else if ((arg == "-s" || arg == "--speed") && hasValue) {
+      options.speed = atof(argv[++i]);
+    } else if ((arg == "-n" || arg == "--loops") && hasValue) {
+      options.loops = std::max(1, atoi(argv[++i]));
+    } else if ((arg == "-t" || arg == "--timeout") && hasValue) {
+      options.timeoutMs = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--no-keep-alive") {
+      options.keepAlive = false;
+    } else if (arg == "--csv" && hasValue) {
+      options.csvPath = argv[++i];
+    } else if (arg == "--json" && hasValue) {
+      options.jsonPath = argv[++i];
+    } else if (arg[0] == '-') {
+      usage();
+      return 2;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() != 2) {
+    usage();
+    return 2;
+  }
+  options.host = positional[0];
+  options.tracePath = positional[1];
+  return replay(options);
+}
@@ -0,0 +1,202 @@
+// Compares the round-trip latency of the binary UDP protocol with /setgpio.
+//
+// Build (Linux/macOS):
+//   g++ -O2 -std=c++17 -pthread -o udp_bench tools/udp_bench.cpp
+//
+// Usage:
+//   udp_bench [-n count] [-g gpio] [--http-port N] [--udp-port N] <host>
+//     Toggles one pin `count` times over each protocol against a device
+//     running html_GPIO_control_dashboard.cpp (defaults: 1000, GPIO 2,
+//     HTTP port 80, UDP port 4210).
+//   udp_bench --loopback [-n count]
+//     Runs both against minimal responders on 127.0.0.1, which shows the
+//     client and protocol overhead without Wi-Fi or the device.
+
+#include "gpio_udp.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedUs(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// One /setgpio request on a fresh connection, as the device's web server
+// closes every connection after its response. Returns the HTTP status.
+static int httpSet(const sockaddr_in &address, int gpio, bool level) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  timeval tv = {2, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (connect(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+    close(fd);
+    return 0;
+  }
+  char request[128];
+  int len = snprintf(request, sizeof(request), "GET /setgpio?gpio=%d&state=%s HTTP/1.1\r\nHost: bench\r\n\r\n", gpio,
+                     level ? "high" : "low");
+  std::string response;
+  if (send(fd, request, len, MSG_NOSIGNAL) == len) {
+    char buffer[512];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      response.append(buffer, n);
+    }
+  }
+  close(fd);
+  return response.compare(0, 5, "HTTP/") == 0 ? atoi(response.c_str() + 9) : 0;
+}
+
+static void report(const char* name, std::vector<double> &us, int failures) {
+  std::sort(us.begin(), us.end());
+  auto at = [&](double p) { return us.empty() ? 0 : us[std::min(us.size() - 1, (size_t)(p * (us.size() - 1) + 0.5))]; };
+  double sum = 0;
+  for (double v : us) sum += v;
+  printf("%-10s %8zu %8d %10.1f %10.1f %10.1f %10.1f\n", name, us.size(), failures, us.empty() ? 0 : sum / us.size(),
+         at(0.50), at(0.99), at(0.999));
+}
+
+// Loopback responders: a UDP socket that acks every frame, and an HTTP
+// listener that answers like /setgpio and closes the connection
+static std::atomic<bool> stopping(false);
+
+static void udpResponder(int fd) {
+  uint8_t frame[64];
+  sockaddr_in from;
+  socklen_t fromLen = sizeof(from);
+  ssize_t n;
+  while ((n = recvfrom(fd, frame, sizeof(frame), 0, (sockaddr*)&from, &fromLen)) >= 0 && !stopping) {
+    if (n < (ssize_t)sizeof(gpioudp::Header)) continue;
+    gpioudp::Ack ack = {};
+    memcpy(&ack.header, frame, sizeof(ack.header));
+    ack.header.type |= gpioudp::ACK;
+    sendto(fd, &ack, sizeof(ack), 0, (sockaddr*)&from, fromLen);
+    fromLen = sizeof(from);
+  }
+}
+
+static void httpResponder(int listener) {
+  const std::string body = "{\"gpio\":2,\"state\":\"HIGH\",\"status\":\"success\"}";
+  const std::string reply = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                            std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+  for (;;) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0 || stopping) break;
+    std::string request;
+    char buffer[512];
+    ssize_t n;
+    while (request.find("\r\n\r\n") == std::string::npos && (n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      request.append(buffer, n);
+    }
+    send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+    close(fd);
+  }
+}
+
+static uint16_t bindLoopback(int fd) {
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(address);
+  bind(fd, (sockaddr*)&address, sizeof(address));
+  getsockname(fd, (sockaddr*)&address, &len);
+  return ntohs(address.sin_port);
+}
+
+int main(int argc, char **argv) {
+  signal(SIGPIPE, SIG_IGN);
+  int count = 1000;
+  int gpio = 2;
+  int httpPort = 80;
+  int udpPort = gpioudp::DEFAULT_PORT;
+  bool loopback = false;
+  std::string host;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue) {
+      count = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-g" && hasValue) {
+      gpio = atoi(argv[++i]);
+    } else if (arg == "--http-port" && hasValue) {
+      httpPort = atoi(argv[++i]);
+    } else if (arg == "--udp-port" && hasValue) {
+      udpPort = atoi(argv[++i]);
+    } else if (arg == "--loopback") {
+      loopback = true;
+    } else if (arg[0] != '-' && host.empty()) {
+      host = arg;
+    } else {
+      fprintf(stderr, "usage: udp_bench [-n count] [-g gpio] [--http-port N] [--udp-port N] <host>\n"
+                      "       udp_bench --loopback [-n count]\n");
+      return 2;
+    }
+  }
+  if (host.empty() && !loopback) {
+    fprintf(stderr, "no host given (or use --loopback)\n");
+    return 2;
+  }
+
+  std::vector<std::thread> responders;
+  if (loopback) {
+    host = "127.0.0.1";
+    int udpFd = socket(AF_INET, SOCK_DGRAM, 0);
+    udpPort = bindLoopback(udpFd);
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    httpPort = bindLoopback(listener);
+    listen(listener, 64);
+    responders.emplace_back(udpResponder, udpFd);
+    responders.emplace_back(httpResponder, listener);
+    for (std::thread &responder : responders) responder.detach();
+  }
+
+  gpioudp::Client client;
+  if (!client.open(host.c_str(), udpPort)) {
+    fprintf(stderr, "cannot resolve %s\n", host.c_str());
+    return 1;
+  }
+  sockaddr_in httpAddress = {};
+  httpAddress.sin_family = AF_INET;
+  httpAddress.sin_port = htons(httpPort);
+  hostent* resolved = gethostbyname(host.c_str());
+  memcpy(&httpAddress.sin_addr, resolved->h_addr_list[0], sizeof(httpAddress.sin_addr));
+
+  std::vector<double> udpUs, httpUs;
+  int udpFailures = 0, httpFailures = 0;
+  for (int i = 0; i < count; i++) {
+    Clock::time_point start = Clock::now();
+    gpioudp::Status status = client.set(gpio, i & 1);
+    if (status == gpioudp::OK) {
+      udpUs.push_back(elapsedUs(start));
+    } else {
+      udpFailures++;
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    Clock::time_point start = Clock::now();
+    if (httpSet(httpAddress, gpio, i & 1) == 200) {
+      httpUs.push_back(elapsedUs(start));
+    } else {
+      httpFailures++;
+    }
+  }
+  stopping = true;
+
+  printf("%-10s %8s %8s %10s %10s %10s %10s\n", "protocol", "ok", "failed", "mean_us", "p50_us", "p99_us", "p999_us");
+  report("udp", udpUs, udpFailures);
+  report("http", httpUs, httpFailures);
+  printf("udp frames resent: %u\n", client.resent());
+  return 0;
+}
@@ -0,0 +1,183 @@
+// Host test for the binary UDP control of html_GPIO_control_dashboard.cpp,
+// on the host build: setup() as gpio_host runs it, with frames injected
+// through simUdpPacket() and laid out with the structs of tools/gpio_udp.h,
+// so the client's layouts are checked against the sketch's as well.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target udp_sim
+//   ./build/udp_sim
+//
+// Checks:
+//
+// - set, mask write and PWM frames are acked ok and drive their pins; a
+//   resend with the same seq gets the cached ack and runs nothing again
+// - an invalid pin and a wrong body length get their status codes
+// - with the actuation task held up, frames are acked ok until the ring is
+//   full; then a set, a mask write and a PWM frame are each acked busy, and
+//   none of them reaches its pin once the task runs again
+// - a busy ack is not cached: the same frames resent with the same seqs are
+//   run, acked ok and drive their pins
+// - once every LEDC channel is taken, a PWM frame for one pin more is acked
+//   no channel, not busy
+// - a pin armed for edge capture is acked invalid for a set and a mask
+//   write and answered 409 by /setgpio, until it is disarmed
+//
+// Exits non-zero on the first violation.
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+
+#include "gpio_udp.h"
+#include "net.h"
+#include "sim.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+void setup();
+extern AsyncUDP udp;
+
+static uint32_t seq = 1000;
+
+static std::mutex stallLock;
+static std::condition_variable stallDone;
+static bool stalled = false;
+
+// Sends one frame and returns its ack's status, or -1 without a valid ack
+template <typename Body>
+static int send(uint8_t type, const Body &body, uint32_t frameSeq, size_t len = sizeof(Body)) {
+  uint8_t frame[sizeof(gpioudp::Header) + sizeof(Body)];
+  gpioudp::Header header = {gpioudp::MAGIC, gpioudp::VERSION, type, 0, frameSeq};
+  memcpy(frame, &header, sizeof(header));
+  memcpy(frame + sizeof(header), &body, sizeof(body));
+  std::vector<std::vector<uint8_t>> replies = simUdpPacket(udp, frame, sizeof(header) + len);
+  gpioudp::Ack ack;
+  if (replies.size() != 1 || replies[0].size() != sizeof(ack)) return -1;
+  memcpy(&ack, replies[0].data(), sizeof(ack));
+  if (ack.header.seq != frameSeq || ack.header.type != (type | gpioudp::ACK)) return -1;
+  return ack.header.status;
+}
+
+static bool level(int gpio) {
+  return simPinLevel(gpio);
+}
+
+// The duty of the LEDC channel driving a pin, or -1 when none is
+static long duty(int gpio) {
+  for (const SimLedcChannel &channel : simLedc.channel) {
+    if (channel.gpio == gpio) return channel.duty;
+  }
+  return -1;
+}
+
+// Lets the actuation task finish what is queued
+static void settle() {
+  delay(20);
+}
+
+int main(int argc, char**) {
+  if (argc > 1) {
+    fprintf(stderr, "usage: udp_sim\n");
+    return 2;
+  }
+  simSerialQuiet = true;
+  simWifi.scanJoinMs = 1; // joined during the run, not while the process exits
+  setup();
+  // Holds the actuation task in its next GPIO_OUT write while stalled
+  simOnOutWrite = [](int, uint32_t) {
+    std::unique_lock<std::mutex> lock(stallLock);
+    stallDone.wait(lock, [] { return !stalled; });
+  };
+
+  // Ok, and a resend answered from the cache
+  gpioudp::Set set = {4, 1, {0, 0}};
+  uint32_t first = ++seq;
+  simCheck("set", send(gpioudp::SET, set, first), gpioudp::OK);
+  settle();
+  if (!level(4)) simFail("GPIO 4 after set high", 0, 1);
+  set.level = 0;
+  simCheck("resent set, same seq", send(gpioudp::SET, gpioudp::Set{4, 1, {0, 0}}, first), gpioudp::OK);
+  simCheck("set low", send(gpioudp::SET, set, ++seq), gpioudp::OK);
+  simCheck("resent set high, same seq as before", send(gpioudp::SET, gpioudp::Set{4, 1, {0, 0}}, first), gpioudp::OK);
+  settle();
+  if (level(4)) simFail("GPIO 4 after a cached resend", 1, 0);
+  gpioudp::Mask mask = {{1u << 13, 0}, {0, 0}};
+  simCheck("mask write", send(gpioudp::MASK, mask, ++seq), gpioudp::OK);
+  gpioudp::Pwm pwm = {18, 8, 128, 5000};
+  simCheck("PWM", send(gpioudp::PWM, pwm, ++seq), gpioudp::OK);
+  settle();
+  if (!level(13)) simFail("GPIO 13 after mask write", 0, 1);
+  if (duty(18) != 128) simFail("GPIO 18 duty after PWM", duty(18), 128);
+  simCheck("set on GPIO 6", send(gpioudp::SET, gpioudp::Set{6, 1, {0, 0}}, ++seq), gpioudp::INVALID);
+  simCheck("short set", send(gpioudp::SET, set, ++seq, sizeof(set) - 1), gpioudp::BAD_FRAME);
+
+  // Fill the ring behind a held-up actuation task
+  {
+    std::lock_guard<std::mutex> lock(stallLock);
+    stalled = true;
+  }
+  int queued = 0;
+  int status = gpioudp::OK;
+  while (status == gpioudp::OK && queued < 200) {
+    status = send(gpioudp::SET, gpioudp::Set{4, (uint8_t)(queued & 1), {0, 0}}, ++seq);
+    queued++;
+  }
+  printf("%d set frames acked ok before the ring was full\n", queued - 1);
+  simCheck("set with the ring full", status, gpioudp::BUSY);
+  uint32_t busySet = ++seq, busyMask = ++seq, busyPwm = ++seq;
+  gpioudp::Set setHigh = {5, 1, {0, 0}};
+  gpioudp::Mask maskHigh = {{1u << 14, 0}, {0, 0}};
+  gpioudp::Pwm pwmOther = {19, 8, 64, 5000};
+  simCheck("set with the ring full", send(gpioudp::SET, setHigh, busySet), gpioudp::BUSY);
+  simCheck("mask write with the ring full", send(gpioudp::MASK, maskHigh, busyMask), gpioudp::BUSY);
+  simCheck("PWM with the ring full", send(gpioudp::PWM, pwmOther, busyPwm), gpioudp::BUSY);
+  {
+    std::lock_guard<std::mutex> lock(stallLock);
+    stalled = false;
+  }
+  stallDone.notify_all();
+  settle();
+  if (level(5)) simFail("GPIO 5 after a busy set", 1, 0);
+  if (level(14)) simFail("GPIO 14 after a busy mask write", 1, 0);
+  if (duty(19) >= 0) simFail("GPIO 19 duty after a busy PWM frame", duty(19), -1);
+
+  // The same frames again, not answered from the cache
+  simCheck("busy set resent", send(gpioudp::SET, setHigh, busySet), gpioudp::OK);
+  simCheck("busy mask write resent", send(gpioudp::MASK, maskHigh, busyMask), gpioudp::OK);
+  simCheck("busy PWM resent", send(gpioudp::PWM, pwmOther, busyPwm), gpioudp::OK);
+  settle();
+  if (!level(5)) simFail("GPIO 5 after the resent set", 0, 1);
+  if (!level(14)) simFail("GPIO 14 after the resent mask write", 0, 1);
+  if (duty(19) != 64) simFail("GPIO 19 duty after the resent PWM frame", duty(19), 64);
+
+  // Every channel taken, then one PWM pin more
+  std::vector<int> pwmPins;
+  status = gpioudp::OK;
+  for (int gpio = 0; gpio < 40 && status != gpioudp::NO_CHANNEL; gpio++) {
+    if (gpio == 4 || gpio == 5 || gpio == 13 || gpio == 14 || gpio == 15 || duty(gpio) >= 0) continue;
+    status = send(gpioudp::PWM, gpioudp::Pwm{(uint8_t)gpio, 8, 32, 5000}, ++seq);
+    if (status == gpioudp::OK) pwmPins.push_back(gpio);
+  }
+  simCheck("PWM without a channel", status, gpioudp::NO_CHANNEL);
+  for (int gpio : pwmPins) {
+    send(gpioudp::SET, gpioudp::Set{(uint8_t)gpio, 0, {0, 0}}, ++seq);
+  }
+  settle();
+
+  // Held by edge capture
+  if (hostRequest("GET", "/edge?gpio=15&mode=both").code != 200) simFail("/edge on GPIO 15", 0, 200);
+  simCheck("set on an armed pin", send(gpioudp::SET, gpioudp::Set{15, 1, {0, 0}}, ++seq), gpioudp::INVALID);
+  simCheck("mask write with an armed pin", send(gpioudp::MASK, gpioudp::Mask{{1u << 15, 0}, {0, 0}}, ++seq),
+         gpioudp::INVALID);
+  HostResponse response = hostRequest("GET", "/setgpio?gpio=15&state=high");
+  if (response.code != 409) simFail("/setgpio on an armed pin", response.code, 409);
+  settle();
+  if (level(15)) simFail("GPIO 15 while armed", 1, 0);
+  hostRequest("GET", "/edge?gpio=15&mode=off");
+  simCheck("set once disarmed", send(gpioudp::SET, gpioudp::Set{15, 1, {0, 0}}, ++seq), gpioudp::OK);
+  settle();
+  if (!level(15)) simFail("GPIO 15 once disarmed", 0, 1);
+
+  return simExit();
+}
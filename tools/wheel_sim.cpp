@@ -0,0 +1,311 @@
+// Host test for the scheduler's timer wheel, run against the real code in
+// gpio_core.h on the host build (host/): scheduleAdd(), scheduleCancel(),
+// and schedulerTick() with the wheelLink() and wheelCascade() under it, on a
+// manual clock.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target wheel_sim
+//   ./build/wheel_sim [-b batches] [-n entries per batch] [-s seed]
+//
+// The clock starts 50 s before millis() wraps. Batches of entries are added
+// at different times, with delays on either side of every level boundary
+// (64 ms, 4096 ms, 262144 ms), at and past WHEEL_MAX_DELAY, 0, a group
+// sharing one deadline, and random delays over the whole range; a quarter
+// have a duration, so their reset goes back into the wheel when they fire.
+// The tool steps the clock to the millisecond before and the millisecond of
+// each deadline and checks, from the schedule events, that:
+//
+// - every set and reset fires once, exactly on its deadline, in that order
+// - nothing fires that was not due, was cancelled, or is not ours
+// - a pending entry's slot still holds it: no other entry overwrote it
+// - cancelling works once, and an expired or cancelled ID cancels nothing
+// - a full pool refuses the next entry and leaves the others untouched
+//
+// Then times inserts into a full pool, expiring them, and an idle tick.
+// Exits non-zero on the first violation.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Tracked {
+  uint32_t id;
+  uint8_t phase;     // the phase that fires next
+  uint32_t due;      // ms it fires on
+  uint32_t expires;  // of the set
+  uint32_t duration;
+  uint8_t gpio;
+};
+
+static std::mt19937 rng(1);
+static std::vector<int> gpios;
+static std::vector<Tracked> live;
+static std::vector<uint32_t> gone; // expired and cancelled IDs
+static uint32_t fires = 0;
+static uint32_t cascades = 0;
+
+static void fail(const char* what, uint32_t id, long got, long want) {
+  simFailf("%s: id %u got %ld, expected %ld", what, id, got, want);
+}
+
+// Which of two times, as millis() values around now, comes first
+static bool before(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+static void advanceTo(uint32_t ms) {
+  simAdvanceUs((int64_t)(uint32_t)(ms - (uint32_t)millis()) * 1000);
+}
+
+static uint32_t tick() {
+  uint32_t from = wheelNow;
+  schedulerTick();
+  // Level 1 and up cascade once every WHEEL_SIZE ms passed
+  cascades += ((wheelNow >> WHEEL_BITS) - (from >> WHEEL_BITS)) & (UINT32_MAX >> WHEEL_BITS);
+  return millis();
+}
+
+static std::vector<ScheduleEvent> drainEvents() {
+  std::vector<ScheduleEvent> events(scheduleEvents, scheduleEvents + scheduleEventCount);
+  scheduleEventCount = 0;
+  return events;
+}
+
+static uint32_t add(uint32_t delayMs, uint32_t duration) {
+  GpioCommand cmd = {};
+  cmd.op = rng() & 1 ? OP_HIGH : OP_LOW;
+  cmd.gpio = gpios[rng() % gpios.size()];
+  cmd.duration = duration;
+  uint32_t expires = millis() + delayMs;
+  // Overdue entries go into the slot the next tick runs
+  uint32_t due = before(expires, wheelNow) ? wheelNow : expires;
+  uint32_t id = scheduleAdd(cmd, delayMs);
+  if (id == 0) {
+    fail("pool exhausted", 0, pendingEntries, SCHEDULER_CAPACITY);
+    return 0;
+  }
+  live.push_back({id, PHASE_SET, due, expires, duration, cmd.gpio});
+  return id;
+}
+
+// Below 1 << bits, log-uniform from WHEEL_SIZE up so every level gets its
+// share. Shorter delays are in the fixed list: many of them would share
+// deadlines, and the event log only holds SCHEDULE_EVENT_LOG fires a tick.
+static uint32_t randomDelay(int bits) {
+  int top = WHEEL_BITS + rng() % (bits - WHEEL_BITS);
+  return (1UL << top) + rng() % (1UL << top);
+}
+
+static void addBatch(int entries) {
+  std::vector<uint32_t> delays = {0, 1, WHEEL_MASK, WHEEL_MAX_DELAY, WHEEL_MAX_DELAY + 1, WHEEL_MAX_DELAY + 123457};
+  for (int level = 1; level < WHEEL_LEVELS; level++) {
+    uint32_t boundary = 1UL << (WHEEL_BITS * level);
+    delays.insert(delays.end(), {boundary - 1, boundary, boundary + 1});
+  }
+  uint32_t group = 1000 + rng() % 100000;
+  for (int i = 0; i < 16; i++) {
+    delays.push_back(group);
+  }
+  while ((int)delays.size() < entries) {
+    delays.push_back(randomDelay(WHEEL_BITS * WHEEL_LEVELS));
+  }
+  for (uint32_t delayMs : delays) {
+    add(delayMs, rng() % 4 ? 0 : randomDelay(20));
+  }
+}
+
+// Every pending entry still sits in its slot of the pool, unchanged
+static void checkPool() {
+  for (const Tracked &t : live) {
+    const ScheduledEntry &entry = scheduleEntries[t.id % SCHEDULER_CAPACITY];
+    if (entry.id != t.id || entry.phase != t.phase || entry.cmd.gpio != t.gpio) {
+      fail("entry overwritten", t.id, entry.id, t.id);
+    }
+  }
+  if (pendingEntries != live.size()) fail("pending count", 0, pendingEntries, live.size());
+}
+
+static void cancelSome() {
+  if (live.empty() || rng() % 8) return;
+  size_t i = rng() % live.size();
+  uint32_t id = live[i].id;
+  if (!scheduleCancel(id)) fail("cancel", id, 0, 1);
+  if (scheduleCancel(id)) fail("cancelled twice", id, 1, 0);
+  gone.push_back(id);
+  live.erase(live.begin() + i);
+  uint32_t stale = gone[rng() % gone.size()];
+  if (scheduleCancel(stale)) fail("stale ID cancelled an entry", stale, 1, 0);
+}
+
+// Steps to each deadline in turn until nothing is pending
+static void run(int batches, int entries) {
+  while (!live.empty() || batches > 0) {
+    if (batches > 0 && live.size() < (size_t)entries) {
+      addBatch(entries);
+      batches--;
+    }
+    uint32_t now = millis();
+    uint32_t next = live.front().due;
+    for (const Tracked &t : live) {
+      if (before(t.due, next)) next = t.due;
+    }
+    if (before(now, next - 1)) {
+      advanceTo(next - 1);
+      tick();
+      for (const ScheduleEvent &event : drainEvents()) {
+        fail("fired early", event.id, (long)millis(), next);
+      }
+    }
+    advanceTo(next);
+    uint32_t at = tick();
+    for (const ScheduleEvent &event : drainEvents()) {
+      auto it = std::find_if(live.begin(), live.end(), [&](const Tracked &t) { return t.id == event.id; });
+      if (it == live.end()) {
+        fail("fired an entry that was not pending", event.id, at, 0);
+        continue;
+      }
+      fires++;
+      if (it->due != at) fail("fired off its deadline", event.id, at, it->due);
+      if (event.phase != it->phase) fail("phase", event.id, event.phase, it->phase);
+      if (it->phase == PHASE_SET && it->duration > 0) {
+        // The reset is due duration after the set's expiry, at the earliest now
+        uint32_t resetDue = it->expires + it->duration;
+        it->phase = PHASE_RESET;
+        it->due = before(resetDue, at) ? at : resetDue;
+      } else {
+        gone.push_back(it->id);
+        live.erase(it);
+      }
+    }
+    for (auto it = live.begin(); it != live.end();) {
+      if (before(at, it->due)) {
+        ++it;
+        continue;
+      }
+      fail("missed its deadline", it->id, at, it->due);
+      scheduleCancel(it->id); // out of the way, so the run goes on
+      it = live.erase(it);
+    }
+    if (scheduleEventsDropped) {
+      fail("schedule events dropped, fires unchecked", 0, scheduleEventsDropped, 0);
+      scheduleEventsDropped = 0;
+    }
+    checkPool();
+    cancelSome();
+  }
+}
+
+// A full pool turns the next entry away and keeps the ones it has
+static void exhaust() {
+  // Spread out, for the event log
+  for (uint32_t delayMs = 1000; pendingEntries < SCHEDULER_CAPACITY; delayMs += 1 + rng() % 50) {
+    add(delayMs, 0);
+  }
+  GpioCommand cmd = {};
+  cmd.op = OP_HIGH;
+  cmd.gpio = gpios[0];
+  if (scheduleAdd(cmd, 5) != 0) fail("added to a full pool", 0, 1, 0);
+  checkPool();
+  run(0, 0);
+}
+
+static double nsSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void throughput() {
+  scheduleEventListeners = 0;
+  GpioCommand cmd = {};
+  cmd.gpio = gpios[0];
+  std::vector<uint32_t> delays(SCHEDULER_CAPACITY);
+  for (uint32_t &delayMs : delays) {
+    delayMs = randomDelay(22);
+  }
+  uint32_t last = *std::max_element(delays.begin(), delays.end());
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t delayMs : delays) {
+    cmd.op = delayMs & 1 ? OP_HIGH : OP_LOW;
+    scheduleAdd(cmd, delayMs);
+  }
+  double insertNs = nsSince(t0) / SCHEDULER_CAPACITY;
+
+  // Expiry, with the cascades and the inline writes, in 1 s catch-ups
+  uint32_t start = millis();
+  double tickNs = 0;
+  while (before(millis(), start + last)) {
+    advanceTo(std::min<uint32_t>(millis() + 1000, start + last));
+    t0 = std::chrono::steady_clock::now();
+    schedulerTick();
+    tickNs += nsSince(t0);
+  }
+  if (pendingEntries > 0) {
+    fail("entries left after the last deadline", 0, pendingEntries, 0);
+    return;
+  }
+
+  // The same span with nothing pending, to take out of the above
+  double idleNs = 0;
+  for (uint32_t ms = 0; ms < last; ms += 1000) {
+    advanceTo(millis() + 1000);
+    t0 = std::chrono::steady_clock::now();
+    schedulerTick();
+    idleNs += nsSince(t0);
+  }
+  printf("%d entries: insert %.0f ns, expire %.0f ns each; idle tick %.1f ns per ms (this host)\n",
+         SCHEDULER_CAPACITY, insertNs, (tickNs - idleNs) / SCHEDULER_CAPACITY, idleNs / last);
+}
+
+int main(int argc, char **argv) {
+  int batches = 12;
+  int entries = 200;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-b" && hasValue) {
+      batches = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-n" && hasValue) {
+      entries = std::min(SCHEDULER_CAPACITY / 2, std::max(40, atoi(argv[++i])));
+    } else if (arg == "-s" && hasValue) {
+      rng.seed(strtoul(argv[++i], NULL, 10));
+    } else {
+      fprintf(stderr, "usage: wheel_sim [-b batches] [-n entries per batch] [-s seed]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  simManualClock((int64_t)(0x100000000LL - 50000) * 1000); // millis() wraps 50 s in
+  ledcPoolBegin();
+  // What schedulerBegin() sets up, minus the ticker: the tool runs the ticks
+  for (int i = 0; i < WHEEL_LEVELS * WHEEL_SIZE; i++) {
+    wheelSlots[i] = ENTRY_NONE;
+  }
+  for (int i = SCHEDULER_CAPACITY - 1; i >= 0; i--) {
+    scheduleEntries[i].phase = PHASE_FREE;
+    scheduleEntries[i].next = freeEntry;
+    freeEntry = i;
+  }
+  wheelNow = millis();
+  scheduleEventListeners = 1;
+
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT && gpios.size() < 8; gpio++) {
+    if (pinCanOutput(gpio)) gpios.push_back(gpio);
+  }
+
+  uint32_t startMs = millis();
+  run(batches, entries);
+  printf("%u fires over %u ms from %u, %u level 1 cascades, %zu IDs retired\n", fires, (uint32_t)millis() - startMs, startMs,
+         cascades, gone.size());
+  exhaust();
+  printf("full pool: %d entries kept, the next one refused\n", SCHEDULER_CAPACITY);
+  if (scheduleDropped) fail("scheduled commands dropped", 0, scheduleDropped, 0);
+  throughput();
+
+  return simExit();
+}
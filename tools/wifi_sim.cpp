@@ -0,0 +1,276 @@
+// Host test for the Wi-Fi link state machine: wifiJoin() and wifiStep()
+// from gpio_core.h, built on the host build (host/).
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target wifi_sim
+//   ./build/wifi_sim [-s seed] [-v]
+//
+// Plays wifiLoop() against a simulated driver and access point, ticking a
+// clock in 10 ms steps the way loop() runs. The driver answers a cached
+// join in 300 ms and a scanning one in 2.5 s when the AP is where it
+// expects, says nothing when a cached join aims at the wrong channel and
+// reports a disconnect when the AP is gone. Scripted scenarios cover a
+// first boot, drops with a fast cached rejoin, an AP that moved channel, an
+// AP that is down for minutes, a flapping link and a driver that never
+// answers. Checks the join kind, the counters and the backoff bounds.
+// Exits non-zero on the first violation; -v prints every action.
+
+#include "gpio_core.h"
+#include "sim.h"
+
+#include <random>
+#include <string>
+
+const char* const actionNames[] = {"none", "join cached", "join scan", "stop", "save"};
+
+#define TICK_MS 10
+#define CACHED_JOIN_MS 300
+#define SCAN_JOIN_MS 2500
+#define NO_EVENT 0xFFFFFFFF
+
+// The driver and the access point
+struct World {
+  bool apUp;
+  bool silent;            // the driver never reports anything
+  uint8_t apChannel;
+  uint8_t cacheChannel;   // 0 when nothing is cached
+  bool connected;
+  uint8_t event;          // what the driver reports at eventAt
+  uint32_t eventAt;
+};
+
+static World world;
+static WifiLink link;
+static uint32_t now;
+static std::mt19937 rng;
+static bool verbose = false;
+static int joins[3];      // by LinkAction: cached, scan
+static uint32_t lastWait;
+
+static void fail(const char* scenario, const char* what) {
+  simFailf("%s: %s at %u ms (state %s, failures %u)", scenario, what, now, linkStateNames[link.state], link.failures);
+}
+
+// What the driver does for an action of wifiLoop()
+static void drive(LinkAction action) {
+  if (verbose && action != LINK_NONE) printf("%8u ms  %s\n", now, actionNames[action]);
+  switch (action) {
+    case LINK_JOIN_CACHED:
+    case LINK_JOIN_SCAN: {
+      joins[action - LINK_JOIN_CACHED]++;
+      world.connected = false;
+      world.eventAt = NO_EVENT;
+      if (world.silent) break;
+      bool cached = action == LINK_JOIN_CACHED;
+      if (world.apUp && (!cached || world.cacheChannel == world.apChannel)) {
+        world.event = LINK_GOT_IP;
+        world.eventAt = now + (cached ? CACHED_JOIN_MS : SCAN_JOIN_MS);
+      } else if (!world.apUp) {
+        world.event = LINK_LOST;
+        world.eventAt = now + (cached ? CACHED_JOIN_MS : SCAN_JOIN_MS);
+      }
+      break;
+    }
+    case LINK_STOP:
+      world.connected = false;
+      world.eventAt = NO_EVENT;
+      lastWait = link.wait;
+      break;
+    case LINK_SAVE:
+      world.cacheChannel = world.apChannel;
+      break;
+    default:
+      break;
+  }
+}
+
+// One pass of loop(): the pending driver event, if due, then wifiStep()
+static void tick() {
+  uint8_t event = LINK_TICK;
+  if (world.eventAt != NO_EVENT && (int32_t)(now - world.eventAt) >= 0) {
+    event = world.event;
+    world.connected = event == LINK_GOT_IP && world.apUp;
+    world.eventAt = NO_EVENT;
+  }
+  drive(wifiStep(link, event, now, world.cacheChannel != 0, rng()));
+}
+
+static void run(uint32_t ms) {
+  for (uint32_t end = now + ms; now != end; now += TICK_MS) {
+    tick();
+  }
+}
+
+// Runs at least one pass, then until the link is up or ms have passed;
+// returns the time taken
+static uint32_t runUntilUp(uint32_t ms) {
+  uint32_t start = now;
+  do {
+    tick();
+    now += TICK_MS;
+  } while (link.state != LINK_UP && now - start < ms);
+  return now - start;
+}
+
+// The AP drops the connection
+static void apDrop() {
+  if (world.connected) {
+    world.connected = false;
+    world.event = LINK_LOST;
+    world.eventAt = now;
+  }
+}
+
+static void reset(uint8_t cacheChannel) {
+  world = World();
+  world.apUp = true;
+  world.apChannel = 6;
+  world.cacheChannel = cacheChannel;
+  world.eventAt = NO_EVENT;
+  link = WifiLink();
+  joins[0] = joins[1] = 0;
+  now = 0;
+}
+
+static void expect(const char* scenario, bool ok, const char* what) {
+  if (!ok) fail(scenario, what);
+}
+
+int main(int argc, char **argv) {
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-s" && i + 1 < argc) {
+      seed = strtoul(argv[++i], NULL, 0);
+    } else if (arg == "-v") {
+      verbose = true;
+    } else {
+      fprintf(stderr, "usage: wifi_sim [-s seed] [-v]\n");
+      return 2;
+    }
+  }
+  rng.seed(seed);
+
+  // First boot: nothing cached, so the first join scans
+  const char* scenario = "first boot";
+  reset(0);
+  uint32_t took = runUntilUp(20000);
+  expect(scenario, link.state == LINK_UP, "never came up");
+  expect(scenario, joins[0] == 0 && joins[1] == 1, "did not join with a single scan");
+  expect(scenario, link.lastConnectMs == SCAN_JOIN_MS, "join time not recorded");
+  expect(scenario, world.cacheChannel == 6, "BSSID/channel not cached");
+  printf("%-20s up in %u ms\n", scenario, took);
+
+  // Boot with a good cache: a cached join, no scan
+  scenario = "cached boot";
+  reset(6);
+  took = runUntilUp(20000);
+  expect(scenario, joins[0] == 1 && joins[1] == 0, "did not join from the cache");
+  expect(scenario, took <= CACHED_JOIN_MS + TICK_MS, "cached join too slow");
+  printf("%-20s up in %u ms\n", scenario, took);
+
+  // A drop rejoins at once from the cache
+  scenario = "drop";
+  run(5000);
+  apDrop();
+  uint32_t dropAt = now;
+  took = runUntilUp(20000);
+  expect(scenario, link.drops == 1 && link.connects == 2, "counters off");
+  expect(scenario, joins[0] == 2 && joins[1] == 0, "did not rejoin from the cache");
+  expect(scenario, link.lastOutageMs <= CACHED_JOIN_MS + TICK_MS, "outage too long");
+  expect(scenario, link.lastOutageMs == now - TICK_MS - dropAt, "outage not measured from the drop");
+  printf("%-20s back in %u ms\n", scenario, link.lastOutageMs);
+
+  // The AP moved to another channel: the cached join times out, a scan
+  // finds it, and the next drop uses the new cache
+  scenario = "channel change";
+  world.apChannel = 11;
+  apDrop();
+  took = runUntilUp(60000);
+  expect(scenario, link.state == LINK_UP, "never came up");
+  expect(scenario, joins[0] == 3 && joins[1] == 1, "no scan after the cached join failed");
+  expect(scenario, link.failed == 1 && link.failures == 0, "failure counters off");
+  expect(scenario, took <= WIFI_CACHED_TIMEOUT_MS + SCAN_JOIN_MS + 2 * TICK_MS, "fallback too slow");
+  expect(scenario, world.cacheChannel == 11, "cache not updated");
+  printf("%-20s back in %u ms\n", scenario, took);
+  run(1000);
+  apDrop();
+  took = runUntilUp(20000);
+  expect(scenario, joins[0] == 4 && joins[1] == 1 && took <= CACHED_JOIN_MS + TICK_MS,
+         "did not go back to cached joins");
+
+  // The AP is down for five minutes: joins back off, doubling from 1 s up
+  // to 60 s with jitter, and the link recovers within one wait of its return
+  scenario = "ap down";
+  world.apUp = false;
+  apDrop();
+  world.event = LINK_LOST;
+  world.eventAt = now;
+  uint32_t downAt = now;
+  int joinsBefore = joins[0] + joins[1];
+  uint32_t nominal = WIFI_BACKOFF_MIN_MS;
+  int waits = 0;
+  uint32_t minWait = 0xFFFFFFFF, maxWait = 0;
+  while (now - downAt < 300000) {
+    lastWait = 0;
+    uint8_t failuresBefore = link.failures;
+    tick();
+    now += TICK_MS;
+    if (lastWait == 0) continue;
+    // Cached joins fall straight through to a scan; only scans back off
+    if (lastWait < nominal / 2 || lastWait > nominal) fail(scenario, "wait outside [nominal/2, nominal]");
+    if (link.failures != failuresBefore + 1) fail(scenario, "failures not counted");
+    if (nominal == WIFI_BACKOFF_MAX_MS) {
+      minWait = lastWait < minWait ? lastWait : minWait;
+      maxWait = lastWait > maxWait ? lastWait : maxWait;
+    }
+    nominal = nominal * 2 < WIFI_BACKOFF_MAX_MS ? nominal * 2 : WIFI_BACKOFF_MAX_MS;
+    waits++;
+  }
+  expect(scenario, link.state != LINK_UP, "came up with the AP down");
+  expect(scenario, nominal == WIFI_BACKOFF_MAX_MS && waits >= 6, "backoff never reached its cap");
+  expect(scenario, maxWait > minWait, "no jitter at the cap");
+  int joinsWhileDown = joins[0] + joins[1] - joinsBefore;
+  world.apUp = true;
+  took = runUntilUp(WIFI_BACKOFF_MAX_MS + WIFI_CACHED_TIMEOUT_MS + SCAN_JOIN_MS + 1000);
+  expect(scenario, link.state == LINK_UP, "did not recover");
+  expect(scenario, link.failures == 0, "failures not reset");
+  expect(scenario, link.lastOutageMs == now - TICK_MS - downAt, "outage not measured from the drop");
+  printf("%-20s %u backoffs in 5 min, waits at the cap %u-%u ms, %d joins, back %u ms after the AP\n", scenario,
+         waits, minWait, maxWait, joinsWhileDown, took);
+
+  // Flapping: a drop every two seconds rejoins from the cache every time
+  // and never backs off
+  scenario = "flapping";
+  reset(6);
+  runUntilUp(20000);
+  for (int i = 0; i < 50; i++) {
+    run(2000);
+    apDrop();
+    runUntilUp(20000);
+    if (link.lastOutageMs > CACHED_JOIN_MS + TICK_MS) fail(scenario, "slow rejoin");
+  }
+  expect(scenario, link.drops == 50 && link.connects == 51, "counters off");
+  expect(scenario, joins[1] == 0 && link.failed == 0, "fell back to scanning");
+  expect(scenario, link.maxConnectMs <= CACHED_JOIN_MS + TICK_MS, "max connect time off");
+  printf("%-20s %u drops, %u connects, max join %u ms\n", scenario, link.drops, link.connects, link.maxConnectMs);
+
+  // A driver that never answers: the cached join times out after 3 s, the
+  // scan after 15 s, then it backs off
+  scenario = "timeouts";
+  reset(6);
+  world.silent = true;
+  uint32_t stopAt = 0;
+  while (stopAt == 0 && now < 60000) {
+    lastWait = 0;
+    tick();
+    if (lastWait) stopAt = now;
+    now += TICK_MS;
+  }
+  expect(scenario, stopAt == WIFI_CACHED_TIMEOUT_MS + WIFI_SCAN_TIMEOUT_MS, "timeouts off");
+  expect(scenario, joins[0] == 1 && joins[1] == 1 && link.failed == 2, "join sequence off");
+  expect(scenario, link.state == LINK_BACKOFF, "not backing off");
+  printf("%-20s gave up after %u ms, backing off %u ms\n", scenario, stopAt, link.wait);
+
+  return simExit();
+}
@@ -0,0 +1,317 @@
+// Host test for the WebSocket channel of html_GPIO_control_dashboard.cpp:
+// setup() as gpio_host runs it, in-process clients on the sketch's /ws
+// (host/ESPAsyncWebServer.h), and wsPush() called as loop() calls it.
+//
+// Build and run (Linux/macOS):
+//   cmake -S . -B build && cmake --build build --target ws_sim
+//   ./build/ws_sim [-n round trips] [-c connects in the race]
+//
+// Checks:
+//
+// - round trip: a command frame gets its reply, and the change reaches the
+//   client in the next push; reports the time from command to update
+// - fan-out: every client gets the same update frame, a new one a snapshot
+//   first, one past WS_MAX_CLIENTS is closed with 1013, and one whose send
+//   queue is full is skipped and then sent a snapshot instead of the delta
+// - the largest frames: all pins changed, PWM with 16-bit duties, a full
+//   schedule event log, and a client due a snapshot in the same push. Every
+//   frame must be complete JSON, with every pin in it.
+// - connects, commands and disconnects on one thread (async_tcp) racing
+//   pushes on another (the loop task): the subscriber count matches the
+//   clients left, and each client's first push is a snapshot. Build with
+//   -DSANITIZE=thread to check the subscriber table for data races.
+//
+// Exits non-zero on the first violation.
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <soc/soc_caps.h>
+
+#include "sim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+void setup();
+void wsPush();
+extern AsyncWebSocket ws;
+extern int wsSubscriberCount;
+
+static void fail(const char* check, const std::string &what) {
+  simFailf("%s: %s", check, what.c_str());
+}
+
+// One JSON object, brackets balanced outside strings and closed by its last
+// character: what a truncated frame is not
+static bool wellFormed(const std::string &frame) {
+  int depth = 0;
+  bool inString = false;
+  for (size_t i = 0; i < frame.size(); i++) {
+    char c = frame[i];
+    if (inString) {
+      inString = c != '"';
+    } else if (c == '"') {
+      inString = true;
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (--depth < 0 || (depth == 0 && i != frame.size() - 1)) return false;
+    }
+  }
+  return frame.size() > 1 && frame[0] == '{' && depth == 0 && !inString;
+}
+
+static size_t count(const std::string &text, const std::string &what) {
+  size_t n = 0;
+  for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1)) n++;
+  return n;
+}
+
+static bool isPush(const std::string &frame) {
+  return frame.compare(0, 9, "{\"event\":") == 0;
+}
+
+static std::vector<std::string> pushes(AsyncWebSocketClient* client) {
+  std::vector<std::string> frames;
+  for (const std::string &frame : client->received_) {
+    if (isPush(frame)) frames.push_back(frame);
+  }
+  return frames;
+}
+
+// Pushes until the client has more than `have` frames, as loop() would
+static bool pumpUntil(AsyncWebSocketClient* client, size_t have, int ms = 1000) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  while (client->received_.size() <= have) {
+    if (std::chrono::steady_clock::now() > end) return false;
+    wsPush();
+    if (client->received_.size() <= have) std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+  return true;
+}
+
+static std::vector<int> outputPins() {
+  std::vector<int> gpios;
+  for (int gpio = 0; gpio < SOC_GPIO_PIN_COUNT; gpio++) {
+    std::string reply = "s " + std::to_string(gpio) + " low";
+    AsyncWebSocketClient* probe = ws.simConnect();
+    ws.simMessage(probe, reply.c_str());
+    if (!probe->received_.empty() && probe->received_.back().find("success") != std::string::npos) gpios.push_back(gpio);
+    ws.simDisconnect(probe);
+  }
+  return gpios;
+}
+
+static void roundTrip(int trips, int gpio) {
+  AsyncWebSocketClient* client = ws.simConnect();
+  wsPush();
+  std::vector<std::string> first = pushes(client);
+  if (first.size() != 1 || first[0].compare(0, 20, "{\"event\":\"snapshot\",") != 0) {
+    fail("round trip", "first frame is not a snapshot");
+  }
+  std::vector<double> us;
+  for (int i = 0; i < trips; i++) {
+    bool high = i & 1;
+    std::string command = "s " + std::to_string(gpio) + (high ? " high" : " low");
+    std::string reply = "{\"gpio\":" + std::to_string(gpio) + ",\"state\":\"" + (high ? "HIGH" : "LOW") +
+                        "\",\"status\":\"success\"}";
+    std::string update = "{\"gpio\":" + std::to_string(gpio) + ",\"state\":\"" + (high ? "HIGH" : "LOW") + "\"}";
+    size_t have = client->received_.size();
+    auto t0 = std::chrono::steady_clock::now();
+    ws.simMessage(client, command.c_str());
+    if (client->received_.size() != have + 1 || client->received_.back() != reply) {
+      fail("round trip", "reply " + (client->received_.size() > have ? client->received_.back() : "missing"));
+      break;
+    }
+    if (!pumpUntil(client, have + 1)) {
+      fail("round trip", "no update after " + command);
+      break;
+    }
+    us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+    const std::string &frame = client->received_.back();
+    if (frame.find(update) == std::string::npos || !wellFormed(frame)) fail("round trip", "update " + frame);
+  }
+  ws.simDisconnect(client);
+  if (us.empty()) return;
+  std::sort(us.begin(), us.end());
+  printf("round trip: %zu commands, command to update %.1f us median, %.1f us p99 on this host\n", us.size(),
+         us[us.size() / 2], us[us.size() * 99 / 100]);
+}
+
+static void fanOut(int gpio) {
+  std::vector<AsyncWebSocketClient*> clients;
+  for (int i = 0; i < 8; i++) clients.push_back(ws.simConnect());
+  AsyncWebSocketClient* extra = ws.simConnect();
+  if (!extra->closed_ || extra->closeCode_ != 1013) fail("fan-out", "client past the limit not closed with 1013");
+  ws.simDisconnect(extra);
+  if (wsSubscriberCount != 8) fail("fan-out", "subscribers " + std::to_string(wsSubscriberCount));
+  wsPush();
+  for (AsyncWebSocketClient* client : clients) {
+    if (pushes(client).size() != 1 || pushes(client)[0].find("\"snapshot\"") == std::string::npos) {
+      fail("fan-out", "new client without a snapshot");
+    }
+  }
+
+  // One client's queue is full for this change
+  clients[3]->queueFull_ = true;
+  size_t have = clients[0]->received_.size();
+  std::string command = "s " + std::to_string(gpio) + " high";
+  ws.simMessage(clients[0], command.c_str());
+  if (!pumpUntil(clients[0], have + 1)) fail("fan-out", "no update");
+  std::string delta = clients[0]->received_.back();
+  for (size_t i = 1; i < clients.size(); i++) {
+    std::vector<std::string> frames = pushes(clients[i]);
+    if (i == 3) {
+      if (frames.size() != 1) fail("fan-out", "full client was sent " + std::to_string(frames.size() - 1) + " frames");
+    } else if (frames.size() != 2 || frames.back() != delta) {
+      fail("fan-out", "client " + std::to_string(i) + " did not get the same update");
+    }
+  }
+  clients[3]->queueFull_ = false;
+  wsPush();
+  std::vector<std::string> frames = pushes(clients[3]);
+  if (frames.size() != 2 || frames.back().find("\"snapshot\"") == std::string::npos) {
+    fail("fan-out", "drained client was not sent a snapshot");
+  }
+  size_t others = pushes(clients[0]).size();
+  wsPush();
+  if (pushes(clients[0]).size() != others) fail("fan-out", "push with nothing to send");
+
+  // A slot freed by a disconnect is reused
+  ws.simDisconnect(clients[5]);
+  if (wsSubscriberCount != 7) fail("fan-out", "subscribers after a disconnect " + std::to_string(wsSubscriberCount));
+  clients[5] = ws.simConnect();
+  if (clients[5]->closed_) fail("fan-out", "free slot not reused");
+  printf("fan-out: 8 clients, identical %zu-byte update, full queue skipped then resynced\n", delta.size());
+  for (AsyncWebSocketClient* client : clients) ws.simDisconnect(client);
+}
+
+// Everything changes at once, with 16-bit duties and more schedule events
+// than the log holds, while a new client is due a snapshot
+static void largestFrames(const std::vector<int> &gpios) {
+  AsyncWebSocketClient* steady = ws.simConnect();
+  AsyncWebSocketClient* control = ws.simConnect();
+  wsPush();
+  std::vector<int> pwm;
+  for (int gpio : gpios) {
+    std::string command = "s " + std::to_string(gpio) + " pwm65535 1000 16";
+    ws.simMessage(control, command.c_str());
+    if (control->received_.back().find("success") != std::string::npos) {
+      pwm.push_back(gpio);
+    } else {
+      command = "s " + std::to_string(gpio) + " high";
+      ws.simMessage(control, command.c_str());
+    }
+  }
+  // More events than the log holds, each with the longest state
+  for (int i = 0; i < 40; i++) {
+    std::string command = "t " + std::to_string(pwm[i % pwm.size()]) + " pwm65535 1 0 1000 16";
+    ws.simMessage(control, command.c_str());
+  }
+  delay(100); // every schedule fires
+  AsyncWebSocketClient* fresh = ws.simConnect();
+  size_t have = steady->received_.size();
+  wsPush();
+
+  if (steady->received_.size() != have + 1) {
+    fail("largest frames", "no update");
+  } else {
+    const std::string &delta = steady->received_.back();
+    if (!wellFormed(delta)) fail("largest frames", "update is not complete JSON: ..." + delta.substr(delta.size() - 40));
+    if (count(delta, "{\"gpio\":") != gpios.size()) {
+      fail("largest frames", "update has " + std::to_string(count(delta, "{\"gpio\":")) + " pins");
+    }
+    if (delta.find("\"dropped\":0}") != std::string::npos) fail("largest frames", "event log did not overflow");
+    if (pushes(fresh).size() != 1) {
+      fail("largest frames", "no snapshot");
+    } else {
+      std::string snapshot = pushes(fresh)[0];
+      if (!wellFormed(snapshot)) fail("largest frames", "snapshot is not complete JSON");
+      if (count(snapshot, "{\"gpio\":") != gpios.size()) fail("largest frames", "snapshot is missing pins");
+      printf("largest frames: %zu pins (%zu PWM), update %zu bytes and snapshot %zu bytes in one push\n", gpios.size(),
+             pwm.size(), delta.size(), snapshot.size());
+    }
+  }
+  ws.simDisconnect(steady);
+  ws.simDisconnect(control);
+  ws.simDisconnect(fresh);
+}
+
+// async_tcp connects, commands and disconnects while the loop task pushes
+static void race(int connects, const std::vector<int> &gpios) {
+  std::atomic<bool> stop(false);
+  std::thread loopTask([&] {
+    while (!stop) {
+      wsPush();
+      ws.cleanupClients();
+    }
+  });
+  std::vector<AsyncWebSocketClient*> open, all;
+  uint32_t seed = 1;
+  for (int i = 0; i < connects; i++) {
+    seed = seed * 1103515245 + 12345;
+    AsyncWebSocketClient* client = ws.simConnect();
+    all.push_back(client);
+    if (client->closed_) {
+      ws.simDisconnect(client);
+    } else {
+      open.push_back(client);
+      std::string command = "s " + std::to_string(gpios[seed % gpios.size()]) + (seed & 0x100 ? " high" : " low");
+      ws.simMessage(client, command.c_str());
+    }
+    if (open.size() > 2 && seed % 3 == 0) {
+      size_t which = (seed >> 8) % open.size();
+      ws.simDisconnect(open[which]);
+      open.erase(open.begin() + which);
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  stop = true;
+  loopTask.join();
+
+  if (wsSubscriberCount != (int)open.size()) {
+    fail("race", "subscribers " + std::to_string(wsSubscriberCount) + ", clients " + std::to_string(open.size()));
+  }
+  size_t frames = 0;
+  for (AsyncWebSocketClient* client : all) {
+    std::vector<std::string> p = pushes(client);
+    frames += p.size();
+    if (!p.empty() && p[0].find("\"snapshot\"") == std::string::npos) fail("race", "first push is not a snapshot");
+    for (const std::string &frame : p) {
+      if (!wellFormed(frame)) fail("race", "frame is not complete JSON");
+    }
+  }
+  for (AsyncWebSocketClient* client : open) ws.simDisconnect(client);
+  printf("race: %d connects, %zu pushed frames, %zu clients left\n", connects, frames, open.size());
+}
+
+int main(int argc, char** argv) {
+  int trips = 2000;
+  int connects = 2000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-n" && hasValue) {
+      trips = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-c" && hasValue) {
+      connects = std::max(1, atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: ws_sim [-n round trips] [-c connects in the race]\n");
+      return 2;
+    }
+  }
+
+  simSerialQuiet = true;
+  setup();
+  std::vector<int> gpios = outputPins();
+  wsPush();
+  roundTrip(trips, gpios[0]);
+  fanOut(gpios[1]);
+  largestFrames(gpios);
+  race(connects, gpios);
+  return simExit();
+}